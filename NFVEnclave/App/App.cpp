@@ -31,7 +31,7 @@
 #include <stdio.h>
 #include <string.h>
 #include <assert.h>
-#include <sys/time.h>
+#include <time.h>
 # include <unistd.h>
 # include <pwd.h>
 # define MAX_PATH FILENAME_MAX
@@ -46,12 +46,32 @@
 #include <cstring>
 #include <cwchar>
 #include <fstream>
+#include <random>
+#include <vector>
 #include "sample_libcrypto.h"
+#include "nf_gcm.h"
+#include "nf_session.h"
+#include "Driver/Options.h"
+#include "Driver/Switchless.h"
+#include "Driver/Ring.h"
+#include "Driver/Log.h"
+#include "Driver/Ruleset.h"
+#include "Driver/Pool.h"
+#include "Driver/Corpus.h"
+#include "Driver/Pcap.h"
+#include "Driver/Pipeline.h"
+#include "Driver/Buffers.h"
+#include "Driver/Sched.h"
+#include "Benchmark/Nf.h"
+#include "Benchmark/Ab.h"
+#include "Benchmark/Load.h"
 
 //int encrypt_file(char* pcapdir);
 /* Global EID shared by multiple threads */
 sgx_enclave_id_t global_eid = 0;
 
+const uint8_t app_data_key[16] = {0x87, 0xA6, 0x0B, 0x39, 0xD5, 0x26, 0xAB, 0x1C, 0x30, 0x9E, 0xEC, 0x60, 0x6C, 0x72, 0xBA, 0x36};
+
 typedef struct _sgx_errlist_t {
     sgx_status_t err;
     const char *msg;
@@ -171,16 +191,38 @@ size_t GetFileSize(char* filename)
     return size;
 }
 
+/* Sequence number the IVs of the pages start at: random, in the inbound half */
+static uint64_t app_page_seq_start(void)
+{
+    std::random_device rd;
+    uint64_t seq = ((uint64_t) rd() << 32) | rd();
+
+    return seq >> 2;
+}
+
+/* app_page_iv:
+ *   Takes the next IV to encrypt a page under app_data_key with:
+ *   NF_SESSION_DEFAULT_FLOW || seq, seq one more for every page. The
+ *   sequence numbers start at a random point in the inbound half, so two
+ *   runs under the same key do not meet and neither does the enclave's
+ *   output, whose sequence numbers have the top bit set.
+ */
+void app_page_iv(uint8_t* iv)
+{
+    static uint64_t next = app_page_seq_start();
+
+    nf_gcm_make_iv(iv, NF_SESSION_DEFAULT_FLOW, __atomic_fetch_add(&next, 1, __ATOMIC_RELAXED));
+}
+
 /* Initialize the enclave:
- *   Call sgx_create_enclave to initialize an enclave instance
+ *   Call sgx_create_enclave to initialize an enclave instance, with the
+ *   switchless worker pools if --switchless was given
  */
-int initialize_enclave(void)
+int initialize_enclave(const APP_OPTIONS_t *opts)
 {
     sgx_status_t ret = SGX_ERROR_UNEXPECTED;
 
-    /* Call sgx_create_enclave to initialize an enclave instance */
-    /* Debug Support: set 2nd parameter to 1 */
-    ret = sgx_create_enclave(ENCLAVE_FILENAME, SGX_DEBUG_FLAG, NULL, NULL, &global_eid, NULL);
+    ret = app_create_enclave(ENCLAVE_FILENAME, opts, opts->switchless, &global_eid);
     if (ret != SGX_SUCCESS) {
         print_error_message(ret);
         return -1;
@@ -198,134 +240,567 @@ void ocall_print_string(const char *str)
     printf("%s", str);
 }
 
+/* Pages encrypted by one nf_gcm_encrypt_mb() call as the directory is read */
+#define APP_PAGE_GROUP (NF_GCM_WAYS * 8)
+
+/* Takes pages[first..], encrypted, once a group is full; 0 to go on */
+typedef int (*app_group_f)(std::vector<WEB_PAGE_t>& pages, size_t first, void *arg);
+
+/* encrypt_pages:
+ *   Encrypts pages[first..] in one multi-buffer batch and gives their
+ *   cleartexts back to the pool: only the ciphertexts stay.
+ */
+static void encrypt_pages(std::vector<WEB_PAGE_t>& pages, size_t first)
+{
+    std::vector<NF_GCM_JOB_t> jobs(pages.size() - first);
+    NF_GCM_KEY_t key;
+
+    nf_gcm_key_init(&key, app_data_key);
+    for (size_t i = 0; i < jobs.size(); i++) {
+        WEB_PAGE_t *page = &pages[first + i];
+        app_page_iv(page->iv);
+        jobs[i].key = &key;
+        jobs[i].iv = page->iv;
+        jobs[i].src = page->cleartext;
+        jobs[i].len = page->lSize;
+        jobs[i].dst = page->cyphertext;
+        jobs[i].tag = page->en_mac;
+    }
+    nf_gcm_encrypt_mb(jobs.data(), jobs.size());
+    nf_gcm_key_clear(&key);
+
+    for (size_t i = first; i < pages.size(); i++) {
+        app_buffer_put(pages[i].cleartext, pages[i].lSize);
+        pages[i].cleartext = NULL;
+    }
+}
+
+/* Encrypts pages[*first..] and hands them to fn, if any */
+static int load_group(std::vector<WEB_PAGE_t>& pages, size_t *first, app_group_f fn, void *arg)
+{
+    encrypt_pages(pages, *first);
+    if (fn && fn(pages, *first, arg) != 0)
+        return 1;
+    *first = pages.size();
+    return 0;
+}
+
+/* put_pages:
+ *   Gives the buffers of pages back to the pool.
+ */
+static void put_pages(std::vector<WEB_PAGE_t>& pages)
+{
+    for (size_t p = 0; p < pages.size(); p++) {
+        app_buffer_put(pages[p].cleartext, pages[p].lSize);
+        app_buffer_put(pages[p].cyphertext, pages[p].lSize);
+    }
+    pages.clear();
+}
+
+/* load_pages:
+ *   Reads every non-empty file of dir. A pcap capture is cut into pages by
+ *   pcap_mode instead of being one. Every APP_PAGE_GROUP pages, and at the
+ *   end, the new pages are encrypted and handed to fn, which may write,
+ *   run and put them at once; with no fn they all stay in pages.
+ */
+static int load_pages(const char* dir, app_pcap_mode_t pcap_mode, std::vector<WEB_PAGE_t>& pages,
+                      app_group_f fn, void *arg)
+{
+    std::vector<WEB_PAGE_t> read;
+    struct dirent *ptr = nullptr;
+    DIR *dp = opendir(dir);
+    size_t first = pages.size();
+
+    if (dp == nullptr)
+        return 0;
+    while ((ptr = readdir(dp)) != nullptr) {
+        if (strcmp(ptr->d_name, ".") == 0 || strcmp(ptr->d_name, "..") == 0)
+            continue;
+
+        WEB_PAGE_t page;
+        char buf1[300];
+        snprintf(page.name, sizeof(page.name), "%s", ptr->d_name);
+        snprintf(buf1, sizeof(buf1), "%s%s", dir, ptr->d_name);
+        FILE *ifp = fopen(buf1, "rb");
+        if(ifp==nullptr){
+            printf("\nFile %s not exist.\n",buf1);
+            closedir(dp);
+            return 1;
+        }
+        page.lSize = GetFileSize(buf1);
+        if (page.lSize == 0) {
+            fclose(ifp);
+            continue;
+        }
+        page.cleartext = (uint8_t*) app_buffer_get(page.lSize);
+        page.cyphertext = (uint8_t*) app_buffer_get(page.lSize);
+        if (!page.cleartext || !page.cyphertext) {
+            printf("\nOut of memory for file %s.\n",buf1);
+            app_buffer_put(page.cleartext, page.lSize);
+            app_buffer_put(page.cyphertext, page.lSize);
+            fclose(ifp);
+            closedir(dp);
+            return 1;
+        }
+        fread(page.cleartext, 1, page.lSize, ifp);
+        fclose(ifp);
+        read.clear();
+        if (app_pcap_is_capture(page.cleartext, page.lSize)) {
+            int rc = app_pcap_pages(page.name, page.cleartext, page.lSize, pcap_mode, read);
+
+            app_buffer_put(page.cleartext, page.lSize);
+            app_buffer_put(page.cyphertext, page.lSize);
+            if (rc != 0) {
+                put_pages(read);
+                closedir(dp);
+                return 1;
+            }
+        } else {
+            read.push_back(page);
+        }
+        /* A capture may hold many groups */
+        for (size_t i = 0; i < read.size(); i++) {
+            pages.push_back(read[i]);
+            if (pages.size() - first == APP_PAGE_GROUP && load_group(pages, &first, fn, arg) != 0) {
+                read.erase(read.begin(), read.begin() + i + 1);
+                put_pages(read);
+                closedir(dp);
+                return 1;
+            }
+        }
+    }
+    closedir(dp);
+    return first < pages.size() ? load_group(pages, &first, fn, arg) : 0;
+}
+
+/* save_pages:
+ *   Saves the ciphertexts, MACs and IVs of pages[first..] to ../WebEnc/.
+ */
+static int save_pages(std::vector<WEB_PAGE_t>& pages, size_t first, void *arg)
+{
+    (void) arg;
+    for (size_t i = first; i < pages.size(); i++) {
+        char buf2[300], buf3[300], buf4[300];
+        snprintf(buf2, sizeof(buf2), "../WebEnc/%s_en", pages[i].name);
+        snprintf(buf3, sizeof(buf3), "../WebEnc/%s_en_mac", pages[i].name);
+        snprintf(buf4, sizeof(buf4), "../WebEnc/%s_en_iv", pages[i].name);
+        FILE *ofp_ctext = fopen(buf2, "wb");
+        if(ofp_ctext==nullptr){
+            printf("\nCan not open or create file %s.\n",buf2);
+            return 1;
+        }
+        FILE *ofp_mac = fopen(buf3, "wb");
+        if(ofp_mac==nullptr){
+            printf("\nCan not open or create file %s.\n",buf3);
+            fclose(ofp_ctext);
+            return 1;
+        }
+        FILE *ofp_iv = fopen(buf4, "wb");
+        if(ofp_iv==nullptr){
+            printf("\nCan not open or create file %s.\n",buf4);
+            fclose(ofp_ctext);
+            fclose(ofp_mac);
+            return 1;
+        }
+        fwrite(pages[i].cyphertext, 1, pages[i].lSize, ofp_ctext);
+        fwrite(pages[i].en_mac, 1, SAMPLE_AESGCM_MAC_SIZE, ofp_mac);
+        fwrite(pages[i].iv, 1, sizeof(pages[i].iv), ofp_iv);
+        fclose(ofp_ctext);
+        fclose(ofp_mac);
+        fclose(ofp_iv);
+    }
+    return 0;
+}
+
 double stime()
 {
-    struct timeval tp;
-    gettimeofday(&tp, NULL);
-    return (double)tp.tv_sec + (double)tp.tv_usec / 1000000;
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+/* pack_group:
+ *   Appends pages[first..] to the packed corpus being written and gives
+ *   their buffers back.
+ */
+static int pack_group(std::vector<WEB_PAGE_t>& pages, size_t first, void *arg)
+{
+    if (app_corpus_add((APP_CORPUS_WRITER_t *) arg, pages, first) != 0)
+        return 1;
+    for (size_t i = first; i < pages.size(); i++)
+        app_buffer_put(pages[i].cyphertext, pages[i].lSize);
+    pages.resize(first);
+    return 0;
+}
+
+/* run_nfs:
+ *   Runs the IDS and the compression over page, one ECALL each.
+ */
+static void run_nfs(WEB_PAGE_t *page)
+{
+    sgx_status_t status = SGX_SUCCESS;
+    size_t lSize = page->lSize;
+
+    /*------------------Enclave Processing----------------------------*/
+    double tic, toc;
+    size_t oSize;
+    uint8_t* encProcessedtext;
+    uint8_t out_mac[16], out_iv[12];
+    uint64_t out_seq;
+    /* Room for the compressed page, the larger output of the two NFs */
+    const nf_id_t compression = NF_COMPRESSION;
+    size_t oCap = nf_out_cap(&compression, 1, lSize);
+    encProcessedtext = (uint8_t*) app_buffer_get(oCap);
+    if (!encProcessedtext) {
+        printf("IDS:%s:Error:0x%x\n", page->name, SGX_ERROR_OUT_OF_MEMORY);
+        return;
+    }
+    // 开始计时
+    tic = stime();
+    size_t matched = 0;
+    enclave_ids(global_eid,&status,page->cyphertext,lSize,page->en_mac,page->iv,&oSize,
+                encProcessedtext,oCap,out_mac,out_iv,&out_seq,&matched);
+    // 结束计时
+    toc = stime();
+    if(matched) {
+        printf("IDS(Legal):%s:Time:%f\n", page->name, toc - tic);
+    }else{
+        printf("IDS(Illegal):%s:Time:%f\n", page->name, toc - tic);
+    }
+
+    tic = stime();
+    // 传入密文和mac，在enclave中进行分析，并输出处理后数据的密文
+    // ecall的第一个参数是eid，第二个参数是status，后面的才是EDL中自定义的
+    enclave_compression(global_eid,&status,page->cyphertext,lSize,page->en_mac,page->iv,&oSize,
+                        encProcessedtext,oCap,out_mac,out_iv,&out_seq);
+    toc = stime();
+    printf("Compression:%s:Time:%f:InputSize:%zu:OutputSize:%zu\n", page->name,toc - tic,lSize,oSize);
+    app_buffer_put(encProcessedtext, oCap);
+}
+
+/* run_chain:
+ *   Runs the IDS and the compression over page as one service chain.
+ */
+static void run_chain(WEB_PAGE_t *page)
+{
+    static const char *nf_names[] = {"IDS", "Badword", "Compression"};
+    nf_id_t chain[] = {NF_IDS, NF_COMPRESSION};
+    const size_t nstages = sizeof(chain) / sizeof(chain[0]);
+    nf_stage_stats_t stats[sizeof(chain) / sizeof(chain[0])];
+    sgx_status_t status = SGX_SUCCESS;
+    size_t lSize = page->lSize;
+    size_t oSize = 0, matched = 0;
+    double tic, toc;
+    size_t oCap = nf_out_cap(chain, nstages, lSize);
+    uint8_t* encProcessedtext;
+    uint8_t out_mac[16], out_iv[12];
+    uint64_t out_seq;
+
+    encProcessedtext = (uint8_t*) app_buffer_get(oCap);
+    if (!encProcessedtext) {
+        printf("Chain:%s:Error:0x%x\n", page->name, SGX_ERROR_OUT_OF_MEMORY);
+        return;
+    }
+    tic = stime();
+    enclave_nf_chain(global_eid,&status,chain,nstages,page->cyphertext,lSize,page->en_mac,page->iv,
+                     &oSize,encProcessedtext,oCap,out_mac,out_iv,&out_seq,stats,&matched);
+    toc = stime();
+    if (status != SGX_SUCCESS) {
+        printf("Chain:%s:Error:0x%x\n", page->name, status);
+        app_buffer_put(encProcessedtext, oCap);
+        return;
+    }
+    printf("Chain:%s:Time:%f:InputSize:%zu:OutputSize:%zu:Matched:%zu\n",
+           page->name, toc - tic, lSize, oSize, matched);
+    for (size_t i = 0; i < nstages; i++)
+        printf("Stage:%s:%s:InBytes:%llu:OutBytes:%llu:Cycles:%llu\n", page->name,
+               nf_names[chain[i]], (unsigned long long) stats[i].in_bytes,
+               (unsigned long long) stats[i].out_bytes,
+               (unsigned long long) stats[i].cycles);
+    app_buffer_put(encProcessedtext, oCap);
+}
+
+/* run_batch:
+ *   Runs the IDS and then the compression over pages[first..first+n), one
+ *   batched ECALL per NF. The pages are packed back to back and every page
+ *   gets an output slot that holds its compressed output, the larger one.
+ */
+static void run_batch(std::vector<WEB_PAGE_t>& pages, size_t first, size_t n)
+{
+    std::vector<nf_batch_desc_t> descs(n);
+    std::vector<nf_batch_result_t> results(n);
+    const nf_id_t compression = NF_COMPRESSION;
+    size_t in_len = 0, out_len = 0;
+    sgx_status_t ret, status = SGX_SUCCESS;
+    double tic, toc;
+
+    for (size_t i = 0; i < n; i++) {
+        WEB_PAGE_t *page = &pages[first + i];
+        descs[i].in_offset = in_len;
+        descs[i].in_len = page->lSize;
+        memcpy(descs[i].mac, page->en_mac, sizeof(descs[i].mac));
+        memcpy(descs[i].iv, page->iv, sizeof(descs[i].iv));
+        descs[i].out_offset = out_len;
+        descs[i].out_cap = nf_out_cap(&compression, 1, page->lSize);
+        in_len += page->lSize;
+        out_len += descs[i].out_cap;
+    }
+    uint8_t *in = (uint8_t*) app_buffer_get(in_len);
+    uint8_t *out = (uint8_t*) app_buffer_get(out_len);
+    if (!in || !out) {
+        printf("IDSBatch:Error:0x%x\n", SGX_ERROR_OUT_OF_MEMORY);
+        app_buffer_put(in, in_len);
+        app_buffer_put(out, out_len);
+        return;
+    }
+    for (size_t i = 0; i < n; i++)
+        memcpy(in + descs[i].in_offset, pages[first + i].cyphertext, pages[first + i].lSize);
+
+    tic = stime();
+    ret = enclave_ids_batch(global_eid, &status, in, in_len, descs.data(), n, out, out_len,
+                            results.data());
+    toc = stime();
+    if (ret != SGX_SUCCESS || status != SGX_SUCCESS) {
+        printf("IDSBatch:Error:0x%x\n", ret != SGX_SUCCESS ? ret : status);
+    } else {
+        size_t matched = 0;
+        for (size_t i = 0; i < n; i++) {
+            if (results[i].status != SGX_SUCCESS)
+                printf("IDSBatch:%s:Error:0x%x\n", pages[first + i].name, results[i].status);
+            matched += results[i].matched ? 1 : 0;
+        }
+        printf("IDSBatch:Pages:%zu:Bytes:%zu:Time:%f:Matched:%zu\n", n, in_len, toc - tic,
+               matched);
+    }
+
+    tic = stime();
+    ret = enclave_compression_batch(global_eid, &status, in, in_len, descs.data(), n, out,
+                                    out_len, results.data());
+    toc = stime();
+    if (ret != SGX_SUCCESS || status != SGX_SUCCESS) {
+        printf("CompressionBatch:Error:0x%x\n", ret != SGX_SUCCESS ? ret : status);
+    } else {
+        size_t oSize = 0;
+        for (size_t i = 0; i < n; i++) {
+            if (results[i].status != SGX_SUCCESS)
+                printf("CompressionBatch:%s:Error:0x%x\n", pages[first + i].name,
+                       results[i].status);
+            oSize += results[i].out_len;
+        }
+        printf("CompressionBatch:Pages:%zu:Time:%f:InputSize:%zu:OutputSize:%zu\n", n,
+               toc - tic, in_len, oSize);
+    }
+    app_buffer_put(in, in_len);
+    app_buffer_put(out, out_len);
+}
+
+/* run_group:
+ *   Saves pages[first..] and runs the NFs of opts over the pages, then
+ *   gives their buffers back, so a run that sees each page once holds no
+ *   more than a group. A batch short of opts->batch pages waits for the
+ *   next group, or for main() after the last.
+ */
+static int run_group(std::vector<WEB_PAGE_t>& pages, size_t first, void *arg)
+{
+    const APP_OPTIONS_t *opts = (const APP_OPTIONS_t *) arg;
+    size_t done = 0;
+
+    if (save_pages(pages, first, NULL) != 0)
+        return 1;
+    if (opts->batch) {
+        for (; pages.size() - done >= opts->batch; done += opts->batch)
+            run_batch(pages, done, opts->batch);
+    } else {
+        for (; done < pages.size(); done++) {
+            if (opts->chain)
+                run_chain(&pages[done]);
+            else
+                run_nfs(&pages[done]);
+        }
+    }
+    for (size_t p = 0; p < done; p++)
+        app_buffer_put(pages[p].cyphertext, pages[p].lSize);
+    pages.erase(pages.begin(), pages.begin() + done);
+    return 0;
+}
+
+/* page_workers:
+ *   Scheduler workers that cut the large pages of a run among them. The
+ *   load, the rings and the pool hold the TCS themselves; trusted
+ *   switchless workers take theirs out of the same budget.
+ */
+static unsigned page_workers(const APP_OPTIONS_t *opts)
+{
+    unsigned workers = opts->sched;
+
+    if (opts->nrates || opts->ring || opts->threads)
+        return 0;
+    if (opts->switchless)
+        workers = opts->sl_tworkers < workers ? workers - opts->sl_tworkers : 0;
+    return workers;
 }
 
 /* Application entry */
 int SGX_CDECL main(int argc, char *argv[])
 {
+    APP_OPTIONS_t opts;
+    int opt_ret = app_parse_options(argc, argv, &opts);
+    if (opt_ret != 0)
+        return opt_ret < 0 ? 1 : 0;
+
+    if (opts.switchless_bench) {
+        switchless_benchmark(&opts);
+        return 0;
+    }
+
+    if (opts.marshal_bench) {
+        marshal_benchmark(&opts);
+        return 0;
+    }
+
+    char dir[] = "../Web/";
+//    encrypt_file(dir);
+
+    /* Packing needs no enclave: encrypt the directory once and exit */
+    if (opts.pack) {
+        std::vector<WEB_PAGE_t> pages;
+        APP_CORPUS_WRITER_t writer;
+        int rc = app_corpus_begin(&writer, opts.pack) != 0 ||
+                 load_pages(dir, opts.pcap_mode, pages, pack_group, &writer) != 0;
+
+        rc = app_corpus_end(&writer, !rc) != 0 || rc;
+        put_pages(pages);
+        app_buffer_trim();
+        return rc;
+    }
+
+    /* The A/B run creates an enclave of each variant itself */
+    if (opts.ab) {
+        std::vector<WEB_PAGE_t> pages;
+        APP_CORPUS_t corpus = {NULL, 0};
+        int rc = opts.corpus ? app_corpus_map(opts.corpus, &corpus, pages) != 0
+                             : load_pages(dir, opts.pcap_mode, pages, save_pages, NULL) != 0;
+
+        if (!rc)
+            rc = nf_ab_compare(pages, &opts) != 0;
+        if (!opts.corpus)
+            put_pages(pages);
+        app_corpus_unmap(&corpus);
+        app_buffer_report();
+        app_buffer_trim();
+        return rc;
+    }
+
     /* Initialize the enclave */
-    if(initialize_enclave() < 0){
+    if(initialize_enclave(&opts) < 0){
         printf("Enter a character before exit ...\n");
         getchar();
         return -1;
     }
 
+    app_log_start(opts.log_interval);
+
     /* -------------------Editing From Here------------------------- */
-    char dir[] = "../Web/";
-//    encrypt_file(dir);
+    if (opts.gcm_bench) {
+        gcm_benchmark();
+        app_log_stop();
+        sgx_destroy_enclave(global_eid);
+        return 0;
+    }
 
-    sgx_status_t status = SGX_SUCCESS;
+    if (opts.queue_bench) {
+        queue_benchmark();
+        app_log_stop();
+        sgx_destroy_enclave(global_eid);
+        return 0;
+    }
 
-    struct dirent *ptr = nullptr;
-    DIR *dp = nullptr;
-    dp = opendir(dir);
-    if (dp != nullptr) {
-        while ((ptr = readdir(dp)) != nullptr) {
-            if (strcmp(ptr->d_name, ".") == 0 || strcmp(ptr->d_name, "..") == 0) {
-                continue;
-            } else {
-                // 计算文件大小
-//                printf ("%s\n", ptr->d_name);
-                /*------------------Encryption----------------------------*/
-                int ret;
-                uint8_t en_mac[16];
-                /* Encrypt a given file */
-                const uint8_t data_key[16] = {0x87, 0xA6, 0x0B, 0x39, 0xD5, 0x26, 0xAB, 0x1C, 0x30, 0x9E, 0xEC, 0x60, 0x6C, 0x72, 0xBA, 0x36};
-                uint8_t aes_gcm_iv[12] = {0};
-                char buf1[100], buf2[100], buf3[100];
-                sprintf(buf1, "../Web/%s",ptr->d_name);
-                sprintf(buf2, "../WebEnc/%s_en", ptr->d_name);
-                sprintf(buf3, "../WebEnc/%s_en_mac", ptr->d_name);
-                FILE *ifp = fopen(buf1, "rb");
-                if(ifp==nullptr){
-                    printf("\nFile %s not exist.\n",buf1);
-                    return 1;
-                }
-                FILE *ofp_ctext = fopen(buf2, "wb");
-                if(ofp_ctext==nullptr){
-                    printf("\nCan not open or create file %s.\n",buf2);
-                    return 1;
-                }
-                FILE *ofp_mac = fopen(buf3, "wb");
-                if(ofp_mac==nullptr){
-                    printf("\nCan not open or create file %s.\n",buf3);
-                    return 1;
-                }
-                size_t lSize;
-                lSize=GetFileSize(buf1);
-//                if (lSize>500000||lSize==0) continue;
-                if (lSize==0) continue;
-//                if (lSize==0) continue;
-                // Use AES-GCM provided in sample_crypto.h
-                uint8_t* cleartext;
-                uint8_t* cyphertext;
-                cleartext =  (uint8_t*) malloc (sizeof(uint8_t)*lSize);
-                cyphertext = (uint8_t*) malloc (sizeof(uint8_t)*lSize);
-//                printf("lSize:%d\n",lSize);
-                fread(cleartext, 1, lSize, ifp);
-
-                ret = sample_rijndael128GCM_encrypt(
-                        &data_key,
-                        cleartext,
-                        lSize,
-                        cyphertext, // Output
-                        &aes_gcm_iv[0],
-                        12,
-                        NULL,
-                        0,
-                        &en_mac); // Output
-
-                fwrite(cyphertext, 1, lSize, ofp_ctext);
-                fwrite(en_mac, 1, SAMPLE_AESGCM_MAC_SIZE, ofp_mac);
-
-                fclose(ifp);
-                fclose(ofp_ctext);
-                fclose(ofp_mac);
-//                printf("encrypt_file Completed\n");
-
-                /*------------------Enclave Processing----------------------------*/
-                double tic, toc;
-                double tTotal = 0;
-                size_t oSize;
-                uint8_t* encProcessedtext;
-                /* Allocate space for processed data */
-                encProcessedtext = (uint8_t*) malloc (10*sizeof(uint8_t)*lSize);
-//                printf("lSize:%d\n",lSize);
-                memset(encProcessedtext,0,2*sizeof(uint8_t)*lSize);
-                // 开始计时
-                tic = stime();
-                size_t matched = 0;
-//                printf("A\n");
-                enclave_ids(global_eid,&status,cleartext,lSize,en_mac,&oSize,encProcessedtext,&matched);
-                // 结束计时
-                toc = stime();
-                tTotal += (toc - tic);
-                if(matched) {
-                    printf("IDS(Legal):%s:Time:%f\n", ptr->d_name, tTotal);
-                }else{
-                    printf("IDS(Illegal):%s:Time:%f\n", ptr->d_name, tTotal);
-                }
-
-                tic = stime();
-                // 传入密文和mac，在enclave中进行分析，并输出处理后数据的密文
-                // ecall的第一个参数是eid，第二个参数是status，后面的才是EDL中自定义的
-                enclave_compression(global_eid,&status,cyphertext,lSize,en_mac,&oSize,encProcessedtext);
-                toc = stime();
-                tTotal += (toc - tic);
-                printf("Compression:%s:Time:%f:InputSize:%d:OutputSize:%d\n", ptr->d_name,tTotal,lSize,oSize);
-                free(cleartext);
-                free(cyphertext);
-            }
-        }
+    if (opts.sched_bench) {
+        sched_benchmark(&opts);
+        app_log_stop();
+        sgx_destroy_enclave(global_eid);
+        return 0;
+    }
+
+    if (app_provision_rules(global_eid, opts.rules, opts.rules_sealed) != 0) {
+        app_log_stop();
+        sgx_destroy_enclave(global_eid);
+        return 1;
+    }
+
+    if (opts.pipeline[APP_PIPE_ENCLAVE]) {
+        int rc = app_run_pipeline(dir, &opts) != 0;
+
+        app_buffer_report();
+        app_buffer_trim();
+        app_log_stop();
+        sgx_destroy_enclave(global_eid);
+        return rc;
+    }
+
+    /* Without workers the large pages are streamed like the others */
+    unsigned workers = page_workers(&opts);
+    if (workers && app_sched_start(global_eid, workers) != 0)
+        workers = 0;
+
+    /*------------------Encryption----------------------------*/
+    std::vector<WEB_PAGE_t> pages;
+    APP_CORPUS_t corpus = {NULL, 0};
+    int rc;
+
+    /* The benchmark, the load, the rings and the pool go over all pages */
+    if (opts.corpus)
+        rc = app_corpus_map(opts.corpus, &corpus, pages) != 0;
+    else if (opts.bench || opts.nrates || opts.ring || opts.threads)
+        rc = load_pages(dir, opts.pcap_mode, pages, save_pages, NULL) != 0;
+    else
+        rc = load_pages(dir, opts.pcap_mode, pages, run_group, &opts) != 0;
+    if (rc) {
+        if (!opts.corpus)
+            put_pages(pages);
+        app_buffer_trim();
+        if (workers)
+            app_sched_stop(global_eid);
+        app_log_stop();
+        sgx_destroy_enclave(global_eid);
+        return 1;
+    }
+
+    if (opts.bench)
+        nf_benchmark(pages, &opts);
+    else if (opts.nrates) {
+        const char *variant = ENCLAVE_FILENAME;
+        nf_load(pages, &opts, &global_eid, &variant, 1);
+    } else if (opts.ring)
+        app_run_ring(pages, opts.ring);
+    else if (opts.threads)
+        app_run_pool(pages, opts.threads, opts.chain);
+
+    for (size_t p = 0; p < pages.size(); p++) {
+        if (opts.bench || opts.nrates || opts.ring || opts.threads) {
+            /* All pages went through the benchmark, the load, the rings or the pool above */
+        } else if (opts.batch) {
+            /* The first page of each batch runs the whole batch; read from
+             * ../Web/, only the last short batch is left */
+            if (p % opts.batch == 0)
+                run_batch(pages, p, pages.size() - p < opts.batch ? pages.size() - p : opts.batch);
+        } else if (opts.chain)
+            run_chain(&pages[p]);
+        else
+            run_nfs(&pages[p]);
+        /* Pages of a packed corpus are slices of its mapping */
+        if (!opts.corpus)
+            app_buffer_put(pages[p].cyphertext, pages[p].lSize);
     }
+    app_corpus_unmap(&corpus);
+    app_buffer_report();
+    app_buffer_trim();
     /* -------------------Editing Done----------------------------- */
 
     /* Destroy the enclave */
+    if (workers)
+        app_sched_stop(global_eid);
+    app_log_stop();
     sgx_destroy_enclave(global_eid);
 
 //    printf("Info: NFVEnclave successfully returned.\n");
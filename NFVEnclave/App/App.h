@@ -37,6 +37,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdarg.h>
+#include <stdint.h>
 
 #include "sgx_error.h"       /* sgx_status_t */
 #include "sgx_eid.h"     /* sgx_enclave_id_t */
@@ -54,6 +55,19 @@
 
 extern sgx_enclave_id_t global_eid;    /* global enclave id */
 
+/* Key the host encrypts under for the ECALLs without a session */
+extern const uint8_t app_data_key[16];
+
+/* A page of the web directory and its encryption */
+typedef struct web_page {
+    char name[256];
+    size_t lSize;
+    uint8_t* cleartext;
+    uint8_t* cyphertext;
+    uint8_t en_mac[16];
+    uint8_t iv[12];             /* IV of cyphertext, from app_page_iv() */
+} WEB_PAGE_t;
+
 #if defined(__cplusplus)
 extern "C" {
 #endif
@@ -67,6 +81,16 @@ void ecall_libc_functions(void);
 void ecall_libcxx_functions(void);
 void ecall_thread_functions(void);
 size_t GetFileSize(char* filename);
+void app_page_iv(uint8_t* iv);
+
+void print_error_message(sgx_status_t ret);
+
+struct app_options;
+void gcm_benchmark(void);
+void switchless_benchmark(const struct app_options *opts);
+void marshal_benchmark(const struct app_options *opts);
+void queue_benchmark(void);
+void sched_benchmark(const struct app_options *opts);
 
 #if defined(__cplusplus)
 }
@@ -0,0 +1,204 @@
+/*
+ * Ab.cpp: Side-by-side runs of the enclave variants over the pages.
+ *
+ * The variants are built into their own signed enclaves (see Makefile_gcc)
+ * and loaded at once, so every variant sees the same ciphertexts in the
+ * same process. The variants take turns within each round of a page, so
+ * a drift of the machine during the run hits them alike. The first
+ * variant is the baseline: an overhead is the median time, or the output
+ * size, of a variant over that of the baseline for the same page and NF.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "sgx_urts.h"
+#include "../Driver/Buffers.h"
+#include "../Driver/Ruleset.h"
+#include "../Driver/Switchless.h"
+#include "Enclave_u.h"
+#include "Ab.h"
+#include "Load.h"
+
+static const struct { unsigned bit; const char *name; const char *file; } ab_variants[] = {
+    {APP_AB_BARE, "bare", "enclave_bare.signed.so"},
+    {APP_AB_BEFORE, "before", "enclave_before.signed.so"},
+    {APP_AB_MITIGATED, "mitigated", "enclave_mitigated.signed.so"}
+};
+#define AB_VARIANTS (sizeof(ab_variants) / sizeof(ab_variants[0]))
+
+static const struct { nf_id_t nf; const char *name; } ab_nfs[] = {
+    {NF_IDS, "IDS"}, {NF_BADWORD, "Badword"}, {NF_COMPRESSION, "Compression"}
+};
+#define AB_NFS (sizeof(ab_nfs) / sizeof(ab_nfs[0]))
+
+/* What one variant did over all pages of one NF */
+struct ab_sum
+{
+    double log_time;        /* Sum of the logs of the time overheads */
+    size_t out_bytes;
+    size_t pages;
+};
+
+static double ab_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double) ts.tv_sec + (double) ts.tv_nsec / 1e9;
+}
+
+/* One ECALL of nf over page on enclave eid */
+static sgx_status_t ab_call(sgx_enclave_id_t eid, nf_id_t nf, WEB_PAGE_t *page,
+                            uint8_t *out, size_t oCap, size_t *oSize)
+{
+    sgx_status_t ret, status = SGX_SUCCESS;
+    uint8_t out_mac[16], out_iv[12];
+    uint64_t out_seq;
+    size_t matched = 0;
+
+    switch (nf) {
+    case NF_IDS:
+        ret = enclave_ids(eid, &status, page->cyphertext, page->lSize, page->en_mac, page->iv,
+                          oSize, out, oCap, out_mac, out_iv, &out_seq, &matched);
+        break;
+    case NF_BADWORD:
+        ret = enclave_process_badword(eid, &status, page->cyphertext, page->lSize,
+                                      page->en_mac, page->iv, oSize, out, oCap, out_mac,
+                                      out_iv, &out_seq);
+        break;
+    default:
+        ret = enclave_compression(eid, &status, page->cyphertext, page->lSize, page->en_mac,
+                                  page->iv, oSize, out, oCap, out_mac, out_iv, &out_seq);
+        break;
+    }
+    return ret != SGX_SUCCESS ? ret : status;
+}
+
+static double ab_median(std::vector<double>& t)
+{
+    std::nth_element(t.begin(), t.begin() + t.size() / 2, t.end());
+    return t[t.size() / 2];
+}
+
+static double ab_ratio(double x, double base)
+{
+    return base > 0 ? x / base : 0;
+}
+
+/* Runs the NFs of every page on the enclaves eids of the variants used[] */
+static int ab_run(std::vector<WEB_PAGE_t>& pages, const APP_OPTIONS_t *opts,
+                  const sgx_enclave_id_t *eids, const size_t *used, size_t nused)
+{
+    struct ab_sum sums[AB_NFS][AB_VARIANTS];
+    std::vector<double> times[AB_VARIANTS];
+    size_t out_size[AB_VARIANTS];
+    int rc = 0;
+
+    memset(sums, 0, sizeof(sums));
+    for (size_t p = 0; p < pages.size(); p++) {
+        WEB_PAGE_t *page = &pages[p];
+
+        for (size_t f = 0; f < AB_NFS; f++) {
+            /* The bound of the padded variant covers the unpadded ones */
+            size_t oCap = nf_out_cap(&ab_nfs[f].nf, 1, page->lSize);
+            uint8_t *out = (uint8_t *) app_buffer_get(oCap);
+            sgx_status_t ret = SGX_SUCCESS;
+            size_t v = 0;
+
+            if (!out) {
+                printf("AB:%s:%s:Error:0x%x\n", page->name, ab_nfs[f].name,
+                       SGX_ERROR_OUT_OF_MEMORY);
+                rc = -1;
+                continue;
+            }
+            for (v = 0; v < nused; v++)
+                times[v].clear();
+            for (unsigned r = 0; r < opts->warmup + opts->iterations && ret == SGX_SUCCESS; r++) {
+                for (v = 0; v < nused; v++) {
+                    double tic = ab_now();
+
+                    ret = ab_call(eids[v], ab_nfs[f].nf, page, out, oCap, &out_size[v]);
+                    if (ret != SGX_SUCCESS)
+                        break;
+                    if (r >= opts->warmup)
+                        times[v].push_back(ab_now() - tic);
+                }
+            }
+            app_buffer_put(out, oCap);
+            if (ret != SGX_SUCCESS) {
+                printf("AB:%s:%s:%s:Error:0x%x\n", page->name, ab_nfs[f].name,
+                       ab_variants[used[v]].name, ret);
+                rc = -1;
+                continue;
+            }
+
+            double base = ab_median(times[0]);
+            printf("AB:%s:%s:InputSize:%zu", page->name, ab_nfs[f].name, page->lSize);
+            for (v = 0; v < nused; v++) {
+                double t = v ? ab_median(times[v]) : base;
+                double dt = ab_ratio(t, base);
+                double ds = ab_ratio((double) out_size[v], (double) out_size[0]);
+
+                printf(":%s:Time:%f:OutputSize:%zu:TimeOverhead:%.3f:SizeOverhead:%.3f",
+                       ab_variants[used[v]].name, t, out_size[v], dt, ds);
+                sums[f][v].log_time += dt > 0 ? log(dt) : 0;
+                sums[f][v].out_bytes += out_size[v];
+                sums[f][v].pages++;
+            }
+            printf("\n");
+        }
+    }
+
+    /* Geometric mean of the per-page time overheads, total bytes for the size */
+    for (size_t f = 0; f < AB_NFS; f++)
+        for (size_t v = 0; v < nused; v++) {
+            const struct ab_sum *s = &sums[f][v];
+
+            printf("ABSummary:%s:%s:Pages:%zu:TimeOverhead:%.3f:OutputSize:%zu:"
+                   "SizeOverhead:%.3f\n", ab_nfs[f].name, ab_variants[used[v]].name, s->pages,
+                   s->pages ? exp(s->log_time / (double) s->pages) : 0, s->out_bytes,
+                   ab_ratio((double) s->out_bytes, (double) sums[f][0].out_bytes));
+        }
+    return rc;
+}
+
+int nf_ab_compare(std::vector<WEB_PAGE_t>& pages, const APP_OPTIONS_t *opts)
+{
+    sgx_enclave_id_t eids[AB_VARIANTS];
+    size_t used[AB_VARIANTS], nused = 0;
+    int rc = 0;
+
+    for (size_t v = 0; v < AB_VARIANTS && rc == 0; v++) {
+        sgx_status_t ret;
+
+        if (!(opts->ab & ab_variants[v].bit))
+            continue;
+        ret = app_create_enclave(ab_variants[v].file, opts, opts->switchless, &eids[nused]);
+        if (ret != SGX_SUCCESS) {
+            printf("AB:%s:Error:0x%x\n", ab_variants[v].file, ret);
+            print_error_message(ret);
+            rc = -1;
+            break;
+        }
+        used[nused++] = v;
+        /* Each variant parses the rules for itself */
+        if (app_provision_rules(eids[nused - 1], opts->rules, NULL) != 0)
+            rc = -1;
+    }
+    if (rc == 0 && opts->nrates) {
+        const char *names[AB_VARIANTS];
+
+        for (size_t v = 0; v < nused; v++)
+            names[v] = ab_variants[used[v]].name;
+        rc = nf_load(pages, opts, eids, names, nused);
+    } else if (rc == 0) {
+        rc = ab_run(pages, opts, eids, used, nused);
+    }
+
+    for (size_t v = 0; v < nused; v++)
+        sgx_destroy_enclave(eids[v]);
+    return rc;
+}
@@ -0,0 +1,25 @@
+/*
+ * Ab.h: Side-by-side runs of the enclave variants over the pages.
+ */
+
+#ifndef _APP_BENCH_AB_H_
+#define _APP_BENCH_AB_H_
+
+#include <vector>
+#include "../App.h"
+#include "../Driver/Options.h"
+
+/*
+ * Creates an enclave of each variant of opts->ab, provisions its ruleset,
+ * and runs the IDS, the badword filter and the compression of every
+ * variant over the same encrypted pages: opts->warmup untimed times, then
+ * opts->iterations timed times, the variants taking turns within each
+ * round. Prints a line per page and NF with the median time and output
+ * size of each variant and their overheads over the first variant, then
+ * a summary per NF and variant. With opts->rates, puts the variants
+ * under the open-loop load of nf_load instead. Returns 0 unless an
+ * enclave could not be created or an ECALL failed.
+ */
+int nf_ab_compare(std::vector<WEB_PAGE_t>& pages, const APP_OPTIONS_t *opts);
+
+#endif /* !_APP_BENCH_AB_H_ */
@@ -0,0 +1,132 @@
+/*
+ * Gcm.cpp: Host side of the GCM benchmark.
+ *
+ * Part 1 times ecall_gcm_benchmark for each engine and page size: the
+ * per-page cost of the decrypt + encrypt pair every NF ECALL performs.
+ * Part 2 times single enclave_session_process calls on small pages, i.e.
+ * the per-page latency seen by a flow.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../App.h"
+#include "Enclave_u.h"
+#include "sample_libcrypto.h"
+#include "nf_gcm.h"
+
+#define GCM_BENCH_BYTES (64u << 20)     /* Bytes per measurement */
+#define GCM_BENCH_MIN_ITERATIONS 1000
+#define GCM_BENCH_FLOW 0x6763u
+#define GCM_BENCH_PAGES 2000            /* ECALLs per session measurement */
+
+static const char *gcm_engine_names[GCM_BENCH_ENGINES] = {
+    "sdk", "nf_cold", "nf_session", "nf_mb"
+};
+
+static double gcm_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double) ts.tv_sec + (double) ts.tv_nsec / 1e9;
+}
+
+static void gcm_engines(void)
+{
+    static const size_t sizes[] = {64, 256, 512, 1500, 4096, 32768, 262144, 1048576};
+
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        size_t iterations = GCM_BENCH_BYTES / sizes[s];
+        if (iterations < GCM_BENCH_MIN_ITERATIONS)
+            iterations = GCM_BENCH_MIN_ITERATIONS;
+
+        for (int engine = 0; engine < GCM_BENCH_ENGINES; engine++) {
+            sgx_status_t status = SGX_SUCCESS;
+            double tic, toc;
+
+            tic = gcm_now();
+            sgx_status_t ret = ecall_gcm_benchmark(global_eid, &status, engine, sizes[s], iterations);
+            toc = gcm_now();
+            if (ret != SGX_SUCCESS || status != SGX_SUCCESS) {
+                printf("GCM:%s:Size:%zu:Error:0x%x\n", gcm_engine_names[engine], sizes[s],
+                       ret != SGX_SUCCESS ? ret : status);
+                continue;
+            }
+            printf("GCM:%s:Size:%zu:Iterations:%zu:NsPerPage:%.1f:MBps:%.1f\n",
+                   gcm_engine_names[engine], sizes[s], iterations,
+                   (toc - tic) * 1e9 / (double) iterations,
+                   (double) (sizes[s] * iterations) / (toc - tic) / 1e6);
+        }
+    }
+}
+
+static void gcm_session(void)
+{
+    static const size_t sizes[] = {256, 1024, 4096, 16384, 65536};
+    uint8_t data_key[NF_GCM_KEY_SIZE];
+    sgx_status_t status = SGX_SUCCESS;
+    NF_GCM_KEY_t master;
+    uint64_t seq = 0, nonce = 0;
+
+    if (enclave_session_open(global_eid, &status, GCM_BENCH_FLOW, &nonce) != SGX_SUCCESS || status != SGX_SUCCESS) {
+        printf("Session:Error:open:0x%x\n", status);
+        return;
+    }
+    /* The key the enclave derived for this session */
+    nf_gcm_key_init(&master, app_data_key);
+    nf_gcm_derive_key(&master, GCM_BENCH_FLOW, nonce, data_key);
+    nf_gcm_key_clear(&master);
+
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        size_t lSize = sizes[s];
+        uint8_t *page = (uint8_t *) calloc(1, lSize);
+        uint8_t *cyphertext = (uint8_t *) malloc(lSize);
+        const nf_id_t ids = NF_IDS;
+        size_t oCap = nf_out_cap(&ids, 1, lSize);
+        uint8_t *out = (uint8_t *) malloc(oCap);
+        double elapsed = 0;
+        int pages = 0;
+
+        for (; pages < GCM_BENCH_PAGES; pages++) {
+            uint8_t iv[NF_GCM_IV_SIZE], en_mac[16], out_mac[16];
+            size_t oSize, matched;
+            uint64_t out_seq;
+            double tic, toc;
+
+            nf_gcm_make_iv(iv, GCM_BENCH_FLOW, ++seq);
+            sample_rijndael128GCM_encrypt((const sample_aes_gcm_128bit_key_t *) data_key, page,
+                                          (uint32_t) lSize, cyphertext, iv, NF_GCM_IV_SIZE,
+                                          NULL, 0, (sample_aes_gcm_128bit_tag_t *) en_mac);
+            tic = gcm_now();
+            enclave_session_process(global_eid, &status, GCM_BENCH_FLOW, NF_IDS, seq, cyphertext,
+                                    lSize, en_mac, &oSize, out, oCap, out_mac, &out_seq,
+                                    &matched);
+            toc = gcm_now();
+            if (status != SGX_SUCCESS)
+                break;
+            elapsed += toc - tic;
+        }
+        if (pages < GCM_BENCH_PAGES)
+            printf("Session:Size:%zu:Error:0x%x\n", lSize, status);
+        else
+            printf("Session:Size:%zu:Pages:%d:UsPerPage:%.2f\n", lSize, pages,
+                   elapsed * 1e6 / pages);
+
+        free(page);
+        free(cyphertext);
+        free(out);
+    }
+
+    enclave_session_close(global_eid, &status, GCM_BENCH_FLOW);
+}
+
+/* gcm_benchmark:
+ *   Compares the SDK GCM with nf_gcm inside the enclave.
+ */
+void gcm_benchmark(void)
+{
+    gcm_engines();
+    gcm_session();
+}
@@ -0,0 +1,147 @@
+/*
+ * Hdr.cpp: Latency histogram with a bounded relative error. See Hdr.h.
+ */
+
+#include <cmath>
+#include <string.h>
+
+#include "Hdr.h"
+
+#define HDR_EXACT ((uint64_t) 1 << APP_HDR_SUB_BITS)
+#define HDR_HALF ((uint64_t) 1 << (APP_HDR_SUB_BITS - 1))
+#define HDR_MAX (((uint64_t) 1 << APP_HDR_MAX_SHIFT) - 1)
+
+/* Percentile ticks between 1 - 2^-k and 1 - 2^-(k+1) in app_hdr_print */
+#define HDR_TICKS_PER_HALF 5
+
+static size_t hdr_index(uint64_t v)
+{
+    unsigned b;
+
+    if (v < HDR_EXACT)
+        return (size_t) v;
+    if (v > HDR_MAX)
+        v = HDR_MAX;
+    /* v in [2^(S+b-1), 2^(S+b)), buckets 2^b wide */
+    b = (unsigned) (63 - __builtin_clzll(v)) - APP_HDR_SUB_BITS + 1;
+    return (size_t) (HDR_EXACT + (b - 1) * HDR_HALF + ((v >> b) - HDR_HALF));
+}
+
+/* Largest value counted in bucket i */
+static uint64_t hdr_upper(size_t i)
+{
+    uint64_t j, b;
+
+    if (i < HDR_EXACT)
+        return i;
+    j = i - HDR_EXACT;
+    b = j / HDR_HALF + 1;
+    return ((j % HDR_HALF + HDR_HALF) << b) + ((uint64_t) 1 << b) - 1;
+}
+
+/* Middle of bucket i, for the mean and the deviation of app_hdr_print */
+static double hdr_middle(size_t i)
+{
+    uint64_t width;
+
+    if (i < HDR_EXACT)
+        return (double) i;
+    width = (uint64_t) 1 << ((i - HDR_EXACT) / HDR_HALF + 1);
+    return (double) (hdr_upper(i) - width + 1) + (double) width / 2;
+}
+
+void app_hdr_init(APP_HDR_t *h)
+{
+    memset(h, 0, sizeof(*h));
+    h->min = UINT64_MAX;
+}
+
+void app_hdr_record(APP_HDR_t *h, uint64_t value)
+{
+    h->counts[hdr_index(value)]++;
+    h->total++;
+    h->sum += (double) value;
+    if (value < h->min)
+        h->min = value;
+    if (value > h->max)
+        h->max = value;
+}
+
+void app_hdr_merge(APP_HDR_t *into, const APP_HDR_t *from)
+{
+    for (size_t i = 0; i < APP_HDR_BUCKETS; i++)
+        into->counts[i] += from->counts[i];
+    into->total += from->total;
+    into->sum += from->sum;
+    if (from->min < into->min)
+        into->min = from->min;
+    if (from->max > into->max)
+        into->max = from->max;
+}
+
+uint64_t app_hdr_percentile(const APP_HDR_t *h, double p)
+{
+    uint64_t rank, seen = 0;
+
+    if (!h->total)
+        return 0;
+    rank = (uint64_t) std::ceil(p / 100.0 * (double) h->total);
+    if (rank == 0)
+        return h->min;
+    for (size_t i = 0; i < APP_HDR_BUCKETS; i++) {
+        seen += h->counts[i];
+        if (seen >= rank)
+            return hdr_upper(i) < h->max ? hdr_upper(i) : h->max;
+    }
+    return h->max;
+}
+
+void app_hdr_print(FILE *fp, const APP_HDR_t *h, double scale)
+{
+    double mean = 0, var = 0;
+
+    fprintf(fp, "%12s %14s %10s %14s\n\n", "Value", "Percentile", "TotalCount",
+            "1/(1-Percentile)");
+    if (h->total) {
+        uint64_t seen = 0;
+        size_t i = 0;
+
+        /* Halve the distance to 100% every HDR_TICKS_PER_HALF ticks */
+        for (unsigned k = 0; ; k++) {
+            double half = std::ldexp(1.0, -(int) k);
+            unsigned t;
+
+            for (t = 0; t < HDR_TICKS_PER_HALF; t++) {
+                double q = 1.0 - half + half / 2 * t / HDR_TICKS_PER_HALF;
+                uint64_t rank = (uint64_t) std::ceil(q * (double) h->total);
+
+                if (rank == 0)
+                    rank = 1;
+                while (seen + h->counts[i] < rank)
+                    seen += h->counts[i++];
+                fprintf(fp, "%12.3f %2.12f %10llu %14.2f\n",
+                        (double) app_hdr_percentile(h, q * 100) / scale, q,
+                        (unsigned long long) (seen + h->counts[i]), 1.0 / (1.0 - q));
+            }
+            /* Past the resolution of total values */
+            if (1.0 / (half / 2) > (double) h->total)
+                break;
+        }
+        fprintf(fp, "%12.3f %2.12f %10llu\n", (double) h->max / scale, 1.0,
+                (unsigned long long) h->total);
+
+        mean = h->sum / (double) h->total;
+        for (i = 0; i < APP_HDR_BUCKETS; i++)
+            if (h->counts[i]) {
+                double d = hdr_middle(i) - mean;
+                var += d * d * (double) h->counts[i];
+            }
+        var /= (double) h->total;
+    }
+    fprintf(fp, "#[Mean    = %12.3f, StdDeviation   = %12.3f]\n", mean / scale,
+            std::sqrt(var) / scale);
+    fprintf(fp, "#[Max     = %12.3f, Total count    = %12llu]\n", (double) h->max / scale,
+            (unsigned long long) h->total);
+    fprintf(fp, "#[Buckets = %12d, SubBuckets     = %12d]\n", APP_HDR_BUCKETS,
+            1 << APP_HDR_SUB_BITS);
+}
@@ -0,0 +1,48 @@
+/*
+ * Hdr.h: Latency histogram with a bounded relative error (HDR-style).
+ *
+ * Values below 2^APP_HDR_SUB_BITS are counted exactly. Above, each
+ * doubling [2^k, 2^(k+1)) is cut into 2^(APP_HDR_SUB_BITS-1) buckets of
+ * equal width, so a value is known to within 1/128 of itself whatever its
+ * magnitude, and a histogram is a fixed array that records in O(1).
+ */
+
+#ifndef _APP_BENCH_HDR_H_
+#define _APP_BENCH_HDR_H_
+
+#include <stdint.h>
+#include <stdio.h>
+
+#define APP_HDR_SUB_BITS 8
+#define APP_HDR_MAX_SHIFT 40    /* Larger values are counted as 2^40 - 1 */
+#define APP_HDR_BUCKETS ((1 << APP_HDR_SUB_BITS) + \
+                         (APP_HDR_MAX_SHIFT - APP_HDR_SUB_BITS) * (1 << (APP_HDR_SUB_BITS - 1)))
+
+typedef struct app_hdr
+{
+    uint64_t counts[APP_HDR_BUCKETS];
+    uint64_t total;
+    uint64_t min, max;      /* Exact */
+    double sum;
+} APP_HDR_t;
+
+void app_hdr_init(APP_HDR_t *h);
+void app_hdr_record(APP_HDR_t *h, uint64_t value);
+
+/* Adds the counts of from to into */
+void app_hdr_merge(APP_HDR_t *into, const APP_HDR_t *from);
+
+/*
+ * Smallest value v such that p percent of the values are at most v, to
+ * the width of its bucket; 0 for an empty histogram.
+ */
+uint64_t app_hdr_percentile(const APP_HDR_t *h, double p);
+
+/*
+ * Writes the percentile distribution in the text layout of HdrHistogram
+ * (Value, Percentile, TotalCount, 1/(1-Percentile)), values divided by
+ * scale, so the usual HdrHistogram plotters read it.
+ */
+void app_hdr_print(FILE *fp, const APP_HDR_t *h, double scale);
+
+#endif /* !_APP_BENCH_HDR_H_ */
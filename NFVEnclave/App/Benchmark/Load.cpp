@@ -0,0 +1,236 @@
+/*
+ * Load.cpp: Open-loop load of the NF ECALLs at a target rate.
+ *
+ * The send times of a step are fixed before it starts. The workers claim
+ * the pages in send order through a shared cursor, sleep until the send
+ * time of the page they claimed and issue its ECALL, so the workers are
+ * the servers of a FIFO queue fed at the target rate. A page that found
+ * every worker busy is sent late, and its latency, taken from the
+ * scheduled send time rather than the actual one, includes that wait:
+ * an overloaded step shows its queueing delay instead of hiding it by
+ * slowing the arrivals down (coordinated omission).
+ */
+
+#include <algorithm>
+#include <errno.h>
+#include <random>
+#include <stdio.h>
+#include <string.h>
+#include <thread>
+#include <time.h>
+#include <x86intrin.h>
+
+#include "../Driver/Buffers.h"
+#include "../Driver/Pool.h"
+#include "Hdr.h"
+#include "Load.h"
+#include "Nf.h"
+
+#define LOAD_SPIN_NS 50000          /* Spin rather than sleep this close to a send time */
+#define LOAD_LEAD_NS 10000000       /* Time given to the workers to start */
+#define LOAD_SUSTAINED 0.95         /* Share of the offered rate a sustained step achieves */
+
+static const struct { unsigned bit; const char *name; } load_nfs[] = {
+    {APP_BENCH_IDS, "ids"}, {APP_BENCH_BADWORD, "badword"},
+    {APP_BENCH_COMPRESSION, "compression"}, {APP_BENCH_CHAIN, "chain"}
+};
+#define LOAD_NFS (sizeof(load_nfs) / sizeof(load_nfs[0]))
+
+/* One step: the pages of one NF at one rate on one enclave */
+struct load_step
+{
+    std::vector<WEB_PAGE_t> *pages;
+    sgx_enclave_id_t eid;
+    unsigned nf;
+    const uint64_t *sched;      /* Send time of each request, ns after start */
+    size_t count;
+    uint64_t start;             /* CLOCK_MONOTONIC ns */
+    size_t next;                /* Next request to claim */
+};
+
+struct load_worker
+{
+    APP_HDR_t hist;             /* Latencies in ns */
+    size_t done;
+    size_t failed;
+    uint64_t last;              /* End of the last ECALL, ns after start */
+};
+
+/* Highest sustained rate of one NF on one enclave */
+struct load_knee
+{
+    unsigned rate;
+    uint64_t p99;
+};
+
+static uint64_t load_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ull + (uint64_t) ts.tv_nsec;
+}
+
+static void load_wait(uint64_t due)
+{
+    if (due > load_now() + LOAD_SPIN_NS) {
+        struct timespec ts;
+        uint64_t wake = due - LOAD_SPIN_NS;
+
+        ts.tv_sec = (time_t) (wake / 1000000000ull);
+        ts.tv_nsec = (long) (wake % 1000000000ull);
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR)
+            ;
+    }
+    while (load_now() < due)
+        _mm_pause();
+}
+
+static void load_worker_run(struct load_step *step, struct load_worker *w)
+{
+    std::vector<WEB_PAGE_t>& pages = *step->pages;
+    size_t i;
+
+    while ((i = __atomic_fetch_add(&step->next, 1, __ATOMIC_RELAXED)) < step->count) {
+        WEB_PAGE_t *page = &pages[i % pages.size()];
+        uint64_t due = step->start + step->sched[i];
+        size_t out_cap = app_pool_out_cap(page->lSize);
+        uint8_t *out;
+        sgx_status_t ret;
+        size_t oSize = 0;
+        uint64_t end;
+
+        load_wait(due);
+        out = (uint8_t *) app_buffer_get(out_cap);
+        ret = out ? nf_bench_call(step->eid, step->nf, page, out, out_cap, &oSize)
+                  : SGX_ERROR_OUT_OF_MEMORY;
+        app_buffer_put(out, out_cap);
+        end = load_now();
+        if (ret != SGX_SUCCESS) {
+            printf("Load:%s:Error:0x%x\n", page->name, ret);
+            w->failed++;
+            continue;
+        }
+        app_hdr_record(&w->hist, end - due);
+        w->done++;
+        w->last = std::max(w->last, end - step->start);
+    }
+}
+
+/* Send times of rate pages/s for opts->duration seconds, ns after start */
+static void load_schedule(const APP_OPTIONS_t *opts, unsigned rate, unsigned seed,
+                          std::vector<uint64_t>& sched)
+{
+    sched.resize((size_t) rate * opts->duration);
+    if (opts->arrivals == APP_ARRIVALS_CONSTANT) {
+        for (size_t i = 0; i < sched.size(); i++)
+            sched[i] = (uint64_t) ((double) i * 1e9 / rate);
+    } else {
+        std::mt19937_64 gen(seed);
+        std::exponential_distribution<double> gap((double) rate / 1e9);
+        double t = 0;
+
+        for (size_t i = 0; i < sched.size(); i++) {
+            t += gap(gen);
+            sched[i] = (uint64_t) t;
+        }
+    }
+}
+
+/* Runs one step and prints its line; returns 0 unless an ECALL failed */
+static int load_step_run(std::vector<WEB_PAGE_t>& pages, const APP_OPTIONS_t *opts,
+                         sgx_enclave_id_t eid, const char *variant, unsigned nf,
+                         const char *nf_name, unsigned rate, const std::vector<uint64_t>& sched,
+                         FILE *hist_fp, struct load_knee *knee)
+{
+    std::vector<struct load_worker> workers(opts->threads);
+    std::vector<std::thread> threads;
+    struct load_step step = {&pages, eid, nf, sched.data(), sched.size(), 0, 0};
+    static APP_HDR_t hist;
+    size_t done = 0, failed = 0;
+    uint64_t last = 0;
+    double offered, achieved;
+    bool sustained;
+
+    for (unsigned t = 0; t < opts->threads; t++) {
+        app_hdr_init(&workers[t].hist);
+        workers[t].done = workers[t].failed = 0;
+        workers[t].last = 0;
+    }
+    step.start = load_now() + LOAD_LEAD_NS;
+    for (unsigned t = 0; t < opts->threads; t++)
+        threads.push_back(std::thread(load_worker_run, &step, &workers[t]));
+    for (unsigned t = 0; t < opts->threads; t++)
+        threads[t].join();
+
+    app_hdr_init(&hist);
+    for (unsigned t = 0; t < opts->threads; t++) {
+        app_hdr_merge(&hist, &workers[t].hist);
+        done += workers[t].done;
+        failed += workers[t].failed;
+        last = std::max(last, workers[t].last);
+    }
+
+    /* Against the arrivals actually drawn, not the nominal rate */
+    offered = sched.back() ? (double) sched.size() * 1e9 / (double) sched.back() : rate;
+    achieved = last ? (double) done * 1e9 / (double) last : 0;
+    sustained = !failed && achieved >= LOAD_SUSTAINED * offered;
+    printf("Load:%s:%s:Arrivals:%s:Rate:%u:Threads:%u:Pages:%zu:Failed:%zu:OfferedRate:%.1f:"
+           "AchievedRate:%.1f:P50Us:%.1f:P90Us:%.1f:P99Us:%.1f:P999Us:%.1f:MaxUs:%.1f:"
+           "Sustained:%s\n", variant, nf_name,
+           opts->arrivals == APP_ARRIVALS_CONSTANT ? "constant" : "poisson", rate,
+           opts->threads, sched.size(), failed, offered, achieved,
+           app_hdr_percentile(&hist, 50) / 1e3, app_hdr_percentile(&hist, 90) / 1e3,
+           app_hdr_percentile(&hist, 99) / 1e3, app_hdr_percentile(&hist, 99.9) / 1e3,
+           hist.total ? hist.max / 1e3 : 0, sustained ? "yes" : "no");
+    if (sustained && rate > knee->rate) {
+        knee->rate = rate;
+        knee->p99 = app_hdr_percentile(&hist, 99);
+    }
+
+    if (hist_fp) {
+        fprintf(hist_fp, "# Load:%s:%s:Rate:%u (latency in us)\n", variant, nf_name, rate);
+        app_hdr_print(hist_fp, &hist, 1e3);
+        fprintf(hist_fp, "\n");
+    }
+    return failed ? -1 : 0;
+}
+
+int nf_load(std::vector<WEB_PAGE_t>& pages, const APP_OPTIONS_t *opts,
+            const sgx_enclave_id_t *eids, const char *const *variants, size_t nvariants)
+{
+    std::vector<uint64_t> sched;
+    FILE *hist_fp = NULL;
+    int rc = 0;
+
+    if (pages.empty())
+        return 0;
+    if (opts->hist_out && (hist_fp = fopen(opts->hist_out, "w")) == NULL) {
+        printf("\nCan not open or create file %s.\n", opts->hist_out);
+        return -1;
+    }
+
+    for (size_t f = 0; f < LOAD_NFS; f++) {
+        std::vector<struct load_knee> knees(nvariants, load_knee());
+
+        if (!(opts->load_nfs & load_nfs[f].bit))
+            continue;
+        for (unsigned r = 0; r < opts->nrates; r++) {
+            /* The variants take turns over the same arrivals */
+            load_schedule(opts, opts->rates[r], opts->seed + r, sched);
+            for (size_t v = 0; v < nvariants; v++)
+                if (load_step_run(pages, opts, eids[v], variants[v], load_nfs[f].bit,
+                                  load_nfs[f].name, opts->rates[r], sched, hist_fp,
+                                  &knees[v]) != 0)
+                    rc = -1;
+        }
+        for (size_t v = 0; v < nvariants; v++)
+            printf("LoadKnee:%s:%s:Rate:%u:P99Us:%.1f\n", variants[v], load_nfs[f].name,
+                   knees[v].rate, knees[v].p99 / 1e3);
+    }
+
+    if (hist_fp && fclose(hist_fp) != 0) {
+        printf("\nCan not write file %s.\n", opts->hist_out);
+        rc = -1;
+    }
+    return rc;
+}
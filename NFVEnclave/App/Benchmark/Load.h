@@ -0,0 +1,26 @@
+/*
+ * Load.h: Open-loop load of the NF ECALLs at a target rate.
+ */
+
+#ifndef _APP_BENCH_LOAD_H_
+#define _APP_BENCH_LOAD_H_
+
+#include <vector>
+#include "../App.h"
+#include "../Driver/Options.h"
+
+/*
+ * For each NF of opts->load_nfs and each rate of opts->rates, schedules
+ * opts->duration seconds of page arrivals (opts->arrivals) and has
+ * opts->threads workers issue them on each of the nvariants enclaves
+ * eids, named variants[]. A page's latency runs from its scheduled send
+ * time to the end of its ECALL, so time spent waiting for a worker
+ * counts. Prints the latency percentiles and the achieved rate of each
+ * step, then the highest sustained rate per NF and variant, and writes
+ * the latency distributions to opts->hist_out if set. Returns 0 unless an
+ * ECALL failed or the distributions could not be written.
+ */
+int nf_load(std::vector<WEB_PAGE_t>& pages, const APP_OPTIONS_t *opts,
+            const sgx_enclave_id_t *eids, const char *const *variants, size_t nvariants);
+
+#endif /* !_APP_BENCH_LOAD_H_ */
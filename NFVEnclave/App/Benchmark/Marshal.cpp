@@ -0,0 +1,184 @@
+/*
+ * Marshal.cpp: Host side of the marshalling benchmark.
+ *
+ * Times the calls of Marshal.edl for each pointer attribute and payload
+ * size, from 64 B to 16 MiB, as ECALLs and as OCALLs, on a regular enclave
+ * and, in a build with Switchless=enable, on one with the worker pools of
+ * the command line. The OCALLs are issued by one ecall_marshal_ocalls per
+ * measurement, whose own transition is spread over all of them. Each
+ * Marshal: line gives the time per call and the payload bytes moved per
+ * second, to choose the attributes of new NF entry points.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "sgx_urts.h"
+#include "../App.h"
+#include "../Driver/Buffers.h"
+#include "../Driver/Switchless.h"
+#include "Enclave_u.h"
+
+#define MARSHAL_BENCH_MIN_SIZE 64
+#define MARSHAL_BENCH_MAX_SIZE (16u << 20)
+#define MARSHAL_BENCH_BYTES (256u << 20)    /* Payload bytes per measurement */
+#define MARSHAL_BENCH_MIN_CALLS 16
+#define MARSHAL_BENCH_MAX_CALLS 20000
+
+#ifdef NF_SGX_SIM
+#define MARSHAL_BENCH_MODE "sim"
+#else
+#define MARSHAL_BENCH_MODE "hw"
+#endif
+
+static const char *marshal_attr_names[MARSHAL_BENCH_ATTRS] = {
+    "in", "out", "in_out", "user_check", "count"
+};
+
+/* The OCALLs only take their buffer, see Marshal.edl */
+void ocall_marshal_in(const uint8_t *buf, size_t len)
+{
+    (void) buf;
+    (void) len;
+}
+
+void ocall_marshal_out(uint8_t *buf, size_t len)
+{
+    (void) buf;
+    (void) len;
+}
+
+void ocall_marshal_in_out(uint8_t *buf, size_t len)
+{
+    (void) buf;
+    (void) len;
+}
+
+void ocall_marshal_user_check(uint8_t *buf, size_t len)
+{
+    (void) buf;
+    (void) len;
+}
+
+void ocall_marshal_count(const uint64_t *buf, size_t n)
+{
+    (void) buf;
+    (void) n;
+}
+
+static double marshal_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double) ts.tv_sec + (double) ts.tv_nsec / 1e9;
+}
+
+/* calls ECALLs of attr with len bytes of buf; SGX_SUCCESS or the first error */
+static sgx_status_t marshal_ecalls(sgx_enclave_id_t eid, int attr, uint8_t *buf, size_t len,
+                                   size_t calls)
+{
+    sgx_status_t ret = SGX_SUCCESS, status = SGX_SUCCESS;
+
+    for (size_t i = 0; i < calls && ret == SGX_SUCCESS && status == SGX_SUCCESS; i++) {
+        switch (attr) {
+        case MARSHAL_BENCH_IN:
+            ret = ecall_marshal_in(eid, &status, buf, len);
+            break;
+        case MARSHAL_BENCH_OUT:
+            ret = ecall_marshal_out(eid, &status, buf, len);
+            break;
+        case MARSHAL_BENCH_IN_OUT:
+            ret = ecall_marshal_in_out(eid, &status, buf, len);
+            break;
+        case MARSHAL_BENCH_USER_CHECK:
+            ret = ecall_marshal_user_check(eid, &status, buf, len);
+            break;
+        case MARSHAL_BENCH_COUNT:
+            ret = ecall_marshal_count(eid, &status, (const uint64_t *) buf, len / sizeof(uint64_t));
+            break;
+        }
+    }
+    return ret != SGX_SUCCESS ? ret : status;
+}
+
+static sgx_status_t marshal_ocalls(sgx_enclave_id_t eid, int attr, uint8_t *buf, size_t len,
+                                   size_t calls)
+{
+    sgx_status_t status = SGX_SUCCESS;
+    sgx_status_t ret = ecall_marshal_ocalls(eid, &status, attr, len, calls, buf);
+
+    return ret != SGX_SUCCESS ? ret : status;
+}
+
+/* Times one attribute, size and direction on eid and prints its line */
+static void marshal_measure(sgx_enclave_id_t eid, const char *transition, int ocall, int attr,
+                            uint8_t *buf, size_t len)
+{
+    size_t calls = MARSHAL_BENCH_BYTES / len;
+    sgx_status_t ret;
+    double tic, toc;
+
+    if (calls < MARSHAL_BENCH_MIN_CALLS)
+        calls = MARSHAL_BENCH_MIN_CALLS;
+    if (calls > MARSHAL_BENCH_MAX_CALLS)
+        calls = MARSHAL_BENCH_MAX_CALLS;
+
+    /* Warm up: the edge routines' first allocations of this size */
+    ret = ocall ? marshal_ocalls(eid, attr, buf, len, calls / 10 + 1)
+                : marshal_ecalls(eid, attr, buf, len, calls / 10 + 1);
+    tic = marshal_now();
+    if (ret == SGX_SUCCESS)
+        ret = ocall ? marshal_ocalls(eid, attr, buf, len, calls)
+                    : marshal_ecalls(eid, attr, buf, len, calls);
+    toc = marshal_now();
+    if (ret != SGX_SUCCESS) {
+        printf("Marshal:Mode:%s:Call:%s:Attr:%s:Transition:%s:Size:%zu:Error:0x%x\n",
+               MARSHAL_BENCH_MODE, ocall ? "ocall" : "ecall", marshal_attr_names[attr], transition,
+               len, ret);
+        return;
+    }
+    printf("Marshal:Mode:%s:Call:%s:Attr:%s:Transition:%s:Size:%zu:Calls:%zu:NsPerCall:%.1f:"
+           "GBps:%.3f\n", MARSHAL_BENCH_MODE, ocall ? "ocall" : "ecall", marshal_attr_names[attr],
+           transition, len, calls, (toc - tic) * 1e9 / (double) calls,
+           (double) len * (double) calls / (toc - tic) / 1e9);
+}
+
+/* marshal_benchmark:
+ *   Times the pointer attributes of ECALLs and OCALLs across payload sizes.
+ */
+void marshal_benchmark(const struct app_options *opts)
+{
+    static const char *transitions[2] = {"regular", "switchless"};
+    sgx_enclave_id_t eids[2];
+    int ninstances = 1;
+    uint8_t *buf;
+    sgx_status_t ret;
+
+    ret = app_create_enclave(ENCLAVE_FILENAME, opts, 0, &eids[0]);
+    if (ret != SGX_SUCCESS) {
+        print_error_message(ret);
+        return;
+    }
+    /* Without the worker pools, only the regular transitions are timed */
+    if (app_create_enclave(ENCLAVE_FILENAME, opts, 1, &eids[1]) == SGX_SUCCESS)
+        ninstances = 2;
+    printf("Marshal:Mode:%s:Switchless:%s:UWorkers:%u:TWorkers:%u\n", MARSHAL_BENCH_MODE,
+           ninstances == 2 ? "yes" : "no", opts->sl_uworkers, opts->sl_tworkers);
+
+    buf = (uint8_t *) app_buffer_get(MARSHAL_BENCH_MAX_SIZE);
+    if (buf == NULL) {
+        printf("Marshal:Error:out of memory\n");
+    } else {
+        memset(buf, 0x5a, MARSHAL_BENCH_MAX_SIZE);
+        for (size_t len = MARSHAL_BENCH_MIN_SIZE; len <= MARSHAL_BENCH_MAX_SIZE; len *= 4)
+            for (int ocall = 0; ocall < 2; ocall++)
+                for (int attr = 0; attr < MARSHAL_BENCH_ATTRS; attr++)
+                    for (int i = 0; i < ninstances; i++)
+                        marshal_measure(eids[i], transitions[i], ocall, attr, buf, len);
+        app_buffer_put(buf, MARSHAL_BENCH_MAX_SIZE);
+    }
+
+    for (int i = 0; i < ninstances; i++)
+        sgx_destroy_enclave(eids[i]);
+}
@@ -0,0 +1,394 @@
+/*
+ * Nf.cpp: Benchmark of the NF ECALLs over the pages.
+ *
+ * Every ECALL is timed on its own, so each NF yields a latency
+ * distribution: min, mean, p50, p99 and p99.9 over all pages and per page
+ * size bucket, with the throughput as the page bytes over the summed
+ * latencies. --bench-pages also keeps a record per page and NF, which
+ * Tools/nf_analyze pairs across variants. The clock is CLOCK_MONOTONIC, or the TSC calibrated against
+ * it (--timer tsc) for ECALLs too short for the clock's resolution.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <x86intrin.h>
+
+#include "../Driver/Buffers.h"
+#include "../Driver/Pool.h"
+#include "Enclave_u.h"
+#include "Nf.h"
+
+/* Page size buckets: [0, 1K), [1K, 4K), ..., [256K, 1M), [1M, ...) */
+#define BENCH_BUCKETS 7
+static const size_t bench_bucket_limits[BENCH_BUCKETS - 1] = {
+    1 << 10, 4 << 10, 16 << 10, 64 << 10, 256 << 10, 1 << 20
+};
+static const char *bench_bucket_names[BENCH_BUCKETS] = {
+    "0-1K", "1K-4K", "4K-16K", "16K-64K", "64K-256K", "256K-1M", "1M+"
+};
+
+static const struct { unsigned bit; const char *name; } bench_nfs[] = {
+    {APP_BENCH_IDS, "ids"}, {APP_BENCH_BADWORD, "badword"},
+    {APP_BENCH_COMPRESSION, "compression"}, {APP_BENCH_CHAIN, "chain"}
+};
+#define BENCH_NFS (sizeof(bench_nfs) / sizeof(bench_nfs[0]))
+
+#define BENCH_CALIBRATION_NS 100000000ull  /* TSC calibration period */
+
+/* The timed ECALLs of one NF over one bucket */
+struct bench_cell
+{
+    std::vector<double> ns;     /* Latency of each timed ECALL */
+    size_t pages;
+    size_t failed;              /* Pages dropped after a failed ECALL */
+    size_t in_bytes;            /* Page bytes of the timed ECALLs */
+    size_t out_bytes;           /* Output bytes of the timed ECALLs */
+};
+
+struct bench_stats
+{
+    double min, mean, p50, p99, p999;   /* Microseconds */
+    double mbps;
+};
+
+struct bench_timer
+{
+    app_timer_t kind;
+    double ns_per_tick;
+};
+
+static uint64_t bench_mono_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ull + (uint64_t) ts.tv_nsec;
+}
+
+static inline uint64_t bench_ticks(const struct bench_timer *timer)
+{
+    uint64_t tsc;
+
+    if (timer->kind != APP_TIMER_TSC)
+        return bench_mono_ns();
+    /* Keep the ECALL from moving across the reads */
+    _mm_lfence();
+    tsc = __rdtsc();
+    _mm_lfence();
+    return tsc;
+}
+
+/* Measures the TSC rate against CLOCK_MONOTONIC */
+static void bench_timer_init(struct bench_timer *timer, app_timer_t kind)
+{
+    uint64_t ns0, ns1, tsc0, tsc1;
+
+    timer->kind = kind;
+    timer->ns_per_tick = 1.0;
+    if (kind != APP_TIMER_TSC)
+        return;
+    ns0 = bench_mono_ns();
+    tsc0 = __rdtsc();
+    do {
+        ns1 = bench_mono_ns();
+    } while (ns1 - ns0 < BENCH_CALIBRATION_NS);
+    tsc1 = __rdtsc();
+    timer->ns_per_tick = (double) (ns1 - ns0) / (double) (tsc1 - tsc0);
+}
+
+sgx_status_t nf_bench_call(sgx_enclave_id_t eid, unsigned nf, WEB_PAGE_t *page, uint8_t *out,
+                           size_t oCap, size_t *oSize)
+{
+    nf_id_t chain[] = {NF_IDS, NF_COMPRESSION};
+    nf_stage_stats_t stats[sizeof(chain) / sizeof(chain[0])];
+    sgx_status_t ret, status = SGX_SUCCESS;
+    uint8_t out_mac[16], out_iv[12];
+    uint64_t out_seq;
+    size_t matched = 0;
+
+    switch (nf) {
+    case APP_BENCH_IDS:
+        ret = enclave_ids(eid, &status, page->cyphertext, page->lSize, page->en_mac,
+                          page->iv, oSize, out, oCap, out_mac, out_iv, &out_seq, &matched);
+        break;
+    case APP_BENCH_BADWORD:
+        ret = enclave_process_badword(eid, &status, page->cyphertext, page->lSize,
+                                      page->en_mac, page->iv, oSize, out, oCap, out_mac,
+                                      out_iv, &out_seq);
+        break;
+    case APP_BENCH_COMPRESSION:
+        ret = enclave_compression(eid, &status, page->cyphertext, page->lSize,
+                                  page->en_mac, page->iv, oSize, out, oCap, out_mac, out_iv,
+                                  &out_seq);
+        break;
+    default:
+        ret = enclave_nf_chain(eid, &status, chain, sizeof(chain) / sizeof(chain[0]),
+                               page->cyphertext, page->lSize, page->en_mac, page->iv, oSize,
+                               out, oCap, out_mac, out_iv, &out_seq, stats, &matched);
+        break;
+    }
+    return ret != SGX_SUCCESS ? ret : status;
+}
+
+static size_t bench_bucket(size_t size)
+{
+    size_t b = 0;
+
+    while (b < BENCH_BUCKETS - 1 && size >= bench_bucket_limits[b])
+        b++;
+    return b;
+}
+
+/* Nearest-rank percentile p of the sorted samples */
+static double bench_percentile(const std::vector<double>& sorted, double p)
+{
+    size_t rank = (size_t) std::ceil(p / 100.0 * (double) sorted.size());
+
+    return sorted[rank ? rank - 1 : 0];
+}
+
+/* Sorts the samples of cell and summarizes them */
+static void bench_summarize(struct bench_cell *cell, struct bench_stats *stats)
+{
+    double sum = 0;
+
+    memset(stats, 0, sizeof(*stats));
+    if (cell->ns.empty())
+        return;
+    std::sort(cell->ns.begin(), cell->ns.end());
+    for (size_t i = 0; i < cell->ns.size(); i++)
+        sum += cell->ns[i];
+    stats->min = cell->ns[0] / 1e3;
+    stats->mean = sum / (double) cell->ns.size() / 1e3;
+    stats->p50 = bench_percentile(cell->ns, 50) / 1e3;
+    stats->p99 = bench_percentile(cell->ns, 99) / 1e3;
+    stats->p999 = bench_percentile(cell->ns, 99.9) / 1e3;
+    stats->mbps = sum > 0 ? (double) cell->in_bytes / sum * 1e3 : 0;
+}
+
+/* The --bench-pages file */
+struct bench_pages
+{
+    FILE *fp;
+    app_bench_format_t format;
+    int first;
+};
+
+/* Writes name as a CSV field or a JSON string */
+static void bench_write_name(FILE *fp, const char *name, app_bench_format_t format)
+{
+    if (format == APP_BENCH_JSON) {
+        fputc('"', fp);
+        for (const char *c = name; *c; c++) {
+            if (*c == '"' || *c == '\\')
+                fprintf(fp, "\\%c", *c);
+            else if ((unsigned char) *c < 0x20)
+                fprintf(fp, "\\u%04x", (unsigned char) *c);
+            else
+                fputc(*c, fp);
+        }
+        fputc('"', fp);
+    } else if (strpbrk(name, ",\"\r\n")) {
+        fputc('"', fp);
+        for (const char *c = name; *c; c++) {
+            if (*c == '"')
+                fputc('"', fp);
+            fputc(*c, fp);
+        }
+        fputc('"', fp);
+    } else {
+        fputs(name, fp);
+    }
+}
+
+/* One page of one NF: the median, mean and min of its timed ECALLs */
+static void bench_write_page(struct bench_pages *out, const char *nf, const WEB_PAGE_t *page,
+                             size_t oSize, std::vector<double>& ns)
+{
+    double sum = 0, median;
+
+    for (size_t i = 0; i < ns.size(); i++)
+        sum += ns[i];
+    std::nth_element(ns.begin(), ns.begin() + ns.size() / 2, ns.end());
+    median = ns[ns.size() / 2];
+
+    if (out->format == APP_BENCH_JSON) {
+        fprintf(out->fp, "%s\n    {\"nf\": \"%s\", \"page\": ", out->first ? "" : ",", nf);
+        bench_write_name(out->fp, page->name, out->format);
+        fprintf(out->fp, ", \"bucket\": \"%s\", \"in_bytes\": %zu, \"out_bytes\": %zu, "
+                "\"samples\": %zu, \"median_us\": %.3f, \"mean_us\": %.3f, \"min_us\": %.3f}",
+                bench_bucket_names[bench_bucket(page->lSize)], page->lSize, oSize, ns.size(),
+                median / 1e3, sum / (double) ns.size() / 1e3,
+                *std::min_element(ns.begin(), ns.end()) / 1e3);
+    } else {
+        fprintf(out->fp, "%s,", nf);
+        bench_write_name(out->fp, page->name, out->format);
+        fprintf(out->fp, ",%s,%zu,%zu,%zu,%.3f,%.3f,%.3f\n",
+                bench_bucket_names[bench_bucket(page->lSize)], page->lSize, oSize, ns.size(),
+                median / 1e3, sum / (double) ns.size() / 1e3,
+                *std::min_element(ns.begin(), ns.end()) / 1e3);
+    }
+    out->first = 0;
+}
+
+/*
+ * Times the NF over every page into cells[BENCH_BUCKETS] and all, and
+ * each page into out if there is one
+ */
+static int bench_nf(unsigned nf, const char *name, std::vector<WEB_PAGE_t>& pages,
+                    const APP_OPTIONS_t *opts, const struct bench_timer *timer,
+                    struct bench_cell *cells, struct bench_cell *all, struct bench_pages *out)
+{
+    std::vector<double> page_ns;
+    int rc = 0;
+
+    for (size_t p = 0; p < pages.size(); p++) {
+        WEB_PAGE_t *page = &pages[p];
+        struct bench_cell *cell = &cells[bench_bucket(page->lSize)];
+        size_t out_cap = app_pool_out_cap(page->lSize);
+        uint8_t *buf = (uint8_t *) app_buffer_get(out_cap);
+        sgx_status_t ret = buf ? SGX_SUCCESS : SGX_ERROR_OUT_OF_MEMORY;
+        size_t oSize = 0;
+
+        page_ns.clear();
+        for (unsigned i = 0; i < opts->warmup && ret == SGX_SUCCESS; i++)
+            ret = nf_bench_call(global_eid, nf, page, buf, out_cap, &oSize);
+        for (unsigned i = 0; i < opts->iterations && ret == SGX_SUCCESS; i++) {
+            uint64_t tic = bench_ticks(timer);
+            ret = nf_bench_call(global_eid, nf, page, buf, out_cap, &oSize);
+            double ns = (double) (bench_ticks(timer) - tic) * timer->ns_per_tick;
+
+            if (ret != SGX_SUCCESS)
+                break;
+            page_ns.push_back(ns);
+            cell->ns.push_back(ns);
+            all->ns.push_back(ns);
+            cell->in_bytes += page->lSize;
+            all->in_bytes += page->lSize;
+            cell->out_bytes += oSize;
+            all->out_bytes += oSize;
+        }
+        app_buffer_put(buf, out_cap);
+
+        if (ret != SGX_SUCCESS) {
+            printf("Bench:%s:%s:Error:0x%x\n", name, page->name, ret);
+            cell->failed++;
+            all->failed++;
+            rc = -1;
+            continue;
+        }
+        cell->pages++;
+        all->pages++;
+        if (out)
+            bench_write_page(out, name, page, oSize, page_ns);
+    }
+    return rc;
+}
+
+static void bench_write_csv(FILE *fp, const char *nf, const char *bucket,
+                            const struct bench_cell *cell, const struct bench_stats *s)
+{
+    fprintf(fp, "%s,%s,%zu,%zu,%zu,%zu,%zu,%.3f,%.3f,%.3f,%.3f,%.3f,%.2f\n", nf, bucket,
+            cell->pages, cell->ns.size(), cell->failed, cell->in_bytes, cell->out_bytes,
+            s->min, s->mean, s->p50, s->p99, s->p999, s->mbps);
+}
+
+static void bench_write_json(FILE *fp, const char *nf, const char *bucket,
+                             const struct bench_cell *cell, const struct bench_stats *s,
+                             int first)
+{
+    fprintf(fp, "%s\n    {\"nf\": \"%s\", \"bucket\": \"%s\", \"pages\": %zu, \"samples\": %zu, "
+            "\"failed\": %zu, \"in_bytes\": %zu, \"out_bytes\": %zu, \"min_us\": %.3f, "
+            "\"mean_us\": %.3f, \"p50_us\": %.3f, \"p99_us\": %.3f, \"p999_us\": %.3f, "
+            "\"mbps\": %.2f}", first ? "" : ",", nf, bucket, cell->pages, cell->ns.size(),
+            cell->failed, cell->in_bytes, cell->out_bytes, s->min, s->mean, s->p50, s->p99,
+            s->p999, s->mbps);
+}
+
+int nf_benchmark(std::vector<WEB_PAGE_t>& pages, const APP_OPTIONS_t *opts)
+{
+    const char *timer_name = opts->timer == APP_TIMER_TSC ? "tsc" : "monotonic";
+    struct bench_timer timer;
+    struct bench_pages page_out = {NULL, opts->bench_format, 1};
+    FILE *fp = stdout;
+    int rc = 0, first = 1;
+
+    if (opts->bench_out) {
+        fp = fopen(opts->bench_out, "w");
+        if (fp == nullptr) {
+            printf("\nCan not open or create file %s.\n", opts->bench_out);
+            return -1;
+        }
+    }
+    if (opts->bench_pages) {
+        page_out.fp = fopen(opts->bench_pages, "w");
+        if (page_out.fp == nullptr) {
+            printf("\nCan not open or create file %s.\n", opts->bench_pages);
+            if (fp != stdout)
+                fclose(fp);
+            return -1;
+        }
+        if (opts->bench_format == APP_BENCH_JSON)
+            fprintf(page_out.fp, "{\n  \"timer\": \"%s\",\n  \"warmup\": %u,\n  \"iterations\": %u,\n"
+                    "  \"pages\": [", timer_name, opts->warmup, opts->iterations);
+        else
+            fprintf(page_out.fp, "nf,page,bucket,in_bytes,out_bytes,samples,median_us,mean_us,"
+                    "min_us\n");
+    }
+    bench_timer_init(&timer, opts->timer);
+
+    if (opts->bench_format == APP_BENCH_JSON)
+        fprintf(fp, "{\n  \"timer\": \"%s\",\n  \"warmup\": %u,\n  \"iterations\": %u,\n"
+                "  \"results\": [", timer_name, opts->warmup, opts->iterations);
+    else
+        fprintf(fp, "nf,bucket,pages,samples,failed,in_bytes,out_bytes,"
+                "min_us,mean_us,p50_us,p99_us,p999_us,mbps\n");
+
+    for (size_t n = 0; n < BENCH_NFS; n++) {
+        struct bench_cell cells[BENCH_BUCKETS], all;
+        struct bench_stats stats;
+
+        if (!(opts->bench & bench_nfs[n].bit))
+            continue;
+        for (size_t b = 0; b < BENCH_BUCKETS; b++)
+            cells[b].pages = cells[b].failed = cells[b].in_bytes = cells[b].out_bytes = 0;
+        all.pages = all.failed = all.in_bytes = all.out_bytes = 0;
+
+        if (bench_nf(bench_nfs[n].bit, bench_nfs[n].name, pages, opts, &timer, cells, &all,
+                     page_out.fp ? &page_out : NULL))
+            rc = -1;
+
+        for (size_t b = 0; b <= BENCH_BUCKETS; b++) {
+            struct bench_cell *cell = b < BENCH_BUCKETS ? &cells[b] : &all;
+            const char *bucket = b < BENCH_BUCKETS ? bench_bucket_names[b] : "all";
+
+            if (!cell->pages && !cell->failed)
+                continue;
+            bench_summarize(cell, &stats);
+            if (opts->bench_format == APP_BENCH_JSON)
+                bench_write_json(fp, bench_nfs[n].name, bucket, cell, &stats, first);
+            else
+                bench_write_csv(fp, bench_nfs[n].name, bucket, cell, &stats);
+            first = 0;
+        }
+    }
+
+    if (opts->bench_format == APP_BENCH_JSON)
+        fprintf(fp, "\n  ]\n}\n");
+    if (fp != stdout && fclose(fp) != 0) {
+        printf("\nCan not write file %s.\n", opts->bench_out);
+        rc = -1;
+    }
+    if (page_out.fp) {
+        if (opts->bench_format == APP_BENCH_JSON)
+            fprintf(page_out.fp, "\n  ]\n}\n");
+        if (fclose(page_out.fp) != 0) {
+            printf("\nCan not write file %s.\n", opts->bench_pages);
+            rc = -1;
+        }
+    }
+    return rc;
+}
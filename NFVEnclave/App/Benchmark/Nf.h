@@ -0,0 +1,27 @@
+/*
+ * Nf.h: Benchmark of the NF ECALLs over the pages.
+ */
+
+#ifndef _APP_BENCH_NF_H_
+#define _APP_BENCH_NF_H_
+
+#include <vector>
+#include "../App.h"
+#include "../Driver/Options.h"
+
+/*
+ * Runs each NF of opts->bench over every page, opts->warmup untimed times
+ * and then opts->iterations timed times, and writes the latency and
+ * throughput per NF and per page size bucket in opts->bench_format.
+ * Returns 0 unless an ECALL failed or the results could not be written.
+ */
+int nf_benchmark(std::vector<WEB_PAGE_t>& pages, const APP_OPTIONS_t *opts);
+
+/*
+ * One ECALL of the APP_BENCH_* NF nf over page on enclave eid, into the
+ * oCap bytes of out; app_pool_out_cap() is enough for any of them.
+ */
+sgx_status_t nf_bench_call(sgx_enclave_id_t eid, unsigned nf, WEB_PAGE_t *page, uint8_t *out,
+                           size_t oCap, size_t *oSize);
+
+#endif /* !_APP_BENCH_NF_H_ */
@@ -0,0 +1,157 @@
+/*
+ * Queue.cpp: Host side of the queue and counter benchmark.
+ *
+ * Part 1 moves QUEUE_BENCH_ITEMS items through the enclave's work queue
+ * with several producer and consumer host threads, each in its own ECALL,
+ * for the condvar ring of the thread sample and for NF_QUEUE_t. The sum of
+ * the popped items checks that every item arrived exactly once. Part 2
+ * increments a shared counter from several threads, under a mutex and
+ * with an atomic add.
+ */
+
+#include <stdio.h>
+#include <thread>
+#include <time.h>
+#include <vector>
+
+#include "../App.h"
+#include "Enclave_u.h"
+
+#define QUEUE_BENCH_ITEMS (1u << 20)    /* Items per run, all producers together */
+#define QUEUE_BENCH_CAPACITY 64
+#define COUNTER_BENCH_INCREMENTS (1u << 20)     /* Per run, all threads together */
+
+static const char *queue_design_names[QUEUE_BENCH_DESIGNS] = {"cond", "lockfree"};
+static const char *counter_design_names[2] = {"mutex", "atomic"};
+
+static double queue_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double) ts.tv_sec + (double) ts.tv_nsec / 1e9;
+}
+
+/* Share i of total split n ways, the remainder to the first ones */
+static size_t queue_share(size_t total, unsigned n, unsigned i)
+{
+    return total / n + (i < total % n ? 1 : 0);
+}
+
+static void queue_produce(size_t items, sgx_status_t *result)
+{
+    sgx_status_t status = SGX_SUCCESS;
+    sgx_status_t ret = ecall_queue_bench_produce(global_eid, &status, items);
+
+    *result = ret != SGX_SUCCESS ? ret : status;
+}
+
+static void queue_consume(size_t items, uint64_t *sum, sgx_status_t *result)
+{
+    sgx_status_t status = SGX_SUCCESS;
+    sgx_status_t ret = ecall_queue_bench_consume(global_eid, &status, items, sum);
+
+    *result = ret != SGX_SUCCESS ? ret : status;
+}
+
+static void queue_run(int design, unsigned producers, unsigned consumers)
+{
+    std::vector<std::thread> threads;
+    std::vector<sgx_status_t> results(producers + consumers, SGX_SUCCESS);
+    std::vector<uint64_t> sums(consumers, 0);
+    sgx_status_t status = SGX_SUCCESS, ret;
+    uint64_t expected = 0, sum = 0;
+    size_t parks = 0;
+    double tic, toc;
+
+    ret = ecall_queue_bench_init(global_eid, &status, design, QUEUE_BENCH_CAPACITY);
+    if (ret != SGX_SUCCESS || status != SGX_SUCCESS) {
+        printf("QueueBench:Design:%s:Error:0x%x\n", queue_design_names[design],
+               ret != SGX_SUCCESS ? ret : status);
+        return;
+    }
+
+    tic = queue_now();
+    for (unsigned c = 0; c < consumers; c++)
+        threads.emplace_back(queue_consume, queue_share(QUEUE_BENCH_ITEMS, consumers, c),
+                             &sums[c], &results[producers + c]);
+    for (unsigned p = 0; p < producers; p++) {
+        size_t items = queue_share(QUEUE_BENCH_ITEMS, producers, p);
+
+        expected += (uint64_t) items * (items + 1) / 2;
+        threads.emplace_back(queue_produce, items, &results[p]);
+    }
+    for (size_t t = 0; t < threads.size(); t++)
+        threads[t].join();
+    toc = queue_now();
+
+    ret = ecall_queue_bench_fini(global_eid, &status, &parks);
+    for (size_t t = 0; t < results.size(); t++)
+        if (ret == SGX_SUCCESS && status == SGX_SUCCESS)
+            status = results[t];
+    for (unsigned c = 0; c < consumers; c++)
+        sum += sums[c];
+    if (ret != SGX_SUCCESS || status != SGX_SUCCESS || sum != expected) {
+        printf("QueueBench:Design:%s:Producers:%u:Consumers:%u:Error:0x%x:Sum:%llu:Expected:%llu\n",
+               queue_design_names[design], producers, consumers, ret != SGX_SUCCESS ? ret : status,
+               (unsigned long long) sum, (unsigned long long) expected);
+        return;
+    }
+    printf("QueueBench:Design:%s:Producers:%u:Consumers:%u:Items:%u:Capacity:%u:Time:%f:"
+           "NsPerItem:%.1f:Parks:%zu\n", queue_design_names[design], producers, consumers,
+           QUEUE_BENCH_ITEMS, QUEUE_BENCH_CAPACITY, toc - tic,
+           (toc - tic) * 1e9 / QUEUE_BENCH_ITEMS, parks);
+}
+
+static void counter_increment(int design, size_t increments, sgx_status_t *result)
+{
+    sgx_status_t status = SGX_SUCCESS;
+    sgx_status_t ret = ecall_counter_bench(global_eid, &status, design, increments);
+
+    *result = ret != SGX_SUCCESS ? ret : status;
+}
+
+static void counter_run(int design, unsigned nthreads)
+{
+    std::vector<std::thread> threads;
+    std::vector<sgx_status_t> results(nthreads, SGX_SUCCESS);
+    sgx_status_t status = SGX_SUCCESS;
+    double tic, toc;
+
+    tic = queue_now();
+    for (unsigned t = 0; t < nthreads; t++)
+        threads.emplace_back(counter_increment, design,
+                             queue_share(COUNTER_BENCH_INCREMENTS, nthreads, t), &results[t]);
+    for (unsigned t = 0; t < nthreads; t++)
+        threads[t].join();
+    toc = queue_now();
+
+    for (unsigned t = 0; t < nthreads; t++)
+        if (status == SGX_SUCCESS)
+            status = results[t];
+    if (status != SGX_SUCCESS) {
+        printf("CounterBench:Design:%s:Threads:%u:Error:0x%x\n", counter_design_names[design],
+               nthreads, status);
+        return;
+    }
+    printf("CounterBench:Design:%s:Threads:%u:Increments:%u:Time:%f:NsPerIncrement:%.1f\n",
+           counter_design_names[design], nthreads, COUNTER_BENCH_INCREMENTS, toc - tic,
+           (toc - tic) * 1e9 / COUNTER_BENCH_INCREMENTS);
+}
+
+/* queue_benchmark:
+ *   Compares the lock-free queue and counter with their mutex and condvar
+ *   counterparts. At most 8 threads, within the TCSs of the enclave.
+ */
+void queue_benchmark(void)
+{
+    static const unsigned configs[][2] = {{1, 1}, {1, 4}, {4, 1}, {2, 2}, {4, 4}};
+    static const unsigned counter_threads[] = {1, 2, 4, 8};
+
+    for (size_t c = 0; c < sizeof(configs) / sizeof(configs[0]); c++)
+        for (int design = 0; design < QUEUE_BENCH_DESIGNS; design++)
+            queue_run(design, configs[c][0], configs[c][1]);
+
+    for (size_t t = 0; t < sizeof(counter_threads) / sizeof(counter_threads[0]); t++)
+        for (int design = COUNTER_BENCH_MUTEX; design <= COUNTER_BENCH_ATOMIC; design++)
+            counter_run(design, counter_threads[t]);
+}
@@ -0,0 +1,98 @@
+/*
+ * Sched.cpp: Host side of the work-stealing scheduler benchmark.
+ *
+ * Runs the IDS scan and the smaz compression over one big trusted page,
+ * chunk by chunk, first in a plain loop on the calling thread and then
+ * with nf_parallel_for() spread over --sched workers. Each time is the
+ * best of SCHED_BENCH_RUNS. The results of both must agree; the Sched:
+ * lines at the end give the share of the work each deque ran.
+ */
+
+#include <stdio.h>
+#include <time.h>
+
+#include "../App.h"
+#include "../Driver/Options.h"
+#include "../Driver/Sched.h"
+#include "Enclave_u.h"
+
+#define SCHED_BENCH_RUNS 3
+
+static const char *sched_kernel_names[] = {"scan", "compress"};
+
+static double sched_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double) ts.tv_sec + (double) ts.tv_nsec / 1e9;
+}
+
+/* Best time of the runs; 0 with *result unset on error */
+static double sched_time(int kernel, int parallel, uint64_t *result)
+{
+    double best = 0;
+
+    for (int r = 0; r < SCHED_BENCH_RUNS; r++) {
+        sgx_status_t status = SGX_SUCCESS, ret;
+        double tic = sched_now(), t;
+
+        ret = ecall_sched_bench_run(global_eid, &status, kernel, parallel, result);
+        t = sched_now() - tic;
+        if (ret != SGX_SUCCESS || status != SGX_SUCCESS) {
+            printf("SchedBench:Kernel:%s:Parallel:%d:Error:0x%x\n", sched_kernel_names[kernel],
+                   parallel, ret != SGX_SUCCESS ? ret : status);
+            return 0;
+        }
+        if (r == 0 || t < best)
+            best = t;
+    }
+    return best;
+}
+
+/* sched_benchmark:
+ *   Serial against chunk-parallel NF kernels, for each page size and
+ *   chunk size, on opts->sched workers.
+ */
+void sched_benchmark(const struct app_options *opts)
+{
+    static const size_t sizes[] = {1u << 20, 16u << 20};
+    static const size_t grains[] = {4096, 32768};
+
+    if (app_sched_start(global_eid, opts->sched) != 0)
+        return;
+
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        for (size_t g = 0; g < sizeof(grains) / sizeof(grains[0]); g++) {
+            sgx_status_t status = SGX_SUCCESS, ret;
+
+            ret = ecall_sched_bench_init(global_eid, &status, sizes[s], grains[g]);
+            if (ret != SGX_SUCCESS || status != SGX_SUCCESS) {
+                printf("SchedBench:Size:%zu:Grain:%zu:Error:0x%x\n", sizes[s], grains[g],
+                       ret != SGX_SUCCESS ? ret : status);
+                continue;
+            }
+            for (int k = SCHED_BENCH_SCAN; k <= SCHED_BENCH_COMPRESS; k++) {
+                uint64_t serial = 0, parallel = 0;
+                double ts = sched_time(k, 0, &serial);
+                double tp = ts > 0 ? sched_time(k, 1, &parallel) : 0;
+
+                if (ts == 0 || tp == 0)
+                    continue;
+                if (serial != parallel) {
+                    printf("SchedBench:Kernel:%s:Size:%zu:Grain:%zu:Error:Mismatch:Serial:%llu:"
+                           "Parallel:%llu\n", sched_kernel_names[k], sizes[s], grains[g],
+                           (unsigned long long) serial, (unsigned long long) parallel);
+                    continue;
+                }
+                printf("SchedBench:Kernel:%s:Size:%zu:Grain:%zu:Workers:%u:SerialMBps:%.1f:"
+                       "ParallelMBps:%.1f:Speedup:%.2f:Result:%llu\n", sched_kernel_names[k],
+                       sizes[s], grains[g], opts->sched, (double) sizes[s] / ts / 1e6,
+                       (double) sizes[s] / tp / 1e6, ts / tp, (unsigned long long) serial);
+            }
+            ecall_sched_bench_fini(global_eid, &status);
+        }
+    }
+
+    app_sched_report(global_eid);
+    app_sched_stop(global_eid);
+}
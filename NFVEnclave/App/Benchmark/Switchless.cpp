@@ -0,0 +1,138 @@
+/*
+ * Switchless.cpp: Host side of the switchless benchmark.
+ *
+ * Creates two instances of the enclave, a regular one and one with the
+ * worker pools of the command line, and times the same calls on both:
+ * enclave_ids over small pages (one ECALL per page) and
+ * ecall_print_benchmark (one ECALL, many ocall_print_string). Run it on a
+ * simulation and on a hardware build: simulation only models the
+ * transitions, so the gap is much smaller there.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "sgx_urts.h"
+#include "../App.h"
+#include "../Driver/Switchless.h"
+#include "Enclave_u.h"
+#include "sample_libcrypto.h"
+
+#define SL_BENCH_CALLS 20000        /* ECALLs per measurement */
+#define SL_BENCH_PRINTS 200000      /* OCALLs per measurement */
+
+#ifdef NF_SGX_SIM
+#define SL_BENCH_MODE "sim"
+#else
+#define SL_BENCH_MODE "hw"
+#endif
+
+static double sl_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double) ts.tv_sec + (double) ts.tv_nsec / 1e9;
+}
+
+/* Seconds taken by calls enclave_ids of the page, or -1 */
+static double sl_time_ids(sgx_enclave_id_t eid, uint8_t *cyphertext, size_t lSize,
+                          uint8_t *en_mac, uint8_t *iv, uint8_t *out, size_t oCap,
+                          size_t calls)
+{
+    sgx_status_t status = SGX_SUCCESS;
+    double tic = sl_now();
+
+    for (size_t i = 0; i < calls; i++) {
+        uint8_t out_mac[16], out_iv[12];
+        uint64_t out_seq;
+        size_t oSize, matched;
+        if (enclave_ids(eid, &status, cyphertext, lSize, en_mac, iv, &oSize, out, oCap, out_mac,
+                        out_iv, &out_seq, &matched) != SGX_SUCCESS || status != SGX_SUCCESS)
+            return -1;
+    }
+    return sl_now() - tic;
+}
+
+/* Seconds taken by prints empty OCALLs, or -1 */
+static double sl_time_print(sgx_enclave_id_t eid, size_t prints)
+{
+    sgx_status_t status = SGX_SUCCESS;
+    double tic = sl_now();
+
+    if (ecall_print_benchmark(eid, &status, prints) != SGX_SUCCESS || status != SGX_SUCCESS)
+        return -1;
+    return sl_now() - tic;
+}
+
+static void sl_report(const char *call, size_t size, const double t[2], size_t n)
+{
+    if (t[0] < 0 || t[1] < 0) {
+        printf("Switchless:Mode:%s:Call:%s:Size:%zu:Error\n", SL_BENCH_MODE, call, size);
+        return;
+    }
+    printf("Switchless:Mode:%s:Call:%s:Size:%zu:RegularUs:%.3f:SwitchlessUs:%.3f:Speedup:%.2f\n",
+           SL_BENCH_MODE, call, size, t[0] * 1e6 / (double) n, t[1] * 1e6 / (double) n,
+           t[0] / t[1]);
+}
+
+/* switchless_benchmark:
+ *   Compares regular and switchless transitions.
+ */
+void switchless_benchmark(const struct app_options *opts)
+{
+    static const size_t sizes[] = {64, 256, 1500, 4096};
+    const uint8_t data_key[16] = {0x87, 0xA6, 0x0B, 0x39, 0xD5, 0x26, 0xAB, 0x1C, 0x30, 0x9E, 0xEC, 0x60, 0x6C, 0x72, 0xBA, 0x36};
+    sgx_enclave_id_t eids[2];
+    sgx_status_t ret;
+
+    for (int sl = 0; sl < 2; sl++) {
+        ret = app_create_enclave(ENCLAVE_FILENAME, opts, sl, &eids[sl]);
+        if (ret != SGX_SUCCESS) {
+            print_error_message(ret);
+            if (sl)
+                sgx_destroy_enclave(eids[0]);
+            return;
+        }
+    }
+    printf("Switchless:Mode:%s:UWorkers:%u:TWorkers:%u:Fallback:%u:Sleep:%u\n", SL_BENCH_MODE,
+           opts->sl_uworkers, opts->sl_tworkers, opts->sl_fallback, opts->sl_sleep);
+
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        size_t lSize = sizes[s];
+        uint8_t *page = (uint8_t *) calloc(1, lSize);
+        uint8_t *cyphertext = (uint8_t *) malloc(lSize);
+        const nf_id_t ids = NF_IDS;
+        size_t oCap = nf_out_cap(&ids, 1, lSize);
+        uint8_t *out = (uint8_t *) malloc(oCap);
+        uint8_t en_mac[16], iv[12];
+        double t[2];
+
+        app_page_iv(iv);
+        sample_rijndael128GCM_encrypt((const sample_aes_gcm_128bit_key_t *) data_key, page,
+                                      (uint32_t) lSize, cyphertext, iv, sizeof(iv), NULL, 0,
+                                      (sample_aes_gcm_128bit_tag_t *) en_mac);
+        for (int sl = 0; sl < 2; sl++) {
+            /* Warm up */
+            sl_time_ids(eids[sl], cyphertext, lSize, en_mac, iv, out, oCap, SL_BENCH_CALLS / 10);
+            t[sl] = sl_time_ids(eids[sl], cyphertext, lSize, en_mac, iv, out, oCap,
+                                SL_BENCH_CALLS);
+        }
+        sl_report("ids", lSize, t, SL_BENCH_CALLS);
+
+        free(page);
+        free(cyphertext);
+        free(out);
+    }
+
+    {
+        double t[2];
+        for (int sl = 0; sl < 2; sl++)
+            t[sl] = sl_time_print(eids[sl], SL_BENCH_PRINTS);
+        sl_report("print", 0, t, SL_BENCH_PRINTS);
+    }
+
+    sgx_destroy_enclave(eids[0]);
+    sgx_destroy_enclave(eids[1]);
+}
@@ -0,0 +1,181 @@
+/*
+ * Buffers.cpp: Pool of page-aligned host buffers. See Buffers.h.
+ *
+ * A free buffer keeps the link to the next one of its class in its first
+ * bytes, so the free lists cost no memory of their own. Each class has
+ * its own lock; the counters are atomics.
+ */
+
+#include <mutex>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/resource.h>
+
+#include "Buffers.h"
+
+#define BUFFER_ALIGN 4096
+#define BUFFER_MIN_SHIFT 12     /* 4 KiB */
+#define BUFFER_STEP_SHIFT 14    /* Quarter steps from 16 KiB on */
+#define BUFFER_MAX_SHIFT 40     /* Larger buffers bypass the free lists */
+#define BUFFER_POW2_CLASSES (BUFFER_STEP_SHIFT - BUFFER_MIN_SHIFT + 1)
+#define BUFFER_CLASSES (BUFFER_POW2_CLASSES + 4 * (BUFFER_MAX_SHIFT - BUFFER_STEP_SHIFT))
+
+struct buffer_free
+{
+    struct buffer_free *next;
+};
+
+struct buffer_class
+{
+    std::mutex lock;
+    struct buffer_free *free;
+};
+
+static struct buffer_class buffer_classes[BUFFER_CLASSES];
+static APP_BUFFER_STATS_t buffer_totals;
+
+/* Class of a size-byte buffer and its capacity; -1 past the largest class */
+static int buffer_class_of(size_t size, size_t *cap)
+{
+    unsigned s = BUFFER_MIN_SHIFT;
+    size_t quarter, q;
+
+    if (size <= ((size_t) 1 << BUFFER_STEP_SHIFT)) {
+        while (((size_t) 1 << s) < size)
+            s++;
+        *cap = (size_t) 1 << s;
+        return (int) (s - BUFFER_MIN_SHIFT);
+    }
+    if (size > ((size_t) 1 << BUFFER_MAX_SHIFT)) {
+        *cap = (size + BUFFER_ALIGN - 1) & ~((size_t) BUFFER_ALIGN - 1);
+        return -1;
+    }
+
+    /* 2^s < size <= 2^(s+1), in steps of 2^(s-2) */
+    s = 63 - (unsigned) __builtin_clzll((unsigned long long) (size - 1));
+    quarter = (size_t) 1 << (s - 2);
+    q = (size - ((size_t) 1 << s) + quarter - 1) / quarter;
+    *cap = ((size_t) 1 << s) + q * quarter;
+    return (int) (BUFFER_POW2_CLASSES + 4 * (s - BUFFER_STEP_SHIFT) + q - 1);
+}
+
+/* Capacity of the buffers of class c */
+static size_t buffer_class_cap(int c)
+{
+    unsigned s, q;
+
+    if (c < BUFFER_POW2_CLASSES)
+        return (size_t) 1 << (c + BUFFER_MIN_SHIFT);
+    s = BUFFER_STEP_SHIFT + (unsigned) (c - BUFFER_POW2_CLASSES) / 4;
+    q = (unsigned) (c - BUFFER_POW2_CLASSES) % 4 + 1;
+    return ((size_t) 1 << s) + q * ((size_t) 1 << (s - 2));
+}
+
+static void buffer_count_use(size_t cap)
+{
+    size_t in_use = __atomic_add_fetch(&buffer_totals.in_use, cap, __ATOMIC_RELAXED);
+    size_t peak = __atomic_load_n(&buffer_totals.peak, __ATOMIC_RELAXED);
+
+    while (in_use > peak &&
+           !__atomic_compare_exchange_n(&buffer_totals.peak, &peak, in_use, true,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        ;
+}
+
+void *app_buffer_get(size_t size)
+{
+    size_t cap;
+    int c = buffer_class_of(size, &cap);
+    void *buf = NULL;
+
+    if (c >= 0) {
+        struct buffer_class *cl = &buffer_classes[c];
+        std::lock_guard<std::mutex> guard(cl->lock);
+
+        if (cl->free) {
+            buf = cl->free;
+            cl->free = cl->free->next;
+        }
+    }
+    if (buf) {
+        __atomic_sub_fetch(&buffer_totals.held, cap, __ATOMIC_RELAXED);
+        __atomic_add_fetch(&buffer_totals.reuses, 1, __ATOMIC_RELAXED);
+    } else {
+        if (posix_memalign(&buf, BUFFER_ALIGN, cap) != 0)
+            return NULL;
+        __atomic_add_fetch(&buffer_totals.allocs, 1, __ATOMIC_RELAXED);
+    }
+    buffer_count_use(cap);
+    return buf;
+}
+
+void app_buffer_put(void *buf, size_t size)
+{
+    size_t cap;
+    int c = buffer_class_of(size, &cap);
+
+    if (!buf)
+        return;
+    __atomic_sub_fetch(&buffer_totals.in_use, cap, __ATOMIC_RELAXED);
+
+    /* Claim room on the free lists before linking the buffer in */
+    if (c >= 0 && __atomic_add_fetch(&buffer_totals.held, cap, __ATOMIC_RELAXED) <=
+                  APP_BUFFER_HOLD_MAX) {
+        struct buffer_class *cl = &buffer_classes[c];
+        struct buffer_free *node = (struct buffer_free *) buf;
+        std::lock_guard<std::mutex> guard(cl->lock);
+
+        node->next = cl->free;
+        cl->free = node;
+        return;
+    }
+    if (c >= 0)
+        __atomic_sub_fetch(&buffer_totals.held, cap, __ATOMIC_RELAXED);
+    free(buf);
+    __atomic_add_fetch(&buffer_totals.releases, 1, __ATOMIC_RELAXED);
+}
+
+void app_buffer_stats(APP_BUFFER_STATS_t *stats)
+{
+    stats->allocs = __atomic_load_n(&buffer_totals.allocs, __ATOMIC_RELAXED);
+    stats->reuses = __atomic_load_n(&buffer_totals.reuses, __ATOMIC_RELAXED);
+    stats->releases = __atomic_load_n(&buffer_totals.releases, __ATOMIC_RELAXED);
+    stats->in_use = __atomic_load_n(&buffer_totals.in_use, __ATOMIC_RELAXED);
+    stats->peak = __atomic_load_n(&buffer_totals.peak, __ATOMIC_RELAXED);
+    stats->held = __atomic_load_n(&buffer_totals.held, __ATOMIC_RELAXED);
+}
+
+void app_buffer_report(void)
+{
+    APP_BUFFER_STATS_t st;
+    struct rusage ru;
+
+    app_buffer_stats(&st);
+    if (getrusage(RUSAGE_SELF, &ru) != 0)
+        ru.ru_maxrss = 0;
+    printf("Buffers:Allocs:%zu:Reuses:%zu:Releases:%zu:InUse:%zu:Peak:%zu:Held:%zu:"
+           "MaxRSSKiB:%ld\n", st.allocs, st.reuses, st.releases, st.in_use, st.peak, st.held, ru.ru_maxrss);
+}
+
+void app_buffer_trim(void)
+{
+    for (int c = 0; c < BUFFER_CLASSES; c++) {
+        struct buffer_class *cl = &buffer_classes[c];
+        struct buffer_free *node;
+
+        {
+            std::lock_guard<std::mutex> guard(cl->lock);
+            node = cl->free;
+            cl->free = NULL;
+        }
+        while (node) {
+            struct buffer_free *next = node->next;
+
+            free(node);
+            __atomic_sub_fetch(&buffer_totals.held, buffer_class_cap(c), __ATOMIC_RELAXED);
+            __atomic_add_fetch(&buffer_totals.releases, 1, __ATOMIC_RELAXED);
+            node = next;
+        }
+    }
+}
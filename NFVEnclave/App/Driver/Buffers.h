@@ -0,0 +1,43 @@
+/*
+ * Buffers.h: Pool of page-aligned host buffers.
+ *
+ * Buffers come in size classes: 4, 8 and 16 KiB, then four classes per
+ * doubling (20, 24, 28, 32 KiB, ...), so a buffer wastes less than a
+ * quarter of its size. A buffer put back goes on the free list of its
+ * class and serves the next request of that class; once the pages of a
+ * run have been seen, the pool hands out buffers without allocating.
+ */
+
+#ifndef _APP_BUFFERS_H_
+#define _APP_BUFFERS_H_
+
+#include <stddef.h>
+
+/* Bytes the free lists may hold; buffers put back beyond it are freed */
+#define APP_BUFFER_HOLD_MAX ((size_t) 1 << 30)
+
+typedef struct app_buffer_stats
+{
+    size_t allocs;      /* Buffers obtained from the system */
+    size_t reuses;      /* Requests served from a free list */
+    size_t releases;    /* Buffers given back to the system */
+    size_t in_use;      /* Bytes handed out and not put back */
+    size_t peak;        /* Highest in_use */
+    size_t held;        /* Bytes on the free lists */
+} APP_BUFFER_STATS_t;
+
+/* A page-aligned buffer of at least size bytes, or NULL if out of memory */
+void *app_buffer_get(size_t size);
+
+/* Puts back buf, obtained with the same size; NULL is ignored */
+void app_buffer_put(void *buf, size_t size);
+
+void app_buffer_stats(APP_BUFFER_STATS_t *stats);
+
+/* Prints the stats and the peak RSS of the process */
+void app_buffer_report(void);
+
+/* Frees the buffers on the free lists */
+void app_buffer_trim(void);
+
+#endif /* !_APP_BUFFERS_H_ */
@@ -0,0 +1,223 @@
+/*
+ * Corpus.cpp: Packed corpus of encrypted pages. See Corpus.h.
+ *
+ * A run over the ../Web/ directory opens, sizes and reads every page and
+ * writes two files per page to ../WebEnc/; a packed corpus is one open
+ * and one mmap, and the pages are slices of it.
+ */
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "Corpus.h"
+
+#define APP_CORPUS_COPY (1u << 20)      /* Bytes moved at a time from the spool */
+
+static uint64_t corpus_align(uint64_t x, uint64_t a)
+{
+    return (x + a - 1) / a * a;
+}
+
+int app_corpus_begin(APP_CORPUS_WRITER_t *w, const char *path)
+{
+    w->path = path;
+    w->spool = std::string(path) + ".data";
+    w->index.clear();
+    w->names.clear();
+    w->data_len = 0;
+    w->data = fopen(w->spool.c_str(), "w+b");
+    if (w->data == nullptr) {
+        printf("\nCan not open or create file %s.\n", w->spool.c_str());
+        return -1;
+    }
+    return 0;
+}
+
+int app_corpus_add(APP_CORPUS_WRITER_t *w, const std::vector<WEB_PAGE_t>& pages, size_t first)
+{
+    static const uint8_t zeros[APP_CORPUS_PAYLOAD_ALIGN] = {0};
+
+    if (w->data == nullptr)
+        return -1;
+    for (size_t i = first; i < pages.size(); i++) {
+        APP_CORPUS_ENTRY_t e;
+        uint64_t pad = corpus_align(w->data_len, APP_CORPUS_PAYLOAD_ALIGN) - w->data_len;
+
+        if (w->index.size() == UINT32_MAX) {
+            printf("\nToo many pages for a packed corpus.\n");
+            return -1;
+        }
+        memset(&e, 0, sizeof(e));
+        e.name_len = (uint32_t) strlen(pages[i].name);
+        e.name_off = (uint32_t) w->names.size();
+        e.offset = w->data_len + pad;
+        e.length = pages[i].lSize;
+        memcpy(e.mac, pages[i].en_mac, sizeof(e.mac));
+        memcpy(e.iv, pages[i].iv, sizeof(e.iv));
+        if (fwrite(zeros, 1, pad, w->data) != pad ||
+            fwrite(pages[i].cyphertext, 1, pages[i].lSize, w->data) != pages[i].lSize) {
+            printf("\nCan not write file %s.\n", w->spool.c_str());
+            return -1;
+        }
+        w->names.append(pages[i].name, e.name_len);
+        w->index.push_back(e);
+        w->data_len = e.offset + e.length;
+    }
+    return 0;
+}
+
+int app_corpus_end(APP_CORPUS_WRITER_t *w, bool write)
+{
+    static const uint8_t zeros[APP_CORPUS_ALIGN] = {0};
+    APP_CORPUS_HEADER_t header;
+    FILE *fp = nullptr;
+    int ok = write && w->data != nullptr;
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, APP_CORPUS_MAGIC, sizeof(header.magic));
+    header.version = APP_CORPUS_VERSION;
+    header.count = (uint32_t) w->index.size();
+    header.index_off = sizeof(header);
+    header.names_off = header.index_off + w->index.size() * sizeof(APP_CORPUS_ENTRY_t);
+    header.names_len = w->names.size();
+    header.data_off = corpus_align(header.names_off + header.names_len, APP_CORPUS_ALIGN);
+    header.data_len = w->data_len;
+
+    if (ok) {
+        fp = fopen(w->path, "wb");
+        if (fp == nullptr) {
+            printf("\nCan not open or create file %s.\n", w->path);
+            ok = 0;
+        }
+    }
+    if (fp) {
+        size_t pad = header.data_off - header.names_off - header.names_len;
+        std::vector<uint8_t> buf(APP_CORPUS_COPY);
+        size_t n;
+
+        ok = fwrite(&header, sizeof(header), 1, fp) == 1 &&
+             fwrite(w->index.data(), sizeof(APP_CORPUS_ENTRY_t), w->index.size(), fp) ==
+                 w->index.size() &&
+             fwrite(w->names.data(), 1, w->names.size(), fp) == w->names.size() &&
+             fwrite(zeros, 1, pad, fp) == pad && fflush(w->data) == 0 &&
+             fseek(w->data, 0, SEEK_SET) == 0;
+        /* The payloads, from the spool */
+        while (ok && (n = fread(buf.data(), 1, buf.size(), w->data)) > 0)
+            ok = fwrite(buf.data(), 1, n, fp) == n;
+        if (ferror(w->data))
+            ok = 0;
+        if (fclose(fp) != 0)
+            ok = 0;
+        if (!ok) {
+            printf("\nCan not write file %s.\n", w->path);
+            remove(w->path);
+        }
+    }
+    if (w->data)
+        fclose(w->data);
+    w->data = nullptr;
+    remove(w->spool.c_str());
+    if (ok)
+        printf("Corpus:%s:Pages:%zu:Bytes:%llu\n", w->path, w->index.size(),
+               (unsigned long long) (header.data_off + header.data_len));
+    w->index.clear();
+    w->names.clear();
+    return ok ? 0 : -1;
+}
+
+/* Whether [off, off + len) lies within [0, size) */
+static bool corpus_in(uint64_t off, uint64_t len, uint64_t size)
+{
+    return off <= size && len <= size - off;
+}
+
+int app_corpus_map(const char *path, APP_CORPUS_t *corpus, std::vector<WEB_PAGE_t>& pages)
+{
+    const APP_CORPUS_HEADER_t *header;
+    const APP_CORPUS_ENTRY_t *index;
+    const uint8_t *base;
+    size_t first = pages.size();
+    struct stat st;
+    int fd;
+
+    corpus->map = NULL;
+    corpus->size = 0;
+    fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        printf("\nFile %s not exist.\n", path);
+        return -1;
+    }
+    if (fstat(fd, &st) != 0 || (size_t) st.st_size < sizeof(APP_CORPUS_HEADER_t)) {
+        printf("\n%s is not a packed corpus.\n", path);
+        close(fd);
+        return -1;
+    }
+    /* Fault the whole file in now rather than inside the timed ECALLs */
+    corpus->map = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+    close(fd);
+    if (corpus->map == MAP_FAILED) {
+        corpus->map = NULL;
+        printf("\nCan not map file %s.\n", path);
+        return -1;
+    }
+    corpus->size = (size_t) st.st_size;
+    base = (const uint8_t *) corpus->map;
+    header = (const APP_CORPUS_HEADER_t *) base;
+
+    if (memcmp(header->magic, APP_CORPUS_MAGIC, sizeof(header->magic)) == 0 &&
+        header->version != APP_CORPUS_VERSION) {
+        printf("\n%s is a version %u corpus, pack it again.\n", path, header->version);
+        app_corpus_unmap(corpus);
+        return -1;
+    }
+    if (memcmp(header->magic, APP_CORPUS_MAGIC, sizeof(header->magic)) != 0 ||
+        header->index_off % sizeof(uint64_t) != 0 ||
+        !corpus_in(header->index_off, (uint64_t) header->count * sizeof(APP_CORPUS_ENTRY_t),
+                   corpus->size) ||
+        !corpus_in(header->names_off, header->names_len, corpus->size) ||
+        !corpus_in(header->data_off, header->data_len, corpus->size)) {
+        printf("\n%s is not a packed corpus.\n", path);
+        app_corpus_unmap(corpus);
+        return -1;
+    }
+
+    index = (const APP_CORPUS_ENTRY_t *) (base + header->index_off);
+    pages.reserve(pages.size() + header->count);
+    for (uint32_t i = 0; i < header->count; i++) {
+        const APP_CORPUS_ENTRY_t *e = &index[i];
+        WEB_PAGE_t page;
+        size_t len;
+
+        if (!corpus_in(e->offset, e->length, header->data_len) ||
+            !corpus_in(e->name_off, e->name_len, header->names_len)) {
+            printf("\n%s: page %u is out of the file.\n", path, i);
+            pages.resize(first);
+            app_corpus_unmap(corpus);
+            return -1;
+        }
+        if (e->length == 0)
+            continue;
+        len = e->name_len < sizeof(page.name) ? e->name_len : sizeof(page.name) - 1;
+        memcpy(page.name, base + header->names_off + e->name_off, len);
+        page.name[len] = '\0';
+        page.lSize = (size_t) e->length;
+        page.cleartext = NULL;
+        page.cyphertext = (uint8_t *) base + header->data_off + e->offset;
+        memcpy(page.en_mac, e->mac, sizeof(page.en_mac));
+        memcpy(page.iv, e->iv, sizeof(page.iv));
+        pages.push_back(page);
+    }
+    return 0;
+}
+
+void app_corpus_unmap(APP_CORPUS_t *corpus)
+{
+    if (corpus->map)
+        munmap(corpus->map, corpus->size);
+    corpus->map = NULL;
+    corpus->size = 0;
+}
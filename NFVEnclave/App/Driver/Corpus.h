@@ -0,0 +1,99 @@
+/*
+ * Corpus.h: Packed corpus of encrypted pages, mapped instead of read.
+ *
+ * The file, in host byte order:
+ *
+ *   APP_CORPUS_HEADER_t
+ *   APP_CORPUS_ENTRY_t[count]     offset, length, MAC and IV of each page
+ *   names                         the page names, not NUL-terminated
+ *   padding to APP_CORPUS_ALIGN
+ *   payloads                      the ciphertexts, each at a multiple of
+ *                                 APP_CORPUS_PAYLOAD_ALIGN
+ *
+ * The ciphertexts are encrypted under app_data_key, each under the IV of
+ * its entry, which app_page_iv() gave it. The pages handed out by
+ * app_corpus_map() point into the mapping: there is no cleartext, and
+ * the enclave reads the ciphertexts where they lie.
+ */
+
+#ifndef _APP_CORPUS_H_
+#define _APP_CORPUS_H_
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include "../App.h"
+
+#define APP_CORPUS_MAGIC "NFVPAGES"
+#define APP_CORPUS_VERSION 2         /* 1 had one IV for all the pages */
+#define APP_CORPUS_ALIGN 4096           /* Start of the payloads */
+#define APP_CORPUS_PAYLOAD_ALIGN 64     /* Each payload, one cache line */
+
+typedef struct app_corpus_header {
+    char magic[8];              /* APP_CORPUS_MAGIC */
+    uint32_t version;           /* APP_CORPUS_VERSION */
+    uint32_t count;             /* Pages */
+    uint64_t index_off;         /* APP_CORPUS_ENTRY_t[count] */
+    uint64_t names_off;
+    uint64_t names_len;
+    uint64_t data_off;          /* Payloads, aligned to APP_CORPUS_ALIGN */
+    uint64_t data_len;
+    uint8_t reserved[16];
+} APP_CORPUS_HEADER_t;
+
+typedef struct app_corpus_entry {
+    uint64_t offset;            /* Of the ciphertext, from data_off */
+    uint64_t length;
+    uint32_t name_off;          /* Of the name, from names_off */
+    uint32_t name_len;
+    uint8_t mac[16];
+    uint8_t iv[12];
+    uint32_t reserved;
+} APP_CORPUS_ENTRY_t;
+
+/* A mapped corpus */
+typedef struct app_corpus {
+    void *map;
+    size_t size;
+} APP_CORPUS_t;
+
+/*
+ * A packed corpus being written a group of pages at a time. The payloads
+ * go to a spool file next to the corpus, since the index before them is
+ * only known at the end; the writer keeps just the index and the names.
+ */
+typedef struct app_corpus_writer {
+    const char *path;
+    std::string spool;                      /* path.data */
+    FILE *data;                             /* The payloads so far */
+    std::vector<APP_CORPUS_ENTRY_t> index;
+    std::string names;
+    uint64_t data_len;
+} APP_CORPUS_WRITER_t;
+
+/* Starts a packed corpus to be written to path. Returns 0 on success. */
+int app_corpus_begin(APP_CORPUS_WRITER_t *w, const char *path);
+
+/*
+ * Appends the encrypted pages[first..] to the corpus; their buffers may be
+ * put as soon as it returns. Returns 0 on success.
+ */
+int app_corpus_add(APP_CORPUS_WRITER_t *w, const std::vector<WEB_PAGE_t>& pages, size_t first);
+
+/*
+ * Writes the corpus to its path if write is set, and removes the spool
+ * either way. Returns 0 if the corpus was written.
+ */
+int app_corpus_end(APP_CORPUS_WRITER_t *w, bool write);
+
+/*
+ * Maps the packed corpus at path read-only and appends its pages to
+ * pages, their cyphertext pointing into the mapping. The pages are valid
+ * until app_corpus_unmap(). Returns 0 on success.
+ */
+int app_corpus_map(const char *path, APP_CORPUS_t *corpus, std::vector<WEB_PAGE_t>& pages);
+
+void app_corpus_unmap(APP_CORPUS_t *corpus);
+
+#endif /* !_APP_CORPUS_H_ */
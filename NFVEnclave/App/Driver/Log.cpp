@@ -0,0 +1,66 @@
+/*
+ * Log.cpp: Host side of the enclave's buffered log.
+ *
+ * The enclave flushes its log on its own once the buffer fills up. A
+ * thread here also polls enclave_log_flush on a timer, so that a quiet
+ * enclave does not sit on its last lines, and app_log_stop() takes the
+ * rest at shutdown.
+ */
+
+#include <stdio.h>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include "../App.h"
+#include "Enclave_u.h"
+#include "Log.h"
+
+static std::thread log_thread;
+static std::mutex log_mutex;
+static std::condition_variable log_cond;
+static bool log_stopping = false;
+
+/* A batch of log lines of the enclave */
+void ocall_log_flush(const char *buf, size_t len)
+{
+    fwrite(buf, 1, len, stdout);
+}
+
+static void log_flush(void)
+{
+    sgx_status_t status = SGX_SUCCESS;
+    enclave_log_flush(global_eid, &status);
+}
+
+void app_log_start(unsigned interval_ms)
+{
+    if (!interval_ms)
+        return;
+
+    log_stopping = false;
+    log_thread = std::thread([interval_ms]() {
+        std::unique_lock<std::mutex> lock(log_mutex);
+        while (!log_cond.wait_for(lock, std::chrono::milliseconds(interval_ms),
+                                  [] { return log_stopping; })) {
+            lock.unlock();
+            log_flush();
+            lock.lock();
+        }
+    });
+}
+
+void app_log_stop(void)
+{
+    if (log_thread.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(log_mutex);
+            log_stopping = true;
+        }
+        log_cond.notify_one();
+        log_thread.join();
+    }
+    log_flush();
+    fflush(stdout);
+}
@@ -0,0 +1,22 @@
+/*
+ * Log.h: Host side of the enclave's buffered log.
+ */
+
+#ifndef _APP_LOG_H_
+#define _APP_LOG_H_
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+/* Polls enclave_log_flush every interval_ms milliseconds; 0 never polls */
+void app_log_start(unsigned interval_ms);
+
+/* Stops the polls and flushes what is left; call before destroying the enclave */
+void app_log_stop(void);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif /* !_APP_LOG_H_ */
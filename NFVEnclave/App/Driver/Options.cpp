@@ -0,0 +1,525 @@
+/*
+ * Options.cpp: Command line of the App.
+ */
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "Options.h"
+#include "Ruleset.h"
+
+/* Defaults of the SDK's switchless configuration */
+#define APP_SL_WORKERS 1
+#define APP_SL_RETRIES 20000
+
+/* Period of the enclave log polls */
+#define APP_LOG_INTERVAL_MS 100
+
+/* Runs of each page and NF in the benchmark */
+#define APP_BENCH_WARMUP 3
+#define APP_BENCH_ITERATIONS 20
+
+/* Open-loop load steps */
+#define APP_LOAD_DURATION 10
+#define APP_LOAD_RATE_MAX 10000000
+#define APP_LOAD_REQUESTS_MAX (1u << 24)    /* Pages scheduled in one step */
+
+/* TCSNum of Enclave.config.xml */
+#define APP_TCS_NUM 10
+
+/* Ring workers each hold a TCS for the whole run */
+#define APP_RING_WORKERS_MAX 8
+
+/*
+ * Scheduler workers hold a TCS for the whole run; one is left for the
+ * ECALL that forks and one for the log polls
+ */
+#define APP_SCHED_WORKERS (APP_TCS_NUM - 2)
+
+/* Pool threads hold a TCS per ECALL; one is left for the log polls */
+#define APP_POOL_THREADS_MAX (APP_TCS_NUM - 1)
+
+/* Pages queued between two pipeline stages */
+#define APP_QUEUE_DEPTH 64
+
+static void app_usage(const char *prog)
+{
+    printf("Usage: %s [options]\n"
+           "  --ab LIST           run the pages through the enclave variants of LIST side\n"
+           "                      by side and exit: bare,before,mitigated or all; the\n"
+           "                      first one is the baseline of the overheads\n"
+           "  --arrivals A        arrivals of --rate: constant or poisson (default constant)\n"
+           "  --batch N           process the pages N at a time with the batched ECALLs\n"
+           "  --bench LIST        benchmark the NFs of LIST over the pages and exit:\n"
+           "                      ids,badword,compression,chain or all\n"
+           "  --bench-format F    benchmark results as csv or json (default csv)\n"
+           "  --bench-out FILE    write the benchmark results to FILE (default stdout)\n"
+           "  --bench-pages FILE  also write the time and output size of each page and NF\n"
+           "                      to FILE, in the --bench-format (for Tools/nf_analyze)\n"
+           "  --chain             run IDS and compression as one enclave_nf_chain ECALL\n"
+           "                      per page instead of one ECALL per NF\n"
+           "  --corpus FILE       take the encrypted pages from the packed corpus FILE\n"
+           "                      instead of ../Web/\n"
+           "  --duration S        seconds of arrivals of each --rate step (default %d)\n"
+           "  --gcm-bench         compare the GCM implementations and exit\n"
+           "  --hist-out FILE     write the latency distribution of each --rate step to\n"
+           "                      FILE, in the HdrHistogram percentile layout\n"
+           "  --iterations N      timed runs of each page and NF (default %d)\n"
+           "  --load-nfs LIST     NFs of --rate: ids,badword,compression,chain or all\n"
+           "                      (default all)\n"
+           "  --log-interval MS   flush the enclave log every MS milliseconds, 0 only\n"
+           "                      when its buffer fills up and at exit (default %d)\n"
+           "  --marshal-bench     time ECALLs and OCALLs of each pointer attribute from\n"
+           "                      64 B to 16 MiB, regular and switchless, and exit\n"
+           "  --pack FILE         encrypt ../Web/ into the packed corpus FILE and exit\n"
+           "  --pipeline L,C,E,S  run ../Web/ through a staged pipeline with L loader, C\n"
+           "                      host crypto, E enclave (at most %d) and S sink threads\n"
+           "  --pcap-mode M       pages of the pcap captures in ../Web/: body (one per\n"
+           "                      HTTP body), stream (one per TCP direction) or segment\n"
+           "                      (one per in-order TCP segment) (default body)\n"
+           "  --queue-bench       compare the enclave's lock-free work queue and atomic\n"
+           "                      counter with the mutex/condvar ones and exit\n"
+           "  --queue-depth N     pages queued between pipeline stages (default %d)\n"
+           "  --rate LIST         open-loop load: issue the pages to the --threads workers\n"
+           "                      at each comma-separated rate (pages/s) in turn and\n"
+           "                      report the latency from the scheduled send times\n"
+           "  --ring N            feed the pages to N long-running enclave workers\n"
+           "                      through shared rings (at most %d)\n"
+           "  --rules FILE        badword patterns, separated by '|' or newlines\n"
+           "                      (default %s)\n"
+           "  --rules-sealed FILE load the ruleset sealed in FILE; if there is no\n"
+           "                      usable one, seal the rules file there\n"
+           "  --sched N           enclave threads of the work-stealing scheduler that\n"
+           "                      split IDS and compression pages of 1 MiB and more\n"
+           "                      (default and at most %d, less the trusted workers)\n"
+           "  --sched-bench       run the NF kernels chunk-parallel on the scheduler\n"
+           "                      against a plain loop and exit\n"
+           "  --seed N            seed of the Poisson arrivals (default 1)\n"
+           "  --threads N         process the pages on N host threads that issue the\n"
+           "                      NF ECALLs concurrently (at most %d, with --switchless\n"
+           "                      minus the trusted workers)\n"
+           "  --timer T           benchmark clock: monotonic or tsc (default monotonic)\n"
+           "  --warmup N          untimed runs of each page and NF first (default %d)\n"
+           "  --switchless        make the NF ECALLs and the prints switchless\n"
+           "                      (needs a build with Switchless=enable)\n"
+           "  --switchless-bench  compare regular and switchless calls and exit\n"
+           "  --sl-uworkers N     untrusted workers, serve switchless OCALLs (default %d)\n"
+           "  --sl-tworkers N     trusted workers, serve switchless ECALLs (default %d)\n"
+           "  --sl-fallback N     retries before a call falls back to a regular\n"
+           "                      transition (default %d)\n"
+           "  --sl-sleep N        idle retries before a worker sleeps (default %d)\n"
+           "  -h, --help          show this text\n", prog, APP_LOAD_DURATION, APP_BENCH_ITERATIONS, APP_LOG_INTERVAL_MS,
+           APP_POOL_THREADS_MAX, APP_QUEUE_DEPTH, APP_RING_WORKERS_MAX, APP_RULES_FILE, APP_SCHED_WORKERS, APP_POOL_THREADS_MAX, APP_BENCH_WARMUP,
+           APP_SL_WORKERS, APP_SL_WORKERS, APP_SL_RETRIES, APP_SL_RETRIES);
+}
+
+/* Parses a decimal count in [min, max] */
+static int app_parse_count(const char *name, const char *arg, unsigned long min,
+                           unsigned long max, unsigned *value)
+{
+    char *end;
+    unsigned long n = strtoul(arg, &end, 10);
+
+    if (*arg == '\0' || *arg == '-' || *end != '\0' || n < min || n > max) {
+        printf("Bad %s: %s\n", name, arg);
+        return -1;
+    }
+    *value = (unsigned) n;
+    return 0;
+}
+
+/* Parses the comma-separated NFs of --bench into APP_BENCH_* bits */
+static int app_parse_bench(const char *arg, unsigned *mask)
+{
+    static const struct { const char *name; unsigned bits; } nfs[] = {
+        {"ids", APP_BENCH_IDS}, {"badword", APP_BENCH_BADWORD},
+        {"compression", APP_BENCH_COMPRESSION}, {"chain", APP_BENCH_CHAIN},
+        {"all", APP_BENCH_IDS | APP_BENCH_BADWORD | APP_BENCH_COMPRESSION | APP_BENCH_CHAIN}
+    };
+    const char *p = arg;
+
+    *mask = 0;
+    while (*p) {
+        size_t len = strcspn(p, ",");
+        size_t i;
+
+        for (i = 0; i < sizeof(nfs) / sizeof(nfs[0]); i++)
+            if (strlen(nfs[i].name) == len && strncmp(p, nfs[i].name, len) == 0)
+                break;
+        if (i == sizeof(nfs) / sizeof(nfs[0])) {
+            printf("Bad NF list: %s\n", arg);
+            return -1;
+        }
+        *mask |= nfs[i].bits;
+        p += len;
+        if (*p == ',')
+            p++;
+    }
+    if (!*mask) {
+        printf("Bad NF list: %s\n", arg);
+        return -1;
+    }
+    return 0;
+}
+
+/* Parses the comma-separated variants of --ab into APP_AB_* bits */
+static int app_parse_ab(const char *arg, unsigned *mask)
+{
+    static const struct { const char *name; unsigned bits; } variants[] = {
+        {"bare", APP_AB_BARE}, {"before", APP_AB_BEFORE}, {"mitigated", APP_AB_MITIGATED},
+        {"all", APP_AB_BARE | APP_AB_BEFORE | APP_AB_MITIGATED}
+    };
+    const char *p = arg;
+
+    *mask = 0;
+    while (*p) {
+        size_t len = strcspn(p, ",");
+        size_t i;
+
+        for (i = 0; i < sizeof(variants) / sizeof(variants[0]); i++)
+            if (strlen(variants[i].name) == len && strncmp(p, variants[i].name, len) == 0)
+                break;
+        if (i == sizeof(variants) / sizeof(variants[0])) {
+            printf("Bad variant list: %s\n", arg);
+            return -1;
+        }
+        *mask |= variants[i].bits;
+        p += len;
+        if (*p == ',')
+            p++;
+    }
+    /* A comparison needs two variants */
+    if (__builtin_popcount(*mask) < 2) {
+        printf("Bad variant list: %s (at least two of bare, before, mitigated)\n", arg);
+        return -1;
+    }
+    return 0;
+}
+
+/* Parses the comma-separated pages/s of --rate */
+static int app_parse_rates(const char *arg, unsigned *rates, unsigned *nrates)
+{
+    const char *p = arg;
+
+    *nrates = 0;
+    do {
+        char *end;
+        unsigned long n = strtoul(p, &end, 10);
+
+        if (end == p || *p == '-' || n < 1 || n > APP_LOAD_RATE_MAX ||
+            (*end != ',' && *end != '\0') || *nrates == APP_LOAD_STEPS_MAX) {
+            printf("Bad rate list: %s (at most %d rates of 1 to %d pages/s)\n", arg,
+                   APP_LOAD_STEPS_MAX, APP_LOAD_RATE_MAX);
+            return -1;
+        }
+        rates[(*nrates)++] = (unsigned) n;
+        p = *end ? end + 1 : end;
+    } while (*p);
+    return 0;
+}
+
+/* Parses the four comma-separated stage thread counts of --pipeline */
+static int app_parse_pipeline(const char *arg, unsigned *threads)
+{
+    static const unsigned max[APP_PIPE_STAGES] = {64, 64, APP_POOL_THREADS_MAX, 64};
+    const char *p = arg;
+
+    for (int s = 0; s < APP_PIPE_STAGES; s++) {
+        char *end;
+        unsigned long n = strtoul(p, &end, 10);
+
+        if (end == p || *p == '-' || n < 1 || n > max[s] ||
+            *end != (s == APP_PIPE_STAGES - 1 ? '\0' : ',')) {
+            printf("Bad pipeline: %s (L,C,E,S threads, E at most %d)\n", arg,
+                   APP_POOL_THREADS_MAX);
+            return -1;
+        }
+        threads[s] = (unsigned) n;
+        p = end + 1;
+    }
+    return 0;
+}
+
+/* app_parse_options:
+ *   Fills opts from argv.
+ */
+int app_parse_options(int argc, char *argv[], APP_OPTIONS_t *opts)
+{
+    enum {
+        OPT_AB = 256, OPT_ARRIVALS, OPT_BATCH, OPT_BENCH, OPT_BENCH_FORMAT, OPT_BENCH_OUT, OPT_BENCH_PAGES, OPT_CHAIN, OPT_CORPUS,
+        OPT_DURATION, OPT_GCM_BENCH, OPT_HIST_OUT, OPT_ITERATIONS, OPT_LOAD_NFS, OPT_LOG_INTERVAL, OPT_MARSHAL_BENCH, OPT_PACK, OPT_PCAP_MODE, OPT_PIPELINE, OPT_QUEUE_BENCH, OPT_QUEUE_DEPTH, OPT_RATE, OPT_RING, OPT_RULES, OPT_RULES_SEALED, OPT_SCHED, OPT_SCHED_BENCH, OPT_SEED,
+        OPT_SWITCHLESS, OPT_SWITCHLESS_BENCH, OPT_THREADS, OPT_TIMER, OPT_WARMUP,
+        OPT_SL_UWORKERS, OPT_SL_TWORKERS, OPT_SL_FALLBACK, OPT_SL_SLEEP
+    };
+    static const struct option longopts[] = {
+        {"ab",               required_argument, NULL, OPT_AB},
+        {"arrivals",         required_argument, NULL, OPT_ARRIVALS},
+        {"batch",            required_argument, NULL, OPT_BATCH},
+        {"bench",            required_argument, NULL, OPT_BENCH},
+        {"bench-format",     required_argument, NULL, OPT_BENCH_FORMAT},
+        {"bench-out",        required_argument, NULL, OPT_BENCH_OUT},
+        {"bench-pages",      required_argument, NULL, OPT_BENCH_PAGES},
+        {"chain",            no_argument,       NULL, OPT_CHAIN},
+        {"corpus",           required_argument, NULL, OPT_CORPUS},
+        {"duration",         required_argument, NULL, OPT_DURATION},
+        {"gcm-bench",        no_argument,       NULL, OPT_GCM_BENCH},
+        {"hist-out",         required_argument, NULL, OPT_HIST_OUT},
+        {"iterations",       required_argument, NULL, OPT_ITERATIONS},
+        {"load-nfs",         required_argument, NULL, OPT_LOAD_NFS},
+        {"log-interval",     required_argument, NULL, OPT_LOG_INTERVAL},
+        {"marshal-bench",    no_argument,       NULL, OPT_MARSHAL_BENCH},
+        {"pack",             required_argument, NULL, OPT_PACK},
+        {"pcap-mode",        required_argument, NULL, OPT_PCAP_MODE},
+        {"pipeline",         required_argument, NULL, OPT_PIPELINE},
+        {"queue-bench",      no_argument,       NULL, OPT_QUEUE_BENCH},
+        {"queue-depth",      required_argument, NULL, OPT_QUEUE_DEPTH},
+        {"rate",             required_argument, NULL, OPT_RATE},
+        {"ring",             required_argument, NULL, OPT_RING},
+        {"rules",            required_argument, NULL, OPT_RULES},
+        {"rules-sealed",     required_argument, NULL, OPT_RULES_SEALED},
+        {"sched",            required_argument, NULL, OPT_SCHED},
+        {"sched-bench",      no_argument,       NULL, OPT_SCHED_BENCH},
+        {"seed",             required_argument, NULL, OPT_SEED},
+        {"switchless",       no_argument,       NULL, OPT_SWITCHLESS},
+        {"switchless-bench", no_argument,       NULL, OPT_SWITCHLESS_BENCH},
+        {"threads",          required_argument, NULL, OPT_THREADS},
+        {"timer",            required_argument, NULL, OPT_TIMER},
+        {"warmup",           required_argument, NULL, OPT_WARMUP},
+        {"sl-uworkers",      required_argument, NULL, OPT_SL_UWORKERS},
+        {"sl-tworkers",      required_argument, NULL, OPT_SL_TWORKERS},
+        {"sl-fallback",      required_argument, NULL, OPT_SL_FALLBACK},
+        {"sl-sleep",         required_argument, NULL, OPT_SL_SLEEP},
+        {"help",             no_argument,       NULL, 'h'},
+        {NULL, 0, NULL, 0}
+    };
+    int c, ret = 0;
+
+    memset(opts, 0, sizeof(*opts));
+    opts->warmup = APP_BENCH_WARMUP;
+    opts->iterations = APP_BENCH_ITERATIONS;
+    opts->log_interval = APP_LOG_INTERVAL_MS;
+    opts->queue_depth = APP_QUEUE_DEPTH;
+    opts->duration = APP_LOAD_DURATION;
+    opts->load_nfs = APP_BENCH_IDS | APP_BENCH_BADWORD | APP_BENCH_COMPRESSION | APP_BENCH_CHAIN;
+    opts->seed = 1;
+    opts->sched = APP_SCHED_WORKERS;
+    opts->sl_uworkers = APP_SL_WORKERS;
+    opts->sl_tworkers = APP_SL_WORKERS;
+    opts->sl_fallback = APP_SL_RETRIES;
+    opts->sl_sleep = APP_SL_RETRIES;
+
+    while (ret == 0 && (c = getopt_long(argc, argv, "h", longopts, NULL)) != -1) {
+        switch (c) {
+        case OPT_AB:
+            ret = app_parse_ab(optarg, &opts->ab);
+            break;
+        case OPT_ARRIVALS:
+            if (strcmp(optarg, "constant") == 0) {
+                opts->arrivals = APP_ARRIVALS_CONSTANT;
+            } else if (strcmp(optarg, "poisson") == 0) {
+                opts->arrivals = APP_ARRIVALS_POISSON;
+            } else {
+                printf("Bad arrivals: %s\n", optarg);
+                ret = -1;
+            }
+            break;
+        case OPT_BATCH:
+            ret = app_parse_count("batch size", optarg, 1, 65536, &opts->batch);
+            break;
+        case OPT_BENCH:
+            ret = app_parse_bench(optarg, &opts->bench);
+            break;
+        case OPT_BENCH_FORMAT:
+            if (strcmp(optarg, "csv") == 0) {
+                opts->bench_format = APP_BENCH_CSV;
+            } else if (strcmp(optarg, "json") == 0) {
+                opts->bench_format = APP_BENCH_JSON;
+            } else {
+                printf("Bad benchmark format: %s\n", optarg);
+                ret = -1;
+            }
+            break;
+        case OPT_BENCH_OUT:
+            opts->bench_out = optarg;
+            break;
+        case OPT_BENCH_PAGES:
+            opts->bench_pages = optarg;
+            break;
+        case OPT_CHAIN:
+            opts->chain = 1;
+            break;
+        case OPT_CORPUS:
+            opts->corpus = optarg;
+            break;
+        case OPT_DURATION:
+            ret = app_parse_count("duration", optarg, 1, 3600, &opts->duration);
+            break;
+        case OPT_GCM_BENCH:
+            opts->gcm_bench = 1;
+            break;
+        case OPT_HIST_OUT:
+            opts->hist_out = optarg;
+            break;
+        case OPT_ITERATIONS:
+            ret = app_parse_count("iteration count", optarg, 1, 1000000, &opts->iterations);
+            break;
+        case OPT_LOAD_NFS:
+            ret = app_parse_bench(optarg, &opts->load_nfs);
+            break;
+        case OPT_LOG_INTERVAL:
+            ret = app_parse_count("log interval", optarg, 0, 3600000, &opts->log_interval);
+            break;
+        case OPT_MARSHAL_BENCH:
+            opts->marshal_bench = 1;
+            break;
+        case OPT_PACK:
+            opts->pack = optarg;
+            break;
+        case OPT_PCAP_MODE:
+            if (strcmp(optarg, "body") == 0) {
+                opts->pcap_mode = APP_PCAP_BODY;
+            } else if (strcmp(optarg, "stream") == 0) {
+                opts->pcap_mode = APP_PCAP_STREAM;
+            } else if (strcmp(optarg, "segment") == 0) {
+                opts->pcap_mode = APP_PCAP_SEGMENT;
+            } else {
+                printf("Bad pcap mode: %s\n", optarg);
+                ret = -1;
+            }
+            break;
+        case OPT_PIPELINE:
+            ret = app_parse_pipeline(optarg, opts->pipeline);
+            break;
+        case OPT_QUEUE_BENCH:
+            opts->queue_bench = 1;
+            break;
+        case OPT_QUEUE_DEPTH:
+            ret = app_parse_count("queue depth", optarg, 1, 65536, &opts->queue_depth);
+            break;
+        case OPT_RATE:
+            ret = app_parse_rates(optarg, opts->rates, &opts->nrates);
+            break;
+        case OPT_RING:
+            ret = app_parse_count("worker count", optarg, 1, APP_RING_WORKERS_MAX, &opts->ring);
+            break;
+        case OPT_RULES:
+            opts->rules = optarg;
+            break;
+        case OPT_RULES_SEALED:
+            opts->rules_sealed = optarg;
+            break;
+        case OPT_SCHED:
+            ret = app_parse_count("worker count", optarg, 1, APP_SCHED_WORKERS, &opts->sched);
+            break;
+        case OPT_SCHED_BENCH:
+            opts->sched_bench = 1;
+            break;
+        case OPT_SEED:
+            ret = app_parse_count("seed", optarg, 0, 0xffffffffUL, &opts->seed);
+            break;
+        case OPT_SWITCHLESS:
+            opts->switchless = 1;
+            break;
+        case OPT_SWITCHLESS_BENCH:
+            opts->switchless_bench = 1;
+            break;
+        case OPT_THREADS:
+            ret = app_parse_count("thread count", optarg, 1, APP_POOL_THREADS_MAX, &opts->threads);
+            break;
+        case OPT_TIMER:
+            if (strcmp(optarg, "monotonic") == 0) {
+                opts->timer = APP_TIMER_MONOTONIC;
+            } else if (strcmp(optarg, "tsc") == 0) {
+                opts->timer = APP_TIMER_TSC;
+            } else {
+                printf("Bad timer: %s\n", optarg);
+                ret = -1;
+            }
+            break;
+        case OPT_WARMUP:
+            ret = app_parse_count("warm-up count", optarg, 0, 1000000, &opts->warmup);
+            break;
+        case OPT_SL_UWORKERS:
+            ret = app_parse_count("untrusted worker count", optarg, 0, 64, &opts->sl_uworkers);
+            break;
+        case OPT_SL_TWORKERS:
+            ret = app_parse_count("trusted worker count", optarg, 0, 64, &opts->sl_tworkers);
+            break;
+        case OPT_SL_FALLBACK:
+            ret = app_parse_count("retry count", optarg, 0, 0xffffffffUL, &opts->sl_fallback);
+            break;
+        case OPT_SL_SLEEP:
+            ret = app_parse_count("retry count", optarg, 0, 0xffffffffUL, &opts->sl_sleep);
+            break;
+        case 'h':
+            app_usage(argv[0]);
+            return 1;
+        default:
+            app_usage(argv[0]);
+            return -1;
+        }
+    }
+    if (ret != 0)
+        return ret;
+    if (optind < argc) {
+        printf("Unexpected argument: %s\n", argv[optind]);
+        app_usage(argv[0]);
+        return -1;
+    }
+    if (opts->pack && opts->corpus) {
+        printf("--pack does not combine with --corpus\n");
+        return -1;
+    }
+    if (opts->bench && (opts->ring || opts->batch || opts->threads)) {
+        printf("--bench does not combine with --ring, --batch or --threads\n");
+        return -1;
+    }
+    if (opts->pipeline[APP_PIPE_ENCLAVE] &&
+        (opts->bench || opts->ring || opts->batch || opts->threads || opts->corpus || opts->pack)) {
+        printf("--pipeline does not combine with --bench, --ring, --batch, --threads,\n"
+               "--corpus or --pack\n");
+        return -1;
+    }
+    /* Each variant seals for itself, so one sealed copy cannot serve them all */
+    if (opts->ab && (opts->bench || opts->ring || opts->batch || (opts->threads && !opts->nrates) ||
+                     opts->chain || opts->pipeline[APP_PIPE_ENCLAVE] || opts->pack ||
+                     opts->rules_sealed)) {
+        printf("--ab does not combine with --bench, --ring, --batch, --threads (but with\n"
+               "--rate), --chain, --pipeline, --pack or --rules-sealed\n");
+        return -1;
+    }
+    if (opts->nrates && (opts->bench || opts->ring || opts->batch || opts->chain ||
+                         opts->pipeline[APP_PIPE_ENCLAVE] || opts->pack)) {
+        printf("--rate does not combine with --bench, --ring, --batch, --chain, --pipeline\n"
+               "or --pack\n");
+        return -1;
+    }
+    for (unsigned i = 0; i < opts->nrates; i++)
+        if ((unsigned long long) opts->rates[i] * opts->duration > APP_LOAD_REQUESTS_MAX) {
+            printf("%u pages/s for %u s schedules more than %u pages\n", opts->rates[i],
+                   opts->duration, APP_LOAD_REQUESTS_MAX);
+            return -1;
+        }
+    /* The load workers are pool threads */
+    if (opts->nrates && !opts->threads)
+        opts->threads = 1;
+    if (opts->threads && (opts->ring || opts->batch)) {
+        printf("--threads does not combine with --ring or --batch\n");
+        return -1;
+    }
+    /* Trusted switchless workers take their TCS for the whole run */
+    if (opts->threads && opts->switchless && opts->threads + opts->sl_tworkers > APP_POOL_THREADS_MAX) {
+        printf("%u threads and %u trusted workers exceed TCSNum %d\n", opts->threads,
+               opts->sl_tworkers, APP_TCS_NUM);
+        return -1;
+    }
+    if (opts->pipeline[APP_PIPE_ENCLAVE] && opts->switchless &&
+        opts->pipeline[APP_PIPE_ENCLAVE] + opts->sl_tworkers > APP_POOL_THREADS_MAX) {
+        printf("%u enclave threads and %u trusted workers exceed TCSNum %d\n",
+               opts->pipeline[APP_PIPE_ENCLAVE], opts->sl_tworkers, APP_TCS_NUM);
+        return -1;
+    }
+    return 0;
+}
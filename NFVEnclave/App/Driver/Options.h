@@ -0,0 +1,91 @@
+/*
+ * Options.h: Command line of the App.
+ */
+
+#ifndef _APP_OPTIONS_H_
+#define _APP_OPTIONS_H_
+
+/* NFs of --bench */
+#define APP_BENCH_IDS         (1u << 0)
+#define APP_BENCH_BADWORD     (1u << 1)
+#define APP_BENCH_COMPRESSION (1u << 2)
+#define APP_BENCH_CHAIN       (1u << 3)   /* IDS and compression as one enclave_nf_chain */
+
+/* Enclave variants of --ab, in the order of the comparison */
+#define APP_AB_BARE      (1u << 0)   /* enclave_bare.signed.so, Enclave_bare.cpp */
+#define APP_AB_BEFORE    (1u << 1)   /* enclave_before.signed.so, Enclave_before.cpp */
+#define APP_AB_MITIGATED (1u << 2)   /* enclave_mitigated.signed.so, Enclave.cpp */
+
+typedef enum { APP_BENCH_CSV, APP_BENCH_JSON } app_bench_format_t;
+typedef enum { APP_TIMER_MONOTONIC, APP_TIMER_TSC } app_timer_t;
+
+/* Steps of a --rate sweep */
+#define APP_LOAD_STEPS_MAX 32
+
+/* Arrivals of --rate: evenly spaced, or a Poisson process of the same mean */
+typedef enum { APP_ARRIVALS_CONSTANT, APP_ARRIVALS_POISSON } app_arrivals_t;
+
+/* Stages of --pipeline, in page order */
+enum { APP_PIPE_LOAD, APP_PIPE_CRYPTO, APP_PIPE_ENCLAVE, APP_PIPE_SINK, APP_PIPE_STAGES };
+
+/* Pages of a pcap capture */
+typedef enum {
+    APP_PCAP_BODY,      /* One page per HTTP message body */
+    APP_PCAP_STREAM,    /* One page per reassembled direction of a flow */
+    APP_PCAP_SEGMENT    /* One page per in-order TCP segment payload */
+} app_pcap_mode_t;
+
+typedef struct app_options
+{
+    unsigned ab;        /* --ab LIST: APP_AB_* variants to compare, 0 = off */
+    unsigned bench;     /* --bench LIST: APP_BENCH_* to benchmark, 0 = off */
+    unsigned warmup;    /* --warmup N: untimed runs of each page and NF */
+    unsigned iterations;    /* --iterations N: timed runs of each page and NF */
+    app_bench_format_t bench_format;    /* --bench-format csv|json */
+    const char *bench_out;  /* --bench-out FILE: results, NULL = stdout */
+    const char *bench_pages;    /* --bench-pages FILE: a record per page and NF */
+    app_timer_t timer;  /* --timer monotonic|tsc */
+    int gcm_bench;      /* --gcm-bench: run the GCM benchmark and exit */
+    int marshal_bench;  /* --marshal-bench: time the ECALL/OCALL attributes and exit */
+    int queue_bench;    /* --queue-bench: compare the work queues and counters and exit */
+    int sched_bench;    /* --sched-bench: run the NF kernels chunk-parallel and exit */
+    unsigned sched;     /* --sched N: scheduler threads; large pages and --sched-bench */
+    int chain;          /* --chain: one enclave_nf_chain per page */
+    const char *corpus; /* --corpus FILE: packed corpus to map, NULL = ../Web/ */
+    const char *pack;   /* --pack FILE: write ../Web/ as a packed corpus and exit */
+    app_pcap_mode_t pcap_mode;  /* --pcap-mode body|stream|segment */
+    unsigned batch;     /* --batch N: N pages per batched ECALL, 0 = off */
+    unsigned ring;      /* --ring N: N enclave workers fed by rings, 0 = off */
+    unsigned threads;   /* --threads N: N host threads issue the NF ECALLs, 0 = off */
+    unsigned pipeline[APP_PIPE_STAGES]; /* --pipeline L,C,E,S: threads per stage, 0 = off */
+    unsigned queue_depth;   /* --queue-depth N: pages between two pipeline stages */
+    unsigned rates[APP_LOAD_STEPS_MAX]; /* --rate R[,R...]: pages/s of each load step */
+    unsigned nrates;    /* Load steps, 0 = no open-loop load */
+    app_arrivals_t arrivals;    /* --arrivals constant|poisson */
+    unsigned duration;  /* --duration S: seconds of arrivals per load step */
+    unsigned load_nfs;  /* --load-nfs LIST: APP_BENCH_* NFs put under load */
+    unsigned seed;      /* --seed N: Poisson arrivals */
+    const char *hist_out;   /* --hist-out FILE: latency distribution of each step */
+    unsigned log_interval;  /* --log-interval MS: enclave log polls, 0 = off */
+    const char *rules;  /* --rules FILE: badword ruleset, NULL = APP_RULES_FILE */
+    const char *rules_sealed;   /* --rules-sealed FILE: sealed copy of the ruleset */
+    int switchless;     /* --switchless: create the enclave with worker pools */
+    int switchless_bench; /* --switchless-bench: compare the transitions and exit */
+    unsigned sl_uworkers;   /* --sl-uworkers N: untrusted workers (switchless OCALLs) */
+    unsigned sl_tworkers;   /* --sl-tworkers N: trusted workers (switchless ECALLs) */
+    unsigned sl_fallback;   /* --sl-fallback N: retries before a call falls back */
+    unsigned sl_sleep;      /* --sl-sleep N: idle retries before a worker sleeps */
+} APP_OPTIONS_t;
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+/* Returns 0 to go on, 1 if the usage was printed, -1 on a bad option */
+int app_parse_options(int argc, char *argv[], APP_OPTIONS_t *opts);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif /* !_APP_OPTIONS_H_ */
@@ -0,0 +1,546 @@
+/*
+ * Pcap.cpp: Pages from libpcap captures. See Pcap.h.
+ *
+ * The capture is parsed from memory, without libpcap. Each direction of a
+ * TCP flow keeps the next expected sequence number, unwrapped to a 64-bit
+ * stream offset, and the segments that arrived ahead of it; a segment is
+ * delivered once everything before it has been, so the stream comes out
+ * in order whatever order the packets were captured in. IP fragments and
+ * segments cut short by the snap length are skipped, and whatever still
+ * waits behind a gap when the capture ends is dropped.
+ */
+
+#include <arpa/inet.h>
+#include <map>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <strings.h>
+
+#include "Buffers.h"
+#include "Pcap.h"
+
+#define PCAP_MAGIC_US 0xa1b2c3d4u
+#define PCAP_MAGIC_NS 0xa1b23c4du
+#define PCAP_HEADER_LEN 24
+#define PCAP_RECORD_LEN 16
+
+/* Link types */
+#define PCAP_LINK_NULL 0
+#define PCAP_LINK_ETHERNET 1
+#define PCAP_LINK_RAW 101
+#define PCAP_LINK_LOOP 108
+#define PCAP_LINK_SLL 113
+#define PCAP_LINK_IPV4 228
+#define PCAP_LINK_IPV6 229
+
+#define PCAP_TCP_SYN 0x02
+
+/* Bytes a direction may hold ahead of a gap; later segments are dropped */
+#define PCAP_OOO_MAX (16u << 20)
+
+/* A segment further ahead than this is not part of the stream */
+#define PCAP_WINDOW_MAX (1ull << 30)
+
+/* Longest HTTP start line looked at */
+#define PCAP_HTTP_LINE_MAX 8192
+
+/* One direction of a TCP flow */
+struct pcap_key
+{
+    uint8_t src[16];
+    uint8_t dst[16];
+    uint16_t sport;
+    uint16_t dport;
+    uint8_t v6;
+
+    bool operator<(const pcap_key& o) const { return memcmp(this, &o, sizeof(o)) < 0; }
+};
+
+struct pcap_stream
+{
+    pcap_key key;
+    bool started;
+    uint32_t next_seq;          /* Next sequence number expected */
+    uint64_t next;              /* Its stream offset, the bytes delivered */
+    std::map<uint64_t, std::string> ooo;    /* Segments ahead, by stream offset */
+    size_t ooo_bytes;
+    std::string data;           /* The bytes delivered */
+    std::vector<size_t> segments;   /* Ends of the delivered chunks in data */
+};
+
+struct pcap_capture
+{
+    bool swapped;
+    uint32_t link;
+    std::map<pcap_key, size_t> index;   /* Streams, in order of appearance */
+    std::vector<pcap_stream> streams;
+    size_t packets;
+    size_t skipped;             /* Not TCP, fragments, truncated */
+    size_t dropped;             /* Bytes left behind a gap or beyond PCAP_OOO_MAX */
+};
+
+/* A TCP segment of a packet */
+struct pcap_segment
+{
+    pcap_key key;
+    uint32_t seq;
+    uint8_t flags;
+    const uint8_t *payload;
+    size_t len;
+};
+
+static inline uint16_t pcap_be16(const uint8_t *p)
+{
+    return (uint16_t) (p[0] << 8 | p[1]);
+}
+
+static inline uint32_t pcap_be32(const uint8_t *p)
+{
+    return (uint32_t) p[0] << 24 | (uint32_t) p[1] << 16 | (uint32_t) p[2] << 8 | p[3];
+}
+
+static inline uint32_t pcap_le32(const uint8_t *p)
+{
+    return (uint32_t) p[3] << 24 | (uint32_t) p[2] << 16 | (uint32_t) p[1] << 8 | p[0];
+}
+
+/* A 32-bit field of the file, in the byte order of the capturing host */
+static inline uint32_t pcap_u32(const struct pcap_capture *cap, const uint8_t *p)
+{
+    return cap->swapped ? pcap_be32(p) : pcap_le32(p);
+}
+
+bool app_pcap_is_capture(const uint8_t *data, size_t len)
+{
+    uint32_t magic;
+
+    if (len < PCAP_HEADER_LEN)
+        return false;
+    magic = pcap_le32(data);
+    return magic == PCAP_MAGIC_US || magic == PCAP_MAGIC_NS ||
+           pcap_be32(data) == PCAP_MAGIC_US || pcap_be32(data) == PCAP_MAGIC_NS;
+}
+
+static bool pcap_tcp(const uint8_t *p, size_t len, struct pcap_segment *seg)
+{
+    size_t doff;
+
+    if (len < 20)
+        return false;
+    doff = (size_t) (p[12] >> 4) * 4;
+    if (doff < 20 || doff > len)
+        return false;
+    seg->key.sport = pcap_be16(p);
+    seg->key.dport = pcap_be16(p + 2);
+    seg->seq = pcap_be32(p + 4);
+    seg->flags = p[13];
+    seg->payload = p + doff;
+    seg->len = len - doff;
+    return true;
+}
+
+static bool pcap_ipv4(const uint8_t *p, size_t len, struct pcap_segment *seg)
+{
+    size_t ihl, total;
+
+    if (len < 20 || (p[0] >> 4) != 4)
+        return false;
+    ihl = (size_t) (p[0] & 0x0f) * 4;
+    total = pcap_be16(p + 2);
+    /* A fragment, or a packet cut by the snap length */
+    if (ihl < 20 || total < ihl || total > len || (pcap_be16(p + 6) & 0x3fff) != 0 || p[9] != 6)
+        return false;
+    memset(&seg->key, 0, sizeof(seg->key));
+    memcpy(seg->key.src, p + 12, 4);
+    memcpy(seg->key.dst, p + 16, 4);
+    return pcap_tcp(p + ihl, total - ihl, seg);
+}
+
+static bool pcap_ipv6(const uint8_t *p, size_t len, struct pcap_segment *seg)
+{
+    size_t off = 40;
+    uint8_t next;
+
+    if (len < 40 || (p[0] >> 4) != 6 || (size_t) pcap_be16(p + 4) + 40 > len)
+        return false;
+    len = (size_t) pcap_be16(p + 4) + 40;
+    next = p[6];
+    /* Hop-by-hop, routing and destination options; fragments are skipped */
+    while (next == 0 || next == 43 || next == 60) {
+        if (off + 8 > len)
+            return false;
+        next = p[off];
+        off += ((size_t) p[off + 1] + 1) * 8;
+    }
+    if (next != 6 || off > len)
+        return false;
+    memset(&seg->key, 0, sizeof(seg->key));
+    memcpy(seg->key.src, p + 8, 16);
+    memcpy(seg->key.dst, p + 24, 16);
+    seg->key.v6 = 1;
+    return pcap_tcp(p + off, len - off, seg);
+}
+
+static bool pcap_ip(const uint8_t *p, size_t len, struct pcap_segment *seg)
+{
+    if (len < 1)
+        return false;
+    return (p[0] >> 4) == 4 ? pcap_ipv4(p, len, seg) : pcap_ipv6(p, len, seg);
+}
+
+/* Finds the TCP segment of a packet of the capture's link type */
+static bool pcap_packet(const struct pcap_capture *cap, const uint8_t *p, size_t len,
+                        struct pcap_segment *seg)
+{
+    uint32_t family;
+    uint16_t type;
+    size_t off;
+
+    switch (cap->link) {
+    case PCAP_LINK_ETHERNET:
+        if (len < 14)
+            return false;
+        type = pcap_be16(p + 12);
+        off = 14;
+        while (type == 0x8100 || type == 0x88a8) {
+            if (len < off + 4)
+                return false;
+            type = pcap_be16(p + off + 2);
+            off += 4;
+        }
+        break;
+    case PCAP_LINK_SLL:
+        if (len < 16)
+            return false;
+        type = pcap_be16(p + 14);
+        off = 16;
+        break;
+    case PCAP_LINK_NULL:
+    case PCAP_LINK_LOOP:
+        if (len < 4)
+            return false;
+        /* AF_INET is 2 everywhere, AF_INET6 is 10, 24, 28 or 30 */
+        family = pcap_le32(p) > 0xffff ? pcap_be32(p) : pcap_le32(p);
+        type = family == 2 ? 0x0800 : 0x86dd;
+        off = 4;
+        break;
+    case PCAP_LINK_RAW:
+    case PCAP_LINK_IPV4:
+    case PCAP_LINK_IPV6:
+        return pcap_ip(p, len, seg);
+    default:
+        return false;
+    }
+    if (type == 0x0800)
+        return pcap_ipv4(p + off, len - off, seg);
+    if (type == 0x86dd)
+        return pcap_ipv6(p + off, len - off, seg);
+    return false;
+}
+
+static void pcap_deliver(struct pcap_stream *s, const uint8_t *p, size_t len)
+{
+    s->data.append((const char *) p, len);
+    s->segments.push_back(s->data.size());
+    s->next += len;
+    s->next_seq += (uint32_t) len;
+}
+
+/* Delivers what of the segment at off is past s->next */
+static void pcap_deliver_at(struct pcap_stream *s, uint64_t off, const uint8_t *p, size_t len)
+{
+    if (off + len <= s->next)
+        return;             /* A retransmission */
+    pcap_deliver(s, p + (s->next - off), len - (size_t) (s->next - off));
+}
+
+static void pcap_reassemble(struct pcap_capture *cap, const struct pcap_segment *seg)
+{
+    std::map<pcap_key, size_t>::iterator it = cap->index.find(seg->key);
+    struct pcap_stream *s;
+    uint64_t off;
+
+    if (it == cap->index.end()) {
+        it = cap->index.insert(std::make_pair(seg->key, cap->streams.size())).first;
+        cap->streams.push_back(pcap_stream());
+        cap->streams.back().key = seg->key;
+        cap->streams.back().started = false;
+        cap->streams.back().ooo_bytes = 0;
+    }
+    s = &cap->streams[it->second];
+
+    /* The SYN takes a sequence number; a flow caught midway starts here */
+    if (seg->flags & PCAP_TCP_SYN) {
+        if (!s->started) {
+            s->started = true;
+            s->next_seq = seg->seq + 1;
+            s->next = 0;
+        }
+        return;
+    }
+    if (!s->started) {
+        s->started = true;
+        s->next_seq = seg->seq;
+        s->next = 0;
+    }
+    if (!seg->len)
+        return;
+
+    off = s->next + (int64_t) (int32_t) (seg->seq - s->next_seq);
+    if ((int64_t) off < 0 || off > s->next + PCAP_WINDOW_MAX) {
+        cap->dropped += seg->len;
+        return;
+    }
+    if (off > s->next) {
+        std::string& held = s->ooo[off];
+
+        if (seg->len <= held.size())
+            return;
+        if (s->ooo_bytes - held.size() + seg->len > PCAP_OOO_MAX) {
+            cap->dropped += seg->len;
+            if (held.empty())
+                s->ooo.erase(off);
+            return;
+        }
+        s->ooo_bytes += seg->len - held.size();
+        held.assign((const char *) seg->payload, seg->len);
+        return;
+    }
+
+    pcap_deliver_at(s, off, seg->payload, seg->len);
+    while (!s->ooo.empty() && s->ooo.begin()->first <= s->next) {
+        std::map<uint64_t, std::string>::iterator first = s->ooo.begin();
+
+        pcap_deliver_at(s, first->first, (const uint8_t *) first->second.data(),
+                        first->second.size());
+        s->ooo_bytes -= first->second.size();
+        s->ooo.erase(first);
+    }
+}
+
+/* Value of the header name in the header block [begin, end), or NULL */
+static const char *pcap_http_header(const std::string& msg, size_t begin, size_t end,
+                                    const char *name, size_t *len)
+{
+    size_t n = strlen(name);
+
+    for (size_t line = msg.find("\r\n", begin); line != std::string::npos && line < end;
+         line = msg.find("\r\n", line + 2)) {
+        size_t p = line + 2, eol = msg.find("\r\n", p);
+
+        if (eol == std::string::npos || eol > end)
+            eol = end;
+        if (eol - p > n && msg[p + n] == ':' && strncasecmp(msg.c_str() + p, name, n) == 0) {
+            p += n + 1;
+            while (p < eol && (msg[p] == ' ' || msg[p] == '\t'))
+                p++;
+            *len = eol - p;
+            return msg.c_str() + p;
+        }
+    }
+    return NULL;
+}
+
+/* Whether msg holds an HTTP/1.x message at pos, and if so which kind */
+static bool pcap_http_start(const std::string& msg, size_t pos, bool *response)
+{
+    size_t eol;
+
+    if (msg.compare(pos, 5, "HTTP/") == 0) {
+        *response = true;
+        return true;
+    }
+    eol = msg.find("\r\n", pos);
+    if (eol == std::string::npos || eol - pos > PCAP_HTTP_LINE_MAX || eol - pos < 9)
+        return false;
+    *response = false;
+    return msg.compare(eol - 9, 8, " HTTP/1.") == 0;
+}
+
+/* Decodes the chunked body at pos; returns where the message ends */
+static size_t pcap_http_chunked(const std::string& msg, size_t pos, std::string& body)
+{
+    for (;;) {
+        size_t eol = msg.find("\r\n", pos);
+        unsigned long size;
+        char *end;
+
+        if (eol == std::string::npos)
+            return msg.size();
+        size = strtoul(msg.c_str() + pos, &end, 16);
+        if (end == msg.c_str() + pos)
+            return msg.size();
+        pos = eol + 2;
+        if (size == 0) {
+            /* Trailers, then an empty line */
+            if (msg.compare(pos, 2, "\r\n") == 0)
+                return pos + 2;
+            eol = msg.find("\r\n\r\n", pos);
+            return eol == std::string::npos ? msg.size() : eol + 4;
+        }
+        if (size > msg.size() - pos) {
+            body.append(msg, pos, std::string::npos);
+            return msg.size();
+        }
+        body.append(msg, pos, size);
+        pos += size + 2;
+        if (pos > msg.size())
+            return msg.size();
+    }
+}
+
+/*
+ * pcap_http_bodies:
+ *   Cuts a stream into its HTTP/1.x messages and returns their bodies,
+ *   chunked ones decoded; content codings are left as they are. Stops at
+ *   the first bytes that are not an HTTP message.
+ */
+static void pcap_http_bodies(const std::string& msg, std::vector<std::string>& bodies)
+{
+    size_t pos = 0;
+
+    while (pos < msg.size()) {
+        size_t head = msg.find("\r\n\r\n", pos), n;
+        const char *value;
+        std::string body;
+        bool response;
+        int status = 0;
+
+        if (!pcap_http_start(msg, pos, &response) || head == std::string::npos)
+            return;
+        if (response && msg.size() > pos + 12)
+            status = atoi(msg.c_str() + pos + 9);
+        head += 4;
+
+        if (response && (status / 100 == 1 || status == 204 || status == 304)) {
+            pos = head;
+        } else if ((value = pcap_http_header(msg, pos, head - 2, "Transfer-Encoding", &n)) &&
+                   memmem(value, n, "chunked", 7)) {
+            pos = pcap_http_chunked(msg, head, body);
+        } else if ((value = pcap_http_header(msg, pos, head - 2, "Content-Length", &n))) {
+            unsigned long long length = strtoull(value, NULL, 10);
+
+            if (length > msg.size() - head)
+                length = msg.size() - head;
+            body.assign(msg, head, (size_t) length);
+            pos = head + (size_t) length;
+        } else if (response) {
+            /* Delimited by the end of the connection */
+            body.assign(msg, head, std::string::npos);
+            pos = msg.size();
+        } else {
+            pos = head;
+        }
+        if (!body.empty())
+            bodies.push_back(body);
+    }
+}
+
+/* Appends a page of len bytes at data, named name#n */
+static int pcap_page(std::vector<WEB_PAGE_t>& pages, const char *name, size_t n,
+                     const char *data, size_t len)
+{
+    WEB_PAGE_t page;
+
+    snprintf(page.name, sizeof(page.name), "%s#%zu", name, n);
+    page.lSize = len;
+    page.cleartext = (uint8_t *) app_buffer_get(len);
+    page.cyphertext = (uint8_t *) app_buffer_get(len);
+    if (!page.cleartext || !page.cyphertext) {
+        app_buffer_put(page.cleartext, len);
+        app_buffer_put(page.cyphertext, len);
+        return -1;
+    }
+    memcpy(page.cleartext, data, len);
+    pages.push_back(page);
+    return 0;
+}
+
+/* file#src.sport-dst.dport, the prefix of the pages of a stream */
+static void pcap_stream_name(const char *file, const struct pcap_stream *s, char *buf,
+                             size_t size)
+{
+    char src[INET6_ADDRSTRLEN], dst[INET6_ADDRSTRLEN];
+    int af = s->key.v6 ? AF_INET6 : AF_INET;
+
+    inet_ntop(af, s->key.src, src, sizeof(src));
+    inet_ntop(af, s->key.dst, dst, sizeof(dst));
+    snprintf(buf, size, "%s#%s.%u-%s.%u", file, src, s->key.sport, dst, s->key.dport);
+}
+
+int app_pcap_pages(const char *name, const uint8_t *data, size_t len, app_pcap_mode_t mode,
+                   std::vector<WEB_PAGE_t>& pages)
+{
+    struct pcap_capture cap;
+    size_t pos = PCAP_HEADER_LEN, first = pages.size(), bytes = 0;
+    char prefix[200];
+    int rc = 0;
+
+    if (!app_pcap_is_capture(data, len)) {
+        printf("\n%s is not a pcap capture.\n", name);
+        return -1;
+    }
+    cap.swapped = pcap_be32(data) == PCAP_MAGIC_US || pcap_be32(data) == PCAP_MAGIC_NS;
+    cap.link = pcap_u32(&cap, data + 20) & 0x0fffffff;
+    cap.packets = cap.skipped = cap.dropped = 0;
+
+    while (pos + PCAP_RECORD_LEN <= len) {
+        uint32_t incl = pcap_u32(&cap, data + pos + 8);
+        uint32_t orig = pcap_u32(&cap, data + pos + 12);
+        struct pcap_segment seg;
+
+        pos += PCAP_RECORD_LEN;
+        if (incl > len - pos) {
+            printf("Warning: %s is cut short in packet %zu\n", name, cap.packets + 1);
+            break;
+        }
+        cap.packets++;
+        if (incl < orig || !pcap_packet(&cap, data + pos, incl, &seg))
+            cap.skipped++;
+        else
+            pcap_reassemble(&cap, &seg);
+        pos += incl;
+    }
+
+    for (size_t i = 0; i < cap.streams.size() && rc == 0; i++) {
+        struct pcap_stream *s = &cap.streams[i];
+        std::vector<std::string> bodies;
+        size_t begin = 0;
+
+        for (std::map<uint64_t, std::string>::iterator it = s->ooo.begin(); it != s->ooo.end(); ++it)
+            cap.dropped += it->second.size();
+        if (s->data.empty())
+            continue;
+        pcap_stream_name(name, s, prefix, sizeof(prefix));
+
+        switch (mode) {
+        case APP_PCAP_STREAM:
+            rc = pcap_page(pages, prefix, 0, s->data.data(), s->data.size());
+            break;
+        case APP_PCAP_SEGMENT:
+            for (size_t j = 0; j < s->segments.size() && rc == 0; j++) {
+                rc = pcap_page(pages, prefix, j, s->data.data() + begin, s->segments[j] - begin);
+                begin = s->segments[j];
+            }
+            break;
+        default:
+            pcap_http_bodies(s->data, bodies);
+            for (size_t j = 0; j < bodies.size() && rc == 0; j++)
+                rc = pcap_page(pages, prefix, j, bodies[j].data(), bodies[j].size());
+            break;
+        }
+    }
+    if (rc != 0) {
+        printf("\nOut of memory for the pages of %s.\n", name);
+        return -1;
+    }
+
+    for (size_t i = first; i < pages.size(); i++)
+        bytes += pages[i].lSize;
+    printf("Pcap:%s:Packets:%zu:Skipped:%zu:Streams:%zu:Pages:%zu:Bytes:%zu:Dropped:%zu\n",
+           name, cap.packets, cap.skipped, cap.streams.size(), pages.size() - first, bytes,
+           cap.dropped);
+    return 0;
+}
@@ -0,0 +1,32 @@
+/*
+ * Pcap.h: Pages from libpcap captures.
+ *
+ * A capture in ../Web/ is read natively (classic pcap, micro- or
+ * nanosecond, either byte order; Ethernet, VLAN, Linux cooked, BSD
+ * loopback or raw IP links; IPv4 and IPv6). The TCP segments of each
+ * direction of a flow are reassembled in sequence order, retransmissions
+ * and overlaps dropped, and the stream is cut into pages by the mode.
+ */
+
+#ifndef _APP_PCAP_H_
+#define _APP_PCAP_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+#include "../App.h"
+#include "Options.h"
+
+/* Whether data starts like a pcap capture */
+bool app_pcap_is_capture(const uint8_t *data, size_t len);
+
+/*
+ * Appends the pages of the capture data[0..len) to pages, named after
+ * name, their cleartext and cyphertext from app_buffer_get() like those
+ * of a plain file. Returns 0, or -1 if the capture is malformed or out of
+ * memory.
+ */
+int app_pcap_pages(const char *name, const uint8_t *data, size_t len, app_pcap_mode_t mode,
+                   std::vector<WEB_PAGE_t>& pages);
+
+#endif /* !_APP_PCAP_H_ */
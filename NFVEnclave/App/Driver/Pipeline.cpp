@@ -0,0 +1,474 @@
+/*
+ * Pipeline.cpp: Processes the pages of a directory as a staged pipeline.
+ *
+ * load -> crypto -> enclave -> sink, each stage on its own threads and
+ * each pair joined by a bounded lock-free queue of pages. A stage waits
+ * only on its queues: the enclave threads never read a file or encrypt a
+ * page, and a full queue holds back the stages before it, so at most
+ * queue_depth pages sit between two stages.
+ *
+ * A stage is done when its last thread returns; the next stage drains
+ * its input queue and stops. Each thread times what it waits on: an
+ * empty input queue (starved) or a full output queue (blocked); the rest
+ * of its time is busy, the stage's occupancy.
+ *
+ * The page buffers come from the buffer pool and the page records from a
+ * queue of spares, so once the first pages are through a page costs no
+ * allocation.
+ */
+
+#include <algorithm>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <sys/stat.h>
+#include <thread>
+#include <time.h>
+#include <unistd.h>
+#include <vector>
+
+#include "../App.h"
+#include "Buffers.h"
+#include "Enclave_u.h"
+#include "nf_gcm.h"
+#include "nf_mpmc.h"
+#include "Pcap.h"
+#include "Pipeline.h"
+#include "Pool.h"
+
+#define PIPE_SPINS 64           /* Retries of a queue before yielding */
+#define PIPE_NAP_NS 20000       /* Sleep between retries after as many yields */
+
+static const char *pipe_stage_names[APP_PIPE_STAGES] = {"load", "crypto", "enclave", "sink"};
+
+/* A page on its way through the stages */
+struct pipe_page
+{
+    WEB_PAGE_t page;
+    sgx_status_t status;
+    size_t matched;
+    size_t oSize;
+};
+
+/* What one thread of a stage did */
+struct pipe_stats
+{
+    size_t items;
+    size_t failed;
+    size_t matched;
+    size_t in_bytes;
+    size_t out_bytes;
+    uint64_t busy_ns;
+    uint64_t starved_ns;        /* Waiting on an empty input queue */
+    uint64_t blocked_ns;        /* Waiting on a full output queue */
+    uint64_t depth;             /* Input queue depths seen by the pops */
+};
+
+struct pipeline
+{
+    const APP_OPTIONS_t *opts;
+    const char *dir;
+    std::vector<std::string> files;
+    size_t next_file;
+    NF_MPMC_t queues[APP_PIPE_STAGES - 1];      /* queues[s] feeds stage s + 1 */
+    NF_MPMC_t spares;                           /* Page records to reuse */
+    unsigned running[APP_PIPE_STAGES];          /* Threads of the stage not returned */
+    int done[APP_PIPE_STAGES];                  /* All the stage's pages are queued */
+    int sink_error;                             /* The sink reported a write error */
+    std::vector<struct pipe_stats> stats[APP_PIPE_STAGES];
+};
+
+static uint64_t pipe_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ull + (uint64_t) ts.tv_nsec;
+}
+
+static void pipe_backoff(unsigned *spins)
+{
+    struct timespec nap = {0, PIPE_NAP_NS};
+
+    if (++*spins < PIPE_SPINS)
+        __builtin_ia32_pause();
+    else if (*spins < 2 * PIPE_SPINS)
+        sched_yield();
+    else
+        nanosleep(&nap, NULL);
+}
+
+/* Queues item for the stage after stage */
+static void pipe_push(struct pipeline *pl, int stage, struct pipe_page *item,
+                      struct pipe_stats *st)
+{
+    uint64_t t0 = 0;
+    unsigned spins = 0;
+
+    while (!nf_mpmc_put(&pl->queues[stage], item)) {
+        if (!t0)
+            t0 = pipe_ns();
+        pipe_backoff(&spins);
+    }
+    if (t0)
+        st->blocked_ns += pipe_ns() - t0;
+}
+
+/* Next page for stage, or NULL once the stage before is done and drained */
+static struct pipe_page *pipe_pop(struct pipeline *pl, int stage, struct pipe_stats *st)
+{
+    NF_MPMC_t *q = &pl->queues[stage - 1];
+    uint64_t t0 = 0;
+    unsigned spins = 0;
+
+    for (;;) {
+        /* Read before the pop: once done, an empty queue stays empty */
+        int done = __atomic_load_n(&pl->done[stage - 1], __ATOMIC_ACQUIRE);
+        size_t depth = nf_mpmc_size(q);
+        struct pipe_page *item = (struct pipe_page *) nf_mpmc_take(q);
+
+        if (item || done) {
+            if (t0)
+                st->starved_ns += pipe_ns() - t0;
+            if (item)
+                st->depth += depth;
+            return item;
+        }
+        if (!t0)
+            t0 = pipe_ns();
+        pipe_backoff(&spins);
+    }
+}
+
+static void pipe_free(struct pipeline *pl, struct pipe_page *item)
+{
+    app_buffer_put(item->page.cleartext, item->page.lSize);
+    app_buffer_put(item->page.cyphertext, item->page.lSize);
+    if (!nf_mpmc_put(&pl->spares, item))
+        free(item);
+}
+
+/* Wraps a loaded page and queues it for the crypto */
+static void pipe_emit(struct pipeline *pl, const WEB_PAGE_t *page, struct pipe_stats *st)
+{
+    struct pipe_page *item = (struct pipe_page *) nf_mpmc_take(&pl->spares);
+
+    if (!item)
+        item = (struct pipe_page *) malloc(sizeof(*item));
+    if (!item) {
+        printf("Pipeline:%s:Error:0x%x\n", page->name, SGX_ERROR_OUT_OF_MEMORY);
+        app_buffer_put(page->cleartext, page->lSize);
+        app_buffer_put(page->cyphertext, page->lSize);
+        st->failed++;
+        return;
+    }
+    item->page = *page;
+    item->status = SGX_SUCCESS;
+    item->matched = 0;
+    item->oSize = 0;
+    st->items++;
+    st->in_bytes += page->lSize;
+    pipe_push(pl, APP_PIPE_LOAD, item, st);
+}
+
+/* Reads the whole file at path into a buffer of the pool */
+static uint8_t *pipe_read(const char *path, size_t *size)
+{
+    struct stat sb;
+    uint8_t *data;
+    size_t got = 0;
+    int fd = open(path, O_RDONLY);
+
+    if (fd < 0)
+        return NULL;
+    if (fstat(fd, &sb) != 0 || (data = (uint8_t *) app_buffer_get(sb.st_size)) == NULL) {
+        close(fd);
+        return NULL;
+    }
+    while (got < (size_t) sb.st_size) {
+        ssize_t n = read(fd, data + got, (size_t) sb.st_size - got);
+
+        if (n <= 0)
+            break;
+        got += (size_t) n;
+    }
+    close(fd);
+    if (got != (size_t) sb.st_size) {
+        app_buffer_put(data, (size_t) sb.st_size);
+        return NULL;
+    }
+    *size = got;
+    return data;
+}
+
+static void pipe_load(struct pipeline *pl, struct pipe_stats *st)
+{
+    std::vector<WEB_PAGE_t> pages;
+    char path[300];
+    size_t f;
+
+    while ((f = __atomic_fetch_add(&pl->next_file, 1, __ATOMIC_RELAXED)) < pl->files.size()) {
+        WEB_PAGE_t page;
+        size_t size = 0;
+        uint8_t *data;
+
+        snprintf(path, sizeof(path), "%s%s", pl->dir, pl->files[f].c_str());
+        data = pipe_read(path, &size);
+        if (!data) {
+            printf("\nFile %s not exist.\n", path);
+            st->failed++;
+            continue;
+        }
+        if (size == 0) {
+            app_buffer_put(data, size);
+            continue;
+        }
+        if (app_pcap_is_capture(data, size)) {
+            pages.clear();
+            if (app_pcap_pages(pl->files[f].c_str(), data, size, pl->opts->pcap_mode, pages) != 0)
+                st->failed++;
+            app_buffer_put(data, size);
+            for (size_t i = 0; i < pages.size(); i++)
+                pipe_emit(pl, &pages[i], st);
+            continue;
+        }
+
+        snprintf(page.name, sizeof(page.name), "%s", pl->files[f].c_str());
+        page.lSize = size;
+        page.cleartext = data;
+        page.cyphertext = (uint8_t *) app_buffer_get(size);
+        if (!page.cyphertext) {
+            printf("Pipeline:%s:Error:0x%x\n", page.name, SGX_ERROR_OUT_OF_MEMORY);
+            app_buffer_put(data, size);
+            st->failed++;
+            continue;
+        }
+        pipe_emit(pl, &page, st);
+    }
+}
+
+static void pipe_crypto(struct pipeline *pl, struct pipe_stats *st)
+{
+    struct pipe_page *item;
+    NF_GCM_KEY_t key;
+
+    nf_gcm_key_init(&key, app_data_key);
+    while ((item = pipe_pop(pl, APP_PIPE_CRYPTO, st)) != NULL) {
+        WEB_PAGE_t *page = &item->page;
+
+        app_page_iv(page->iv);
+        nf_gcm_encrypt(&key, page->iv, page->cleartext, page->lSize, page->cyphertext,
+                       page->en_mac);
+        app_buffer_put(page->cleartext, page->lSize);
+        page->cleartext = NULL;
+        st->items++;
+        pipe_push(pl, APP_PIPE_CRYPTO, item, st);
+    }
+    nf_gcm_key_clear(&key);
+}
+
+static void pipe_enclave(struct pipeline *pl, struct pipe_stats *st)
+{
+    struct pipe_page *item;
+
+    while ((item = pipe_pop(pl, APP_PIPE_ENCLAVE, st)) != NULL) {
+        WEB_PAGE_t *page = &item->page;
+        size_t out_cap = app_pool_out_cap(page->lSize);
+        uint8_t *out = (uint8_t *) app_buffer_get(out_cap);
+
+        item->status = out ? app_pool_page(page, out, out_cap, pl->opts->chain,
+                                           &item->matched, &item->oSize)
+                           : SGX_ERROR_OUT_OF_MEMORY;
+        app_buffer_put(out, out_cap);
+        st->items++;
+        pipe_push(pl, APP_PIPE_ENCLAVE, item, st);
+    }
+}
+
+/* Saves the ciphertext, the MAC and the IV of page to ../WebEnc/ like save_pages */
+static int pipe_write(const WEB_PAGE_t *page)
+{
+    char path[300];
+    FILE *fp;
+    int ok;
+
+    snprintf(path, sizeof(path), "../WebEnc/%s_en", page->name);
+    fp = fopen(path, "wb");
+    if (fp == nullptr)
+        return -1;
+    ok = fwrite(page->cyphertext, 1, page->lSize, fp) == page->lSize;
+    ok = fclose(fp) == 0 && ok;
+
+    snprintf(path, sizeof(path), "../WebEnc/%s_en_mac", page->name);
+    fp = fopen(path, "wb");
+    if (fp == nullptr)
+        return -1;
+    ok = fwrite(page->en_mac, 1, sizeof(page->en_mac), fp) == sizeof(page->en_mac) && ok;
+    ok = fclose(fp) == 0 && ok;
+
+    snprintf(path, sizeof(path), "../WebEnc/%s_en_iv", page->name);
+    fp = fopen(path, "wb");
+    if (fp == nullptr)
+        return -1;
+    ok = fwrite(page->iv, 1, sizeof(page->iv), fp) == sizeof(page->iv) && ok;
+    ok = fclose(fp) == 0 && ok;
+    return ok ? 0 : -1;
+}
+
+static void pipe_sink(struct pipeline *pl, struct pipe_stats *st)
+{
+    struct pipe_page *item;
+
+    while ((item = pipe_pop(pl, APP_PIPE_SINK, st)) != NULL) {
+        WEB_PAGE_t *page = &item->page;
+
+        if (item->status != SGX_SUCCESS) {
+            printf("Pipeline:%s:Error:0x%x\n", page->name, item->status);
+            st->failed++;
+        } else {
+            st->matched += item->matched ? 1 : 0;
+            st->out_bytes += item->oSize;
+        }
+        /* One report is enough when ../WebEnc/ is missing */
+        if (pipe_write(page) != 0 && !__atomic_exchange_n(&pl->sink_error, 1, __ATOMIC_RELAXED))
+            printf("\nCan not write %s to ../WebEnc/.\n", page->name);
+        st->items++;
+        pipe_free(pl, item);
+    }
+}
+
+static void pipe_thread(struct pipeline *pl, int stage, unsigned t)
+{
+    struct pipe_stats *st = &pl->stats[stage][t];
+    uint64_t start = pipe_ns();
+
+    switch (stage) {
+    case APP_PIPE_LOAD:
+        pipe_load(pl, st);
+        break;
+    case APP_PIPE_CRYPTO:
+        pipe_crypto(pl, st);
+        break;
+    case APP_PIPE_ENCLAVE:
+        pipe_enclave(pl, st);
+        break;
+    default:
+        pipe_sink(pl, st);
+        break;
+    }
+    st->busy_ns = pipe_ns() - start - st->starved_ns - st->blocked_ns;
+    if (__atomic_sub_fetch(&pl->running[stage], 1, __ATOMIC_ACQ_REL) == 0)
+        __atomic_store_n(&pl->done[stage], 1, __ATOMIC_RELEASE);
+}
+
+static void pipe_list(struct pipeline *pl)
+{
+    struct dirent *ent;
+    DIR *dp = opendir(pl->dir);
+
+    if (dp == nullptr)
+        return;
+    while ((ent = readdir(dp)) != nullptr)
+        if (strcmp(ent->d_name, ".") != 0 && strcmp(ent->d_name, "..") != 0)
+            pl->files.push_back(ent->d_name);
+    closedir(dp);
+    std::sort(pl->files.begin(), pl->files.end());
+}
+
+int app_run_pipeline(const char *dir, const APP_OPTIONS_t *opts)
+{
+    struct pipeline pl;
+    std::vector<std::thread> threads;
+    struct pipe_page *item;
+    struct pipe_stats sum;
+    size_t failed = 0, in_flight;
+    double wall;
+    uint64_t tic;
+    int s;
+
+    pl.opts = opts;
+    pl.dir = dir;
+    pl.next_file = 0;
+    pl.sink_error = 0;
+    pipe_list(&pl);
+
+    /* Room for every page that can be queued or held by a thread */
+    in_flight = (APP_PIPE_STAGES - 1) * (size_t) opts->queue_depth;
+    for (s = 0; s < APP_PIPE_STAGES; s++)
+        in_flight += opts->pipeline[s];
+    if (nf_mpmc_init(&pl.spares, in_flight) != 0) {
+        printf("Pipeline:Error:0x%x\n", SGX_ERROR_OUT_OF_MEMORY);
+        return -1;
+    }
+    for (s = 0; s < APP_PIPE_STAGES - 1; s++) {
+        if (nf_mpmc_init(&pl.queues[s], opts->queue_depth) != 0) {
+            printf("Pipeline:Error:0x%x\n", SGX_ERROR_OUT_OF_MEMORY);
+            while (s-- > 0)
+                nf_mpmc_free(&pl.queues[s]);
+            nf_mpmc_free(&pl.spares);
+            return -1;
+        }
+    }
+    for (s = 0; s < APP_PIPE_STAGES; s++) {
+        pl.running[s] = opts->pipeline[s];
+        pl.done[s] = 0;
+        pl.stats[s].assign(opts->pipeline[s], pipe_stats());
+    }
+
+    tic = pipe_ns();
+    for (s = 0; s < APP_PIPE_STAGES; s++)
+        for (unsigned t = 0; t < opts->pipeline[s]; t++)
+            threads.push_back(std::thread(pipe_thread, &pl, s, t));
+    for (size_t i = 0; i < threads.size(); i++)
+        threads[i].join();
+    wall = (double) (pipe_ns() - tic);
+
+    memset(&sum, 0, sizeof(sum));
+    for (s = 0; s < APP_PIPE_STAGES; s++) {
+        for (unsigned t = 0; t < opts->pipeline[s]; t++) {
+            failed += pl.stats[s][t].failed;
+            sum.matched += pl.stats[s][t].matched;
+            sum.out_bytes += pl.stats[s][t].out_bytes;
+            if (s == APP_PIPE_LOAD)
+                sum.in_bytes += pl.stats[s][t].in_bytes;
+            if (s == APP_PIPE_SINK)
+                sum.items += pl.stats[s][t].items;
+        }
+    }
+    printf("Pipeline:Threads:%u,%u,%u,%u:Depth:%u:Mode:%s:Pages:%zu:Bytes:%zu:Time:%f:"
+           "PagesPerSec:%.1f:MBps:%.1f:Matched:%zu:OutputSize:%zu:Failed:%zu\n",
+           opts->pipeline[0], opts->pipeline[1], opts->pipeline[2], opts->pipeline[3],
+           opts->queue_depth, opts->chain ? "chain" : "nfs", sum.items, sum.in_bytes,
+           wall / 1e9, (double) sum.items / wall * 1e9, (double) sum.in_bytes / wall * 1e3,
+           sum.matched, sum.out_bytes, failed);
+
+    /* Shares of the stage's thread time, summed over its threads */
+    for (s = 0; s < APP_PIPE_STAGES; s++) {
+        struct pipe_stats st;
+        double total = wall * opts->pipeline[s];
+
+        memset(&st, 0, sizeof(st));
+        for (unsigned t = 0; t < opts->pipeline[s]; t++) {
+            st.items += pl.stats[s][t].items;
+            st.busy_ns += pl.stats[s][t].busy_ns;
+            st.starved_ns += pl.stats[s][t].starved_ns;
+            st.blocked_ns += pl.stats[s][t].blocked_ns;
+            st.depth += pl.stats[s][t].depth;
+        }
+        printf("Stage:%s:Threads:%u:Items:%zu:Busy:%.1f:Starved:%.1f:Blocked:%.1f:QueueAvg:%.1f\n",
+               pipe_stage_names[s], opts->pipeline[s], st.items,
+               100.0 * (double) st.busy_ns / total, 100.0 * (double) st.starved_ns / total,
+               100.0 * (double) st.blocked_ns / total,
+               st.items && s != APP_PIPE_LOAD ? (double) st.depth / (double) st.items : 0.0);
+    }
+
+    for (s = 0; s < APP_PIPE_STAGES - 1; s++)
+        nf_mpmc_free(&pl.queues[s]);
+    while ((item = (struct pipe_page *) nf_mpmc_take(&pl.spares)) != NULL)
+        free(item);
+    nf_mpmc_free(&pl.spares);
+    return failed == 0 ? 0 : -1;
+}
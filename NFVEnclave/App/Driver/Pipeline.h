@@ -0,0 +1,21 @@
+/*
+ * Pipeline.h: Processes the pages of a directory as a staged pipeline.
+ */
+
+#ifndef _APP_PIPELINE_H_
+#define _APP_PIPELINE_H_
+
+#include "Options.h"
+
+/*
+ * Runs the pages of dir through four stages, each on its own threads
+ * (opts->pipeline) and joined by bounded queues of opts->queue_depth
+ * pages: the loader reads the files, the host crypto encrypts them, the
+ * enclave dispatch runs the NFs like a pool thread, and the sink writes
+ * the ciphertexts to ../WebEnc/ and frees the pages. Reports the
+ * throughput and the occupancy of each stage; returns 0 if every page
+ * went through.
+ */
+int app_run_pipeline(const char *dir, const APP_OPTIONS_t *opts);
+
+#endif /* !_APP_PIPELINE_H_ */
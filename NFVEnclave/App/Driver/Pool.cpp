@@ -0,0 +1,148 @@
+/*
+ * Pool.cpp: Processes the pages on a pool of host threads.
+ *
+ * The queue is the page vector itself: a thread claims the next page with
+ * an atomic increment of a shared cursor, so a thread that drew small
+ * pages simply takes more of them. Each thread takes the output buffer of
+ * a page from the buffer pool and keeps its own totals, which are summed
+ * once the threads are joined.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <thread>
+#include <time.h>
+
+#include "Buffers.h"
+#include "Enclave_u.h"
+#include "Pool.h"
+
+struct pool_totals
+{
+    size_t pages;
+    size_t failed;
+    size_t matched;
+    size_t out_bytes;
+};
+
+static double pool_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double) ts.tv_sec + (double) ts.tv_nsec / 1e9;
+}
+
+/* One page, one ECALL per NF; returns the first error */
+static sgx_status_t pool_page_nfs(WEB_PAGE_t *page, uint8_t *out, size_t oCap,
+                                  size_t *matched, size_t *oSize)
+{
+    sgx_status_t ret, status = SGX_SUCCESS;
+    uint8_t out_mac[16], out_iv[12];
+    uint64_t out_seq;
+
+    ret = enclave_ids(global_eid, &status, page->cyphertext, page->lSize, page->en_mac,
+                      page->iv, oSize, out, oCap, out_mac, out_iv, &out_seq, matched);
+    if (ret != SGX_SUCCESS || status != SGX_SUCCESS)
+        return ret != SGX_SUCCESS ? ret : status;
+
+    ret = enclave_compression(global_eid, &status, page->cyphertext, page->lSize,
+                              page->en_mac, page->iv, oSize, out, oCap, out_mac, out_iv,
+                              &out_seq);
+    return ret != SGX_SUCCESS ? ret : status;
+}
+
+/* One page, one service chain ECALL */
+static sgx_status_t pool_page_chain(WEB_PAGE_t *page, uint8_t *out, size_t oCap,
+                                    size_t *matched, size_t *oSize)
+{
+    nf_id_t chain[] = {NF_IDS, NF_COMPRESSION};
+    const size_t nstages = sizeof(chain) / sizeof(chain[0]);
+    nf_stage_stats_t stats[sizeof(chain) / sizeof(chain[0])];
+    sgx_status_t ret, status = SGX_SUCCESS;
+    uint8_t out_mac[16], out_iv[12];
+    uint64_t out_seq;
+
+    ret = enclave_nf_chain(global_eid, &status, chain, nstages, page->cyphertext, page->lSize,
+                           page->en_mac, page->iv, oSize, out, oCap, out_mac, out_iv, &out_seq,
+                           stats, matched);
+    return ret != SGX_SUCCESS ? ret : status;
+}
+
+sgx_status_t app_pool_page(WEB_PAGE_t *page, uint8_t *out, size_t oCap, int chain,
+                           size_t *matched, size_t *oSize)
+{
+    *matched = 0;
+    *oSize = 0;
+    return chain ? pool_page_chain(page, out, oCap, matched, oSize)
+                 : pool_page_nfs(page, out, oCap, matched, oSize);
+}
+
+size_t app_pool_out_cap(size_t lSize)
+{
+    /* The compressed page is the larger output, alone or in the chain */
+    const nf_id_t compression = NF_COMPRESSION;
+
+    return nf_out_cap(&compression, 1, lSize);
+}
+
+static void pool_worker(std::vector<WEB_PAGE_t> *pages, size_t *next, int chain,
+                        struct pool_totals *totals)
+{
+    size_t matched, oSize;
+    size_t p;
+
+    while ((p = __atomic_fetch_add(next, 1, __ATOMIC_RELAXED)) < pages->size()) {
+        WEB_PAGE_t *page = &(*pages)[p];
+        size_t out_cap = app_pool_out_cap(page->lSize);
+        uint8_t *out = (uint8_t*) app_buffer_get(out_cap);
+        sgx_status_t ret;
+
+        if (!out) {
+            printf("Pool:%s:Error:0x%x\n", page->name, SGX_ERROR_OUT_OF_MEMORY);
+            totals->failed++;
+            continue;
+        }
+        ret = app_pool_page(page, out, out_cap, chain, &matched, &oSize);
+        app_buffer_put(out, out_cap);
+        if (ret != SGX_SUCCESS) {
+            printf("Pool:%s:Error:0x%x\n", page->name, ret);
+            totals->failed++;
+        } else {
+            totals->matched += matched ? 1 : 0;
+            totals->out_bytes += oSize;
+        }
+        totals->pages++;
+    }
+}
+
+int app_run_pool(std::vector<WEB_PAGE_t>& pages, unsigned threads, int chain)
+{
+    std::vector<struct pool_totals> totals(threads, pool_totals());
+    std::vector<std::thread> pool;
+    struct pool_totals sum = {0, 0, 0, 0};
+    size_t next = 0, in_len = 0;
+    double tic, toc;
+
+    for (size_t p = 0; p < pages.size(); p++)
+        in_len += pages[p].lSize;
+
+    tic = pool_now();
+    for (unsigned t = 0; t < threads; t++)
+        pool.push_back(std::thread(pool_worker, &pages, &next, chain, &totals[t]));
+    for (unsigned t = 0; t < threads; t++)
+        pool[t].join();
+    toc = pool_now();
+
+    for (unsigned t = 0; t < threads; t++) {
+        sum.pages += totals[t].pages;
+        sum.failed += totals[t].failed;
+        sum.matched += totals[t].matched;
+        sum.out_bytes += totals[t].out_bytes;
+    }
+    printf("Pool:Threads:%u:Mode:%s:Pages:%zu:Bytes:%zu:Time:%f:PagesPerSec:%.1f:MBps:%.1f:"
+           "Matched:%zu:OutputSize:%zu:Failed:%zu\n",
+           threads, chain ? "chain" : "nfs", sum.pages, in_len, toc - tic,
+           (double) sum.pages / (toc - tic), (double) in_len / (toc - tic) / 1e6,
+           sum.matched, sum.out_bytes, sum.failed);
+    return sum.failed == 0 ? 0 : -1;
+}
@@ -0,0 +1,31 @@
+/*
+ * Pool.h: Processes the pages on a pool of host threads.
+ */
+
+#ifndef _APP_POOL_H_
+#define _APP_POOL_H_
+
+#include <vector>
+#include "../App.h"
+
+/*
+ * Runs the IDS and the compression over every page on threads host
+ * threads, which take the pages from a shared queue and issue the NF
+ * ECALLs concurrently, each on its own TCS. With chain, a page is one
+ * enclave_nf_chain ECALL instead of one ECALL per NF. Reports the
+ * aggregate pages/s and MB/s; returns 0 if every page went through.
+ */
+int app_run_pool(std::vector<WEB_PAGE_t>& pages, unsigned threads, int chain);
+
+/*
+ * What a pool thread does with a page: the IDS and the compression, or
+ * with chain the enclave_nf_chain of both, into the oCap bytes of out.
+ * *matched is the IDS matches and *oSize the compressed size.
+ */
+sgx_status_t app_pool_page(WEB_PAGE_t *page, uint8_t *out, size_t oCap, int chain,
+                           size_t *matched, size_t *oSize);
+
+/* Output capacity app_pool_page needs for an lSize-byte page */
+size_t app_pool_out_cap(size_t lSize);
+
+#endif /* !_APP_POOL_H_ */
@@ -0,0 +1,172 @@
+/*
+ * Ring.cpp: Feeds the pages to enclave workers through nf_rings.
+ *
+ * All pages and their output slots live in one arena shared with the
+ * workers; page i goes to ring i % workers. When a ring is full the
+ * producer reaps completions from it before it submits more, which is the
+ * only backpressure the workers need.
+ */
+
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+#include <time.h>
+
+#include "Enclave_u.h"
+#include "nf_ring.h"
+#include "Ring.h"
+
+/* Both NFs of a page, in submission order */
+static const nf_id_t ring_nfs[] = {NF_IDS, NF_COMPRESSION};
+static const char *ring_nf_names[] = {"IDS", "Badword", "Compression"};
+#define RING_NFS (sizeof(ring_nfs) / sizeof(ring_nfs[0]))
+
+struct ring_totals
+{
+    size_t completed;
+    size_t failed;
+    size_t matched;
+    size_t out_bytes;
+};
+
+static double ring_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double) ts.tv_sec + (double) ts.tv_nsec / 1e9;
+}
+
+/* Reaps whatever ring has completed; returns the number of slots */
+static size_t ring_reap(NF_RING_t *ring, std::vector<WEB_PAGE_t>& pages,
+                        struct ring_totals *totals)
+{
+    NF_RING_SLOT_t *slot;
+    size_t n = 0;
+
+    while ((slot = nf_ring_peek(ring)) != NULL) {
+        if (slot->result.status != SGX_SUCCESS) {
+            printf("Ring:%s:%s:Error:0x%x\n", pages[slot->cookie / RING_NFS].name,
+                   ring_nf_names[slot->nf], slot->result.status);
+            totals->failed++;
+        } else {
+            totals->matched += slot->result.matched ? 1 : 0;
+            totals->out_bytes += slot->result.out_len;
+        }
+        totals->completed++;
+        nf_ring_release(ring);
+        n++;
+    }
+    return n;
+}
+
+/* Called by an idle worker */
+void ocall_ring_idle(void)
+{
+    sched_yield();
+}
+
+int app_run_ring(std::vector<WEB_PAGE_t>& pages, unsigned workers)
+{
+    std::vector<NF_RING_t*> rings(workers);
+    std::vector<sgx_status_t> status(workers, SGX_SUCCESS);
+    std::vector<sgx_status_t> ret(workers, SGX_SUCCESS);
+    std::vector<int> exited(workers, 0);
+    std::vector<std::thread> threads;
+    struct ring_totals totals = {0, 0, 0, 0};
+    size_t in_len = 0, arena_len, stalls = 0, submitted = 0;
+    double tic, toc;
+    int rc = 0;
+
+    /* Every NF of a page gets an output slot that holds exactly its output */
+    arena_len = 0;
+    for (size_t p = 0; p < pages.size(); p++) {
+        in_len += pages[p].lSize;
+        for (size_t n = 0; n < RING_NFS; n++)
+            arena_len += nf_out_cap(&ring_nfs[n], 1, pages[p].lSize);
+    }
+    arena_len += in_len;
+    uint8_t *arena = (uint8_t*) malloc(arena_len ? arena_len : 1);
+    if (!arena)
+        return -1;
+
+    for (unsigned w = 0; w < workers; w++) {
+        if (posix_memalign((void **) &rings[w], NF_RING_LINE, sizeof(NF_RING_t)) != 0) {
+            for (unsigned v = 0; v < w; v++)
+                free(rings[v]);
+            free(arena);
+            return -1;
+        }
+        nf_ring_init(rings[w]);
+    }
+
+    for (size_t p = 0, off = 0; p < pages.size(); p++) {
+        memcpy(arena + off, pages[p].cyphertext, pages[p].lSize);
+        off += pages[p].lSize;
+    }
+
+    for (unsigned w = 0; w < workers; w++)
+        threads.push_back(std::thread([&, w]() {
+            ret[w] = enclave_ring_worker(global_eid, &status[w], rings[w], arena, arena_len);
+            __atomic_store_n(&exited[w], 1, __ATOMIC_RELEASE);
+        }));
+
+    tic = ring_now();
+    for (size_t p = 0, in_off = 0, out_off = in_len; p < pages.size() && rc == 0; p++) {
+        for (size_t n = 0; n < RING_NFS && rc == 0; n++, submitted++) {
+            unsigned w = (unsigned) (submitted % workers);
+            nf_batch_desc_t desc;
+
+            desc.in_offset = in_off;
+            desc.in_len = pages[p].lSize;
+            memcpy(desc.mac, pages[p].en_mac, sizeof(desc.mac));
+            memcpy(desc.iv, pages[p].iv, sizeof(desc.iv));
+            desc.out_offset = out_off;
+            desc.out_cap = nf_out_cap(&ring_nfs[n], 1, pages[p].lSize);
+            out_off += desc.out_cap;
+
+            /* Backpressure: a full ring takes nothing until we reap it */
+            if (nf_ring_submit(rings[w], &desc, ring_nfs[n], submitted) == 0)
+                continue;
+            stalls++;
+            while (nf_ring_submit(rings[w], &desc, ring_nfs[n], submitted) != 0) {
+                if (ring_reap(rings[w], pages, &totals))
+                    continue;
+                if (__atomic_load_n(&exited[w], __ATOMIC_ACQUIRE)) {
+                    rc = -1;    /* The worker is gone, reported below */
+                    break;
+                }
+                nf_ring_pause();
+            }
+        }
+        in_off += pages[p].lSize;
+    }
+
+    for (unsigned w = 0; w < workers; w++) {
+        while (nf_ring_pending(rings[w]) && !__atomic_load_n(&exited[w], __ATOMIC_ACQUIRE))
+            if (!ring_reap(rings[w], pages, &totals))
+                nf_ring_pause();
+        ring_reap(rings[w], pages, &totals);
+    }
+    toc = ring_now();
+
+    for (unsigned w = 0; w < workers; w++)
+        __atomic_store_n(&rings[w]->stop, 1, __ATOMIC_RELEASE);
+    for (unsigned w = 0; w < workers; w++) {
+        threads[w].join();
+        if (ret[w] != SGX_SUCCESS || status[w] != SGX_SUCCESS) {
+            printf("Ring:Worker:%u:Error:0x%x\n", w, ret[w] != SGX_SUCCESS ? ret[w] : status[w]);
+            rc = -1;
+        }
+        free(rings[w]);
+    }
+    free(arena);
+
+    printf("Ring:Workers:%u:Pages:%zu:Bytes:%zu:Time:%f:PagesPerSec:%.1f:MBps:%.1f:"
+           "Matched:%zu:OutputSize:%zu:Stalls:%zu:Completed:%zu:Failed:%zu\n",
+           workers, pages.size(), in_len, toc - tic,
+           (double) pages.size() / (toc - tic), (double) in_len / (toc - tic) / 1e6,
+           totals.matched, totals.out_bytes, stalls, totals.completed, totals.failed);
+    return (rc == 0 && totals.failed == 0) ? 0 : -1;
+}
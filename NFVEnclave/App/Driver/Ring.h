@@ -0,0 +1,18 @@
+/*
+ * Ring.h: Feeds the pages to enclave workers through nf_rings.
+ */
+
+#ifndef _APP_RING_H_
+#define _APP_RING_H_
+
+#include <vector>
+#include "../App.h"
+
+/*
+ * Runs the IDS and the compression over every page on workers enclave
+ * threads, each entered once through enclave_ring_worker. Returns 0 if
+ * every page went through.
+ */
+int app_run_ring(std::vector<WEB_PAGE_t>& pages, unsigned workers);
+
+#endif /* !_APP_RING_H_ */
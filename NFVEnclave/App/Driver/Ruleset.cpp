@@ -0,0 +1,121 @@
+/*
+ * Ruleset.cpp: Provisions the badword ruleset of the enclave.
+ *
+ * The rules file goes to enclave_ruleset_load encrypted like a page, under
+ * an IV of its own that goes along with it.
+ * The enclave can seal what it parsed; a later run hands the sealed copy
+ * to enclave_ruleset_unseal and skips the file altogether.
+ */
+
+#include <stdio.h>
+#include <vector>
+
+#include "../App.h"
+#include "Enclave_u.h"
+#include "nf_gcm.h"
+#include "Ruleset.h"
+
+/* Reads the whole file at path into data */
+static bool ruleset_read(const char *path, std::vector<uint8_t>& data)
+{
+    FILE *fp = fopen(path, "rb");
+    long size;
+    bool ok;
+
+    if (fp == nullptr)
+        return false;
+    if (fseek(fp, 0, SEEK_END) != 0 || (size = ftell(fp)) < 0 || fseek(fp, 0, SEEK_SET) != 0) {
+        fclose(fp);
+        return false;
+    }
+    data.resize((size_t) size);
+    ok = fread(data.data(), 1, data.size(), fp) == data.size();
+    fclose(fp);
+    return ok;
+}
+
+static int ruleset_unseal(sgx_enclave_id_t eid, const char *path)
+{
+    std::vector<uint8_t> blob;
+    sgx_status_t ret, status = SGX_ERROR_UNEXPECTED;
+    size_t count = 0;
+
+    if (!ruleset_read(path, blob) || blob.empty())
+        return -1;
+    ret = enclave_ruleset_unseal(eid, &status, blob.data(), blob.size(), &count);
+    if (ret != SGX_SUCCESS || status != SGX_SUCCESS) {
+        printf("Info: sealed ruleset %s not usable, reading the rules file\n", path);
+        return -1;
+    }
+    printf("Info: %zu badword patterns from the sealed ruleset %s\n", count, path);
+    return 0;
+}
+
+static void ruleset_seal(sgx_enclave_id_t eid, const char *path)
+{
+    std::vector<uint8_t> blob;
+    sgx_status_t ret, status = SGX_ERROR_UNEXPECTED;
+    size_t len = 0;
+    FILE *fp;
+
+    /* A first call with no room only reports the size of the blob */
+    ret = enclave_ruleset_seal(eid, &status, NULL, 0, &len);
+    if (ret != SGX_SUCCESS || len == 0) {
+        print_error_message(ret != SGX_SUCCESS ? ret : status);
+        return;
+    }
+    blob.resize(len);
+    ret = enclave_ruleset_seal(eid, &status, blob.data(), blob.size(), &len);
+    if (ret != SGX_SUCCESS || status != SGX_SUCCESS) {
+        print_error_message(ret != SGX_SUCCESS ? ret : status);
+        return;
+    }
+
+    fp = fopen(path, "wb");
+    if (fp == nullptr) {
+        printf("\nCan not open or create file %s.\n", path);
+        return;
+    }
+    if (fwrite(blob.data(), 1, len, fp) != len)
+        printf("\nCan not write file %s.\n", path);
+    fclose(fp);
+}
+
+int app_provision_rules(sgx_enclave_id_t eid, const char *rules, const char *sealed)
+{
+    const char *path = rules ? rules : APP_RULES_FILE;
+    std::vector<uint8_t> text, enc;
+    uint8_t mac[NF_GCM_TAG_SIZE], iv[NF_GCM_IV_SIZE];
+    NF_GCM_KEY_t key;
+    sgx_status_t ret, status = SGX_ERROR_UNEXPECTED;
+    size_t count = 0;
+
+    if (sealed && ruleset_unseal(eid, sealed) == 0)
+        return 0;
+
+    if (!ruleset_read(path, text)) {
+        if (rules) {
+            printf("\nFile %s not exist.\n", path);
+            return -1;
+        }
+        printf("Info: no %s, the enclave keeps its built-in badword list\n", path);
+        return 0;
+    }
+
+    enc.resize(text.size());
+    nf_gcm_key_init(&key, app_data_key);
+    app_page_iv(iv);
+    nf_gcm_encrypt(&key, iv, text.data(), text.size(), enc.data(), mac);
+    nf_gcm_key_clear(&key);
+
+    ret = enclave_ruleset_load(eid, &status, enc.data(), enc.size(), mac, iv, &count);
+    if (ret != SGX_SUCCESS || status != SGX_SUCCESS) {
+        print_error_message(ret != SGX_SUCCESS ? ret : status);
+        return -1;
+    }
+    printf("Info: %zu badword patterns from %s\n", count, path);
+
+    if (sealed)
+        ruleset_seal(eid, sealed);
+    return 0;
+}
@@ -0,0 +1,29 @@
+/*
+ * Ruleset.h: Provisions the badword ruleset of the enclave.
+ */
+
+#ifndef _APP_RULESET_H_
+#define _APP_RULESET_H_
+
+#include "sgx_eid.h"
+
+/* Rules file read when --rules is not given */
+#define APP_RULES_FILE "badwords.txt"
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+/*
+ * Loads the ruleset of enclave eid from the sealed copy at sealed if there
+ * is a usable one, else from the rules file, and then seals it to sealed. rules NULL
+ * means APP_RULES_FILE, which may be missing: the enclave then keeps its
+ * built-in list. Returns 0 unless the ruleset could not be loaded.
+ */
+int app_provision_rules(sgx_enclave_id_t eid, const char *rules, const char *sealed);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif /* !_APP_RULESET_H_ */
@@ -0,0 +1,107 @@
+/*
+ * Sched.cpp: Host threads of the enclave's work-stealing scheduler.
+ *
+ * A worker is a host thread parked inside enclave_sched_worker for the
+ * whole run, so it costs one ECALL however many loops it helps with. Each
+ * start gets a new generation, and enclave_sched_stop() ends only the
+ * workers of that generation: a thread that enters late still sees its
+ * own generation stopped and returns at once.
+ */
+
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <thread>
+#include <vector>
+
+#include "Enclave_u.h"
+#include "nf_sched.h"
+#include "Sched.h"
+
+static std::vector<std::thread> sched_threads;
+static std::vector<sgx_status_t> sched_ret;
+static std::vector<sgx_status_t> sched_status;
+static volatile size_t sched_exited = 0;
+static uint64_t sched_generation = 0;
+
+int app_sched_start(sgx_enclave_id_t eid, unsigned workers)
+{
+    size_t slots = 0, inside = 0;
+    sgx_status_t status = SGX_SUCCESS, ret;
+
+    if (!sched_threads.empty() || workers == 0)
+        return -1;
+
+    sched_generation++;
+    sched_ret.assign(workers, SGX_SUCCESS);
+    sched_status.assign(workers, SGX_SUCCESS);
+    sched_exited = 0;
+    for (unsigned w = 0; w < workers; w++)
+        sched_threads.push_back(std::thread([eid, w]() {
+            sched_ret[w] = enclave_sched_worker(eid, &sched_status[w], sched_generation);
+            __atomic_add_fetch(&sched_exited, 1, __ATOMIC_ACQ_REL);
+        }));
+
+    /* A fork before the workers are in would run alone */
+    while ((ret = enclave_sched_stats(eid, &status, NULL, 0, &slots, &inside)) == SGX_SUCCESS &&
+           status == SGX_SUCCESS && inside < workers &&
+           __atomic_load_n(&sched_exited, __ATOMIC_ACQUIRE) == 0)
+        sched_yield();
+    if (ret != SGX_SUCCESS || status != SGX_SUCCESS || inside < workers) {
+        if (ret != SGX_SUCCESS || status != SGX_SUCCESS)
+            printf("Sched:Start:Error:0x%x\n", ret != SGX_SUCCESS ? ret : status);
+        app_sched_stop(eid);    /* Reports the workers that failed */
+        return -1;
+    }
+    return 0;
+}
+
+int app_sched_stop(sgx_enclave_id_t eid)
+{
+    sgx_status_t status = SGX_SUCCESS, ret;
+    int rc = 0;
+
+    if (sched_threads.empty())
+        return 0;
+    ret = enclave_sched_stop(eid, &status, sched_generation);
+    if (ret != SGX_SUCCESS || status != SGX_SUCCESS) {
+        /* The workers would never return */
+        printf("Sched:Stop:Error:0x%x\n", ret != SGX_SUCCESS ? ret : status);
+        abort();
+    }
+    for (size_t w = 0; w < sched_threads.size(); w++) {
+        sched_threads[w].join();
+        if (sched_ret[w] != SGX_SUCCESS || sched_status[w] != SGX_SUCCESS) {
+            printf("Sched:Worker:%zu:Error:0x%x\n", w,
+                   sched_ret[w] != SGX_SUCCESS ? sched_ret[w] : sched_status[w]);
+            rc = -1;
+        }
+    }
+    sched_threads.clear();
+    return rc;
+}
+
+void app_sched_report(sgx_enclave_id_t eid)
+{
+    std::vector<nf_sched_stats_t> stats(NF_SCHED_SLOTS);
+    size_t slots = 0, inside = 0;
+    sgx_status_t status = SGX_SUCCESS, ret;
+    uint64_t items = 0;
+
+    ret = enclave_sched_stats(eid, &status, stats.data(), stats.size(), &slots, &inside);
+    if (ret != SGX_SUCCESS || status != SGX_SUCCESS) {
+        printf("Sched:Stats:Error:0x%x\n", ret != SGX_SUCCESS ? ret : status);
+        return;
+    }
+    if (slots > stats.size())
+        slots = stats.size();
+    for (size_t i = 0; i < slots; i++)
+        items += stats[i].items;
+    for (size_t i = 0; i < slots; i++)
+        printf("Sched:Slot:%zu:Worker:%u:Tasks:%llu:Items:%llu:Share:%.1f%%:Steals:%llu:"
+               "FailedSteals:%llu:Parks:%llu\n", i, stats[i].worker,
+               (unsigned long long) stats[i].tasks, (unsigned long long) stats[i].items,
+               items ? 100.0 * (double) stats[i].items / (double) items : 0.0,
+               (unsigned long long) stats[i].steals, (unsigned long long) stats[i].failed_steals,
+               (unsigned long long) stats[i].parks);
+}
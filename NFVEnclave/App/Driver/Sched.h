@@ -0,0 +1,23 @@
+/*
+ * Sched.h: Host threads of the enclave's work-stealing scheduler.
+ */
+
+#ifndef _APP_SCHED_H_
+#define _APP_SCHED_H_
+
+#include "../App.h"
+
+/*
+ * Enters workers threads into enclave_sched_worker and waits until they
+ * are all in. Each holds a TCS until app_sched_stop(). Returns 0 on
+ * success; on failure no worker is left running.
+ */
+int app_sched_start(sgx_enclave_id_t eid, unsigned workers);
+
+/* Stops and joins the workers; returns 0 if they all ended cleanly */
+int app_sched_stop(sgx_enclave_id_t eid);
+
+/* One Sched: line per deque in use, with its share of the items */
+void app_sched_report(sgx_enclave_id_t eid);
+
+#endif /* !_APP_SCHED_H_ */
@@ -0,0 +1,42 @@
+/*
+ * Switchless.cpp: Creation of the enclave, with or without switchless calls.
+ *
+ * The switchless ECALLs and OCALLs of Enclave.edl fall back to regular
+ * transitions on an enclave created without worker pools, so the same
+ * build serves both modes. Creating the pools needs sgx_uswitchless and
+ * sgx_tswitchless, which the Makefile links with Switchless=enable.
+ */
+
+#include <stdio.h>
+
+#include "sgx_urts.h"
+#ifdef NF_SWITCHLESS
+#include "sgx_uswitchless.h"
+#endif
+#include "../App.h"
+#include "Switchless.h"
+
+sgx_status_t app_create_enclave(const char *file, const APP_OPTIONS_t *opts, int switchless,
+                                sgx_enclave_id_t *eid)
+{
+    if (!switchless)
+        return sgx_create_enclave(file, SGX_DEBUG_FLAG, NULL, NULL, eid, NULL);
+
+#ifdef NF_SWITCHLESS
+    sgx_uswitchless_config_t config = SGX_USWITCHLESS_CONFIG_INITIALIZER;
+    const void *ex_features[32] = {0};
+
+    config.num_uworkers = opts->sl_uworkers;
+    config.num_tworkers = opts->sl_tworkers;
+    config.retries_before_fallback = opts->sl_fallback;
+    config.retries_before_sleep = opts->sl_sleep;
+    ex_features[SGX_CREATE_ENCLAVE_EX_SWITCHLESS_BIT_IDX] = &config;
+
+    return sgx_create_enclave_ex(file, SGX_DEBUG_FLAG, NULL, NULL, eid, NULL,
+                                 SGX_CREATE_ENCLAVE_EX_SWITCHLESS, ex_features);
+#else
+    (void) opts;
+    printf("Switchless calls need a build with Switchless=enable\n");
+    return SGX_ERROR_FEATURE_NOT_SUPPORTED;
+#endif
+}
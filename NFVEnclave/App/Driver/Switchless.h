@@ -0,0 +1,28 @@
+/*
+ * Switchless.h: Creation of the enclave, with or without switchless calls.
+ */
+
+#ifndef _APP_SWITCHLESS_H_
+#define _APP_SWITCHLESS_H_
+
+#include "sgx_error.h"
+#include "sgx_eid.h"
+#include "Options.h"
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+/*
+ * Creates an instance of the signed enclave file, ENCLAVE_FILENAME unless
+ * the run compares variants. With switchless set, the SDK's worker pools
+ * are configured from the sl_* fields of opts.
+ */
+sgx_status_t app_create_enclave(const char *file, const APP_OPTIONS_t *opts, int switchless,
+                                sgx_enclave_id_t *eid);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif /* !_APP_SWITCHLESS_H_ */
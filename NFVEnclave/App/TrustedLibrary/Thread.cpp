@@ -66,7 +66,7 @@ void data_consumer(void)
 }
 
 /* ecall_thread_functions:
- *   Invokes thread functions including mutex, condition variable, etc.
+ *   Invokes thread functions including atomics, the lock-free queue, etc.
  */
 void ecall_thread_functions(void)
 {
@@ -18,8 +18,7 @@
     along with multifast.  If not, see <http://www.gnu.org/licenses/>.
 */
 
-#include <string.h>
-#include <ctype.h>
+#include "ac_platform.h"
 #include "ahocorasick.h"
 
 #define MPOOL_BLOCK_SIZE (24*4096)
@@ -174,7 +173,8 @@ void *mpool_strndup (struct mpool *pool, const char *str, size_t n)
 
     if ((ret = mpool_malloc(pool, n+1)))
     {
-        strncpy((char *)ret, str, n);
+        /* Patterns may hold NULs, copy all n bytes */
+        memcpy(ret, str, n);
         ((char *)ret)[n] = '\0';
     }
 
@@ -830,11 +830,12 @@ int ac_trie_search (AC_TRIE_t *thiz, AC_TEXT_t *text, int keep,
     else
         position = 0;
 
-    current = thiz->last_node;
-
+    /* A new text starts at the root, not where the last one stopped */
     if (!keep)
         ac_trie_reset (thiz);
 
+    current = thiz->last_node;
+
     /* This is the main search loop.
      * It must be kept as lightweight as possible.
      */
@@ -1608,4 +1609,17 @@ void multifast_rep_flush (AC_TRIE_t *thiz, int keep)
         thiz->last_node = thiz->root;
         thiz->base_position = 0;
     }
-}
\ No newline at end of file
+}
+
+/**
+ * @brief Drops a replacement in progress without calling back, so that the
+ * trie can start over with a new text.
+ *
+ * @param thiz
+ *****************************************************************************/
+void multifast_rep_reset (AC_TRIE_t *thiz)
+{
+    mf_repdata_reset (&thiz->repdata);
+    thiz->last_node = thiz->root;
+    thiz->base_position = 0;
+}
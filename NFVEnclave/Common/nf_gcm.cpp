@@ -0,0 +1,583 @@
+/*
+ * nf_gcm.cpp: AES-128-GCM on AES-NI and PCLMULQDQ. See nf_gcm.h.
+ *
+ * GHASH follows the Intel carry-less multiplication white paper: blocks and
+ * the hash key are byte-reflected, multiplied with four PCLMULQDQ and then
+ * shifted and reduced modulo x^128 + x^7 + x^2 + x + 1. Shift and reduction
+ * are linear, so NF_GCM_WAYS products can be summed before one reduction.
+ */
+
+#include <string.h>
+#include <wmmintrin.h>  /* AES-NI, PCLMULQDQ */
+#include <smmintrin.h>  /* SSE4.1 */
+#include "nf_gcm.h"
+
+#if NF_GCM_WAYS != 8
+#error "The bulk loops below are written for NF_GCM_WAYS == 8"
+#endif
+
+#define NF_GCM_BSWAP _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15)
+
+/*----------------------------------------------------------------------------
+ * AES-128
+ *--------------------------------------------------------------------------*/
+
+static inline __m128i aes128_expand(__m128i key, __m128i assist)
+{
+    assist = _mm_shuffle_epi32(assist, 0xff);
+    key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+    key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+    key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+    return _mm_xor_si128(key, assist);
+}
+
+#define AES128_EXPAND(rk, i, rcon) \
+    rk[i] = aes128_expand(rk[i-1], _mm_aeskeygenassist_si128(rk[i-1], rcon))
+
+static inline __m128i aes128_encrypt(__m128i b, const __m128i *rk)
+{
+    b = _mm_xor_si128(b, rk[0]);
+    for (int r = 1; r < 10; r++)
+        b = _mm_aesenc_si128(b, rk[r]);
+    return _mm_aesenclast_si128(b, rk[10]);
+}
+
+/* Encrypts eight blocks round by round so the AES units stay busy */
+#define AES_ROUND8(b, f, k) do { \
+        b[0] = f(b[0], k); b[1] = f(b[1], k); \
+        b[2] = f(b[2], k); b[3] = f(b[3], k); \
+        b[4] = f(b[4], k); b[5] = f(b[5], k); \
+        b[6] = f(b[6], k); b[7] = f(b[7], k); \
+    } while (0)
+
+static inline void aes128_encrypt8(__m128i *b, const __m128i *rk)
+{
+    AES_ROUND8(b, _mm_xor_si128, rk[0]);
+    for (int r = 1; r < 10; r++)
+        AES_ROUND8(b, _mm_aesenc_si128, rk[r]);
+    AES_ROUND8(b, _mm_aesenclast_si128, rk[10]);
+}
+
+/*----------------------------------------------------------------------------
+ * GHASH
+ *--------------------------------------------------------------------------*/
+
+/* Adds the unreduced 256-bit product a*b to (hi:lo) */
+static inline void clmul_acc(__m128i a, __m128i b, __m128i *lo, __m128i *hi)
+{
+    __m128i t0 = _mm_clmulepi64_si128(a, b, 0x00);
+    __m128i t1 = _mm_clmulepi64_si128(a, b, 0x10);
+    __m128i t2 = _mm_clmulepi64_si128(a, b, 0x01);
+    __m128i t3 = _mm_clmulepi64_si128(a, b, 0x11);
+
+    t1 = _mm_xor_si128(t1, t2);
+    *lo = _mm_xor_si128(*lo, _mm_xor_si128(t0, _mm_slli_si128(t1, 8)));
+    *hi = _mm_xor_si128(*hi, _mm_xor_si128(t3, _mm_srli_si128(t1, 8)));
+}
+
+/* Shifts (hi:lo) left by one bit and reduces it to 128 bits */
+static inline __m128i gf_reduce(__m128i lo, __m128i hi)
+{
+    __m128i t2, t4, t5, t7, t8, t9;
+
+    t7 = _mm_srli_epi32(lo, 31);
+    t8 = _mm_srli_epi32(hi, 31);
+    lo = _mm_slli_epi32(lo, 1);
+    hi = _mm_slli_epi32(hi, 1);
+    t9 = _mm_srli_si128(t7, 12);
+    t8 = _mm_slli_si128(t8, 4);
+    t7 = _mm_slli_si128(t7, 4);
+    lo = _mm_or_si128(lo, t7);
+    hi = _mm_or_si128(hi, t8);
+    hi = _mm_or_si128(hi, t9);
+
+    t7 = _mm_slli_epi32(lo, 31);
+    t8 = _mm_slli_epi32(lo, 30);
+    t9 = _mm_slli_epi32(lo, 25);
+    t7 = _mm_xor_si128(t7, t8);
+    t7 = _mm_xor_si128(t7, t9);
+    t8 = _mm_srli_si128(t7, 4);
+    t7 = _mm_slli_si128(t7, 12);
+    lo = _mm_xor_si128(lo, t7);
+
+    t2 = _mm_srli_epi32(lo, 1);
+    t4 = _mm_srli_epi32(lo, 2);
+    t5 = _mm_srli_epi32(lo, 7);
+    t2 = _mm_xor_si128(t2, t4);
+    t2 = _mm_xor_si128(t2, t5);
+    t2 = _mm_xor_si128(t2, t8);
+    lo = _mm_xor_si128(lo, t2);
+    return _mm_xor_si128(hi, lo);
+}
+
+static inline __m128i gf_mul(__m128i a, __m128i b)
+{
+    __m128i lo = _mm_setzero_si128(), hi = _mm_setzero_si128();
+
+    clmul_acc(a, b, &lo, &hi);
+    return gf_reduce(lo, hi);
+}
+
+/* Y = (Y ^ X) * H for one ciphertext block (not yet reflected) */
+static inline __m128i ghash_block(__m128i y, __m128i x, const __m128i *htab)
+{
+    x = _mm_shuffle_epi8(x, NF_GCM_BSWAP);
+    return gf_mul(_mm_xor_si128(y, x), htab[0]);
+}
+
+/* Y = (Y ^ X0)*H^8 ^ X1*H^7 ^ ... ^ X7*H with a single reduction */
+static inline __m128i ghash_block8(__m128i y, const __m128i *x, const __m128i *htab)
+{
+    const __m128i bswap = NF_GCM_BSWAP;
+    __m128i lo = _mm_setzero_si128(), hi = _mm_setzero_si128();
+
+    clmul_acc(_mm_xor_si128(y, _mm_shuffle_epi8(x[0], bswap)), htab[7], &lo, &hi);
+    for (int k = 1; k < 8; k++)
+        clmul_acc(_mm_shuffle_epi8(x[k], bswap), htab[7 - k], &lo, &hi);
+    return gf_reduce(lo, hi);
+}
+
+/* Y = (Y ^ X0)*H^n ^ X1*H^(n-1) ^ ... ^ X(n-1)*H, 1 <= n <= NF_GCM_WAYS */
+static inline __m128i ghash_blocks(__m128i y, const __m128i *x, int n, const __m128i *htab)
+{
+    const __m128i bswap = NF_GCM_BSWAP;
+    __m128i lo = _mm_setzero_si128(), hi = _mm_setzero_si128();
+
+    clmul_acc(_mm_xor_si128(y, _mm_shuffle_epi8(x[0], bswap)), htab[n - 1], &lo, &hi);
+    for (int k = 1; k < n; k++)
+        clmul_acc(_mm_shuffle_epi8(x[k], bswap), htab[n - 1 - k], &lo, &hi);
+    return gf_reduce(lo, hi);
+}
+
+/*----------------------------------------------------------------------------
+ * Key
+ *--------------------------------------------------------------------------*/
+
+/*
+ * nf_gcm_key_init:
+ *   Expands key into round keys and computes H^1..H^NF_GCM_WAYS.
+ */
+void nf_gcm_key_init(NF_GCM_KEY_t *thiz, const uint8_t *key)
+{
+    __m128i *rk = (__m128i *) thiz->rk;
+    __m128i *htab = (__m128i *) thiz->htab;
+    __m128i h;
+
+    rk[0] = _mm_loadu_si128((const __m128i *) key);
+    AES128_EXPAND(rk, 1, 0x01);
+    AES128_EXPAND(rk, 2, 0x02);
+    AES128_EXPAND(rk, 3, 0x04);
+    AES128_EXPAND(rk, 4, 0x08);
+    AES128_EXPAND(rk, 5, 0x10);
+    AES128_EXPAND(rk, 6, 0x20);
+    AES128_EXPAND(rk, 7, 0x40);
+    AES128_EXPAND(rk, 8, 0x80);
+    AES128_EXPAND(rk, 9, 0x1b);
+    AES128_EXPAND(rk, 10, 0x36);
+
+    h = aes128_encrypt(_mm_setzero_si128(), rk);
+    htab[0] = _mm_shuffle_epi8(h, NF_GCM_BSWAP);
+    for (int i = 1; i < NF_GCM_WAYS; i++)
+        htab[i] = gf_mul(htab[i - 1], htab[0]);
+}
+
+/*
+ * nf_gcm_key_clear:
+ *   Wipes the expanded key.
+ */
+void nf_gcm_key_clear(NF_GCM_KEY_t *thiz)
+{
+    volatile uint8_t *p = (volatile uint8_t *) thiz;
+
+    for (size_t i = 0; i < sizeof(*thiz); i++)
+        p[i] = 0;
+}
+
+/*
+ * nf_gcm_derive_key:
+ *   Encrypts the block "NFSK" || flow_id || nonce, big-endian, under the
+ *   master key. The host holds the master key too and derives the same key
+ *   from the nonce; what a fresh nonce buys is a key that no earlier
+ *   session of the flow used, so none of its pages authenticate again.
+ */
+void nf_gcm_derive_key(const NF_GCM_KEY_t *master, uint32_t flow_id, uint64_t nonce,
+                       uint8_t *key)
+{
+    uint8_t block[16] = {'N', 'F', 'S', 'K'};
+
+    for (int i = 0; i < 4; i++)
+        block[4 + i] = (uint8_t)(flow_id >> (24 - 8 * i));
+    for (int i = 0; i < 8; i++)
+        block[8 + i] = (uint8_t)(nonce >> (56 - 8 * i));
+    _mm_storeu_si128((__m128i *) key,
+                     aes128_encrypt(_mm_loadu_si128((const __m128i *) block),
+                                    (const __m128i *) master->rk));
+}
+
+/*----------------------------------------------------------------------------
+ * Message
+ *--------------------------------------------------------------------------*/
+
+static inline __m128i gcm_counter(__m128i j0, uint32_t ctr)
+{
+    return _mm_insert_epi32(j0, (int) __builtin_bswap32(ctr), 3);
+}
+
+/*
+ * nf_gcm_init:
+ *   Starts a message under a 96-bit IV.
+ */
+void nf_gcm_init(NF_GCM_CTX_t *thiz, const NF_GCM_KEY_t *key, const uint8_t *iv)
+{
+    thiz->key = key;
+    memcpy(thiz->j0, iv, NF_GCM_IV_SIZE);
+    thiz->j0[12] = 0;
+    thiz->j0[13] = 0;
+    thiz->j0[14] = 0;
+    thiz->j0[15] = 1;
+    memset(thiz->ghash, 0, sizeof(thiz->ghash));
+    thiz->partial_len = 0;
+    thiz->ctr = 2;
+    thiz->len = 0;
+}
+
+static void gcm_update(NF_GCM_CTX_t *thiz, const uint8_t *src, size_t len,
+                       uint8_t *dst, int encrypt)
+{
+    const __m128i *rk = (const __m128i *) thiz->key->rk;
+    const __m128i *htab = (const __m128i *) thiz->key->htab;
+    const __m128i j0 = _mm_load_si128((const __m128i *) thiz->j0);
+    __m128i y = _mm_load_si128((const __m128i *) thiz->ghash);
+    size_t i = 0;
+
+    thiz->len += len;
+
+    /* Finish the partial block left by the previous update */
+    if (thiz->partial_len) {
+        while (thiz->partial_len < 16 && i < len) {
+            uint8_t in = src[i];
+            uint8_t out = (uint8_t)(in ^ thiz->ks[thiz->partial_len]);
+
+            dst[i++] = out;
+            thiz->partial[thiz->partial_len++] = encrypt ? out : in;
+        }
+        if (thiz->partial_len < 16) {
+            _mm_store_si128((__m128i *) thiz->ghash, y);
+            return;
+        }
+        y = ghash_block(y, _mm_loadu_si128((const __m128i *) thiz->partial), htab);
+        thiz->partial_len = 0;
+    }
+
+    /* Bulk: NF_GCM_WAYS blocks per iteration */
+    while (len - i >= 16 * NF_GCM_WAYS) {
+        __m128i b[NF_GCM_WAYS], in[NF_GCM_WAYS];
+
+        for (int k = 0; k < NF_GCM_WAYS; k++)
+            b[k] = gcm_counter(j0, thiz->ctr + (uint32_t) k);
+        thiz->ctr += NF_GCM_WAYS;
+        aes128_encrypt8(b, rk);
+
+        for (int k = 0; k < NF_GCM_WAYS; k++) {
+            in[k] = _mm_loadu_si128((const __m128i *)(src + i) + k);
+            b[k] = _mm_xor_si128(b[k], in[k]);
+            _mm_storeu_si128((__m128i *)(dst + i) + k, b[k]);
+        }
+        y = ghash_block8(y, encrypt ? b : in, htab);
+        i += 16 * NF_GCM_WAYS;
+    }
+
+    /* Remaining full blocks */
+    while (len - i >= 16) {
+        __m128i in = _mm_loadu_si128((const __m128i *)(src + i));
+        __m128i out = _mm_xor_si128(in, aes128_encrypt(gcm_counter(j0, thiz->ctr++), rk));
+
+        _mm_storeu_si128((__m128i *)(dst + i), out);
+        y = ghash_block(y, encrypt ? out : in, htab);
+        i += 16;
+    }
+
+    /* Tail: keep the keystream block for the next update */
+    if (i < len) {
+        _mm_storeu_si128((__m128i *) thiz->ks,
+                         aes128_encrypt(gcm_counter(j0, thiz->ctr++), rk));
+        while (i < len) {
+            uint8_t in = src[i];
+            uint8_t out = (uint8_t)(in ^ thiz->ks[thiz->partial_len]);
+
+            dst[i++] = out;
+            thiz->partial[thiz->partial_len++] = encrypt ? out : in;
+        }
+    }
+
+    _mm_store_si128((__m128i *) thiz->ghash, y);
+}
+
+/*
+ * nf_gcm_encrypt_update:
+ *   Encrypts the next len bytes of the message. src and dst may be equal.
+ */
+void nf_gcm_encrypt_update(NF_GCM_CTX_t *thiz, const uint8_t *src, size_t len,
+                           uint8_t *dst)
+{
+    gcm_update(thiz, src, len, dst, 1);
+}
+
+/*
+ * nf_gcm_decrypt_update:
+ *   Decrypts the next len bytes of the message. src and dst may be equal.
+ *   The plaintext is not authenticated before nf_gcm_final().
+ */
+void nf_gcm_decrypt_update(NF_GCM_CTX_t *thiz, const uint8_t *src, size_t len,
+                           uint8_t *dst)
+{
+    gcm_update(thiz, src, len, dst, 0);
+}
+
+/*
+ * nf_gcm_final:
+ *   Computes the tag of the message.
+ */
+void nf_gcm_final(NF_GCM_CTX_t *thiz, uint8_t *tag)
+{
+    const __m128i *rk = (const __m128i *) thiz->key->rk;
+    const __m128i *htab = (const __m128i *) thiz->key->htab;
+    __m128i y = _mm_load_si128((const __m128i *) thiz->ghash);
+    uint8_t lenblk[16] = {0};
+    uint64_t bits = thiz->len * 8;
+
+    if (thiz->partial_len) {
+        memset(thiz->partial + thiz->partial_len, 0, 16 - thiz->partial_len);
+        y = ghash_block(y, _mm_loadu_si128((const __m128i *) thiz->partial), htab);
+        thiz->partial_len = 0;
+    }
+
+    /* len(A) = 0 || len(C), both 64-bit big-endian */
+    for (int k = 0; k < 8; k++)
+        lenblk[15 - k] = (uint8_t)(bits >> (8 * k));
+    y = ghash_block(y, _mm_loadu_si128((const __m128i *) lenblk), htab);
+
+    y = _mm_shuffle_epi8(y, NF_GCM_BSWAP);
+    y = _mm_xor_si128(y, aes128_encrypt(_mm_load_si128((const __m128i *) thiz->j0), rk));
+    _mm_storeu_si128((__m128i *) tag, y);
+}
+
+void nf_gcm_encrypt(const NF_GCM_KEY_t *key, const uint8_t *iv,
+                    const uint8_t *src, size_t len, uint8_t *dst, uint8_t *tag)
+{
+    NF_GCM_CTX_t ctx;
+
+    nf_gcm_init(&ctx, key, iv);
+    nf_gcm_encrypt_update(&ctx, src, len, dst);
+    nf_gcm_final(&ctx, tag);
+}
+
+int nf_gcm_decrypt(const NF_GCM_KEY_t *key, const uint8_t *iv,
+                   const uint8_t *src, size_t len, uint8_t *dst, const uint8_t *tag)
+{
+    NF_GCM_CTX_t ctx;
+    uint8_t expected[NF_GCM_TAG_SIZE];
+
+    nf_gcm_init(&ctx, key, iv);
+    nf_gcm_decrypt_update(&ctx, src, len, dst);
+    nf_gcm_final(&ctx, expected);
+    return nf_gcm_tag_equal(expected, tag) ? 0 : -1;
+}
+
+/*----------------------------------------------------------------------------
+ * Multi-buffer
+ *
+ * Each of NF_GCM_WAYS lanes carries one message of the batch. A step hands
+ * every busy lane a stripe of NF_GCM_WAYS counter blocks. The lanes do not
+ * depend on each other, so the AES rounds of one lane overlap the GHASH of
+ * the previous one, which a lone short message cannot do. A lane that is
+ * done is refilled with the next message of the batch.
+ *--------------------------------------------------------------------------*/
+
+typedef struct gcm_lane
+{
+    NF_GCM_JOB_t *job;      /* NULL for a free lane */
+    __m128i j0;
+    __m128i y;
+    __m128i ekj0;           /* E(K, J0), masks the tag */
+    size_t off;             /* Message bytes processed */
+    uint32_t ctr;           /* Next counter; 1 is J0 itself */
+} GCM_LANE_t;
+
+static void gcm_lane_start(GCM_LANE_t *lane, NF_GCM_JOB_t *job)
+{
+    uint8_t j0[16];
+
+    memcpy(j0, job->iv, NF_GCM_IV_SIZE);
+    j0[12] = 0;
+    j0[13] = 0;
+    j0[14] = 0;
+    j0[15] = 1;
+
+    lane->job = job;
+    lane->j0 = _mm_loadu_si128((const __m128i *) j0);
+    lane->y = _mm_setzero_si128();
+    lane->off = 0;
+    lane->ctr = 1;
+}
+
+/*
+ * Runs one stripe of lane. Returns 1 once the message is done, with the
+ * length block hashed.
+ */
+static inline int gcm_lane_step(GCM_LANE_t *lane, int encrypt)
+{
+    NF_GCM_JOB_t *job = lane->job;
+    const __m128i *rk = (const __m128i *) job->key->rk;
+    const __m128i *htab = (const __m128i *) job->key->htab;
+    __m128i b[NF_GCM_WAYS], x[NF_GCM_WAYS];
+    size_t off = lane->off;
+    size_t need = (lane->ctr == 1) + (job->len - off + 15) / 16;
+    int first = 0, nx = 0;
+
+    /* Only as many counter blocks as the message still needs */
+    if (need >= NF_GCM_WAYS) {
+        for (int k = 0; k < NF_GCM_WAYS; k++)
+            b[k] = gcm_counter(lane->j0, lane->ctr + (uint32_t) k);
+        aes128_encrypt8(b, rk);
+    } else {
+        for (size_t k = 0; k < need; k++)
+            b[k] = aes128_encrypt(gcm_counter(lane->j0, lane->ctr + (uint32_t) k), rk);
+    }
+
+    /* A stripe of whole blocks that is not the last: as in gcm_update() */
+    if (lane->ctr > 1 && job->len - off > 16 * NF_GCM_WAYS) {
+        for (int k = 0; k < NF_GCM_WAYS; k++) {
+            x[k] = _mm_loadu_si128((const __m128i *)(job->src + off) + k);
+            b[k] = _mm_xor_si128(b[k], x[k]);
+            _mm_storeu_si128((__m128i *)(job->dst + off) + k, b[k]);
+        }
+        lane->y = ghash_block8(lane->y, encrypt ? b : x, htab);
+        lane->ctr += NF_GCM_WAYS;
+        lane->off = off + 16 * NF_GCM_WAYS;
+        return 0;
+    }
+
+    if (lane->ctr == 1) {
+        lane->ekj0 = b[0];
+        first = 1;
+    }
+    for (int k = first; k < NF_GCM_WAYS && off < job->len; k++) {
+        size_t n = job->len - off;
+        __m128i in, out;
+
+        if (n >= 16) {
+            in = _mm_loadu_si128((const __m128i *)(job->src + off));
+            out = _mm_xor_si128(in, b[k]);
+            _mm_storeu_si128((__m128i *)(job->dst + off), out);
+            off += 16;
+        } else {
+            uint8_t buf[16] = {0};
+
+            memcpy(buf, job->src + off, n);
+            in = _mm_loadu_si128((const __m128i *) buf);
+            _mm_storeu_si128((__m128i *) buf, _mm_xor_si128(in, b[k]));
+            memcpy(job->dst + off, buf, n);
+            memset(buf + n, 0, 16 - n);
+            out = _mm_loadu_si128((const __m128i *) buf);
+            off += n;
+        }
+        x[nx++] = encrypt ? out : in;
+    }
+    lane->ctr += (uint32_t)(first + nx);
+    lane->off = off;
+
+    /* Last stripe: the length block joins the same reduction if it fits */
+    if (off == job->len) {
+        uint8_t lenblk[16] = {0};
+        uint64_t bits = (uint64_t) job->len * 8;
+
+        for (int i = 0; i < 8; i++)
+            lenblk[15 - i] = (uint8_t)(bits >> (8 * i));
+        if (nx == NF_GCM_WAYS) {
+            lane->y = ghash_blocks(lane->y, x, nx, htab);
+            nx = 0;
+        }
+        x[nx++] = _mm_loadu_si128((const __m128i *) lenblk);
+    }
+    lane->y = ghash_blocks(lane->y, x, nx, htab);
+    return off == job->len;
+}
+/* Produces or checks the tag of lane; returns 1 on a mismatch */
+static size_t gcm_lane_finish(GCM_LANE_t *lane, int encrypt)
+{
+    NF_GCM_JOB_t *job = lane->job;
+    uint8_t tag[NF_GCM_TAG_SIZE];
+    __m128i t = _mm_xor_si128(_mm_shuffle_epi8(lane->y, NF_GCM_BSWAP), lane->ekj0);
+
+    lane->job = NULL;
+    if (encrypt) {
+        _mm_storeu_si128((__m128i *) job->tag, t);
+        job->status = 0;
+        return 0;
+    }
+    _mm_storeu_si128((__m128i *) tag, t);
+    job->status = nf_gcm_tag_equal(tag, job->tag) ? 0 : -1;
+    return job->status ? 1 : 0;
+}
+
+static size_t gcm_mb(NF_GCM_JOB_t *jobs, size_t count, int encrypt)
+{
+    GCM_LANE_t lane[NF_GCM_WAYS];
+    size_t next = 0, failed = 0;
+    int active = 0;
+
+    for (int k = 0; k < NF_GCM_WAYS; k++)
+        lane[k].job = NULL;
+
+    for (;;) {
+        for (int k = 0; k < NF_GCM_WAYS && next < count; k++) {
+            if (!lane[k].job) {
+                gcm_lane_start(&lane[k], &jobs[next++]);
+                active++;
+            }
+        }
+        if (!active)
+            break;
+
+        for (int k = 0; k < NF_GCM_WAYS; k++) {
+            if (lane[k].job && gcm_lane_step(&lane[k], encrypt)) {
+                failed += gcm_lane_finish(&lane[k], encrypt);
+                active--;
+            }
+        }
+    }
+    return failed;
+}
+
+/*
+ * nf_gcm_encrypt_mb:
+ *   Encrypts count independent messages. Any message may be in place.
+ */
+void nf_gcm_encrypt_mb(NF_GCM_JOB_t *jobs, size_t count)
+{
+    gcm_mb(jobs, count, 1);
+}
+
+/*
+ * nf_gcm_decrypt_mb:
+ *   Decrypts count independent messages and checks their tags. The
+ *   plaintext of a job whose status is not 0 must be discarded.
+ */
+size_t nf_gcm_decrypt_mb(NF_GCM_JOB_t *jobs, size_t count)
+{
+    return gcm_mb(jobs, count, 0);
+}
+
+/*
+ * nf_gcm_tag_equal:
+ *   Compares two tags without an early exit.
+ */
+int nf_gcm_tag_equal(const uint8_t *a, const uint8_t *b)
+{
+    uint8_t diff = 0;
+
+    for (size_t i = 0; i < NF_GCM_TAG_SIZE; i++)
+        diff |= (uint8_t)(a[i] ^ b[i]);
+    return diff == 0;
+}
@@ -0,0 +1,90 @@
+/*
+ * nf_mpmc.cpp: Bounded lock-free MPMC ring of pointers. See nf_mpmc.h.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include "nf_mpmc.h"
+
+int nf_mpmc_init(NF_MPMC_t *r, size_t capacity)
+{
+    size_t n = 2;
+
+    while (n < capacity)
+        n <<= 1;
+    r->cells = (struct nf_mpmc_cell *) malloc(n * sizeof(*r->cells));
+    if (!r->cells)
+        return -1;
+    for (size_t i = 0; i < n; i++)
+        r->cells[i].seq = i;
+    r->mask = n - 1;
+    r->head = 0;
+    r->tail = 0;
+    return 0;
+}
+
+void nf_mpmc_free(NF_MPMC_t *r)
+{
+    free(r->cells);
+    r->cells = NULL;
+}
+
+int nf_mpmc_put(NF_MPMC_t *r, void *item)
+{
+    size_t pos = nf_atomic_load_relaxed(&r->head);
+
+    for (;;) {
+        struct nf_mpmc_cell *cell = &r->cells[pos & r->mask];
+        size_t seq = nf_atomic_load(&cell->seq);
+        intptr_t diff = (intptr_t) seq - (intptr_t) pos;
+
+        if (diff == 0) {
+            /* The cell is free for this lap: claim it */
+            if (__atomic_compare_exchange_n(&r->head, &pos, pos + 1, 1,
+                                            __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                cell->item = item;
+                nf_atomic_store(&cell->seq, pos + 1);
+                return 1;
+            }
+        } else if (diff < 0) {
+            return 0;   /* Still holds the item of the previous lap */
+        } else {
+            pos = nf_atomic_load_relaxed(&r->head);
+        }
+    }
+}
+
+void *nf_mpmc_take(NF_MPMC_t *r)
+{
+    size_t pos = nf_atomic_load_relaxed(&r->tail);
+
+    for (;;) {
+        struct nf_mpmc_cell *cell = &r->cells[pos & r->mask];
+        size_t seq = nf_atomic_load(&cell->seq);
+        intptr_t diff = (intptr_t) seq - (intptr_t) (pos + 1);
+
+        if (diff == 0) {
+            /* The cell holds the item of this lap: take it */
+            if (__atomic_compare_exchange_n(&r->tail, &pos, pos + 1, 1,
+                                            __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                void *item = cell->item;
+
+                /* Free the cell for the next lap */
+                nf_atomic_store(&cell->seq, pos + r->mask + 1);
+                return item;
+            }
+        } else if (diff < 0) {
+            return NULL;    /* Not put yet */
+        } else {
+            pos = nf_atomic_load_relaxed(&r->tail);
+        }
+    }
+}
+
+size_t nf_mpmc_size(const NF_MPMC_t *r)
+{
+    size_t head = nf_atomic_load_relaxed(&r->head);
+    size_t tail = nf_atomic_load_relaxed(&r->tail);
+
+    return head > tail ? head - tail : 0;
+}
@@ -0,0 +1,115 @@
+/*
+ * Gcm.cpp: Compares the GCM implementations available to the enclave.
+ */
+
+#include "../Enclave.h"
+#include "Enclave_t.h"
+
+#include "sgx_tcrypto.h"
+#include "nf_gcm.h"
+
+static const uint8_t bench_key[NF_GCM_KEY_SIZE] = {
+    0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07,
+    0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f
+};
+static const uint8_t bench_iv[NF_GCM_IV_SIZE] = {0};
+
+/* Pages per nf_gcm_*_mb call of GCM_BENCH_NF_MB, within a trusted budget */
+#define GCM_BENCH_BATCH 64
+#define GCM_BENCH_BATCH_BYTES (1u << 20)
+
+/* Decrypts and re-encrypts count pages of size bytes as one batch */
+static sgx_status_t gcm_bench_batch(const NF_GCM_KEY_t *key, uint8_t *page, uint8_t *cipher,
+                                    uint8_t *tags, size_t size, size_t count)
+{
+    NF_GCM_JOB_t jobs[GCM_BENCH_BATCH];
+
+    for (size_t j = 0; j < count; j++) {
+        jobs[j].key = key;
+        jobs[j].iv = bench_iv;
+        jobs[j].src = cipher + j * size;
+        jobs[j].len = size;
+        jobs[j].dst = page + j * size;
+        jobs[j].tag = tags + j * NF_GCM_TAG_SIZE;
+    }
+    if (nf_gcm_decrypt_mb(jobs, count))
+        return SGX_ERROR_MAC_MISMATCH;
+
+    for (size_t j = 0; j < count; j++) {
+        jobs[j].src = page + j * size;
+        jobs[j].dst = cipher + j * size;
+    }
+    nf_gcm_encrypt_mb(jobs, count);
+    return SGX_SUCCESS;
+}
+
+/*
+ * ecall_gcm_benchmark:
+ *   Runs iterations times what an NF ECALL does around the NF: decrypt and
+ *   verify a page, then encrypt it again. The host times the call.
+ *   GCM_BENCH_NF_MB handles up to GCM_BENCH_BATCH pages at a time.
+ */
+sgx_status_t ecall_gcm_benchmark(int engine, size_t size, size_t iterations)
+{
+    sgx_status_t ret = SGX_SUCCESS;
+    uint8_t tag[GCM_BENCH_BATCH * NF_GCM_TAG_SIZE];
+    size_t batch = engine == GCM_BENCH_NF_MB ? GCM_BENCH_BATCH : 1;
+    uint8_t *page, *cipher;
+    NF_GCM_KEY_t key;
+
+    if (engine < 0 || engine >= GCM_BENCH_ENGINES || size > UINT32_MAX)
+        return SGX_ERROR_INVALID_PARAMETER;
+    while (batch > 1 && batch * size > GCM_BENCH_BATCH_BYTES)
+        batch /= 2;
+
+    page = (uint8_t *) calloc(batch, size ? size : 1);
+    cipher = (uint8_t *) malloc(batch * (size ? size : 1));
+    if (!page || !cipher) {
+        free(page);
+        free(cipher);
+        return SGX_ERROR_OUT_OF_MEMORY;
+    }
+
+    nf_gcm_key_init(&key, bench_key);
+    for (size_t j = 0; j < batch; j++)
+        nf_gcm_encrypt(&key, bench_iv, page + j * size, size, cipher + j * size,
+                       tag + j * NF_GCM_TAG_SIZE);
+
+    for (size_t i = 0; i < iterations && ret == SGX_SUCCESS; i += batch) {
+        switch (engine) {
+        case GCM_BENCH_SDK:
+            ret = sgx_rijndael128GCM_decrypt((const sgx_aes_gcm_128bit_key_t *) bench_key,
+                    cipher, (uint32_t) size, page, bench_iv, NF_GCM_IV_SIZE, NULL, 0,
+                    (const sgx_aes_gcm_128bit_tag_t *) tag);
+            if (ret == SGX_SUCCESS)
+                ret = sgx_rijndael128GCM_encrypt((const sgx_aes_gcm_128bit_key_t *) bench_key,
+                        page, (uint32_t) size, cipher, bench_iv, NF_GCM_IV_SIZE, NULL, 0,
+                        (sgx_aes_gcm_128bit_tag_t *) tag);
+            break;
+
+        case GCM_BENCH_NF_COLD:
+            nf_gcm_key_init(&key, bench_key);
+            if (nf_gcm_decrypt(&key, bench_iv, cipher, size, page, tag))
+                ret = SGX_ERROR_MAC_MISMATCH;
+            nf_gcm_key_init(&key, bench_key);
+            nf_gcm_encrypt(&key, bench_iv, page, size, cipher, tag);
+            break;
+
+        case GCM_BENCH_NF_SESSION:
+            if (nf_gcm_decrypt(&key, bench_iv, cipher, size, page, tag))
+                ret = SGX_ERROR_MAC_MISMATCH;
+            nf_gcm_encrypt(&key, bench_iv, page, size, cipher, tag);
+            break;
+
+        case GCM_BENCH_NF_MB:
+            ret = gcm_bench_batch(&key, page, cipher, tag, size,
+                                  iterations - i < batch ? iterations - i : batch);
+            break;
+        }
+    }
+
+    nf_gcm_key_clear(&key);
+    free(page);
+    free(cipher);
+    return ret;
+}
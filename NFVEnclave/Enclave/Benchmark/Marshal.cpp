@@ -0,0 +1,93 @@
+/*
+ * Marshal.cpp: Cost of the pointer attributes of ECALLs and OCALLs.
+ *
+ * The ECALLs take their buffer and return: what they cost is the
+ * transition and the work of the edge routines, which is what the
+ * benchmark measures.
+ */
+
+#include "../Enclave.h"
+#include "Enclave_t.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "sgx_trts.h"
+
+sgx_status_t ecall_marshal_in(const uint8_t *buf, size_t len)
+{
+    (void) buf;
+    (void) len;
+    return SGX_SUCCESS;
+}
+
+sgx_status_t ecall_marshal_out(uint8_t *buf, size_t len)
+{
+    (void) buf;
+    (void) len;
+    return SGX_SUCCESS;
+}
+
+sgx_status_t ecall_marshal_in_out(uint8_t *buf, size_t len)
+{
+    (void) buf;
+    (void) len;
+    return SGX_SUCCESS;
+}
+
+/* The check every [user_check] NF ECALL makes before it reads the buffer */
+sgx_status_t ecall_marshal_user_check(uint8_t *buf, size_t len)
+{
+    if (!buf || !sgx_is_outside_enclave(buf, len))
+        return SGX_ERROR_INVALID_PARAMETER;
+    return SGX_SUCCESS;
+}
+
+sgx_status_t ecall_marshal_count(const uint64_t *buf, size_t n)
+{
+    (void) buf;
+    (void) n;
+    return SGX_SUCCESS;
+}
+
+sgx_status_t ecall_marshal_ocalls(int attr, size_t len, size_t iterations, uint8_t *host)
+{
+    sgx_status_t ret = SGX_SUCCESS;
+    uint8_t *buf;
+
+    if (attr < 0 || attr >= MARSHAL_BENCH_ATTRS || len == 0)
+        return SGX_ERROR_INVALID_PARAMETER;
+    if (attr == MARSHAL_BENCH_USER_CHECK) {
+        if (!host || !sgx_is_outside_enclave(host, len))
+            return SGX_ERROR_INVALID_PARAMETER;
+        buf = host;
+    } else {
+        if ((buf = (uint8_t *) malloc(len)) == NULL)
+            return SGX_ERROR_OUT_OF_MEMORY;
+        memset(buf, 0xa5, len);
+    }
+
+    for (size_t i = 0; i < iterations && ret == SGX_SUCCESS; i++) {
+        switch (attr) {
+        case MARSHAL_BENCH_IN:
+            ret = ocall_marshal_in(buf, len);
+            break;
+        case MARSHAL_BENCH_OUT:
+            ret = ocall_marshal_out(buf, len);
+            break;
+        case MARSHAL_BENCH_IN_OUT:
+            ret = ocall_marshal_in_out(buf, len);
+            break;
+        case MARSHAL_BENCH_USER_CHECK:
+            ret = ocall_marshal_user_check(buf, len);
+            break;
+        case MARSHAL_BENCH_COUNT:
+            ret = ocall_marshal_count((const uint64_t *) buf, len / sizeof(uint64_t));
+            break;
+        }
+    }
+
+    if (buf != host)
+        free(buf);
+    return ret;
+}
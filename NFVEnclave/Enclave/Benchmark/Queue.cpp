@@ -0,0 +1,177 @@
+/*
+ * Queue.cpp: Lock-free work queue and counter against mutexes and condvars.
+ *
+ * The baseline is the design of the SDK's thread sample: a ring of items
+ * guarded by a mutex, with a condition variable for each of "not full"
+ * and "not empty". Every push and pop takes the mutex, and a thread that
+ * finds the ring full or empty waits on a condvar, which leaves the
+ * enclave. NF_QUEUE_t spins first and only parks when that fails.
+ */
+
+#include "../Enclave.h"
+#include "Enclave_t.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include "sgx_thread.h"
+#include "nf_atomic.h"
+#include "nf_queue.h"
+
+typedef struct {
+    uintptr_t *buf;
+    size_t capacity;
+    size_t occupied;
+    size_t nextin;
+    size_t nextout;
+    size_t waits;
+    sgx_thread_mutex_t mutex;
+    sgx_thread_cond_t more;
+    sgx_thread_cond_t less;
+} cond_buffer_t;
+
+static int bench_design = -1;
+static cond_buffer_t bench_cond = {NULL, 0, 0, 0, 0, 0,
+    SGX_THREAD_MUTEX_INITIALIZER, SGX_THREAD_COND_INITIALIZER, SGX_THREAD_COND_INITIALIZER};
+static NF_QUEUE_t bench_queue;
+
+static volatile size_t bench_counter = 0;
+static sgx_thread_mutex_t bench_counter_mutex = SGX_THREAD_MUTEX_INITIALIZER;
+
+static void cond_buffer_push(cond_buffer_t *b, uintptr_t item)
+{
+    sgx_thread_mutex_lock(&b->mutex);
+    while (b->occupied >= b->capacity) {
+        b->waits++;
+        sgx_thread_cond_wait(&b->less, &b->mutex);
+    }
+    b->buf[b->nextin] = item;
+    b->nextin = (b->nextin + 1) % b->capacity;
+    b->occupied++;
+    sgx_thread_cond_signal(&b->more);
+    sgx_thread_mutex_unlock(&b->mutex);
+}
+
+static uintptr_t cond_buffer_pop(cond_buffer_t *b)
+{
+    uintptr_t item;
+
+    sgx_thread_mutex_lock(&b->mutex);
+    while (b->occupied == 0) {
+        b->waits++;
+        sgx_thread_cond_wait(&b->more, &b->mutex);
+    }
+    item = b->buf[b->nextout];
+    b->nextout = (b->nextout + 1) % b->capacity;
+    b->occupied--;
+    sgx_thread_cond_signal(&b->less);
+    sgx_thread_mutex_unlock(&b->mutex);
+    return item;
+}
+
+sgx_status_t ecall_queue_bench_init(int design, size_t capacity)
+{
+    if (bench_design != -1 || capacity == 0 || capacity > ((size_t) 1 << 20))
+        return SGX_ERROR_INVALID_PARAMETER;
+
+    switch (design) {
+    case QUEUE_BENCH_COND:
+        bench_cond.buf = (uintptr_t *) malloc(capacity * sizeof(uintptr_t));
+        if (!bench_cond.buf)
+            return SGX_ERROR_OUT_OF_MEMORY;
+        bench_cond.capacity = capacity;
+        bench_cond.occupied = bench_cond.nextin = bench_cond.nextout = 0;
+        bench_cond.waits = 0;
+        break;
+    case QUEUE_BENCH_LOCKFREE: {
+        sgx_status_t ret = nf_queue_init(&bench_queue, capacity);
+        if (ret != SGX_SUCCESS)
+            return ret;
+        break;
+    }
+    default:
+        return SGX_ERROR_INVALID_PARAMETER;
+    }
+    bench_design = design;
+    return SGX_SUCCESS;
+}
+
+sgx_status_t ecall_queue_bench_produce(size_t items)
+{
+    for (size_t i = 1; i <= items; i++) {
+        switch (bench_design) {
+        case QUEUE_BENCH_COND:
+            cond_buffer_push(&bench_cond, i);
+            break;
+        case QUEUE_BENCH_LOCKFREE:
+            if (!nf_queue_push(&bench_queue, (void *) i))
+                return SGX_ERROR_UNEXPECTED;
+            break;
+        default:
+            return SGX_ERROR_INVALID_STATE;
+        }
+    }
+    return SGX_SUCCESS;
+}
+
+sgx_status_t ecall_queue_bench_consume(size_t items, uint64_t *sum)
+{
+    uint64_t total = 0;
+
+    for (size_t i = 0; i < items; i++) {
+        switch (bench_design) {
+        case QUEUE_BENCH_COND:
+            total += cond_buffer_pop(&bench_cond);
+            break;
+        case QUEUE_BENCH_LOCKFREE: {
+            void *item = nf_queue_pop(&bench_queue);
+            if (!item)
+                return SGX_ERROR_UNEXPECTED;
+            total += (uintptr_t) item;
+            break;
+        }
+        default:
+            return SGX_ERROR_INVALID_STATE;
+        }
+    }
+    *sum = total;
+    return SGX_SUCCESS;
+}
+
+/* Only once every produce and consume of the run has returned */
+sgx_status_t ecall_queue_bench_fini(size_t *parks)
+{
+    switch (bench_design) {
+    case QUEUE_BENCH_COND:
+        *parks = bench_cond.waits;
+        free(bench_cond.buf);
+        bench_cond.buf = NULL;
+        break;
+    case QUEUE_BENCH_LOCKFREE:
+        *parks = bench_queue.parks;
+        nf_queue_free(&bench_queue);
+        break;
+    default:
+        return SGX_ERROR_INVALID_STATE;
+    }
+    bench_design = -1;
+    return SGX_SUCCESS;
+}
+
+sgx_status_t ecall_counter_bench(int design, size_t increments)
+{
+    switch (design) {
+    case COUNTER_BENCH_MUTEX:
+        for (size_t i = 0; i < increments; i++) {
+            sgx_thread_mutex_lock(&bench_counter_mutex);
+            bench_counter++;
+            sgx_thread_mutex_unlock(&bench_counter_mutex);
+        }
+        return SGX_SUCCESS;
+    case COUNTER_BENCH_ATOMIC:
+        for (size_t i = 0; i < increments; i++)
+            nf_atomic_add_relaxed(&bench_counter, 1);
+        return SGX_SUCCESS;
+    default:
+        return SGX_ERROR_INVALID_PARAMETER;
+    }
+}
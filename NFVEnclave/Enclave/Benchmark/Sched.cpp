@@ -0,0 +1,180 @@
+/*
+ * Sched.cpp: Chunk-parallel NF kernels on the work-stealing scheduler.
+ *
+ * The buffer stands for one big page, cut into chunks of grain bytes. The
+ * scan counts the IDS signature at every position of a chunk, reading up
+ * to signature_len - 1 bytes into the next one, so a signature across a
+ * chunk boundary is found exactly once; some are planted across the
+ * boundaries on purpose. The compression runs smaz over each chunk into
+ * its own region of the output, and the regions are hashed in chunk
+ * order, as an NF would emit them. The serial run is the same kernel in a
+ * plain loop over the chunks, so both runs must agree.
+ */
+
+#include "../Enclave.h"
+#include "Enclave_t.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "nf_kernels.h"
+#include "nf_sched.h"
+#include "nf_stream.h"
+
+/* A signature every SCHED_BENCH_PLANT bytes, straddling the boundary */
+#define SCHED_BENCH_PLANT (64 * 1024)
+
+int smaz_compress(char *in, int inlen, char *out, int outlen);
+
+static const char *sched_bench_words[] = {
+    "the", "network", "function", "enclave", "page", "of", "and", "script",
+    "a", "header", "<div>", "</div>", "to", "content", "in", "http"
+};
+#define SCHED_BENCH_WORDS (sizeof(sched_bench_words) / sizeof(sched_bench_words[0]))
+
+static struct {
+    uint8_t *text;
+    size_t size;
+    size_t grain;
+    size_t chunks;
+    uint64_t *counts;   /* Per chunk: signatures found */
+    uint8_t *packed;    /* Per chunk: NF_SMAZ_BOUND(grain) bytes */
+    size_t *packed_len;
+    int failed;
+} bench = {NULL, 0, 0, 0, NULL, NULL, NULL, 0};
+
+static const char sched_bench_signature[] = NF_IDS_SIGNATURE;
+
+static void sched_bench_scan(size_t lo, size_t hi, void *arg)
+{
+    size_t len = sizeof(sched_bench_signature) - 1;
+    uint64_t found = 0;
+
+    (void) arg;
+    for (size_t i = lo; i < hi && i + len <= bench.size; i++) {
+        const uint8_t *p = (const uint8_t *) memchr(bench.text + i, sched_bench_signature[0], hi - i);
+
+        if (!p)
+            break;
+        i = (size_t) (p - bench.text);
+        if (i + len <= bench.size && memcmp(p, sched_bench_signature, len) == 0)
+            found++;
+    }
+    bench.counts[lo / bench.grain] = found;
+}
+
+static void sched_bench_compress(size_t lo, size_t hi, void *arg)
+{
+    size_t k = lo / bench.grain;
+    size_t cap = NF_SMAZ_BOUND(bench.grain);
+    int n;
+
+    (void) arg;
+    n = smaz_compress((char *) bench.text + lo, (int) (hi - lo),
+                      (char *) bench.packed + k * cap, (int) cap);
+    if (n < 0 || (size_t) n > cap)
+        bench.failed = 1;
+    bench.packed_len[k] = (size_t) n;
+}
+
+sgx_status_t ecall_sched_bench_init(size_t size, size_t grain)
+{
+    uint32_t seed = 1;
+    size_t off = 0;
+
+    if (bench.text || size == 0 || size > ((size_t) 256 << 20) ||
+        grain == 0 || grain > NF_TILE_SIZE)
+        return SGX_ERROR_INVALID_PARAMETER;
+
+    bench.chunks = (size + grain - 1) / grain;
+    bench.text = (uint8_t *) malloc(size);
+    bench.counts = (uint64_t *) calloc(bench.chunks, sizeof(uint64_t));
+    bench.packed = (uint8_t *) malloc(bench.chunks * NF_SMAZ_BOUND(grain));
+    bench.packed_len = (size_t *) calloc(bench.chunks, sizeof(size_t));
+    bench.size = size;
+    bench.grain = grain;
+    bench.failed = 0;
+    if (!bench.text || !bench.counts || !bench.packed || !bench.packed_len) {
+        ecall_sched_bench_fini();
+        return SGX_ERROR_OUT_OF_MEMORY;
+    }
+
+    while (off < size) {
+        const char *w;
+        size_t n;
+
+        seed ^= seed << 13;
+        seed ^= seed >> 17;
+        seed ^= seed << 5;
+        w = sched_bench_words[seed % SCHED_BENCH_WORDS];
+        n = strlen(w);
+        if (n > size - off)
+            n = size - off;
+        memcpy(bench.text + off, w, n);
+        off += n;
+        if (off < size)
+            bench.text[off++] = ' ';
+    }
+    for (off = SCHED_BENCH_PLANT; off + sizeof(sched_bench_signature) < size;
+         off += SCHED_BENCH_PLANT)
+        memcpy(bench.text + off - 8, sched_bench_signature, sizeof(sched_bench_signature) - 1);
+    return SGX_SUCCESS;
+}
+
+sgx_status_t ecall_sched_bench_run(int kernel, int parallel, uint64_t *result)
+{
+    nf_sched_fn_t fn;
+    uint64_t r = 0;
+
+    if (!bench.text)
+        return SGX_ERROR_INVALID_STATE;
+    switch (kernel) {
+    case SCHED_BENCH_SCAN:
+        fn = sched_bench_scan;
+        break;
+    case SCHED_BENCH_COMPRESS:
+        fn = sched_bench_compress;
+        break;
+    default:
+        return SGX_ERROR_INVALID_PARAMETER;
+    }
+
+    if (parallel) {
+        nf_parallel_for(0, bench.size, bench.grain, fn, NULL);
+    } else {
+        for (size_t lo = 0; lo < bench.size; lo += bench.grain)
+            fn(lo, bench.size - lo > bench.grain ? lo + bench.grain : bench.size, NULL);
+    }
+    if (bench.failed)
+        return SGX_ERROR_UNEXPECTED;
+
+    if (kernel == SCHED_BENCH_SCAN) {
+        for (size_t k = 0; k < bench.chunks; k++)
+            r += bench.counts[k];
+    } else {
+        /* FNV-1a over the chunks in order, lengths included */
+        r = 14695981039346656037ULL;
+        for (size_t k = 0; k < bench.chunks; k++) {
+            const uint8_t *p = bench.packed + k * NF_SMAZ_BOUND(bench.grain);
+
+            r = (r ^ bench.packed_len[k]) * 1099511628211ULL;
+            for (size_t i = 0; i < bench.packed_len[k]; i++)
+                r = (r ^ p[i]) * 1099511628211ULL;
+        }
+    }
+    *result = r;
+    return SGX_SUCCESS;
+}
+
+sgx_status_t ecall_sched_bench_fini(void)
+{
+    free(bench.text);
+    free(bench.counts);
+    free(bench.packed);
+    free(bench.packed_len);
+    bench.text = NULL;
+    bench.counts = NULL;
+    bench.packed = NULL;
+    bench.packed_len = NULL;
+    return SGX_SUCCESS;
+}
@@ -0,0 +1,16 @@
+/*
+ * Switchless.cpp: Regular against switchless transitions.
+ */
+
+#include "../Enclave.h"
+#include "Enclave_t.h"
+
+sgx_status_t ecall_print_benchmark(size_t iterations)
+{
+    for (size_t i = 0; i < iterations; i++) {
+        sgx_status_t ret = ocall_print_string("");
+        if (ret != SGX_SUCCESS)
+            return ret;
+    }
+    return SGX_SUCCESS;
+}
@@ -48,6 +48,10 @@
 // Needed to query extended epid group id.
 #include "sgx_uae_service.h"
 #include "ahocorasick.h"
+#include "nf_kernels.h"
+#include "nf_ruleset.h"
+#include "nf_session.h"
+#include "nf_sched.h"
 //#include "service_provider.h"
 //#include "sample_messages.h"
 //#include "sample_libcrypto.h"
@@ -78,69 +82,19 @@ int printf(const char* fmt, ...)
 #define PATTERN(p,r)    {{p,strlen(p)},{r,strlen(r)},{{0},AC_PATTID_TYPE_DEFAULT}}
 #define CHUNK(c)        {c,strlen(c)}
 
-void generate_patterns(AC_TRIE_t * trie_l){
-    char badwords[] = "carpet muncher|cawk|chink|cipa|cl1t|clit|clitoris|coksucka|coon|cox|crap|beastial|clits|cnut|cock|cock-sucker|cockface|cockhead|cockmuncher|cocks|cocksucks|cocksuka|cocksukka|cok|cokmuncher|cum|cummer|cumming|cums|cumshot|cunilingus|cunillingus|cunnilingus|cunt|cuntlicker|cuntlick|cocksuck|cocksucked|cocksucker|cocksucking|cockmunch|blowjob|bitchin|bitcher|bitch|bestial|asshole||cuntlicking|cunts|cyalis|cyberfuc|cyberfuck|cyberfucked|cyberfucker|cyberfuckers|cyberfucking|d1ck|damn|dick|dickhead|dildo|dildos|dink|dinks|dirsa|dlck|dog-fucker|doggin|dogging|donkeyribber|doosh|duche|dyke|ejaculate|ejaculated|ejaculates|ejaculating|ejaculatings|ejaculation|ejakulate|f u c k|f u c k e r|f4nny|fag|fagging|faggitt|faggot|faggs|fagot|fagots|fags|fanny|fannyflaps|fannyfucker|fanyy|fatass|fcuk|fcuker|fcuking|feck|fecker|felching|fellate|fellatio|fingerfuck|fingerfucked|fingerfucker|fingerfuckers|fingerfucking|fingerfucks|fistfuck|fistfucked|fistfucker|fistfuckers|fistfucking|fistfuckings|fistfucks|flange|fook|fooker|fuck|fucka|fucked|fucker|fuckers|fuckhead|fuckheads|fuckin|fucking|fuckings|fuckingshitmotherfucker|fuckme|fucks|fuckwhit|fuckwit|fudge packer|fudgepacker|fuk|fuker|fukker|fukkin|fuks|fukwhit|fukwit|fux|fux0r|f_u_c_k|gangbang|gangbanged|gangbangs|gaylord|gaysex|goatse|God|god-dam|god-damned|goddamn|goddamned|hardcoresex|hell|heshe|hoar|hoare|hoer|homo|hore|horniest|horny|hotsex|jack-off|jackoff|jap|jerk-off|jism|jiz|jizm|jizz|kawk|knob|knobead|knobed|knobend|knobhead|knobjocky|knobjokey|kock|kondum|kondums|kum|kummer|kumming|kums|kunilingus|l3itch|labia|lust|lusting|m0f0|m0fo|m45terbate|ma5terb8|ma5terbate|masochist|master-bate|masterb8|masterbat*|masterbat3|masterbate|masterbation|masterbations|masturbate|mo-fo|mof0|mofo|mothafuck|mothafucka|mothafuckas|mothafuckaz|mothafucked|mothafucker|mothafuckers|mothafuckin|mothafucking|mothafuckings|mothafucks|mother fucker|motherfuck|motherfucked|motherfucker|motherfuckers|motherfuckin|motherfucking|motherfuckings|motherfuckka|motherfucks|muff|mutha|muthafecker|muthafuckker|muther|mutherfucker|n1gga|n1gger|nazi|nigg3r|nigg4h|nigga|niggah|niggas|niggaz|nigger|niggers|nob|nob jokey|nobhead|nobjocky|nobjokey|numbnuts|nutsack|orgasim|orgasims|orgasm|orgasms|p0rn|pawn|pecker|penis|penisfucker|phonesex|phuck|phuk|phuked|phuking|phukked|phukking|phuks|phuq|pigfucker|pimpis|piss|pissed|pisser|pissers|pisses|pissflaps|pissin|pissing|pissoff|poop|porn|porno|pornography|pornos|prick|pricks|pron|pube|pusse|pussi|pussies|pussy|pussys|rectum|retard|rimjaw|rimming|s hit|s.o.b.|sadist|schlong|screwing|scroat|scrote|scrotum|semen|sex|sh!t|sh1t|shag|shagger|shaggin|shagging|shemale|shit|shitdick|shite|shited|shitey|shitfuck|shitfull|shithead|shiting|shitings|shits|shitted|shitter|shitters|shitting|shittings|shitty|skank|slut|sluts|smegma|smut|snatch|son-of-a-bitch|spac|spunk|s_h_i_t|t1tt1e5|t1tties|teets|teez|testical|testicle|tit|titfuck|tits|titt|tittie5|tittiefucker|titties|tittyfuck|tittywank|titwank|tosser|turd|tw4t|twat|twathead|twatty|twunt|twunter|v14gra|v1gra|vagina|viagra|vulva|w00se|wang|wank|wanker|wanky|whoar|whore|willies|willy|xrated|xxx|locale|padding|html|css|com|cdn|google|com|cdn|google|locale|padding|html|arrse|arse|ass|ass-fucker|assfucker|assfukka|assholes|asswhole|a_s_s|b!tch|b00bs|b17ch|b1tch|ballbag|balls|ballsack|bastard|beastiality|bellend|bestiality|bitch|biatch|bitchers|bitches|bitching|bloody|blow job|blowjobs|boiolas|bollock|bollok|boner|boob|boobs|booobs|boooobs|booooobs|booooooobs|breasts|buceta|bugger|bum|bunny fucker|butt|butthole|buttmuch|buttplug|c0ck|c0cksucker";
-//    char badwords[] = "";
-    const char * delim = "|";
-    char *p;
-//    std::map<int, std::string> badwords_map;
-    vector<char*> badwords_vec;
-    /* 将badwords读入到字典中 */
-    p = strtok(badwords, delim);
-    int count = 1;
-    while(p){
-//        printf("%s\n",p);
-        badwords_vec.push_back(p);
-        count++;
-        p = strtok(NULL, delim);
-    }
-    int loop_invarient = 1;
-    while (count>loop_invarient){
-        loop_invarient = loop_invarient *2;
-    }
-    int additional = loop_invarient - count;
-    vector<char*> badwords_vec_fake;
-    while(additional){
-//        printf("%s\n",p);
-        char *q = "locale";
-        badwords_vec_fake.push_back(q);
-        additional--;
-        q = strtok(NULL, delim);
-    }
-    if (p)
-    {
-        AC_PATTERN_t patterns[badwords_vec.size()];
-    }else{
-        AC_PATTERN_t patterns_fake[badwords_vec.size()];
-    }
-    count = 1;
-    for(vector<char*>::iterator iter = badwords_vec.begin(); iter != badwords_vec.end(); iter++)
-    {
-        count++;
-        AC_PATTERN_t pattern = PATTERN(*iter,"");
-        ac_trie_add(trie_l, &pattern , 0);
-    }
-    loop_invarient = 1;
-    while (count>loop_invarient){
-        loop_invarient = loop_invarient *2;
-    }
-    additional = loop_invarient - count;
-}
+/* Patterns used until the host provisions a ruleset, see nf_ruleset.h */
+const char nf_badword_default_rules[] = "carpet muncher|cawk|chink|cipa|cl1t|clit|clitoris|coksucka|coon|cox|crap|beastial|clits|cnut|cock|cock-sucker|cockface|cockhead|cockmuncher|cocks|cocksucks|cocksuka|cocksukka|cok|cokmuncher|cum|cummer|cumming|cums|cumshot|cunilingus|cunillingus|cunnilingus|cunt|cuntlicker|cuntlick|cocksuck|cocksucked|cocksucker|cocksucking|cockmunch|blowjob|bitchin|bitcher|bitch|bestial|asshole||cuntlicking|cunts|cyalis|cyberfuc|cyberfuck|cyberfucked|cyberfucker|cyberfuckers|cyberfucking|d1ck|damn|dick|dickhead|dildo|dildos|dink|dinks|dirsa|dlck|dog-fucker|doggin|dogging|donkeyribber|doosh|duche|dyke|ejaculate|ejaculated|ejaculates|ejaculating|ejaculatings|ejaculation|ejakulate|f u c k|f u c k e r|f4nny|fag|fagging|faggitt|faggot|faggs|fagot|fagots|fags|fanny|fannyflaps|fannyfucker|fanyy|fatass|fcuk|fcuker|fcuking|feck|fecker|felching|fellate|fellatio|fingerfuck|fingerfucked|fingerfucker|fingerfuckers|fingerfucking|fingerfucks|fistfuck|fistfucked|fistfucker|fistfuckers|fistfucking|fistfuckings|fistfucks|flange|fook|fooker|fuck|fucka|fucked|fucker|fuckers|fuckhead|fuckheads|fuckin|fucking|fuckings|fuckingshitmotherfucker|fuckme|fucks|fuckwhit|fuckwit|fudge packer|fudgepacker|fuk|fuker|fukker|fukkin|fuks|fukwhit|fukwit|fux|fux0r|f_u_c_k|gangbang|gangbanged|gangbangs|gaylord|gaysex|goatse|God|god-dam|god-damned|goddamn|goddamned|hardcoresex|hell|heshe|hoar|hoare|hoer|homo|hore|horniest|horny|hotsex|jack-off|jackoff|jap|jerk-off|jism|jiz|jizm|jizz|kawk|knob|knobead|knobed|knobend|knobhead|knobjocky|knobjokey|kock|kondum|kondums|kum|kummer|kumming|kums|kunilingus|l3itch|labia|lust|lusting|m0f0|m0fo|m45terbate|ma5terb8|ma5terbate|masochist|master-bate|masterb8|masterbat*|masterbat3|masterbate|masterbation|masterbations|masturbate|mo-fo|mof0|mofo|mothafuck|mothafucka|mothafuckas|mothafuckaz|mothafucked|mothafucker|mothafuckers|mothafuckin|mothafucking|mothafuckings|mothafucks|mother fucker|motherfuck|motherfucked|motherfucker|motherfuckers|motherfuckin|motherfucking|motherfuckings|motherfuckka|motherfucks|muff|mutha|muthafecker|muthafuckker|muther|mutherfucker|n1gga|n1gger|nazi|nigg3r|nigg4h|nigga|niggah|niggas|niggaz|nigger|niggers|nob|nob jokey|nobhead|nobjocky|nobjokey|numbnuts|nutsack|orgasim|orgasims|orgasm|orgasms|p0rn|pawn|pecker|penis|penisfucker|phonesex|phuck|phuk|phuked|phuking|phukked|phukking|phuks|phuq|pigfucker|pimpis|piss|pissed|pisser|pissers|pisses|pissflaps|pissin|pissing|pissoff|poop|porn|porno|pornography|pornos|prick|pricks|pron|pube|pusse|pussi|pussies|pussy|pussys|rectum|retard|rimjaw|rimming|s hit|s.o.b.|sadist|schlong|screwing|scroat|scrote|scrotum|semen|sex|sh!t|sh1t|shag|shagger|shaggin|shagging|shemale|shit|shitdick|shite|shited|shitey|shitfuck|shitfull|shithead|shiting|shitings|shits|shitted|shitter|shitters|shitting|shittings|shitty|skank|slut|sluts|smegma|smut|snatch|son-of-a-bitch|spac|spunk|s_h_i_t|t1tt1e5|t1tties|teets|teez|testical|testicle|tit|titfuck|tits|titt|tittie5|tittiefucker|titties|tittyfuck|tittywank|titwank|tosser|turd|tw4t|twat|twathead|twatty|twunt|twunter|v14gra|v1gra|vagina|viagra|vulva|w00se|wang|wank|wanker|wanky|whoar|whore|willies|willy|xrated|xxx|locale|padding|html|css|com|cdn|google|com|cdn|google|locale|padding|html|arrse|arse|ass|ass-fucker|assfucker|assfukka|assholes|asswhole|a_s_s|b!tch|b00bs|b17ch|b1tch|ballbag|balls|ballsack|bastard|beastiality|bellend|bestiality|bitch|biatch|bitchers|bitches|bitching|bloody|blow job|blowjobs|boiolas|bollock|bollok|boner|boob|boobs|booobs|boooobs|booooobs|booooooobs|breasts|buceta|bugger|bum|bunny fucker|butt|butthole|buttmuch|buttplug|c0ck|c0cksucker";
 
 
 /* Define a call-back function of type MF_REPLACE_CALBACK_f */
-void listener (AC_TEXT_t *text, void* len)
+void listener (AC_TEXT_t *text, void* param)
 {
-    int ret = 0;
-//    printf("Length:%d",(int)text->length);
-    int i = 1;
-//    int invariant = 0;
-    while (i<(int)text->length){
-//        invariant = invariant + 1;
-        i = i * 2;
-    }
-//    new_length = (int)text->length;
-    *(int*)len = i;
+    NF_BADWORD_STATE_t *s = (NF_BADWORD_STATE_t *) param;
+
+    if (s->status != SGX_SUCCESS || !text->length)
+        return;
+    s->status = s->emit->cbf((const uint8_t *) text->astring, text->length, s->emit->user);
+    s->out_len += text->length;
 }
 
 void split(const string &s, vector<string>& tokens, const string& delimiters)
@@ -176,129 +130,125 @@ int get_padding_size(int count){
 //    str = std::regex_replace(str, std::regex("def"), "");
 }
 
+/*
+ * Pages from this size on are cut among the workers of nf_sched.h by the
+ * IDS and the compression, if there are workers. Such a page is decrypted
+ * and authenticated whole in trusted memory (nf_tile_run_page()).
+ */
+#define NF_LARGE_PAGE (1 << 20)
+#define NF_IDS_GRAIN (64 * 1024)        /* Scan steps of an IDS task */
+#define NF_COMPRESSION_WAVE 64          /* Chunks compressed before they are emitted */
+
+/* Whether a page of lSize bytes takes the parallel path */
+static int nf_large_page(size_t lSize)
+{
+    return lSize >= NF_LARGE_PAGE && nf_sched_workers() > 0;
+}
+
 uint8_t data_key[16] = {0x87, 0xA6, 0x0B, 0x39, 0xD5, 0x26, 0xAB, 0x1C, 0x30, 0x9E, 0xEC, 0x60, 0x6C, 0x72, 0xBA, 0x36};
-uint8_t aes_gcm_iv[12] = {0};
-int new_length = 1;
 
-sgx_status_t enclave_process_badword(uint8_t* cyphertext, size_t lSize,
-                                     uint8_t* en_mac, size_t* oSize,
-                                     uint8_t* encProcessedtext)
+static sgx_status_t badword_begin(void *state)
 {
-    sgx_status_t ret = SGX_SUCCESS;
-    ret = sgx_rijndael128GCM_decrypt(
-            (const sgx_ec_key_128bit_t*) data_key, //(const sgx_ec_key_128bit_t*) g_secret_DO,
-            cyphertext,
-            lSize,
-            encProcessedtext,
-            aes_gcm_iv,
-            12,
-            NULL,
-            0,
-            (const sgx_aes_gcm_128bit_tag_t*) en_mac);
-
-    AC_TEXT_t input_chunk = CHUNK((const char*)encProcessedtext);
-
-    AC_TRIE_t *trie;
-
-    /* Get a new trie */
-    trie = ac_trie_create();
-
-    /* Generate and add patterns into the trie */
-    generate_patterns(trie);
-    /* Finalize the trie */
-    ac_trie_finalize (trie);
-    /* Replace */
-    multifast_replace (trie, &input_chunk, MF_REPLACE_MODE_NORMAL, listener, &new_length);
+    NF_BADWORD_STATE_t *s = (NF_BADWORD_STATE_t *) state;
+
+    s->out_len = 0;
+    s->status = SGX_SUCCESS;
+
+    /* A finalized trie of the current ruleset, built once and reused */
+    s->trie = nf_ruleset_acquire(&s->rules);
+    if (!s->trie)
+        return SGX_ERROR_OUT_OF_MEMORY;
+    return SGX_SUCCESS;
+}
+
+static sgx_status_t badword_process(void *state, const uint8_t *data, size_t len,
+                                    NF_EMIT_t *emit)
+{
+    NF_BADWORD_STATE_t *s = (NF_BADWORD_STATE_t *) state;
+    AC_TEXT_t input_chunk = {(const AC_ALPHABET_t *) data, len};
+
+    s->emit = emit;
+    /* A badword cut by the end of the chunk stays in the trie's backlog */
+    if (multifast_replace (s->trie, &input_chunk, MF_REPLACE_MODE_NORMAL, listener, s))
+        return SGX_ERROR_UNEXPECTED;
+    /* Pass on what is decided so far, keep the replacement going */
+    multifast_rep_flush (s->trie, 1);
+    return s->status;
+}
+
+static sgx_status_t badword_finish(void *state, NF_EMIT_t *emit)
+{
+    NF_BADWORD_STATE_t *s = (NF_BADWORD_STATE_t *) state;
+    AC_TEXT_t no_chunk = {"", 0};
+
+    s->emit = emit;
+    /* Registers the listener even if the page was empty */
+    if (multifast_replace (s->trie, &no_chunk, MF_REPLACE_MODE_NORMAL, listener, s))
+        return SGX_ERROR_UNEXPECTED;
     /* Flush the buffer */
-    multifast_rep_flush (trie, 0);
-    *oSize=new_length;
-
-    uint8_t en_mac_new[16];
-    ret = sgx_rijndael128GCM_encrypt(
-            (const sgx_ec_key_128bit_t*) data_key,
-            encProcessedtext,
-            *oSize,
-            encProcessedtext, // Output
-            aes_gcm_iv,
-            12,
-            NULL,
-            0,
-            &en_mac_new); // Output
-    return ret;
-//    ac_trie_release (trie);
+    multifast_rep_flush (s->trie, 0);
+    if (s->status != SGX_SUCCESS)
+        return s->status;
+    /* Pad the filtered page to the next power of two */
+    return nf_emit_zeros(emit, get_padding_size((int)s->out_len) - s->out_len);
 }
 
+static void badword_end(void *state)
+{
+    NF_BADWORD_STATE_t *s = (NF_BADWORD_STATE_t *) state;
 
-int matching(char* webpage, char* matchString){
-    int foundMatch = 0;
-    char *p1, *p2, *p3;
-    int i=0,j=0,flag=0;
-    int page_len = strlen(webpage);
-    int match_len = strlen(matchString);
+    nf_ruleset_release(s->rules, s->trie);
+    s->trie = NULL;
+    s->rules = NULL;
+}
 
-    p1 = webpage;
-    p2 = matchString;
+const NF_KERNEL_t nf_badword_kernel = {
+    "badword", badword_begin, badword_process, badword_finish, badword_end
+};
 
-    int iter_count1 = 0;
+sgx_status_t enclave_process_badword(uint8_t* cyphertext, size_t lSize,
+                                     uint8_t* en_mac, uint8_t* in_iv, size_t* oSize,
+                                     uint8_t* encProcessedtext, size_t oCap,
+                                     uint8_t* out_mac, uint8_t* out_iv, uint64_t* out_seq)
+{
+    NF_BADWORD_STATE_t badword;
+    NF_STAGE_t stage = {&nf_badword_kernel, &badword};
+
+    if (nf_tile_check_input(cyphertext, lSize) != SGX_SUCCESS ||
+        nf_tile_check_output(encProcessedtext, oCap) != SGX_SUCCESS)
+        return SGX_ERROR_INVALID_PARAMETER;
+    badword.trie = NULL;
+    badword.rules = NULL;
+    return nf_session_default_run(&stage, 1, in_iv, cyphertext, lSize, en_mac,
+                                  encProcessedtext, oCap, oSize, out_mac, out_iv, out_seq);
+}
 
-    // 从第一位开始匹配matchString的第一位
-    for(i = 0; i<page_len; i++)
-    {
-        // 如果某一位和matchString的第一位匹配，则开始找下面的位
-        if(*p1 == *p2)
-        {
-            p3 = p1;
-            int iter_count2 = 0;
-            for(j = 0; j<match_len; j++)
-            {
-                iter_count2++;
-                if(*p3 == *p2)
-                {
-                    p3++;
-                    p2++;
-                }
-                else{
-                    p3--;
-                    p3++;
-                    break;
-                }
-            }
-            /*---------------------constant loop start------------------*/
-
-            int pad = get_padding_size(iter_count2)-iter_count2;
-            // 添加循环次数
-            for(int p=0;p<pad;p++){
-                iter_count2=iter_count2;
-                if(*p3 == *p2)
-                {
-                    p3--;
-                    p3++;
-                }
-                else{
-                    p3--;
-                    p3++;
-                }
-            }
 
-            /*---------------------constant loop stop------------------*/
-            p2 = matchString;
-            if(j == strlen(matchString))
-            {
-                flag = 1;
-            }else{
-                flag = flag;
-            }
-        }
-        /*-------------------- branch elimination start----------------*/
-        p3 = p3;
+/*
+ * matching_step:
+ *   One position of the constant-time scan: compares matchString with the
+ *   text at p1 and pads the comparison loop to a power of two, then runs
+ *   the dummy comparison that hides whether the first byte matched. The
+ *   dummy loops re-read p1, so nothing past the match_len bytes at p1 is
+ *   read. Returns the updated flag.
+ */
+static int matching_step(const char *p1, const char *matchString, int match_len, int flag)
+{
+    const char *p2 = matchString;
+    const char *p3 = p1;
+    int j = 0;
+
+    // 如果某一位和matchString的第一位匹配，则开始找下面的位
+    if(*p1 == *p2)
+    {
         int iter_count2 = 0;
         for(j = 0; j<match_len; j++)
         {
             iter_count2++;
             if(*p3 == *p2)
             {
-                p3--;
                 p3++;
+                p2++;
             }
             else{
                 p3--;
@@ -306,8 +256,12 @@ int matching(char* webpage, char* matchString){
                 break;
             }
         }
+        p3 = p1;
+        /*---------------------constant loop start------------------*/
+
+        int pad = get_padding_size(iter_count2)-iter_count2;
         // 添加循环次数
-        for(int p=0;p<get_padding_size(iter_count2)-iter_count2;p++){
+        for(int p=0;p<pad;p++){
             iter_count2=iter_count2;
             if(*p3 == *p2)
             {
@@ -319,149 +273,225 @@ int matching(char* webpage, char* matchString){
                 p3++;
             }
         }
-        p2 = p2;
-        if(j == strlen(matchString))
+
+        /*---------------------constant loop stop------------------*/
+        p2 = matchString;
+        if(j == match_len)
         {
-            flag = flag;
-//                return 1;
+            flag = 1;
         }else{
             flag = flag;
         }
-        /*-------------------- branch elimination stop----------------*/
-        p1++;
-        iter_count1++;
     }
-
-    /*---------------------constant loop start------------------*/
-    int pad_1 = get_padding_size(iter_count1)-iter_count1;
-    for (int k = 0; k < pad_1; ++k) {
-        // 如果某一位和matchString的第一位匹配，则开始找下面的位
-        if(*p1 == *p2)
-        {
-            p1=p1;
-            iter_count1=iter_count1;
-            p3 = p3;
-            int iter_count2 = 0;
-            for(j = 0; j<match_len; j++)
-            {
-                iter_count2++;
-                if(*p3 == *p2)
-                {
-                    p3--;
-                    p3++;
-                }
-                else{
-                    p3--;
-                    p3++;
-                    break;
-                }
-            }
-            int pad_2 = get_padding_size(iter_count2)-iter_count2;
-            // 添加循环次数
-            for(int p=0;p<pad_2;p++){
-                iter_count2=iter_count2;
-                if(*p3 == *p2)
-                {
-                    p3--;
-                    p3++;
-                }
-                else{
-                    p3--;
-                    p3++;
-                }
-            }
-            p2 = p2;
-            if(j == strlen(matchString))
-            {
-                flag = flag;
-//                return 1;
-            }else{
-                flag = flag;
-            }
-        }
-        /*-------------------------------- copyed to here------------------*/
-        p3 = p3;
-        int iter_count2 = 0;
-        for(j = 0; j<match_len; j++)
+    /*-------------------- branch elimination start----------------*/
+    p3 = p1;
+    int iter_count2 = 0;
+    for(j = 0; j<match_len; j++)
+    {
+        iter_count2++;
+        if(*p3 == *p2)
         {
-            iter_count2++;
-            if(*p3 == *p2)
-            {
-                p3--;
-                p3++;
-            }
-            else{
-                p3--;
-                p3++;
-                break;
-            }
+            p3--;
+            p3++;
         }
-        // 添加循环次数
-        for(int p=0;p<get_padding_size(iter_count2)-iter_count2;p++){
-            iter_count2=iter_count2;
-            if(*p3 == *p2)
-            {
-                p3--;
-                p3++;
-            }
-            else{
-                p3--;
-                p3++;
-            }
+        else{
+            p3--;
+            p3++;
+            break;
         }
-        p2 = p2;
-        if(j == strlen(matchString))
+    }
+    // 添加循环次数
+    for(int p=0;p<get_padding_size(iter_count2)-iter_count2;p++){
+        iter_count2=iter_count2;
+        if(*p3 == *p2)
         {
-            flag = flag;
-//                return 1;
-        }else{
-            flag = flag;
+            p3--;
+            p3++;
+        }
+        else{
+            p3--;
+            p3++;
         }
-        /*-------------------------------- copyed to here------------------*/
-        p1=p1;
-        iter_count1=iter_count1;
     }
-    /*---------------------constant loop stop------------------*/
-    if(flag==0)
+    if(j == match_len)
     {
-//        printf("Substring NOT found");
-        return 0;
+        flag = flag;
     }else{
-        return 1;
+        flag = flag;
     }
+    /*-------------------- branch elimination stop----------------*/
+    return flag;
+}
+
+/*
+ * matching_pad:
+ *   Runs count dummy steps so that the number of steps of a page only
+ *   depends on the padded page size.
+ */
+static void matching_pad(const char *matchString, int match_len, int count)
+{
+    for (int k = 0; k < count; ++k)
+        (void) matching_step(matchString, matchString, match_len, 0);
+}
+
+int matching(char* webpage, char* matchString){
+    int flag = 0;
+    int page_len = strlen(webpage);
+    int match_len = strlen(matchString);
+
+    // 从第一位开始匹配matchString的第一位
+    for(int i = 0; i<page_len; i++)
+        flag = matching_step(webpage + i, matchString, match_len, flag);
+
+    /*---------------------constant loop start------------------*/
+    matching_pad(matchString, match_len, get_padding_size(page_len)-page_len);
+    /*---------------------constant loop stop------------------*/
+    return flag;
+}
+
+static sgx_status_t ids_begin(void *state)
+{
+    NF_IDS_STATE_t *s = (NF_IDS_STATE_t *) state;
+
+    nf_carry_reset(&s->carry);
+    s->total = 0;
+    s->scanned = 0;
+    s->matched = 0;
+    if (!s->signature_len || s->signature_len > NF_CARRY_MAX_WIDTH)
+        return SGX_ERROR_INVALID_PARAMETER;
+    return SGX_SUCCESS;
+}
+
+/* Called by nf_carry_scan() for the positions whose window is complete */
+static void ids_scan(const uint8_t *text, size_t starts, void *user)
+{
+    NF_IDS_STATE_t *s = (NF_IDS_STATE_t *) user;
+
+    for (size_t i = 0; i < starts; i++)
+        s->matched = matching_step((const char *) text + i, s->signature,
+                                   (int) s->signature_len, s->matched);
+}
+
+static sgx_status_t ids_process(void *state, const uint8_t *data, size_t len,
+                                NF_EMIT_t *emit)
+{
+    NF_IDS_STATE_t *s = (NF_IDS_STATE_t *) state;
+
+    s->total += len;
+    s->scanned += nf_carry_scan(&s->carry, data, len, s->signature_len, ids_scan, s);
+    /* The IDS does not modify the page */
+    return emit->cbf(data, len, emit->user);
+}
+
+static sgx_status_t ids_finish(void *state, NF_EMIT_t *emit)
+{
+    NF_IDS_STATE_t *s = (NF_IDS_STATE_t *) state;
+
+    /* The last signature_len - 1 positions cannot match, they are padded
+     * along with the rest */
+    matching_pad(s->signature, (int) s->signature_len,
+                 get_padding_size((int) s->total) - (int) s->scanned);
+    return SGX_SUCCESS;
+}
+
+static void ids_end(void *state)
+{
+}
+
+const NF_KERNEL_t nf_ids_kernel = {
+    "ids", ids_begin, ids_process, ids_finish, ids_end
+};
+
+/* A large page under the IDS, see ids_large_page() */
+struct ids_large
+{
+    NF_IDS_STATE_t *ids;
+    const uint8_t *page;
+    size_t scanned;         /* Start positions whose window is complete */
+    int *matched;           /* Per task */
+};
+
+/*
+ * Steps [lo, hi) of the scan. The steps before scanned compare the
+ * signature with the page, reading up to signature_len - 1 bytes past hi,
+ * so a signature across two tasks is found by the first one; the others
+ * are the padding of ids_finish().
+ */
+static void ids_large_task(size_t lo, size_t hi, void *arg)
+{
+    struct ids_large *l = (struct ids_large *) arg;
+    NF_IDS_STATE_t *s = l->ids;
+    int flag = 0;
+    size_t i;
+
+    for (i = lo; i < hi && i < l->scanned; i++)
+        flag = matching_step((const char *) l->page + i, s->signature,
+                             (int) s->signature_len, flag);
+    matching_pad(s->signature, (int) s->signature_len, (int) (hi - i));
+    l->matched[lo / NF_IDS_GRAIN] = flag;
+}
+
+/*
+ * ids_large_page:
+ *   The IDS over a whole page, its scan cut among the scheduler's workers.
+ *   It takes as many steps as the streaming kernel, padding included, and
+ *   comes to the same verdict.
+ */
+static sgx_status_t ids_large_page(const uint8_t *page, size_t len, NF_EMIT_t *emit, void *user)
+{
+    NF_IDS_STATE_t *s = (NF_IDS_STATE_t *) user;
+    size_t steps = (size_t) get_padding_size((int) len);
+    size_t tasks = (steps + NF_IDS_GRAIN - 1) / NF_IDS_GRAIN;
+    struct ids_large l;
+    sgx_status_t ret;
+
+    ret = ids_begin(s);
+    if (ret != SGX_SUCCESS)
+        return ret;
+    l.ids = s;
+    l.page = page;
+    l.scanned = len >= s->signature_len ? len - s->signature_len + 1 : 0;
+    l.matched = (int *) calloc(tasks, sizeof(int));
+    if (!l.matched)
+        return SGX_ERROR_OUT_OF_MEMORY;
+
+    nf_parallel_for(0, steps, NF_IDS_GRAIN, ids_large_task, &l);
+    for (size_t k = 0; k < tasks; k++)
+        s->matched |= l.matched[k];
+    s->total = len;
+    s->scanned = l.scanned;
+    free(l.matched);
+    /* The IDS does not modify the page */
+    return emit->cbf(page, len, emit->user);
 }
 
 sgx_status_t enclave_ids(uint8_t* cyphertext, size_t lSize,
-                         uint8_t* en_mac,size_t* oSize,uint8_t* encProcessedtext, size_t* matched)
+                         uint8_t* en_mac,uint8_t* in_iv,size_t* oSize,uint8_t* encProcessedtext,
+                         size_t oCap,
+                         uint8_t* out_mac, uint8_t* out_iv, uint64_t* out_seq, size_t* matched)
 {
     sgx_status_t ret = SGX_SUCCESS;
-    ret = sgx_rijndael128GCM_decrypt(
-            (const sgx_ec_key_128bit_t*) data_key, //(const sgx_ec_key_128bit_t*) g_secret_DO,
-            cyphertext,
-            lSize,
-            encProcessedtext,
-            aes_gcm_iv,
-            12,
-            NULL,
-            0,
-            (const sgx_aes_gcm_128bit_tag_t*) en_mac);
-    char matchString[] = "<script>onerror=alert;throw 1</script>";
-    *oSize=lSize;
-    *matched = matching((char*)cyphertext,matchString);
-    uint8_t en_mac_new[16];
-
-    ret = sgx_rijndael128GCM_encrypt(
-            (const sgx_ec_key_128bit_t*) data_key,
-            encProcessedtext,
-            *oSize,
-            encProcessedtext, // Output
-            aes_gcm_iv,
-            12,
-            NULL,
-            0,
-            &en_mac_new); // Output
+    char matchString[] = NF_IDS_SIGNATURE;
+    NF_IDS_STATE_t ids;
+    NF_STAGE_t stage = {&nf_ids_kernel, &ids};
+
+    *matched = 0;
+    if (nf_tile_check_input(cyphertext, lSize) != SGX_SUCCESS ||
+        nf_tile_check_output(encProcessedtext, oCap) != SGX_SUCCESS)
+        return SGX_ERROR_INVALID_PARAMETER;
+    ids.signature = matchString;
+    ids.signature_len = strlen(matchString);
+    ret = SGX_ERROR_OUT_OF_MEMORY;
+    if (nf_large_page(lSize))
+        ret = nf_session_default_run_page(ids_large_page, &ids, in_iv, cyphertext, lSize,
+                                          en_mac, encProcessedtext, oCap, oSize, out_mac,
+                                          out_iv, out_seq);
+    /* A page that does not fit in the enclave is streamed instead */
+    if (ret == SGX_ERROR_OUT_OF_MEMORY)
+        ret = nf_session_default_run(&stage, 1, in_iv, cyphertext, lSize, en_mac,
+                                     encProcessedtext, oCap, oSize, out_mac, out_iv, out_seq);
+    *matched = (ret == SGX_SUCCESS) ? ids.matched : 0;
     return ret;
-//    ac_trie_release (trie);
 }
 
 
@@ -620,39 +650,128 @@ int smaz_compress(char *in, int inlen, char *out, int outlen) {
     return out-_out;
 }
 
-sgx_status_t enclave_compression(uint8_t* cyphertext, size_t lSize,
-                                 uint8_t* en_mac,size_t* oSize,uint8_t* encProcessedtext)
+static sgx_status_t compression_begin(void *state)
+{
+    ((NF_COMPRESSION_STATE_t *) state)->out_len = 0;
+    return SGX_SUCCESS;
+}
+
+static sgx_status_t compression_process(void *state, const uint8_t *data, size_t len,
+                                        NF_EMIT_t *emit)
+{
+    NF_COMPRESSION_STATE_t *s = (NF_COMPRESSION_STATE_t *) state;
+    sgx_status_t ret = SGX_SUCCESS;
+
+    /* Smaz keeps no state between calls, so the output is a valid smaz
+     * stream whatever the chunking */
+    for (size_t off = 0; off < len && ret == SGX_SUCCESS; off += NF_TILE_SIZE) {
+        size_t n = len - off < NF_TILE_SIZE ? len - off : NF_TILE_SIZE;
+        int packed_len = smaz_compress((char*)data + off, (int)n, (char*)s->packed, (int)sizeof(s->packed));
+
+        ret = emit->cbf(s->packed, (size_t)packed_len, emit->user);
+        s->out_len += packed_len;
+    }
+    return ret;
+}
+
+static sgx_status_t compression_finish(void *state, NF_EMIT_t *emit)
+{
+    NF_COMPRESSION_STATE_t *s = (NF_COMPRESSION_STATE_t *) state;
+
+    /* Pad the compressed page to the next power of two */
+    return nf_emit_zeros(emit, get_padding_size((int)s->out_len) - s->out_len);
+}
+
+static void compression_end(void *state)
+{
+}
+
+const NF_KERNEL_t nf_compression_kernel = {
+    "compression", compression_begin, compression_process, compression_finish, compression_end
+};
+
+/* A wave of NF_TILE_SIZE chunks of a large page, see compression_large_page() */
+struct compression_large
+{
+    const uint8_t *page;
+    size_t base;            /* Offset of the first chunk of the wave */
+    uint8_t *packed;        /* Per chunk: NF_SMAZ_BOUND(NF_TILE_SIZE) bytes */
+    size_t *packed_len;
+};
+
+static void compression_large_task(size_t lo, size_t hi, void *arg)
+{
+    struct compression_large *l = (struct compression_large *) arg;
+    size_t k = (lo - l->base) / NF_TILE_SIZE;
+
+    l->packed_len[k] = (size_t) smaz_compress((char *) l->page + lo, (int) (hi - lo),
+                                              (char *) l->packed + k * NF_SMAZ_BOUND(NF_TILE_SIZE),
+                                              (int) NF_SMAZ_BOUND(NF_TILE_SIZE));
+}
+
+/*
+ * compression_large_page:
+ *   The compression over a whole page, NF_COMPRESSION_WAVE chunks at a
+ *   time cut among the scheduler's workers. The chunks are those that
+ *   compression_process() cuts the page into and they are emitted in
+ *   order, so the output is the same byte for byte.
+ */
+static sgx_status_t compression_large_page(const uint8_t *page, size_t len, NF_EMIT_t *emit,
+                                           void *user)
 {
+    NF_COMPRESSION_STATE_t *s = (NF_COMPRESSION_STATE_t *) user;
+    struct compression_large l;
     sgx_status_t ret = SGX_SUCCESS;
-    uint8_t* storage = (uint8_t*) malloc(lSize);
-    ret = sgx_rijndael128GCM_decrypt(
-            (const sgx_ec_key_128bit_t*) data_key, //(const sgx_ec_key_128bit_t*) g_secret_DO,
-            cyphertext,
-            lSize,
-            storage,
-            aes_gcm_iv,
-            12,
-            NULL,
-            0,
-            (const sgx_aes_gcm_128bit_tag_t*) en_mac);
-
-//    char matchString[] = "alert(1)";
-    *oSize=(size_t)smaz_compress((char*)storage,lSize,(char*)encProcessedtext,lSize);
-//    *matched = matching((char*)cyphertext,matchString);
-
-    *oSize=get_padding_size(*oSize);
-    uint8_t en_mac_new[16];
-
-    ret = sgx_rijndael128GCM_encrypt(
-            (const sgx_ec_key_128bit_t*) data_key,
-            encProcessedtext,
-            *oSize,
-            encProcessedtext, // Output
-            aes_gcm_iv,
-            12,
-            NULL,
-            0,
-            &en_mac_new); // Output
+
+    compression_begin(s);
+    l.page = page;
+    l.packed = (uint8_t *) malloc(NF_COMPRESSION_WAVE * NF_SMAZ_BOUND(NF_TILE_SIZE));
+    l.packed_len = (size_t *) calloc(NF_COMPRESSION_WAVE, sizeof(size_t));
+    if (!l.packed || !l.packed_len) {
+        free(l.packed);
+        free(l.packed_len);
+        return SGX_ERROR_OUT_OF_MEMORY;
+    }
+
+    for (l.base = 0; l.base < len && ret == SGX_SUCCESS;
+         l.base += NF_COMPRESSION_WAVE * NF_TILE_SIZE) {
+        size_t end = len - l.base > NF_COMPRESSION_WAVE * NF_TILE_SIZE
+                         ? l.base + NF_COMPRESSION_WAVE * NF_TILE_SIZE : len;
+
+        nf_parallel_for(l.base, end, NF_TILE_SIZE, compression_large_task, &l);
+        for (size_t k = 0; k * NF_TILE_SIZE < end - l.base && ret == SGX_SUCCESS; k++) {
+            ret = emit->cbf(l.packed + k * NF_SMAZ_BOUND(NF_TILE_SIZE), l.packed_len[k],
+                            emit->user);
+            s->out_len += l.packed_len[k];
+        }
+    }
+    free(l.packed);
+    free(l.packed_len);
+    if (ret != SGX_SUCCESS)
+        return ret;
+    return compression_finish(s, emit);
+}
+
+sgx_status_t enclave_compression(uint8_t* cyphertext, size_t lSize,
+                                 uint8_t* en_mac,uint8_t* in_iv,size_t* oSize,
+                                 uint8_t* encProcessedtext,
+                                 size_t oCap, uint8_t* out_mac, uint8_t* out_iv,
+                                 uint64_t* out_seq)
+{
+    NF_COMPRESSION_STATE_t compression;
+    NF_STAGE_t stage = {&nf_compression_kernel, &compression};
+    sgx_status_t ret = SGX_ERROR_OUT_OF_MEMORY;
+
+    if (nf_tile_check_input(cyphertext, lSize) != SGX_SUCCESS ||
+        nf_tile_check_output(encProcessedtext, oCap) != SGX_SUCCESS)
+        return SGX_ERROR_INVALID_PARAMETER;
+    if (nf_large_page(lSize))
+        ret = nf_session_default_run_page(compression_large_page, &compression, in_iv,
+                                          cyphertext, lSize, en_mac, encProcessedtext, oCap,
+                                          oSize, out_mac, out_iv, out_seq);
+    /* A page that does not fit in the enclave is streamed instead */
+    if (ret == SGX_ERROR_OUT_OF_MEMORY)
+        ret = nf_session_default_run(&stage, 1, in_iv, cyphertext, lSize, en_mac,
+                                     encProcessedtext, oCap, oSize, out_mac, out_iv, out_seq);
     return ret;
-//    ac_trie_release (trie);
-}
\ No newline at end of file
+}
@@ -1,3 +1,12 @@
+/*
+ * Enclave_bare.cpp: Bare variant of the NFs, the baseline of the A/B runs.
+ *
+ * Each ECALL pays for the transition and the decryption and re-encryption
+ * of the page, and does as little NF work as still yields its output: the
+ * IDS does not scan the page, the badword filter and the compression run
+ * as in Enclave_before.cpp. Nothing is padded.
+ */
+
 #include "Enclave.h"
 #include "Enclave_t.h" /* print_string */
 //#include <stdlib.h>
@@ -14,9 +23,12 @@
 // Needed to query extended epid group id.
 #include "sgx_uae_service.h"
 #include "ahocorasick.h"
+#include "nf_kernels.h"
+#include "nf_ruleset.h"
+#include "nf_session.h"
 #include <string.h>
-/*
- * printf:
+/* 
+ * printf: 
  *   Invokes OCALL to display the enclave buffer to the terminal.
  */
 int printf(const char* fmt, ...)
@@ -35,172 +47,149 @@ int printf(const char* fmt, ...)
 #define PATTERN(p,r)    {{p,strlen(p)},{r,strlen(r)},{{0},AC_PATTID_TYPE_DEFAULT}}
 #define CHUNK(c)        {c,strlen(c)}
 
-void generate_patterns(AC_TRIE_t * trie_l){
-//    char badwords[] = "locale|padding|html|css|com|cdn|google";
-    char badwords[] = "carpet muncher|cawk|chink|cipa|cl1t|clit|clitoris|coksucka|coon|cox|crap|beastial|clits|cnut|cock|cock-sucker|cockface|cockhead|cockmuncher|cocks|cocksucks|cocksuka|cocksukka|cok|cokmuncher|cum|cummer|cumming|cums|cumshot|cunilingus|cunillingus|cunnilingus|cunt|cuntlicker|cuntlick|cocksuck|cocksucked|cocksucker|cocksucking|cockmunch|blowjob|bitchin|bitcher|bitch|bestial|asshole||cuntlicking|cunts|cyalis|cyberfuc|cyberfuck|cyberfucked|cyberfucker|cyberfuckers|cyberfucking|d1ck|damn|dick|dickhead|dildo|dildos|dink|dinks|dirsa|dlck|dog-fucker|doggin|dogging|donkeyribber|doosh|duche|dyke|ejaculate|ejaculated|ejaculates|ejaculating|ejaculatings|ejaculation|ejakulate|f u c k|f u c k e r|f4nny|fag|fagging|faggitt|faggot|faggs|fagot|fagots|fags|fanny|fannyflaps|fannyfucker|fanyy|fatass|fcuk|fcuker|fcuking|feck|fecker|felching|fellate|fellatio|fingerfuck|fingerfucked|fingerfucker|fingerfuckers|fingerfucking|fingerfucks|fistfuck|fistfucked|fistfucker|fistfuckers|fistfucking|fistfuckings|fistfucks|flange|fook|fooker|fuck|fucka|fucked|fucker|fuckers|fuckhead|fuckheads|fuckin|fucking|fuckings|fuckingshitmotherfucker|fuckme|fucks|fuckwhit|fuckwit|fudge packer|fudgepacker|fuk|fuker|fukker|fukkin|fuks|fukwhit|fukwit|fux|fux0r|f_u_c_k|gangbang|gangbanged|gangbangs|gaylord|gaysex|goatse|God|god-dam|god-damned|goddamn|goddamned|hardcoresex|hell|heshe|hoar|hoare|hoer|homo|hore|horniest|horny|hotsex|jack-off|jackoff|jap|jerk-off|jism|jiz|jizm|jizz|kawk|knob|knobead|knobed|knobend|knobhead|knobjocky|knobjokey|kock|kondum|kondums|kum|kummer|kumming|kums|kunilingus|l3itch|labia|lust|lusting|m0f0|m0fo|m45terbate|ma5terb8|ma5terbate|masochist|master-bate|masterb8|masterbat*|masterbat3|masterbate|masterbation|masterbations|masturbate|mo-fo|mof0|mofo|mothafuck|mothafucka|mothafuckas|mothafuckaz|mothafucked|mothafucker|mothafuckers|mothafuckin|mothafucking|mothafuckings|mothafucks|mother fucker|motherfuck|motherfucked|motherfucker|motherfuckers|motherfuckin|motherfucking|motherfuckings|motherfuckka|motherfucks|muff|mutha|muthafecker|muthafuckker|muther|mutherfucker|n1gga|n1gger|nazi|nigg3r|nigg4h|nigga|niggah|niggas|niggaz|nigger|niggers|nob|nob jokey|nobhead|nobjocky|nobjokey|numbnuts|nutsack|orgasim|orgasims|orgasm|orgasms|p0rn|pawn|pecker|penis|penisfucker|phonesex|phuck|phuk|phuked|phuking|phukked|phukking|phuks|phuq|pigfucker|pimpis|piss|pissed|pisser|pissers|pisses|pissflaps|pissin|pissing|pissoff|poop|porn|porno|pornography|pornos|prick|pricks|pron|pube|pusse|pussi|pussies|pussy|pussys|rectum|retard|rimjaw|rimming|s hit|s.o.b.|sadist|schlong|screwing|scroat|scrote|scrotum|semen|sex|sh!t|sh1t|shag|shagger|shaggin|shagging|shemale|shit|shitdick|shite|shited|shitey|shitfuck|shitfull|shithead|shiting|shitings|shits|shitted|shitter|shitters|shitting|shittings|shitty|skank|slut|sluts|smegma|smut|snatch|son-of-a-bitch|spac|spunk|s_h_i_t|t1tt1e5|t1tties|teets|teez|testical|testicle|tit|titfuck|tits|titt|tittie5|tittiefucker|titties|tittyfuck|tittywank|titwank|tosser|turd|tw4t|twat|twathead|twatty|twunt|twunter|v14gra|v1gra|vagina|viagra|vulva|w00se|wang|wank|wanker|wanky|whoar|whore|willies|willy|xrated|xxx|locale|padding|html|css|com|cdn|google|com|cdn|google|locale|padding|html|arrse|arse|ass|ass-fucker|assfucker|assfukka|assholes|asswhole|a_s_s|b!tch|b00bs|b17ch|b1tch|ballbag|balls|ballsack|bastard|beastiality|bellend|bestiality|bitch|biatch|bitchers|bitches|bitching|bloody|blow job|blowjobs|boiolas|bollock|bollok|boner|boob|boobs|booobs|boooobs|booooobs|booooooobs|breasts|buceta|bugger|bum|bunny fucker|butt|butthole|buttmuch|buttplug|c0ck|c0cksucker";
-    const char * delim = "|";
-    char *p;
-//    std::map<int, std::string> badwords_map;
-    std::vector<char*> badwords_vec;
-    /* 将badwords读入到字典中 */
-    p = strtok(badwords, delim);
-    int count = 1;
-    while(p){
-        badwords_vec.push_back(p);
-        count++;
-        p = strtok(NULL, delim);
-    }
-    int loop_invarient = 1;
-    if (p){AC_PATTERN_t patterns[badwords_vec.size()];}
-    for(std::vector<char*>::iterator iter = badwords_vec.begin(); iter != badwords_vec.end(); iter++)
-    {
-        AC_PATTERN_t pattern = PATTERN(*iter,"");
-        ac_trie_add(trie_l, &pattern , 0);
-    }
-}
+/* Patterns used until the host provisions a ruleset, see nf_ruleset.h */
+const char nf_badword_default_rules[] = "carpet muncher|cawk|chink|cipa|cl1t|clit|clitoris|coksucka|coon|cox|crap|beastial|clits|cnut|cock|cock-sucker|cockface|cockhead|cockmuncher|cocks|cocksucks|cocksuka|cocksukka|cok|cokmuncher|cum|cummer|cumming|cums|cumshot|cunilingus|cunillingus|cunnilingus|cunt|cuntlicker|cuntlick|cocksuck|cocksucked|cocksucker|cocksucking|cockmunch|blowjob|bitchin|bitcher|bitch|bestial|asshole||cuntlicking|cunts|cyalis|cyberfuc|cyberfuck|cyberfucked|cyberfucker|cyberfuckers|cyberfucking|d1ck|damn|dick|dickhead|dildo|dildos|dink|dinks|dirsa|dlck|dog-fucker|doggin|dogging|donkeyribber|doosh|duche|dyke|ejaculate|ejaculated|ejaculates|ejaculating|ejaculatings|ejaculation|ejakulate|f u c k|f u c k e r|f4nny|fag|fagging|faggitt|faggot|faggs|fagot|fagots|fags|fanny|fannyflaps|fannyfucker|fanyy|fatass|fcuk|fcuker|fcuking|feck|fecker|felching|fellate|fellatio|fingerfuck|fingerfucked|fingerfucker|fingerfuckers|fingerfucking|fingerfucks|fistfuck|fistfucked|fistfucker|fistfuckers|fistfucking|fistfuckings|fistfucks|flange|fook|fooker|fuck|fucka|fucked|fucker|fuckers|fuckhead|fuckheads|fuckin|fucking|fuckings|fuckingshitmotherfucker|fuckme|fucks|fuckwhit|fuckwit|fudge packer|fudgepacker|fuk|fuker|fukker|fukkin|fuks|fukwhit|fukwit|fux|fux0r|f_u_c_k|gangbang|gangbanged|gangbangs|gaylord|gaysex|goatse|God|god-dam|god-damned|goddamn|goddamned|hardcoresex|hell|heshe|hoar|hoare|hoer|homo|hore|horniest|horny|hotsex|jack-off|jackoff|jap|jerk-off|jism|jiz|jizm|jizz|kawk|knob|knobead|knobed|knobend|knobhead|knobjocky|knobjokey|kock|kondum|kondums|kum|kummer|kumming|kums|kunilingus|l3itch|labia|lust|lusting|m0f0|m0fo|m45terbate|ma5terb8|ma5terbate|masochist|master-bate|masterb8|masterbat*|masterbat3|masterbate|masterbation|masterbations|masturbate|mo-fo|mof0|mofo|mothafuck|mothafucka|mothafuckas|mothafuckaz|mothafucked|mothafucker|mothafuckers|mothafuckin|mothafucking|mothafuckings|mothafucks|mother fucker|motherfuck|motherfucked|motherfucker|motherfuckers|motherfuckin|motherfucking|motherfuckings|motherfuckka|motherfucks|muff|mutha|muthafecker|muthafuckker|muther|mutherfucker|n1gga|n1gger|nazi|nigg3r|nigg4h|nigga|niggah|niggas|niggaz|nigger|niggers|nob|nob jokey|nobhead|nobjocky|nobjokey|numbnuts|nutsack|orgasim|orgasims|orgasm|orgasms|p0rn|pawn|pecker|penis|penisfucker|phonesex|phuck|phuk|phuked|phuking|phukked|phukking|phuks|phuq|pigfucker|pimpis|piss|pissed|pisser|pissers|pisses|pissflaps|pissin|pissing|pissoff|poop|porn|porno|pornography|pornos|prick|pricks|pron|pube|pusse|pussi|pussies|pussy|pussys|rectum|retard|rimjaw|rimming|s hit|s.o.b.|sadist|schlong|screwing|scroat|scrote|scrotum|semen|sex|sh!t|sh1t|shag|shagger|shaggin|shagging|shemale|shit|shitdick|shite|shited|shitey|shitfuck|shitfull|shithead|shiting|shitings|shits|shitted|shitter|shitters|shitting|shittings|shitty|skank|slut|sluts|smegma|smut|snatch|son-of-a-bitch|spac|spunk|s_h_i_t|t1tt1e5|t1tties|teets|teez|testical|testicle|tit|titfuck|tits|titt|tittie5|tittiefucker|titties|tittyfuck|tittywank|titwank|tosser|turd|tw4t|twat|twathead|twatty|twunt|twunter|v14gra|v1gra|vagina|viagra|vulva|w00se|wang|wank|wanker|wanky|whoar|whore|willies|willy|xrated|xxx|locale|padding|html|css|com|cdn|google|com|cdn|google|locale|padding|html|arrse|arse|ass|ass-fucker|assfucker|assfukka|assholes|asswhole|a_s_s|b!tch|b00bs|b17ch|b1tch|ballbag|balls|ballsack|bastard|beastiality|bellend|bestiality|bitch|biatch|bitchers|bitches|bitching|bloody|blow job|blowjobs|boiolas|bollock|bollok|boner|boob|boobs|booobs|boooobs|booooobs|booooooobs|breasts|buceta|bugger|bum|bunny fucker|butt|butthole|buttmuch|buttplug|c0ck|c0cksucker";
 
 /* Define a call-back function of type MF_REPLACE_CALBACK_f */
-void listener (AC_TEXT_t *text, void* new_length)
+void listener (AC_TEXT_t *text, void* param)
 {
-    int ret = 0;
-//    printf("Length:%d",(int)text->length);
-    int i = 1;
-    int invariant = 0;
-    *(int *)new_length = (int)text->length;
+    NF_BADWORD_STATE_t *s = (NF_BADWORD_STATE_t *) param;
 
+    if (s->status != SGX_SUCCESS || !text->length)
+        return;
+    s->status = s->emit->cbf((const uint8_t *) text->astring, text->length, s->emit->user);
+    s->out_len += text->length;
 }
 
-int new_length = 1;
 uint8_t data_key[16] = {0x87, 0xA6, 0x0B, 0x39, 0xD5, 0x26, 0xAB, 0x1C, 0x30, 0x9E, 0xEC, 0x60, 0x6C, 0x72, 0xBA, 0x36};
-uint8_t aes_gcm_iv[12] = {0};
+
+static sgx_status_t badword_begin(void *state)
+{
+    NF_BADWORD_STATE_t *s = (NF_BADWORD_STATE_t *) state;
+
+    s->out_len = 0;
+    s->status = SGX_SUCCESS;
+
+    /* A finalized trie of the current ruleset, built once and reused */
+    s->trie = nf_ruleset_acquire(&s->rules);
+    if (!s->trie)
+        return SGX_ERROR_OUT_OF_MEMORY;
+    return SGX_SUCCESS;
+}
+
+static sgx_status_t badword_process(void *state, const uint8_t *data, size_t len,
+                                    NF_EMIT_t *emit)
+{
+    NF_BADWORD_STATE_t *s = (NF_BADWORD_STATE_t *) state;
+    AC_TEXT_t input_chunk = {(const AC_ALPHABET_t *) data, len};
+
+    s->emit = emit;
+    /* A badword cut by the end of the chunk stays in the trie's backlog */
+    if (multifast_replace (s->trie, &input_chunk, MF_REPLACE_MODE_NORMAL, listener, s))
+        return SGX_ERROR_UNEXPECTED;
+    /* Pass on what is decided so far, keep the replacement going */
+    multifast_rep_flush (s->trie, 1);
+    return s->status;
+}
+
+static sgx_status_t badword_finish(void *state, NF_EMIT_t *emit)
+{
+    NF_BADWORD_STATE_t *s = (NF_BADWORD_STATE_t *) state;
+    AC_TEXT_t no_chunk = {"", 0};
+
+    s->emit = emit;
+    /* Registers the listener even if the page was empty */
+    if (multifast_replace (s->trie, &no_chunk, MF_REPLACE_MODE_NORMAL, listener, s))
+        return SGX_ERROR_UNEXPECTED;
+    multifast_rep_flush (s->trie, 0);
+    return s->status;
+}
+
+static void badword_end(void *state)
+{
+    NF_BADWORD_STATE_t *s = (NF_BADWORD_STATE_t *) state;
+
+    nf_ruleset_release(s->rules, s->trie);
+    s->trie = NULL;
+    s->rules = NULL;
+}
+
+const NF_KERNEL_t nf_badword_kernel = {
+    "badword", badword_begin, badword_process, badword_finish, badword_end
+};
 
 sgx_status_t enclave_process_badword(uint8_t* cyphertext, size_t lSize,
-                                     uint8_t* en_mac, size_t* oSize,
-                                     uint8_t* encProcessedtext)
+                                     uint8_t* en_mac, uint8_t* in_iv, size_t* oSize,
+                                     uint8_t* encProcessedtext, size_t oCap,
+                                     uint8_t* out_mac, uint8_t* out_iv, uint64_t* out_seq)
 {
-    sgx_status_t ret = SGX_SUCCESS;
-    ret = sgx_rijndael128GCM_decrypt(
-            (const sgx_ec_key_128bit_t*) data_key, //(const sgx_ec_key_128bit_t*) g_secret_DO,
-            cyphertext,
-            lSize,
-            encProcessedtext,
-            aes_gcm_iv,
-            12,
-            NULL,
-            0,
-            (const sgx_aes_gcm_128bit_tag_t*) en_mac);
-    AC_TEXT_t input_chunk = CHUNK((const char*)encProcessedtext);
-    AC_TRIE_t *trie;
-
-    /* Get a new trie */
-    trie = ac_trie_create();
-
-    /* Generate and add patterns into the trie */
-    generate_patterns(trie);
-    /* Finalize the trie */
-    ac_trie_finalize (trie);
-
-    /* Replace */
-    multifast_replace (trie, &input_chunk, MF_REPLACE_MODE_NORMAL, listener, &new_length);
-
-    multifast_rep_flush (trie, 0);
-
-    *oSize=new_length;
-    uint8_t en_mac_new[16];
-    ret = sgx_rijndael128GCM_encrypt(
-            (const sgx_ec_key_128bit_t*) data_key,
-            encProcessedtext,
-            *oSize,
-            encProcessedtext, // Output
-            aes_gcm_iv,
-            12,
-            NULL,
-            0,
-            &en_mac_new); // Output
-
-    ac_trie_release (trie);
-    return ret;
+    NF_BADWORD_STATE_t badword;
+    NF_STAGE_t stage = {&nf_badword_kernel, &badword};
+
+    if (nf_tile_check_input(cyphertext, lSize) != SGX_SUCCESS ||
+        nf_tile_check_output(encProcessedtext, oCap) != SGX_SUCCESS)
+        return SGX_ERROR_INVALID_PARAMETER;
+    badword.trie = NULL;
+    badword.rules = NULL;
+    return nf_session_default_run(&stage, 1, in_iv, cyphertext, lSize, en_mac,
+                                  encProcessedtext, oCap, oSize, out_mac, out_iv, out_seq);
 }
 
 
 
-size_t matching(char* webpage, char* matchString){
-    int foundMatch = 0;
-    char *p1, *p2, *p3;
-    int i=0,j=0,flag=0;
-    int page_len = strlen(webpage);
-    int match_len = strlen(matchString);
-
-    p1 = webpage;
-    p2 = matchString;
-
-    // 从第一位开始匹配matchString的第一位
-    for(i = 0; i<page_len; i++)
-    {
-        // 如果某一位和matchString的第一位匹配，则开始找下面的位
-        if(*p1 == *p2)
-        {
-            p3 = p1;
-            for(j = 0; j<match_len; j++)
-            {
-                if(*p3 == *p2)
-                {
-                    p3++;
-                    p2++;
-                }
-                else
-                    break;
-            }
-            p2 = matchString;
-            if(j == strlen(matchString))
-            {
-                flag = 1;
-//                printf("\nSubstring found at index : %d\n",i);
-                return 1;
-            }
-        }
-        p1++;
-    }
-    if(flag==0)
-    {
-//        printf("Substring NOT found");
-        return 0;
-    }
+static sgx_status_t ids_begin(void *state)
+{
+    NF_IDS_STATE_t *s = (NF_IDS_STATE_t *) state;
+
+    s->total = 0;
+    s->scanned = 0;
+    s->matched = 0;
+    return SGX_SUCCESS;
 }
 
+static sgx_status_t ids_process(void *state, const uint8_t *data, size_t len,
+                                NF_EMIT_t *emit)
+{
+    NF_IDS_STATE_t *s = (NF_IDS_STATE_t *) state;
+
+    /* The bare IDS only carries the page through the enclave, unscanned */
+    s->total += len;
+    return emit->cbf(data, len, emit->user);
+}
+
+static sgx_status_t ids_finish(void *state, NF_EMIT_t *emit)
+{
+    return SGX_SUCCESS;
+}
+
+static void ids_end(void *state)
+{
+}
+
+const NF_KERNEL_t nf_ids_kernel = {
+    "ids", ids_begin, ids_process, ids_finish, ids_end
+};
+
 sgx_status_t enclave_ids(uint8_t* cyphertext, size_t lSize,
-                         uint8_t* en_mac,size_t* oSize,uint8_t* encProcessedtext, size_t* matched)
+                         uint8_t* en_mac,uint8_t* in_iv,size_t* oSize,uint8_t* encProcessedtext,
+                         size_t oCap,
+                         uint8_t* out_mac, uint8_t* out_iv, uint64_t* out_seq, size_t* matched)
 {
     sgx_status_t ret = SGX_SUCCESS;
-    ret = sgx_rijndael128GCM_decrypt(
-            (const sgx_ec_key_128bit_t*) data_key, //(const sgx_ec_key_128bit_t*) g_secret_DO,
-            cyphertext,
-            lSize,
-            encProcessedtext,
-            aes_gcm_iv,
-            12,
-            NULL,
-            0,
-            (const sgx_aes_gcm_128bit_tag_t*) en_mac);
-
-//    char matchString[] = "<script>onerror=alert;throw 1</script>";
-    *oSize=lSize;
-//    *matched = matching((char*)cyphertext,matchString);
-    uint8_t en_mac_new[16];
-
-    ret = sgx_rijndael128GCM_encrypt(
-            (const sgx_ec_key_128bit_t*) data_key,
-            encProcessedtext,
-            *oSize,
-            encProcessedtext, // Output
-            aes_gcm_iv,
-            12,
-            NULL,
-            0,
-            &en_mac_new); // Output
-
+    char matchString[] = NF_IDS_SIGNATURE;
+    NF_IDS_STATE_t ids;
+    NF_STAGE_t stage = {&nf_ids_kernel, &ids};
+
+    *matched = 0;
+    if (nf_tile_check_input(cyphertext, lSize) != SGX_SUCCESS ||
+        nf_tile_check_output(encProcessedtext, oCap) != SGX_SUCCESS)
+        return SGX_ERROR_INVALID_PARAMETER;
+    ids.signature = matchString;
+    ids.signature_len = strlen(matchString);
+    ret = nf_session_default_run(&stage, 1, in_iv, cyphertext, lSize, en_mac,
+                                 encProcessedtext, oCap, oSize, out_mac, out_iv, out_seq);
+    *matched = (ret == SGX_SUCCESS) ? ids.matched : 0;
     return ret;
-//    ac_trie_release (trie);
 }
 
 /* Our compression codebook, used for compression */
@@ -357,37 +346,55 @@ int smaz_compress(char *in, int inlen, char *out, int outlen) {
     return out-_out;
 }
 
-sgx_status_t enclave_compression(uint8_t* cyphertext, size_t lSize,
-                                 uint8_t* en_mac,size_t* oSize,uint8_t* encProcessedtext)
+static sgx_status_t compression_begin(void *state)
+{
+    ((NF_COMPRESSION_STATE_t *) state)->out_len = 0;
+    return SGX_SUCCESS;
+}
+
+static sgx_status_t compression_process(void *state, const uint8_t *data, size_t len,
+                                        NF_EMIT_t *emit)
 {
+    NF_COMPRESSION_STATE_t *s = (NF_COMPRESSION_STATE_t *) state;
     sgx_status_t ret = SGX_SUCCESS;
-    uint8_t* storage = (uint8_t*) malloc(lSize);
-    ret = sgx_rijndael128GCM_decrypt(
-            (const sgx_ec_key_128bit_t*) data_key, //(const sgx_ec_key_128bit_t*) g_secret_DO,
-            cyphertext,
-            lSize,
-            storage,
-            aes_gcm_iv,
-            12,
-            NULL,
-            0,
-            (const sgx_aes_gcm_128bit_tag_t*) en_mac);
-
-//    char matchString[] = "alert(1)";
-    *oSize=(size_t)smaz_compress((char*)storage,lSize,(char*)encProcessedtext,lSize);
-//    *matched = matching((char*)cyphertext,matchString);
-    uint8_t en_mac_new[16];
-
-    ret = sgx_rijndael128GCM_encrypt(
-            (const sgx_ec_key_128bit_t*) data_key,
-            encProcessedtext,
-            *oSize,
-            encProcessedtext, // Output
-            aes_gcm_iv,
-            12,
-            NULL,
-            0,
-            &en_mac_new); // Output
+
+    /* Smaz keeps no state between calls, so the output is a valid smaz
+     * stream whatever the chunking */
+    for (size_t off = 0; off < len && ret == SGX_SUCCESS; off += NF_TILE_SIZE) {
+        size_t n = len - off < NF_TILE_SIZE ? len - off : NF_TILE_SIZE;
+        int packed_len = smaz_compress((char*)data + off, (int)n, (char*)s->packed, (int)sizeof(s->packed));
+
+        ret = emit->cbf(s->packed, (size_t)packed_len, emit->user);
+        s->out_len += packed_len;
+    }
     return ret;
-//    ac_trie_release (trie);
-}
\ No newline at end of file
+}
+
+static sgx_status_t compression_finish(void *state, NF_EMIT_t *emit)
+{
+    return SGX_SUCCESS;
+}
+
+static void compression_end(void *state)
+{
+}
+
+const NF_KERNEL_t nf_compression_kernel = {
+    "compression", compression_begin, compression_process, compression_finish, compression_end
+};
+
+sgx_status_t enclave_compression(uint8_t* cyphertext, size_t lSize,
+                                 uint8_t* en_mac,uint8_t* in_iv,size_t* oSize,
+                                 uint8_t* encProcessedtext,
+                                 size_t oCap, uint8_t* out_mac, uint8_t* out_iv,
+                                 uint64_t* out_seq)
+{
+    NF_COMPRESSION_STATE_t compression;
+    NF_STAGE_t stage = {&nf_compression_kernel, &compression};
+
+    if (nf_tile_check_input(cyphertext, lSize) != SGX_SUCCESS ||
+        nf_tile_check_output(encProcessedtext, oCap) != SGX_SUCCESS)
+        return SGX_ERROR_INVALID_PARAMETER;
+    return nf_session_default_run(&stage, 1, in_iv, cyphertext, lSize, en_mac,
+                                  encProcessedtext, oCap, oSize, out_mac, out_iv, out_seq);
+}
@@ -33,72 +33,66 @@
 #include "../Enclave.h"
 #include "Enclave_t.h"
 
+#include <stdint.h>
 #include "sgx_thread.h"
+#include "nf_atomic.h"
+#include "nf_queue.h"
 
-static size_t global_counter = 0;
-static sgx_thread_mutex_t global_mutex = SGX_THREAD_MUTEX_INITIALIZER;
+static volatile size_t global_counter = 0;
 
 #define BUFFER_SIZE 50
 
-typedef struct {
-    int buf[BUFFER_SIZE];
-    int occupied;
-    int nextin;
-    int nextout;
-    sgx_thread_mutex_t mutex;
-    sgx_thread_cond_t more;
-    sgx_thread_cond_t less;
-} cond_buffer_t;
+/* Made by the first producer or consumer in */
+static NF_QUEUE_t buffer;
+static volatile size_t buffer_ready = 0;
+static sgx_thread_mutex_t buffer_mutex = SGX_THREAD_MUTEX_INITIALIZER;
 
-static cond_buffer_t buffer = {{0, 0, 0, 0, 0, 0}, 0, 0, 0,
-    SGX_THREAD_MUTEX_INITIALIZER, SGX_THREAD_COND_INITIALIZER, SGX_THREAD_COND_INITIALIZER};
+static NF_QUEUE_t *get_buffer(void)
+{
+    if (!nf_atomic_load(&buffer_ready)) {
+        sgx_thread_mutex_lock(&buffer_mutex);
+        if (!buffer_ready && nf_queue_init(&buffer, BUFFER_SIZE) == SGX_SUCCESS)
+            nf_atomic_store(&buffer_ready, 1);
+        sgx_thread_mutex_unlock(&buffer_mutex);
+    }
+    return buffer_ready ? &buffer : NULL;
+}
 
 /*
  * ecall_increase_counter:
- *   Utilize thread APIs inside the enclave.
+ *   Utilize atomic operations inside the enclave.
  */
 size_t ecall_increase_counter(void)
 {
     size_t ret = 0;
     for (int i = 0; i < LOOPS_PER_THREAD; i++) {
-        sgx_thread_mutex_lock(&global_mutex);
-        /* mutually exclusive adding */
-        size_t tmp = global_counter;
-        global_counter = ++tmp;
-        if (4*LOOPS_PER_THREAD == global_counter)
-            ret = global_counter;
-        sgx_thread_mutex_unlock(&global_mutex);
+        /* one locked add, no lock to take */
+        size_t tmp = nf_atomic_add(&global_counter, 1);
+        if (4*LOOPS_PER_THREAD == tmp)
+            ret = tmp;
     }
     return ret;
 }
 
+/*
+ * ecall_producer, ecall_consumer:
+ *   Pass items through a lock-free queue; a waiting thread spins before it
+ *   parks on a condition variable.
+ */
 void ecall_producer(void)
 {
-    for (int i = 0; i < 4*LOOPS_PER_THREAD; i++) {
-        cond_buffer_t *b = &buffer;
-        sgx_thread_mutex_lock(&b->mutex);
-        while (b->occupied >= BUFFER_SIZE)
-            sgx_thread_cond_wait(&b->less, &b->mutex);
-        b->buf[b->nextin] = b->nextin;
-        b->nextin++;
-        b->nextin %= BUFFER_SIZE;
-        b->occupied++;
-        sgx_thread_cond_signal(&b->more);
-        sgx_thread_mutex_unlock(&b->mutex);
-    }
+    NF_QUEUE_t *b = get_buffer();
+    if (!b)
+        return;
+    for (int i = 0; i < 4*LOOPS_PER_THREAD; i++)
+        nf_queue_push(b, (void *) (uintptr_t) (i + 1));     /* items are never NULL */
 }
 
 void ecall_consumer(void)
 {
-    for (int i = 0; i < LOOPS_PER_THREAD; i++) {
-        cond_buffer_t *b = &buffer;
-        sgx_thread_mutex_lock(&b->mutex);
-        while(b->occupied <= 0)
-            sgx_thread_cond_wait(&b->more, &b->mutex);
-        b->buf[b->nextout++] = 0;
-        b->nextout %= BUFFER_SIZE;
-        b->occupied--;
-        sgx_thread_cond_signal(&b->less);
-        sgx_thread_mutex_unlock(&b->mutex);
-    }
+    NF_QUEUE_t *b = get_buffer();
+    if (!b)
+        return;
+    for (int i = 0; i < LOOPS_PER_THREAD; i++)
+        nf_queue_pop(b);
 }
@@ -0,0 +1,234 @@
+/*
+ * enclave_batch.cpp: Batched NF ECALLs, many pages per enclave transition.
+ *
+ * The pages of a batch lie back to back in one input buffer; descriptor i
+ * locates page i and its slot in the untrusted output buffer, result i
+ * reports how it went. A bad page only fails its own result.
+ *
+ * Small pages are decrypted and re-encrypted in groups with the
+ * multi-buffer GCM, the NF still runs page by page in between. Larger
+ * pages go through nf_tile_run() like the single-page ECALLs.
+ *
+ * Every page comes under the IV of its descriptor and every output page
+ * gets one of its own from nf_session_default_iv(), returned in its
+ * result: a batch is many pages under the default key, and one IV for
+ * all of them would repeat the GCM nonce.
+ */
+
+#include <string.h>
+#include "Enclave.h"
+#include "Enclave_t.h"
+#include "sgx_trts.h"
+#include "nf_session.h"
+#include "nf_kernels.h"
+#include "nf_log.h"
+
+#define NF_BATCH_SMALL 4096                 /* Largest page of the group path */
+#define NF_BATCH_GROUP 32                   /* Pages per multi-buffer group */
+#define NF_BATCH_OUT_SLOT (4 * NF_BATCH_SMALL)  /* Trusted output of a small page */
+
+/* Trusted output of a small page */
+struct nf_batch_slot
+{
+    uint8_t *buf;
+    size_t len;
+    size_t cap;
+    int overflow;
+};
+
+static sgx_status_t nf_batch_store(const uint8_t *data, size_t len, void *user)
+{
+    struct nf_batch_slot *slot = (struct nf_batch_slot *) user;
+
+    if (len > slot->cap - slot->len) {
+        slot->overflow = 1;
+        return SGX_ERROR_INVALID_PARAMETER;
+    }
+    memcpy(slot->buf + slot->len, data, len);
+    slot->len += len;
+    return SGX_SUCCESS;
+}
+
+static int nf_batch_desc_ok(const nf_batch_desc_t *desc, size_t in_len, size_t out_len)
+{
+    return desc->in_offset <= in_len && desc->in_len <= in_len - desc->in_offset &&
+           desc->out_offset <= out_len && desc->out_cap <= out_len - desc->out_offset;
+}
+
+static void nf_batch_report(nf_batch_result_t *result, nf_id_t nf, sgx_status_t ret,
+                            size_t out_len, const NF_ANY_STATE_t *state)
+{
+    result->status = ret;
+    result->out_len = out_len;
+    result->matched = (ret == SGX_SUCCESS && nf == NF_IDS) ? state->ids.matched : 0;
+    if (ret != SGX_SUCCESS) {
+        memset(result->iv, 0, sizeof(result->iv));
+        result->out_seq = 0;
+    }
+}
+
+/* A page on its own, streamed like the single-page ECALLs */
+static void nf_batch_page(nf_id_t nf, const uint8_t *in, nf_batch_desc_t *desc,
+                          uint8_t *out, nf_batch_result_t *result)
+{
+    NF_STAGE_t stage;
+    NF_ANY_STATE_t state;
+    size_t oSize = 0;
+    sgx_status_t ret;
+
+    ret = nf_stage_init(&stage, nf, &state);
+    if (ret == SGX_SUCCESS)
+        ret = nf_session_default_iv(result->iv, &result->out_seq);
+    if (ret == SGX_SUCCESS)
+        ret = nf_tile_run(&stage, 1, nf_session_default_key(), desc->iv,
+                          in + desc->in_offset, desc->in_len, desc->mac, result->iv,
+                          out + desc->out_offset, desc->out_cap, &oSize, result->mac);
+    nf_batch_report(result, nf, ret, oSize, &state);
+}
+
+/*
+ * nf_batch_group:
+ *   Processes the small pages idx[0..n): one multi-buffer decryption, the
+ *   NF over each page, one multi-buffer encryption. Unlike the streaming
+ *   path, a page whose tag does not match never reaches the NF.
+ */
+static void nf_batch_group(nf_id_t nf, const uint8_t *in, nf_batch_desc_t *descs,
+                           const size_t *idx, size_t n, uint8_t *out,
+                           nf_batch_result_t *results, uint8_t *plain, uint8_t *processed)
+{
+    NF_GCM_JOB_t jobs[NF_BATCH_GROUP];
+    const NF_GCM_KEY_t *key = nf_session_default_key();
+    size_t nenc = 0;
+
+    for (size_t j = 0; j < n; j++) {
+        nf_batch_desc_t *desc = &descs[idx[j]];
+
+        jobs[j].key = key;
+        jobs[j].iv = desc->iv;
+        jobs[j].src = in + desc->in_offset;
+        jobs[j].len = desc->in_len;
+        jobs[j].dst = plain + j * NF_BATCH_SMALL;
+        jobs[j].tag = desc->mac;
+    }
+    nf_gcm_decrypt_mb(jobs, n);
+
+    for (size_t j = 0; j < n; j++) {
+        nf_batch_desc_t *desc = &descs[idx[j]];
+        nf_batch_result_t *result = &results[idx[j]];
+        struct nf_batch_slot slot = {processed + j * NF_BATCH_OUT_SLOT, 0,
+                                     desc->out_cap < NF_BATCH_OUT_SLOT ? (size_t) desc->out_cap
+                                                                       : NF_BATCH_OUT_SLOT, 0};
+        NF_EMIT_t sink = {nf_batch_store, &slot};
+        NF_STAGE_t stage;
+        NF_ANY_STATE_t state;
+        sgx_status_t ret;
+
+        if (jobs[j].status) {
+            nf_batch_report(result, nf, SGX_ERROR_MAC_MISMATCH, 0, NULL);
+            continue;
+        }
+
+        ret = nf_stage_init(&stage, nf, &state);
+        if (ret == SGX_SUCCESS)
+            ret = nf_tile_run_plain(&stage, 1, plain + j * NF_BATCH_SMALL, desc->in_len, &sink);
+        if (slot.overflow && desc->out_cap > NF_BATCH_OUT_SLOT) {
+            /* Output larger than the trusted slot, but it fits the host's */
+            nf_batch_page(nf, in, desc, out, result);
+            continue;
+        }
+        if (ret == SGX_SUCCESS)
+            ret = nf_session_default_iv(result->iv, &result->out_seq);
+        nf_batch_report(result, nf, ret, ret == SGX_SUCCESS ? slot.len : 0, &state);
+        if (ret != SGX_SUCCESS)
+            continue;
+
+        jobs[nenc].key = key;
+        jobs[nenc].iv = result->iv;
+        jobs[nenc].src = slot.buf;
+        jobs[nenc].len = slot.len;
+        jobs[nenc].dst = out + desc->out_offset;
+        jobs[nenc].tag = result->mac;
+        nenc++;
+    }
+    nf_gcm_encrypt_mb(jobs, nenc);
+}
+
+/*
+ * nf_batch:
+ *   Runs the NF nf over the count pages of a batch. Fails as a whole only
+ *   if the output buffer is not outside the enclave or memory runs out;
+ *   otherwise results[i].status tells how page i went.
+ */
+static sgx_status_t nf_batch(nf_id_t nf, uint8_t *in, size_t in_len,
+                             nf_batch_desc_t *descs, size_t count,
+                             uint8_t *out, size_t out_len, nf_batch_result_t *results)
+{
+    size_t idx[NF_BATCH_GROUP];
+    size_t n = 0;
+    uint8_t *plain = NULL, *processed = NULL;
+
+    memset(results, 0, count * sizeof(*results));
+    if (!count)
+        return SGX_SUCCESS;
+    if (!out || !sgx_is_outside_enclave(out, out_len))
+        return SGX_ERROR_INVALID_PARAMETER;
+
+    for (size_t i = 0; i < count; i++) {
+        if (!nf_batch_desc_ok(&descs[i], in_len, out_len)) {
+            NF_LOG_WARN("batch: descriptor %zu out of range", i);
+            results[i].status = SGX_ERROR_INVALID_PARAMETER;
+            continue;
+        }
+        if (nf_session_default_check_iv(descs[i].iv) != SGX_SUCCESS) {
+            NF_LOG_WARN("batch: descriptor %zu has an outbound IV", i);
+            results[i].status = SGX_ERROR_INVALID_PARAMETER;
+            continue;
+        }
+        if (descs[i].in_len > NF_BATCH_SMALL) {
+            nf_batch_page(nf, in, &descs[i], out, &results[i]);
+            continue;
+        }
+
+        if (!plain) {
+            plain = (uint8_t *) malloc(NF_BATCH_GROUP * NF_BATCH_SMALL);
+            processed = (uint8_t *) malloc(NF_BATCH_GROUP * NF_BATCH_OUT_SLOT);
+            if (!plain || !processed) {
+                free(plain);
+                free(processed);
+                return SGX_ERROR_OUT_OF_MEMORY;
+            }
+        }
+        idx[n++] = i;
+        if (n == NF_BATCH_GROUP) {
+            nf_batch_group(nf, in, descs, idx, n, out, results, plain, processed);
+            n = 0;
+        }
+    }
+    if (n)
+        nf_batch_group(nf, in, descs, idx, n, out, results, plain, processed);
+
+    free(plain);
+    free(processed);
+    return SGX_SUCCESS;
+}
+
+sgx_status_t enclave_ids_batch(uint8_t* in, size_t in_len, nf_batch_desc_t* descs,
+                               size_t count, uint8_t* out, size_t out_len,
+                               nf_batch_result_t* results)
+{
+    return nf_batch(NF_IDS, in, in_len, descs, count, out, out_len, results);
+}
+
+sgx_status_t enclave_compression_batch(uint8_t* in, size_t in_len, nf_batch_desc_t* descs,
+                                       size_t count, uint8_t* out, size_t out_len,
+                                       nf_batch_result_t* results)
+{
+    return nf_batch(NF_COMPRESSION, in, in_len, descs, count, out, out_len, results);
+}
+
+sgx_status_t enclave_process_badword_batch(uint8_t* in, size_t in_len, nf_batch_desc_t* descs,
+                                           size_t count, uint8_t* out, size_t out_len,
+                                           nf_batch_result_t* results)
+{
+    return nf_batch(NF_BADWORD, in, in_len, descs, count, out, out_len, results);
+}
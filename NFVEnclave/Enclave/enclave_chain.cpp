@@ -0,0 +1,83 @@
+/*
+ * enclave_chain.cpp: Service chains, several NFs over one decryption.
+ */
+
+#include <string.h>
+#include "Enclave.h"
+#include "Enclave_t.h"
+#include "nf_session.h"
+#include "nf_kernels.h"
+
+static char nf_ids_signature[] = NF_IDS_SIGNATURE;
+
+/*
+ * nf_stage_init:
+ *   Sets up stage to run the NF nf with its state in state.
+ */
+sgx_status_t nf_stage_init(NF_STAGE_t *stage, nf_id_t nf, NF_ANY_STATE_t *state)
+{
+    switch (nf) {
+    case NF_IDS:
+        stage->kernel = &nf_ids_kernel;
+        state->ids.signature = nf_ids_signature;
+        state->ids.signature_len = strlen(nf_ids_signature);
+        break;
+    case NF_BADWORD:
+        stage->kernel = &nf_badword_kernel;
+        state->badword.trie = NULL;
+        state->badword.rules = NULL;
+        break;
+    case NF_COMPRESSION:
+        stage->kernel = &nf_compression_kernel;
+        break;
+    default:
+        return SGX_ERROR_INVALID_PARAMETER;
+    }
+    stage->state = state;
+    return SGX_SUCCESS;
+}
+
+/*
+ * enclave_nf_chain:
+ *   Runs the NFs chain[0..nstages) back to back over the page: each tile is
+ *   decrypted once, passes through every NF and what the last one emits is
+ *   encrypted once into the oCap bytes of encProcessedtext, under the IV
+ *   of out_iv and out_seq with its tag in out_mac. stats[i] reports stage
+ *   i; matching is set if an IDS stage found its signature.
+ */
+sgx_status_t enclave_nf_chain(nf_id_t* chain, size_t nstages,
+                              uint8_t* cyphertext, size_t lSize,
+                              uint8_t* en_mac, uint8_t* in_iv, size_t* oSize,
+                              uint8_t* encProcessedtext, size_t oCap,
+                              uint8_t* out_mac, uint8_t* out_iv, uint64_t* out_seq,
+                              nf_stage_stats_t* stats, size_t* matching)
+{
+    NF_STAGE_t stages[NF_CHAIN_MAX];
+    NF_ANY_STATE_t states[NF_CHAIN_MAX];
+    sgx_status_t ret;
+
+    *oSize = 0;
+    *matching = 0;
+    if (!nstages || nstages > NF_CHAIN_MAX ||
+        nf_tile_check_input(cyphertext, lSize) != SGX_SUCCESS ||
+        nf_tile_check_output(encProcessedtext, oCap) != SGX_SUCCESS)
+        return SGX_ERROR_INVALID_PARAMETER;
+
+    for (size_t i = 0; i < nstages; i++) {
+        ret = nf_stage_init(&stages[i], chain[i], &states[i]);
+        if (ret != SGX_SUCCESS)
+            return ret;
+    }
+
+    ret = nf_session_default_run(stages, nstages, in_iv, cyphertext, lSize, en_mac,
+                                 encProcessedtext, oCap, oSize, out_mac, out_iv, out_seq);
+
+    for (size_t i = 0; i < nstages; i++) {
+        stats[i].in_bytes = stages[i].in_bytes;
+        stats[i].out_bytes = stages[i].out_bytes;
+        stats[i].cycles = stages[i].cycles;
+        if (ret == SGX_SUCCESS && chain[i] == NF_IDS && states[i].ids.matched)
+            *matching = 1;
+    }
+    return ret;
+}
@@ -0,0 +1,80 @@
+/*
+ * enclave_log.cpp: Buffered logging inside the enclave. See nf_log.h.
+ */
+
+#include <stdarg.h>
+#include <string.h>
+#include "Enclave.h"
+#include "Enclave_t.h"
+#include "sgx_thread.h"
+#include "nf_log.h"
+
+static char nf_log_buffer[NF_LOG_BUFFER_SIZE];
+static size_t nf_log_len = 0;
+static sgx_thread_mutex_t nf_log_mutex = SGX_THREAD_MUTEX_INITIALIZER;
+
+static const char *nf_log_names[] = {"ERROR", "WARN", "INFO", "DEBUG"};
+
+/* Must be called with nf_log_mutex held */
+static sgx_status_t nf_log_flush_locked(void)
+{
+    sgx_status_t ret = SGX_SUCCESS;
+
+    if (nf_log_len) {
+        ret = ocall_log_flush(nf_log_buffer, nf_log_len);
+        nf_log_len = 0;         /* Dropped if the host could not take it */
+    }
+    return ret;
+}
+
+/*
+ * nf_log_write:
+ *   Appends a line to the buffer; the line is tagged with its level so the
+ *   host can tell it from the NF output. Only flushes past the threshold.
+ */
+void nf_log_write(int level, const char *fmt, ...)
+{
+    char line[NF_LOG_LINE_MAX];
+    va_list ap;
+    int n, head;
+
+    if (level < NF_LOG_LEVEL_ERROR || level > NF_LOG_LEVEL_DEBUG)
+        return;
+
+    head = snprintf(line, sizeof(line), "Log:%s:", nf_log_names[level]);
+    va_start(ap, fmt);
+    n = vsnprintf(line + head, sizeof(line) - (size_t) head - 1, fmt, ap);
+    va_end(ap);
+    if (n < 0)
+        return;
+    n = head + (n < (int) sizeof(line) - head - 1 ? n : (int) sizeof(line) - head - 2);
+    line[n++] = '\n';
+
+    sgx_thread_mutex_lock(&nf_log_mutex);
+    if (nf_log_len + (size_t) n > sizeof(nf_log_buffer))
+        nf_log_flush_locked();
+    memcpy(nf_log_buffer + nf_log_len, line, (size_t) n);
+    nf_log_len += (size_t) n;
+    if (nf_log_len >= NF_LOG_FLUSH_THRESHOLD)
+        nf_log_flush_locked();
+    sgx_thread_mutex_unlock(&nf_log_mutex);
+}
+
+sgx_status_t nf_log_flush(void)
+{
+    sgx_status_t ret;
+
+    sgx_thread_mutex_lock(&nf_log_mutex);
+    ret = nf_log_flush_locked();
+    sgx_thread_mutex_unlock(&nf_log_mutex);
+    return ret;
+}
+
+/*
+ * enclave_log_flush:
+ *   Polled by the host on a timer and at shutdown.
+ */
+sgx_status_t enclave_log_flush(void)
+{
+    return nf_log_flush();
+}
@@ -0,0 +1,134 @@
+/*
+ * enclave_queue.cpp: Bounded lock-free MPMC queue inside the enclave. See
+ * nf_queue.h. The ring is Common/nf_mpmc.cpp; this file only parks and
+ * wakes the threads that wait on it.
+ *
+ * A thread parks only after it has counted itself in the waiters and
+ * tried the queue once more, and the other side checks the count after
+ * its own operation, with a full fence on both sides: either the parking
+ * thread sees the item (or the room), or the other side sees the waiter
+ * and signals it under the mutex, which the parking thread holds until
+ * its wait has begun. No wakeup is lost, and the fast path takes no lock.
+ */
+
+#include "Enclave.h"
+#include "nf_queue.h"
+
+sgx_status_t nf_queue_init(NF_QUEUE_t *q, size_t capacity)
+{
+    if (capacity == 0 || capacity > ((size_t) 1 << 30))
+        return SGX_ERROR_INVALID_PARAMETER;
+    if (nf_mpmc_init(&q->ring, capacity) != 0)
+        return SGX_ERROR_OUT_OF_MEMORY;
+    q->push_waiters = 0;
+    q->pop_waiters = 0;
+    q->closed = 0;
+    q->parks = 0;
+    sgx_thread_mutex_init(&q->mutex, NULL);
+    sgx_thread_cond_init(&q->not_full, NULL);
+    sgx_thread_cond_init(&q->not_empty, NULL);
+    return SGX_SUCCESS;
+}
+
+void nf_queue_free(NF_QUEUE_t *q)
+{
+    sgx_thread_cond_destroy(&q->not_empty);
+    sgx_thread_cond_destroy(&q->not_full);
+    sgx_thread_mutex_destroy(&q->mutex);
+    nf_mpmc_free(&q->ring);
+}
+
+/* Wakes one thread parked on cond, if the count says there is one */
+static void nf_queue_wake(NF_QUEUE_t *q, volatile size_t *waiters, sgx_thread_cond_t *cond)
+{
+    nf_atomic_fence();
+    if (nf_atomic_load_relaxed(waiters) == 0)
+        return;
+    sgx_thread_mutex_lock(&q->mutex);
+    sgx_thread_cond_signal(cond);
+    sgx_thread_mutex_unlock(&q->mutex);
+}
+
+int nf_queue_try_push(NF_QUEUE_t *q, void *item)
+{
+    if (!nf_mpmc_put(&q->ring, item))
+        return 0;
+    nf_queue_wake(q, &q->pop_waiters, &q->not_empty);
+    return 1;
+}
+
+void *nf_queue_try_pop(NF_QUEUE_t *q)
+{
+    void *item = nf_mpmc_take(&q->ring);
+
+    if (item)
+        nf_queue_wake(q, &q->push_waiters, &q->not_full);
+    return item;
+}
+
+int nf_queue_push(NF_QUEUE_t *q, void *item)
+{
+    int pushed = 0;
+
+    for (int i = 0; i < NF_QUEUE_SPIN; i++) {
+        if (nf_atomic_load_relaxed(&q->closed))
+            return 0;
+        if (nf_queue_try_push(q, item))
+            return 1;
+        nf_cpu_relax();
+    }
+
+    sgx_thread_mutex_lock(&q->mutex);
+    nf_atomic_add(&q->push_waiters, 1);
+    nf_atomic_fence();
+    while (!nf_atomic_load(&q->closed) && !(pushed = nf_mpmc_put(&q->ring, item))) {
+        q->parks++;
+        sgx_thread_cond_wait(&q->not_full, &q->mutex);
+    }
+    nf_atomic_sub(&q->push_waiters, 1);
+    sgx_thread_mutex_unlock(&q->mutex);
+
+    /* Outside the mutex: nf_queue_wake() takes it */
+    if (pushed)
+        nf_queue_wake(q, &q->pop_waiters, &q->not_empty);
+    return pushed;
+}
+
+void *nf_queue_pop(NF_QUEUE_t *q)
+{
+    void *item;
+
+    for (int i = 0; i < NF_QUEUE_SPIN; i++) {
+        if ((item = nf_queue_try_pop(q)) != NULL)
+            return item;
+        if (nf_atomic_load_relaxed(&q->closed))
+            return nf_queue_try_pop(q);
+        nf_cpu_relax();
+    }
+
+    sgx_thread_mutex_lock(&q->mutex);
+    nf_atomic_add(&q->pop_waiters, 1);
+    nf_atomic_fence();
+    while ((item = nf_mpmc_take(&q->ring)) == NULL && !nf_atomic_load(&q->closed)) {
+        q->parks++;
+        sgx_thread_cond_wait(&q->not_empty, &q->mutex);
+    }
+    nf_atomic_sub(&q->pop_waiters, 1);
+    sgx_thread_mutex_unlock(&q->mutex);
+
+    if (item) {
+        nf_queue_wake(q, &q->push_waiters, &q->not_full);
+        return item;
+    }
+    /* Closed: the pushes all completed before, so what is left is there to drain */
+    return nf_queue_try_pop(q);
+}
+
+void nf_queue_close(NF_QUEUE_t *q)
+{
+    sgx_thread_mutex_lock(&q->mutex);
+    nf_atomic_store(&q->closed, 1);
+    sgx_thread_cond_broadcast(&q->not_full);
+    sgx_thread_cond_broadcast(&q->not_empty);
+    sgx_thread_mutex_unlock(&q->mutex);
+}
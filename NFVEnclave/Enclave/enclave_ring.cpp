@@ -0,0 +1,112 @@
+/*
+ * enclave_ring.cpp: Enclave workers fed through an nf_ring. See nf_ring.h.
+ *
+ * Each worker is entered once and then polls its ring, so in steady state
+ * a page costs no transition at all. The ring and the arena holding the
+ * pages are untrusted: every descriptor is copied in and checked before
+ * use, and nf_tile_run() decrypts each page from per-tile snapshots, so
+ * the host cannot change it under the NF. Each page comes under the IV of
+ * its descriptor, and each output page is encrypted under an IV of its
+ * own from nf_session_default_iv(), which its result returns.
+ */
+
+#include <string.h>
+#include "Enclave.h"
+#include "Enclave_t.h"
+#include "sgx_trts.h"
+#include "sgx_lfence.h"
+#include "nf_ring.h"
+#include "nf_session.h"
+#include "nf_kernels.h"
+#include "nf_log.h"
+
+/* Idle polls before the worker lets the host schedule something else */
+#define NF_RING_SPIN 4096
+
+static sgx_status_t nf_ring_page(const nf_batch_desc_t *desc, nf_id_t nf,
+                                 uint8_t *arena, size_t arena_len, nf_batch_result_t *result)
+{
+    NF_STAGE_t stage;
+    NF_ANY_STATE_t state;
+    size_t oSize = 0;
+    sgx_status_t ret;
+
+    result->out_len = 0;
+    result->matched = 0;
+    if (desc->in_offset > arena_len || desc->in_len > arena_len - desc->in_offset ||
+        desc->out_offset > arena_len || desc->out_cap > arena_len - desc->out_offset ||
+        nf_session_default_check_iv(desc->iv) != SGX_SUCCESS)
+        return SGX_ERROR_INVALID_PARAMETER;
+    sgx_lfence();
+
+    ret = nf_stage_init(&stage, nf, &state);
+    if (ret == SGX_SUCCESS)
+        ret = nf_session_default_iv(result->iv, &result->out_seq);
+    if (ret != SGX_SUCCESS)
+        return ret;
+
+    ret = nf_tile_run(&stage, 1, nf_session_default_key(), desc->iv, arena + desc->in_offset,
+                      desc->in_len, desc->mac, result->iv, arena + desc->out_offset,
+                      desc->out_cap, &oSize, result->mac);
+    result->out_len = oSize;
+    if (ret != SGX_SUCCESS) {
+        memset(result->iv, 0, sizeof(result->iv));
+        result->out_seq = 0;
+    }
+    if (ret == SGX_SUCCESS && nf == NF_IDS)
+        result->matched = state.ids.matched;
+    return ret;
+}
+
+/*
+ * enclave_ring_worker:
+ *   Serves the pages queued on ring until the host sets ring->stop and the
+ *   ring is empty. Outputs go to their slots in arena, following the
+ *   [user_check] convention of the single-page ECALLs.
+ */
+sgx_status_t enclave_ring_worker(void* ring_p, uint8_t* arena, size_t arena_len)
+{
+    NF_RING_t *ring = (NF_RING_t *) ring_p;
+    uint64_t done;
+    unsigned idle = 0;
+
+    if (!ring || !sgx_is_outside_enclave(ring, sizeof(*ring)) ||
+        !arena || !sgx_is_outside_enclave(arena, arena_len))
+        return SGX_ERROR_INVALID_PARAMETER;
+
+    done = ring->done;
+    NF_LOG_INFO("ring worker started at slot %llu", (unsigned long long) done);
+    for (;;) {
+        uint64_t head = nf_ring_load(&ring->head);
+        NF_RING_SLOT_t *slot;
+        nf_batch_desc_t desc;
+        nf_batch_result_t result;
+        uint32_t nf;
+
+        if (done == head) {
+            if (ring->stop)
+                break;
+            if (++idle < NF_RING_SPIN) {
+                nf_ring_pause();
+            } else {
+                idle = 0;
+                ocall_ring_idle();
+            }
+            continue;
+        }
+        idle = 0;
+
+        /* The host may rewrite the slot at any time: use a copy */
+        slot = &ring->slots[done & NF_RING_MASK];
+        memcpy(&desc, &slot->desc, sizeof(desc));
+        nf = slot->nf;
+
+        memset(&result, 0, sizeof(result));
+        result.status = nf_ring_page(&desc, (nf_id_t) nf, arena, arena_len, &result);
+        memcpy(&slot->result, &result, sizeof(result));
+        nf_ring_store(&ring->done, ++done);
+    }
+    NF_LOG_INFO("ring worker stopped at slot %llu", (unsigned long long) done);
+
+    return SGX_SUCCESS;
+}
@@ -0,0 +1,344 @@
+/*
+ * enclave_ruleset.cpp: Badword ruleset provisioned by the host. See
+ * nf_ruleset.h.
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include "Enclave.h"
+#include "Enclave_t.h"
+#include "sgx_thread.h"
+#include "sgx_tseal.h"
+#include "nf_ruleset.h"
+#include "nf_session.h"
+#include "nf_log.h"
+
+struct nf_ruleset
+{
+    char *text;             /**< The patterns, each followed by a NUL */
+    size_t len;
+    size_t count;           /**< Patterns in text */
+    unsigned refs;          /**< Pages using it, plus one while current */
+    AC_TRIE_t *idle[NF_RULESET_IDLE];   /**< Finalized tries, not in use */
+    size_t nidle;
+};
+
+static NF_RULESET_t *nf_ruleset_current = NULL;
+static sgx_thread_mutex_t nf_ruleset_mutex = SGX_THREAD_MUTEX_INITIALIZER;
+
+/*
+ * nf_ruleset_parse:
+ *   Packs the patterns of text[0..len) in place, in a single pass: each
+ *   pattern is followed by a NUL, empty ones are dropped and so is the CR
+ *   of a CRLF line. text must have room for len + 1 bytes. Returns the
+ *   packed length, or (size_t) -1 if a pattern is too long for the trie.
+ */
+static size_t nf_ruleset_parse(char *text, size_t len, size_t *count)
+{
+    size_t w = 0, start = 0;
+
+    *count = 0;
+    for (size_t i = 0; i <= len; i++) {
+        char c = i < len ? text[i] : '\0';
+
+        if (c != '|' && c != '\n' && c != '\0') {
+            text[w++] = c;
+            continue;
+        }
+        if (c == '\n' && w > start && text[w - 1] == '\r')
+            w--;
+        if (w == start)
+            continue;
+        if (w - start > AC_PATTRN_MAX_LENGTH)
+            return (size_t) -1;
+        text[w++] = '\0';
+        start = w;
+        (*count)++;
+    }
+    return w;
+}
+
+/* A finalized trie of the patterns of r; they stay in r->text */
+static AC_TRIE_t *nf_ruleset_build(const NF_RULESET_t *r)
+{
+    AC_TRIE_t *trie = ac_trie_create();
+    size_t n;
+
+    if (!trie)
+        return NULL;
+    for (const char *p = r->text; p < r->text + r->len; p += n + 1) {
+        n = strlen(p);
+        AC_PATTERN_t pattern = {{p, n}, {"", 0}, {{0}, AC_PATTID_TYPE_DEFAULT}};
+        /* A duplicate is refused by the trie, the first one stays */
+        ac_trie_add(trie, &pattern, 0);
+    }
+    ac_trie_finalize(trie);
+    return trie;
+}
+
+static void nf_ruleset_free(NF_RULESET_t *r)
+{
+    for (size_t i = 0; i < r->nidle; i++)
+        ac_trie_release(r->idle[i]);
+    free(r->text);
+    free(r);
+}
+
+/*
+ * nf_ruleset_create:
+ *   Makes a ruleset of the len bytes of text, a malloc'ed buffer of
+ *   len + 1 bytes that the ruleset takes over, and builds its first trie.
+ */
+static sgx_status_t nf_ruleset_create(char *text, size_t len, NF_RULESET_t **rules)
+{
+    NF_RULESET_t *r;
+    size_t count;
+
+    len = nf_ruleset_parse(text, len, &count);
+    if (len == (size_t) -1 || !count) {
+        free(text);
+        return SGX_ERROR_INVALID_PARAMETER;
+    }
+    r = (NF_RULESET_t *) calloc(1, sizeof(*r));
+    if (!r) {
+        free(text);
+        return SGX_ERROR_OUT_OF_MEMORY;
+    }
+    r->text = text;
+    r->len = len;
+    r->count = count;
+    r->refs = 1;
+    r->idle[0] = nf_ruleset_build(r);
+    if (!r->idle[0]) {
+        nf_ruleset_free(r);
+        return SGX_ERROR_OUT_OF_MEMORY;
+    }
+    r->nidle = 1;
+    *rules = r;
+    return SGX_SUCCESS;
+}
+
+/*
+ * nf_ruleset_install:
+ *   Makes r the current ruleset. With only_first, r is dropped instead if
+ *   another thread installed one meanwhile.
+ */
+static void nf_ruleset_install(NF_RULESET_t *r, int only_first)
+{
+    NF_RULESET_t *dead = NULL;
+
+    sgx_thread_mutex_lock(&nf_ruleset_mutex);
+    if (only_first && nf_ruleset_current) {
+        dead = r;
+    } else {
+        if (nf_ruleset_current && --nf_ruleset_current->refs == 0)
+            dead = nf_ruleset_current;
+        nf_ruleset_current = r;
+    }
+    sgx_thread_mutex_unlock(&nf_ruleset_mutex);
+    if (dead)
+        nf_ruleset_free(dead);
+}
+
+/* Takes over text like nf_ruleset_create() and makes it the current ruleset */
+static sgx_status_t nf_ruleset_provision(char *text, size_t len, size_t *count)
+{
+    NF_RULESET_t *r;
+    sgx_status_t ret;
+
+    ret = nf_ruleset_create(text, len, &r);
+    if (ret != SGX_SUCCESS)
+        return ret;
+    *count = r->count;
+    nf_ruleset_install(r, 0);
+    NF_LOG_INFO("ruleset: %zu patterns provisioned", *count);
+    return SGX_SUCCESS;
+}
+
+/* Falls back to the variant's compiled-in patterns */
+static sgx_status_t nf_ruleset_default(void)
+{
+    size_t len = strlen(nf_badword_default_rules);
+    char *text = (char *) malloc(len + 1);
+    NF_RULESET_t *r;
+    sgx_status_t ret;
+
+    if (!text)
+        return SGX_ERROR_OUT_OF_MEMORY;
+    memcpy(text, nf_badword_default_rules, len);
+    ret = nf_ruleset_create(text, len, &r);
+    if (ret == SGX_SUCCESS)
+        nf_ruleset_install(r, 1);
+    return ret;
+}
+
+/*
+ * nf_ruleset_acquire:
+ *   Returns a finalized trie of the current ruleset for one page, and in
+ *   *rules the ruleset to give it back to with nf_ruleset_release(). The
+ *   page keeps its ruleset even if the host provisions another one.
+ */
+AC_TRIE_t *nf_ruleset_acquire(NF_RULESET_t **rules)
+{
+    NF_RULESET_t *r;
+    AC_TRIE_t *trie = NULL;
+
+    *rules = NULL;
+    sgx_thread_mutex_lock(&nf_ruleset_mutex);
+    if (!nf_ruleset_current) {
+        sgx_thread_mutex_unlock(&nf_ruleset_mutex);
+        if (nf_ruleset_default() != SGX_SUCCESS)
+            return NULL;
+        sgx_thread_mutex_lock(&nf_ruleset_mutex);
+    }
+    r = nf_ruleset_current;
+    r->refs++;
+    if (r->nidle)
+        trie = r->idle[--r->nidle];
+    sgx_thread_mutex_unlock(&nf_ruleset_mutex);
+
+    if (!trie)
+        trie = nf_ruleset_build(r);
+    if (!trie) {
+        nf_ruleset_release(r, NULL);
+        return NULL;
+    }
+    *rules = r;
+    return trie;
+}
+
+/*
+ * nf_ruleset_release:
+ *   Gives back a trie from nf_ruleset_acquire(). It is kept for the next
+ *   page if its ruleset is still the current one, whatever state the page
+ *   left it in.
+ */
+void nf_ruleset_release(NF_RULESET_t *rules, AC_TRIE_t *trie)
+{
+    NF_RULESET_t *dead = NULL;
+
+    if (!rules) {
+        if (trie)
+            ac_trie_release(trie);
+        return;
+    }
+    if (trie)
+        multifast_rep_reset(trie);
+
+    sgx_thread_mutex_lock(&nf_ruleset_mutex);
+    if (trie && rules == nf_ruleset_current && rules->nidle < NF_RULESET_IDLE) {
+        rules->idle[rules->nidle++] = trie;
+        trie = NULL;
+    }
+    if (--rules->refs == 0)
+        dead = rules;
+    sgx_thread_mutex_unlock(&nf_ruleset_mutex);
+
+    if (trie)
+        ac_trie_release(trie);
+    if (dead)
+        nf_ruleset_free(dead);
+}
+
+/*
+ * enclave_ruleset_load:
+ *   Replaces the badword ruleset with the len bytes of rules. With a mac,
+ *   rules is encrypted like a page, under the default key and an IV of
+ *   its own, iv, and is only taken if the tag matches. Pages in flight
+ *   finish with the ruleset they started with.
+ */
+sgx_status_t enclave_ruleset_load(uint8_t* rules, size_t len, uint8_t* mac, uint8_t* iv,
+                                  size_t* count)
+{
+    char *text;
+
+    if (!rules || !count || len > NF_RULESET_MAX)
+        return SGX_ERROR_INVALID_PARAMETER;
+    if (mac && (!iv || nf_session_default_check_iv(iv) != SGX_SUCCESS))
+        return SGX_ERROR_INVALID_PARAMETER;
+    *count = 0;
+    text = (char *) malloc(len + 1);
+    if (!text)
+        return SGX_ERROR_OUT_OF_MEMORY;
+
+    if (!mac) {
+        memcpy(text, rules, len);
+    } else if (nf_gcm_decrypt(nf_session_default_key(), iv, rules, len, (uint8_t *) text,
+                              mac)) {
+        NF_LOG_WARN("ruleset: tag mismatch, ruleset refused");
+        free(text);
+        return SGX_ERROR_MAC_MISMATCH;
+    }
+    return nf_ruleset_provision(text, len, count);
+}
+
+/*
+ * enclave_ruleset_seal:
+ *   Seals the current ruleset to the enclave's signer, for
+ *   enclave_ruleset_unseal at a later start. *sealed_len receives the
+ *   size of the blob; if it exceeds cap nothing is sealed and the call
+ *   fails with SGX_ERROR_INVALID_PARAMETER, so a call with cap 0 asks for
+ *   the size.
+ */
+sgx_status_t enclave_ruleset_seal(uint8_t* sealed, size_t cap, size_t* sealed_len)
+{
+    NF_RULESET_t *r;
+    uint32_t need;
+    sgx_status_t ret;
+
+    if (!sealed_len)
+        return SGX_ERROR_INVALID_PARAMETER;
+    *sealed_len = 0;
+
+    sgx_thread_mutex_lock(&nf_ruleset_mutex);
+    r = nf_ruleset_current;
+    if (r)
+        r->refs++;
+    sgx_thread_mutex_unlock(&nf_ruleset_mutex);
+    if (!r)
+        return SGX_ERROR_INVALID_STATE;
+
+    need = sgx_calc_sealed_data_size(0, (uint32_t) r->len);
+    if (need == UINT32_MAX) {
+        ret = SGX_ERROR_UNEXPECTED;
+    } else {
+        *sealed_len = need;
+        if (!sealed || cap < need)
+            ret = SGX_ERROR_INVALID_PARAMETER;
+        else
+            ret = sgx_seal_data(0, NULL, (uint32_t) r->len, (const uint8_t *) r->text,
+                                need, (sgx_sealed_data_t *) sealed);
+    }
+    nf_ruleset_release(r, NULL);
+    return ret;
+}
+
+/*
+ * enclave_ruleset_unseal:
+ *   Makes the ruleset sealed by enclave_ruleset_seal the current one.
+ */
+sgx_status_t enclave_ruleset_unseal(uint8_t* sealed, size_t len, size_t* count)
+{
+    const sgx_sealed_data_t *blob = (const sgx_sealed_data_t *) sealed;
+    uint32_t text_len;
+    char *text;
+    sgx_status_t ret;
+
+    if (!sealed || !count || len < sizeof(sgx_sealed_data_t))
+        return SGX_ERROR_INVALID_PARAMETER;
+    *count = 0;
+    text_len = sgx_get_encrypt_txt_len(blob);
+    if (text_len > NF_RULESET_MAX || sgx_calc_sealed_data_size(0, text_len) > len)
+        return SGX_ERROR_INVALID_PARAMETER;
+    text = (char *) malloc((size_t) text_len + 1);
+    if (!text)
+        return SGX_ERROR_OUT_OF_MEMORY;
+
+    ret = sgx_unseal_data(blob, NULL, NULL, (uint8_t *) text, &text_len);
+    if (ret != SGX_SUCCESS) {
+        NF_LOG_WARN("ruleset: unsealing failed (0x%x)", ret);
+        free(text);
+        return ret;
+    }
+    return nf_ruleset_provision(text, text_len, count);
+}
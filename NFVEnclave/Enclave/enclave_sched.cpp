@@ -0,0 +1,323 @@
+/*
+ * enclave_sched.cpp: Work-stealing scheduler of the enclave's threads. See
+ * nf_sched.h.
+ *
+ * A task holds a range of chunks. Whoever runs it keeps splitting the
+ * range in two and pushes the far half on its own deque until one chunk
+ * is left, so a thief always finds half of what is left of a loop at the
+ * top of a deque, and a fork of any size fits in log2(chunks) entries.
+ * Each task that ends decrements the pending count of its loop; the
+ * thread that forked the loop helps until the count is zero.
+ *
+ * Workers park like the waiters of nf_queue: an idle worker counts itself
+ * in the sleepers under the mutex and looks at the deques once more, a
+ * pusher checks the sleepers after its push, with a full fence on both
+ * sides, and wakes them under the mutex.
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include "Enclave.h"
+#include "Enclave_t.h"
+#include "sgx_thread.h"
+#include "nf_sched.h"
+
+#define NF_SCHED_MASK (NF_SCHED_DEQUE - 1)
+
+struct nf_sched_task
+{
+    nf_sched_fn_t fn;
+    void *arg;
+    size_t lo;
+    size_t hi;
+    size_t grain;
+    volatile size_t *pending;       /**< Tasks of the loop not done yet */
+};
+
+struct nf_sched_slot
+{
+    alignas(NF_CACHE_LINE) volatile size_t top;     /**< Next task to steal */
+    alignas(NF_CACHE_LINE) volatile size_t bottom;  /**< Next free entry, owner only */
+    struct nf_sched_task tasks[NF_SCHED_DEQUE];
+    /* Written by the owner only */
+    volatile uint32_t worker;
+    volatile uint64_t tasks_run;
+    volatile uint64_t items;
+    volatile uint64_t steals;
+    volatile uint64_t failed_steals;
+    volatile uint64_t parks;
+};
+
+static struct nf_sched_slot sched_slots[NF_SCHED_SLOTS];
+static volatile size_t sched_nslots = 0;       /* Slots handed out, may overshoot */
+static volatile size_t sched_workers = 0;
+static volatile size_t sched_sleepers = 0;
+static volatile size_t sched_stopped = 0;      /* Last generation stopped */
+static sgx_thread_mutex_t sched_mutex = SGX_THREAD_MUTEX_INITIALIZER;
+static sgx_thread_cond_t sched_wakeup = SGX_THREAD_COND_INITIALIZER;
+
+/* Slot of the TCS + 1, 0 until it forks or works */
+static __thread size_t sched_self = 0;
+static __thread uint32_t sched_seed = 0;
+
+static struct nf_sched_slot *nf_sched_slot(void)
+{
+    if (sched_self == 0) {
+        sched_self = nf_atomic_add(&sched_nslots, 1);
+        sched_seed = (uint32_t) sched_self * 2654435761u;
+    }
+    return sched_self <= NF_SCHED_SLOTS ? &sched_slots[sched_self - 1] : NULL;
+}
+
+static size_t nf_sched_nslots(void)
+{
+    size_t n = nf_atomic_load(&sched_nslots);
+
+    return n < NF_SCHED_SLOTS ? n : NF_SCHED_SLOTS;
+}
+
+/* Owner: returns 0 if the deque is full */
+static int nf_sched_push(struct nf_sched_slot *s, const struct nf_sched_task *t)
+{
+    size_t b = nf_atomic_load_relaxed(&s->bottom);
+    size_t top = nf_atomic_load(&s->top);
+
+    if (b - top >= NF_SCHED_DEQUE)
+        return 0;
+    s->tasks[b & NF_SCHED_MASK] = *t;
+    nf_atomic_store(&s->bottom, b + 1);
+    return 1;
+}
+
+/* Owner: takes the newest task */
+static int nf_sched_pop(struct nf_sched_slot *s, struct nf_sched_task *t)
+{
+    size_t b = nf_atomic_load_relaxed(&s->bottom) - 1;
+    size_t top;
+    int ok = 1;
+
+    /* Claim the entry before looking at top, so a thief sees the claim */
+    __atomic_store_n(&s->bottom, b, __ATOMIC_RELAXED);
+    nf_atomic_fence();
+    top = nf_atomic_load_relaxed(&s->top);
+    if ((intptr_t) (b - top) < 0) {
+        __atomic_store_n(&s->bottom, b + 1, __ATOMIC_RELAXED);
+        return 0;
+    }
+    *t = s->tasks[b & NF_SCHED_MASK];
+    if (b == top) {
+        /* The last task: race the thieves for it */
+        ok = nf_atomic_cas_strong(&s->top, &top, top + 1);
+        __atomic_store_n(&s->bottom, b + 1, __ATOMIC_RELAXED);
+    }
+    return ok;
+}
+
+/* Any thread: takes the oldest task; 0 if there is none or a race was lost */
+static int nf_sched_take(struct nf_sched_slot *s, struct nf_sched_task *t)
+{
+    size_t top = nf_atomic_load(&s->top);
+    size_t b;
+
+    nf_atomic_fence();
+    b = nf_atomic_load(&s->bottom);
+    if ((intptr_t) (b - top) <= 0)
+        return 0;
+    *t = s->tasks[top & NF_SCHED_MASK];
+    return nf_atomic_cas_strong(&s->top, &top, top + 1);
+}
+
+/* One round over the other deques, from a random one */
+static int nf_sched_steal(struct nf_sched_slot *self, struct nf_sched_task *t)
+{
+    size_t n = nf_sched_nslots();
+    size_t start;
+
+    if (n < 2)
+        return 0;
+    sched_seed ^= sched_seed << 13;
+    sched_seed ^= sched_seed >> 17;
+    sched_seed ^= sched_seed << 5;
+    start = sched_seed % n;
+    for (size_t i = 0; i < n; i++) {
+        struct nf_sched_slot *victim = &sched_slots[(start + i) % n];
+
+        if (victim != self && nf_sched_take(victim, t)) {
+            self->steals++;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static int nf_sched_any_work(void)
+{
+    size_t n = nf_sched_nslots();
+
+    for (size_t i = 0; i < n; i++)
+        if ((intptr_t) (nf_atomic_load(&sched_slots[i].bottom) -
+                        nf_atomic_load(&sched_slots[i].top)) > 0)
+            return 1;
+    return 0;
+}
+
+/* Wakes the parked workers, if the count says there are some */
+static void nf_sched_wake(void)
+{
+    nf_atomic_fence();
+    if (nf_atomic_load_relaxed(&sched_sleepers) == 0)
+        return;
+    sgx_thread_mutex_lock(&sched_mutex);
+    sgx_thread_cond_broadcast(&sched_wakeup);
+    sgx_thread_mutex_unlock(&sched_mutex);
+}
+
+static void nf_sched_park(struct nf_sched_slot *self, size_t generation)
+{
+    sgx_thread_mutex_lock(&sched_mutex);
+    nf_atomic_add(&sched_sleepers, 1);
+    nf_atomic_fence();
+    if (!nf_sched_any_work() && nf_atomic_load(&sched_stopped) < generation) {
+        self->parks++;
+        sgx_thread_cond_wait(&sched_wakeup, &sched_mutex);
+    }
+    nf_atomic_sub(&sched_sleepers, 1);
+    sgx_thread_mutex_unlock(&sched_mutex);
+}
+
+static void nf_sched_run(struct nf_sched_slot *self, const struct nf_sched_task *task)
+{
+    struct nf_sched_task half = *task;
+    size_t lo = task->lo, hi = task->hi, grain = task->grain;
+
+    /* Leave the far half to the thieves until one chunk is left */
+    while (hi - lo > grain) {
+        size_t chunks = (hi - lo + grain - 1) / grain;
+
+        half.lo = lo + chunks / 2 * grain;
+        half.hi = hi;
+        nf_atomic_add(task->pending, 1);
+        if (!nf_sched_push(self, &half)) {
+            nf_atomic_sub(task->pending, 1);
+            break;
+        }
+        nf_sched_wake();
+        hi = half.lo;
+    }
+
+    self->tasks_run++;
+    self->items += hi - lo;
+    for (; lo < hi; lo += grain)
+        task->fn(lo, hi - lo > grain ? lo + grain : hi, task->arg);
+    /* The forking thread may return once this is zero: touch nothing after */
+    nf_atomic_sub(task->pending, 1);
+}
+
+void nf_parallel_for(size_t begin, size_t end, size_t grain, nf_sched_fn_t fn, void *arg)
+{
+    struct nf_sched_slot *self = NULL;
+    struct nf_sched_task task;
+    volatile size_t pending = 1;
+
+    if (begin >= end)
+        return;
+    if (grain == 0)
+        grain = 1;
+    if (end - begin > grain && nf_atomic_load(&sched_workers) != 0)
+        self = nf_sched_slot();
+    if (!self) {
+        for (size_t lo = begin; lo < end; lo += grain)
+            fn(lo, end - lo > grain ? lo + grain : end, arg);
+        return;
+    }
+
+    task.fn = fn;
+    task.arg = arg;
+    task.lo = begin;
+    task.hi = end;
+    task.grain = grain;
+    task.pending = &pending;
+    nf_sched_run(self, &task);
+
+    /* Help with whatever is left, ours first, until the loop is done */
+    while (nf_atomic_load(&pending) != 0) {
+        if (nf_sched_pop(self, &task) || nf_sched_steal(self, &task))
+            nf_sched_run(self, &task);
+        else
+            nf_cpu_relax();
+    }
+}
+
+size_t nf_sched_workers(void)
+{
+    return nf_atomic_load(&sched_workers);
+}
+
+/*
+ * enclave_sched_worker:
+ *   Runs tasks until the host stops generation with enclave_sched_stop().
+ *   The host numbers its starts from 1 and hands every worker of a start
+ *   the same generation.
+ */
+sgx_status_t enclave_sched_worker(uint64_t generation)
+{
+    struct nf_sched_slot *self = nf_sched_slot();
+    struct nf_sched_task task;
+    unsigned idle = 0;
+
+    if (generation == 0)
+        return SGX_ERROR_INVALID_PARAMETER;
+    if (!self)
+        return SGX_ERROR_OUT_OF_TCS;
+
+    self->worker = 1;
+    nf_atomic_add(&sched_workers, 1);
+    while (nf_atomic_load(&sched_stopped) < generation) {
+        if (nf_sched_pop(self, &task) || nf_sched_steal(self, &task)) {
+            nf_sched_run(self, &task);
+            idle = 0;
+            continue;
+        }
+        self->failed_steals++;
+        if (++idle < NF_SCHED_SPIN) {
+            nf_cpu_relax();
+        } else {
+            idle = 0;
+            nf_sched_park(self, generation);
+        }
+    }
+    nf_atomic_sub(&sched_workers, 1);
+    return SGX_SUCCESS;
+}
+
+sgx_status_t enclave_sched_stop(uint64_t generation)
+{
+    if (generation == 0)
+        return SGX_ERROR_INVALID_PARAMETER;
+    nf_atomic_store(&sched_stopped, generation);
+    nf_atomic_fence();
+    sgx_thread_mutex_lock(&sched_mutex);
+    sgx_thread_cond_broadcast(&sched_wakeup);
+    sgx_thread_mutex_unlock(&sched_mutex);
+    return SGX_SUCCESS;
+}
+
+sgx_status_t enclave_sched_stats(nf_sched_stats_t* stats, size_t n, size_t* slots, size_t* workers)
+{
+    size_t used = nf_sched_nslots();
+
+    if (!slots || !workers || (n && !stats))
+        return SGX_ERROR_INVALID_PARAMETER;
+    for (size_t i = 0; i < used && i < n; i++) {
+        memset(&stats[i], 0, sizeof(stats[i]));
+        stats[i].worker = sched_slots[i].worker;
+        stats[i].tasks = sched_slots[i].tasks_run;
+        stats[i].items = sched_slots[i].items;
+        stats[i].steals = sched_slots[i].steals;
+        stats[i].failed_steals = sched_slots[i].failed_steals;
+        stats[i].parks = sched_slots[i].parks;
+    }
+    *slots = used;
+    *workers = nf_sched_workers();
+    return SGX_SUCCESS;
+}
@@ -0,0 +1,349 @@
+/*
+ * enclave_session.cpp: Per-flow crypto sessions. See nf_session.h.
+ */
+
+#include <string.h>
+#include "Enclave.h"
+#include "Enclave_t.h"
+#include "sgx_thread.h"
+#include "sgx_trts.h"
+#include "nf_session.h"
+#include "nf_kernels.h"
+#include "nf_log.h"
+
+/* Page key, defined by the enclave variant */
+extern uint8_t data_key[16];
+
+static NF_SESSION_t nf_sessions[NF_SESSION_MAX];
+static sgx_thread_mutex_t nf_session_mutex = SGX_THREAD_MUTEX_INITIALIZER;
+static uint64_t nf_session_opens = 0;       /* Epoch of the last session opened */
+
+static NF_GCM_KEY_t nf_default_key;
+static volatile int nf_default_key_ready = 0;
+static uint64_t nf_default_out_seq = 0;     /* 0 until the first outbound IV */
+
+/* Must be called with nf_session_mutex held */
+static NF_SESSION_t *nf_session_find(uint32_t flow_id)
+{
+    for (int i = 0; i < NF_SESSION_MAX; i++)
+        if (nf_sessions[i].used && nf_sessions[i].flow_id == flow_id)
+            return &nf_sessions[i];
+    return NULL;
+}
+
+/*
+ * nf_session_open:
+ *   Creates the session of flow_id and expands its key. The outbound
+ *   sequence numbers start at a random point, so a flow that is closed and
+ *   opened again does not reuse the IVs of its previous incarnation.
+ *   NF_SESSION_DEFAULT_FLOW is taken by the pages without a session.
+ */
+sgx_status_t nf_session_open(uint32_t flow_id, const uint8_t *key)
+{
+    NF_SESSION_t *s = NULL;
+    uint64_t start;
+    sgx_status_t ret;
+
+    if (flow_id == NF_SESSION_DEFAULT_FLOW)
+        return SGX_ERROR_INVALID_PARAMETER;
+    ret = sgx_read_rand((unsigned char *) &start, sizeof(start));
+    if (ret != SGX_SUCCESS)
+        return ret;
+
+    sgx_thread_mutex_lock(&nf_session_mutex);
+    if (nf_session_find(flow_id)) {
+        sgx_thread_mutex_unlock(&nf_session_mutex);
+        return SGX_ERROR_INVALID_STATE;
+    }
+    for (int i = 0; i < NF_SESSION_MAX && !s; i++)
+        if (!nf_sessions[i].used)
+            s = &nf_sessions[i];
+    if (!s) {
+        sgx_thread_mutex_unlock(&nf_session_mutex);
+        return SGX_ERROR_OUT_OF_MEMORY;
+    }
+
+    s->flow_id = flow_id;
+    s->epoch = ++nf_session_opens;
+    s->in_seq = 0;
+    /* Random start in the outbound half, far below the wrap-around */
+    s->out_seq = NF_GCM_SEQ_OUT | (start >> 2);
+    nf_gcm_key_init(&s->key, key);
+    s->used = 1;
+    sgx_thread_mutex_unlock(&nf_session_mutex);
+    return SGX_SUCCESS;
+}
+
+/*
+ * nf_session_close:
+ *   Wipes the session of flow_id. The pages of the flow in flight keep
+ *   their copies of the key and fail at nf_session_page_commit().
+ */
+sgx_status_t nf_session_close(uint32_t flow_id)
+{
+    NF_SESSION_t *s;
+
+    sgx_thread_mutex_lock(&nf_session_mutex);
+    s = nf_session_find(flow_id);
+    if (s) {
+        nf_gcm_key_clear(&s->key);
+        s->used = 0;
+    }
+    sgx_thread_mutex_unlock(&nf_session_mutex);
+    return s ? SGX_SUCCESS : SGX_ERROR_INVALID_PARAMETER;
+}
+
+/*
+ * nf_session_page_begin:
+ *   Prepares a page of flow_id sent with sequence number in_seq: rejects a
+ *   sequence number that was already taken, then takes it along with the
+ *   outbound one. Taking it here rather than once the page is authenticated
+ *   keeps the host from running the same page on several threads at once;
+ *   a page that fails authentication uses up its sequence number.
+ */
+sgx_status_t nf_session_page_begin(uint32_t flow_id, uint64_t in_seq,
+                                   NF_SESSION_PAGE_t *page)
+{
+    NF_SESSION_t *s;
+    sgx_status_t ret = SGX_SUCCESS;
+
+    sgx_thread_mutex_lock(&nf_session_mutex);
+    s = nf_session_find(flow_id);
+    if (!s || in_seq >= NF_GCM_SEQ_OUT)
+        ret = SGX_ERROR_INVALID_PARAMETER;
+    else if (in_seq <= s->in_seq) {
+        NF_LOG_WARN("flow %u: replayed page %llu", flow_id, (unsigned long long) in_seq);
+        ret = SGX_ERROR_INVALID_STATE;      /* Replayed page */
+    }
+    else {
+        s->in_seq = in_seq;
+        page->key = s->key;
+        page->epoch = s->epoch;
+        page->in_seq = in_seq;
+        page->out_seq = s->out_seq++;
+        nf_gcm_make_iv(page->in_iv, flow_id, in_seq);
+        nf_gcm_make_iv(page->out_iv, flow_id, page->out_seq);
+    }
+    sgx_thread_mutex_unlock(&nf_session_mutex);
+    return ret;
+}
+
+/*
+ * nf_session_page_commit:
+ *   Checks that the session that began the page is still open once the
+ *   page is done. Fails if the flow was closed, or closed and opened again,
+ *   in the meantime: the output of the page must then not be released.
+ */
+sgx_status_t nf_session_page_commit(uint32_t flow_id, const NF_SESSION_PAGE_t *page)
+{
+    NF_SESSION_t *s;
+    sgx_status_t ret = SGX_SUCCESS;
+
+    sgx_thread_mutex_lock(&nf_session_mutex);
+    s = nf_session_find(flow_id);
+    if (!s || s->epoch != page->epoch)
+        ret = SGX_ERROR_INVALID_STATE;
+    sgx_thread_mutex_unlock(&nf_session_mutex);
+    return ret;
+}
+
+/*
+ * nf_session_default_key:
+ *   Expanded data_key for the ECALLs that predate sessions, computed once.
+ */
+const NF_GCM_KEY_t *nf_session_default_key(void)
+{
+    if (!nf_default_key_ready) {
+        sgx_thread_mutex_lock(&nf_session_mutex);
+        if (!nf_default_key_ready) {
+            nf_gcm_key_init(&nf_default_key, data_key);
+            __sync_synchronize();
+            nf_default_key_ready = 1;
+        }
+        sgx_thread_mutex_unlock(&nf_session_mutex);
+    }
+    return &nf_default_key;
+}
+
+/*
+ * nf_session_default_iv:
+ *   Reserves the next outbound IV under the default key, for the pages
+ *   without a session. They are flow NF_SESSION_DEFAULT_FLOW, like the
+ *   host's, with outbound sequence numbers that start at a random point
+ *   like those of a session.
+ */
+sgx_status_t nf_session_default_iv(uint8_t *iv, uint64_t *seq)
+{
+    uint64_t start;
+    sgx_status_t ret;
+
+    if (!__atomic_load_n(&nf_default_out_seq, __ATOMIC_ACQUIRE)) {
+        ret = sgx_read_rand((unsigned char *) &start, sizeof(start));
+        if (ret != SGX_SUCCESS)
+            return ret;
+        start = NF_GCM_SEQ_OUT | (start >> 2);
+        sgx_thread_mutex_lock(&nf_session_mutex);
+        if (!nf_default_out_seq)
+            __atomic_store_n(&nf_default_out_seq, start, __ATOMIC_RELEASE);
+        sgx_thread_mutex_unlock(&nf_session_mutex);
+    }
+    *seq = __atomic_fetch_add(&nf_default_out_seq, 1, __ATOMIC_RELAXED);
+    nf_gcm_make_iv(iv, NF_SESSION_DEFAULT_FLOW, *seq);
+    return SGX_SUCCESS;
+}
+
+/*
+ * nf_session_default_check_iv:
+ *   Checks that iv is one the host may encrypt a page under with the
+ *   default key: flow NF_SESSION_DEFAULT_FLOW and an inbound sequence
+ *   number, so that it never meets an IV of the enclave's output.
+ */
+sgx_status_t nf_session_default_check_iv(const uint8_t *iv)
+{
+    uint8_t flow[NF_GCM_IV_SIZE];
+
+    nf_gcm_make_iv(flow, NF_SESSION_DEFAULT_FLOW, 0);
+    if (memcmp(iv, flow, 4) != 0 || (iv[4] & 0x80))
+        return SGX_ERROR_INVALID_PARAMETER;
+    return SGX_SUCCESS;
+}
+
+/*
+ * nf_session_default_run:
+ *   Runs the stages over a page without a session: the input is under the
+ *   default key and in_iv, which nf_session_default_check_iv() must
+ *   accept, the output under the next outbound IV of
+ *   nf_session_default_iv(), which goes to out_iv and out_seq, and its tag
+ *   to out_mac. A page that fails gets no IV either.
+ */
+sgx_status_t nf_session_default_run(NF_STAGE_t *stages, size_t nstages, const uint8_t *in_iv,
+                                    const uint8_t *cyphertext, size_t lSize,
+                                    const uint8_t *en_mac, uint8_t *out, size_t oCap,
+                                    size_t *oSize, uint8_t *out_mac, uint8_t *out_iv,
+                                    uint64_t *out_seq)
+{
+    sgx_status_t ret;
+
+    *oSize = 0;
+    ret = nf_session_default_check_iv(in_iv);
+    if (ret == SGX_SUCCESS)
+        ret = nf_session_default_iv(out_iv, out_seq);
+    if (ret == SGX_SUCCESS)
+        ret = nf_tile_run(stages, nstages, nf_session_default_key(), in_iv, cyphertext, lSize,
+                          en_mac, out_iv, out, oCap, oSize, out_mac);
+    if (ret != SGX_SUCCESS) {
+        memset(out_iv, 0, NF_GCM_IV_SIZE);
+        *out_seq = 0;
+    }
+    return ret;
+}
+
+/*
+ * nf_session_default_run_page:
+ *   nf_session_default_run() for an NF that takes the page in one piece
+ *   through nf_tile_run_page().
+ */
+sgx_status_t nf_session_default_run_page(NF_PAGE_CALBACK_f fn, void *user, const uint8_t *in_iv,
+                                         const uint8_t *cyphertext, size_t lSize,
+                                         const uint8_t *en_mac, uint8_t *out, size_t oCap,
+                                         size_t *oSize, uint8_t *out_mac, uint8_t *out_iv,
+                                         uint64_t *out_seq)
+{
+    sgx_status_t ret;
+
+    *oSize = 0;
+    ret = nf_session_default_check_iv(in_iv);
+    if (ret == SGX_SUCCESS)
+        ret = nf_session_default_iv(out_iv, out_seq);
+    if (ret == SGX_SUCCESS)
+        ret = nf_tile_run_page(fn, user, nf_session_default_key(), in_iv, cyphertext, lSize,
+                               en_mac, out_iv, out, oCap, oSize, out_mac);
+    if (ret != SGX_SUCCESS) {
+        memset(out_iv, 0, NF_GCM_IV_SIZE);
+        *out_seq = 0;
+    }
+    return ret;
+}
+
+/*
+ * enclave_session_open:
+ *   Opens flow_id under a key of its own, derived from data_key and a
+ *   random nonce that the host gets back to derive the same key. The
+ *   sequence numbers start over with each open, and so does the key:
+ *   the pages of an earlier session of the flow no longer authenticate.
+ */
+sgx_status_t enclave_session_open(uint32_t flow_id, uint64_t* nonce)
+{
+    uint8_t key[NF_GCM_KEY_SIZE];
+    sgx_status_t ret;
+
+    *nonce = 0;
+    ret = sgx_read_rand((unsigned char *) nonce, sizeof(*nonce));
+    if (ret != SGX_SUCCESS)
+        return ret;
+    nf_gcm_derive_key(nf_session_default_key(), flow_id, *nonce, key);
+    ret = nf_session_open(flow_id, key);
+    for (size_t i = 0; i < sizeof(key); i++)
+        ((volatile uint8_t *) key)[i] = 0;
+    if (ret != SGX_SUCCESS)
+        *nonce = 0;
+    return ret;
+}
+
+sgx_status_t enclave_session_close(uint32_t flow_id)
+{
+    return nf_session_close(flow_id);
+}
+
+/*
+ * enclave_session_process:
+ *   Runs the NF nf over page seq of flow flow_id. The output is encrypted
+ *   under the IV of the outbound sequence number returned in out_seq. A
+ *   page whose flow was closed under it returns nothing, like a page that
+ *   fails authentication: no output, no size and no tag.
+ */
+sgx_status_t enclave_session_process(uint32_t flow_id, nf_id_t nf, uint64_t seq,
+                                     uint8_t* cyphertext, size_t lSize,
+                                     uint8_t* en_mac, size_t* oSize,
+                                     uint8_t* encProcessedtext, size_t oCap, uint8_t* out_mac,
+                                     uint64_t* out_seq, size_t* matched)
+{
+    sgx_status_t ret = SGX_SUCCESS;
+    NF_SESSION_PAGE_t page;
+    NF_STAGE_t stage;
+    NF_ANY_STATE_t state;
+
+    *oSize = 0;
+    *out_seq = 0;
+    *matched = 0;
+
+    ret = nf_tile_check_input(cyphertext, lSize);
+    if (ret == SGX_SUCCESS)
+        ret = nf_tile_check_output(encProcessedtext, oCap);
+    if (ret == SGX_SUCCESS)
+        ret = nf_stage_init(&stage, nf, &state);
+    if (ret != SGX_SUCCESS)
+        return ret;
+
+    ret = nf_session_page_begin(flow_id, seq, &page);
+    if (ret != SGX_SUCCESS)
+        return ret;
+    *out_seq = page.out_seq;
+
+    ret = nf_tile_run(&stage, 1, &page.key, page.in_iv, cyphertext, lSize, en_mac,
+                      page.out_iv, encProcessedtext, oCap, oSize, out_mac);
+    nf_gcm_key_clear(&page.key);
+    if (ret != SGX_SUCCESS)
+        return ret;
+    ret = nf_session_page_commit(flow_id, &page);
+    if (ret != SGX_SUCCESS) {
+        memset(encProcessedtext, 0, *oSize);
+        memset(out_mac, 0, NF_GCM_TAG_SIZE);
+        *oSize = 0;
+        *out_seq = 0;
+        return ret;
+    }
+    if (nf == NF_IDS)
+        *matched = (size_t) state.ids.matched;
+    return ret;
+}
@@ -0,0 +1,100 @@
+/*
+ * enclave_stream.cpp: Block-wise AES-GCM helpers for the NF ECALLs.
+ * See nf_stream.h.
+ */
+
+#include <string.h>
+#include "Enclave.h"
+#include "nf_stream.h"
+
+#define NF_STREAM_PAD_CHUNK 4096
+
+static const uint8_t nf_stream_zeros[NF_STREAM_PAD_CHUNK] = {0};
+
+/*
+ * nf_stream_dec_init:
+ *   Prepares the decryption of a page encrypted with a 96-bit IV.
+ */
+sgx_status_t nf_stream_dec_init(NF_STREAM_DEC_t *thiz,
+                                const NF_GCM_KEY_t *key, const uint8_t *iv)
+{
+    nf_gcm_init(&thiz->gcm, key, iv);
+    return SGX_SUCCESS;
+}
+
+/*
+ * nf_stream_dec_update:
+ *   Decrypts the next len bytes of the page into dst. The plaintext is not
+ *   authenticated until nf_stream_dec_final() returns.
+ */
+sgx_status_t nf_stream_dec_update(NF_STREAM_DEC_t *thiz,
+                                  const uint8_t *src, size_t len, uint8_t *dst)
+{
+    nf_gcm_decrypt_update(&thiz->gcm, src, len, dst);
+    return SGX_SUCCESS;
+}
+
+/*
+ * nf_stream_dec_final:
+ *   Checks the tag of the whole page.
+ */
+sgx_status_t nf_stream_dec_final(NF_STREAM_DEC_t *thiz, const uint8_t *mac)
+{
+    uint8_t tag[NF_GCM_TAG_SIZE];
+
+    nf_gcm_final(&thiz->gcm, tag);
+    return nf_gcm_tag_equal(tag, mac) ? SGX_SUCCESS : SGX_ERROR_MAC_MISMATCH;
+}
+
+/*
+ * nf_stream_enc_init:
+ *   Prepares the encryption of a page into the buffer dst.
+ */
+sgx_status_t nf_stream_enc_init(NF_STREAM_ENC_t *thiz,
+                                const NF_GCM_KEY_t *key, const uint8_t *iv,
+                                uint8_t *dst)
+{
+    nf_gcm_init(&thiz->gcm, key, iv);
+    thiz->dst = dst;
+    thiz->written = 0;
+    return SGX_SUCCESS;
+}
+
+/*
+ * nf_stream_enc_update:
+ *   Encrypts len bytes of trusted plaintext and appends them to the output.
+ *   The GHASH input is taken from registers, never read back from dst.
+ */
+sgx_status_t nf_stream_enc_update(NF_STREAM_ENC_t *thiz,
+                                  const uint8_t *src, size_t len)
+{
+    nf_gcm_encrypt_update(&thiz->gcm, src, len, thiz->dst + thiz->written);
+    thiz->written += len;
+    return SGX_SUCCESS;
+}
+
+/*
+ * nf_stream_enc_pad:
+ *   Appends len encrypted zero bytes to the output.
+ */
+sgx_status_t nf_stream_enc_pad(NF_STREAM_ENC_t *thiz, size_t len)
+{
+    sgx_status_t ret = SGX_SUCCESS;
+
+    while (len && ret == SGX_SUCCESS) {
+        size_t n = len < NF_STREAM_PAD_CHUNK ? len : NF_STREAM_PAD_CHUNK;
+        ret = nf_stream_enc_update(thiz, nf_stream_zeros, n);
+        len -= n;
+    }
+    return ret;
+}
+
+/*
+ * nf_stream_enc_final:
+ *   Produces the tag of the encrypted output.
+ */
+sgx_status_t nf_stream_enc_final(NF_STREAM_ENC_t *thiz, uint8_t *mac)
+{
+    nf_gcm_final(&thiz->gcm, mac);
+    return SGX_SUCCESS;
+}
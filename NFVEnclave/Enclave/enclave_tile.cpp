@@ -0,0 +1,474 @@
+/*
+ * enclave_tile.cpp: Tile-by-tile NF execution framework. See nf_tile.h.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "Enclave.h"
+#include "sgx_trts.h"
+#include "sgx_lfence.h"
+#include "nf_tile.h"
+#include "nf_log.h"
+
+#define NF_TILE_MAX_STAGES 8
+#define NF_TILE_ZERO_CHUNK 4096
+#define NF_TILE_STAGED_MIN (4 * NF_TILE_SIZE)  /* First size of the staged output */
+
+static const uint8_t nf_tile_zeros[NF_TILE_ZERO_CHUNK] = {0};
+
+/*
+ * Stage timing: the clock is handed from stage to stage as the chunks move
+ * down the chain, so every stage is charged only for its own kernel.
+ * Everything else (crypto, framework) goes to a counter nobody reads.
+ */
+struct nf_tile_clock
+{
+    uint64_t last;          /* TSC at the last switch */
+    uint64_t *running;      /* Counter charged until the next switch */
+    uint64_t other;
+};
+
+static inline uint64_t *nf_tile_switch(struct nf_tile_clock *clock, uint64_t *next)
+{
+    uint64_t *prev = clock->running;
+
+#ifdef NF_STAGE_TIMING
+    uint32_t lo, hi;
+    uint64_t now;
+
+    __asm__ volatile ("rdtsc" : "=a" (lo), "=d" (hi));
+    now = ((uint64_t) hi << 32) | lo;
+    *prev += now - clock->last;
+    clock->last = now;
+#endif
+    clock->running = next;
+    return prev;
+}
+
+/* Connects the output of a stage to the next stage or to the sink */
+struct nf_tile_link
+{
+    NF_STAGE_t *from;
+    NF_STAGE_t *to;         /* NULL for the last stage */
+    NF_EMIT_t *sink;
+    struct nf_tile_clock *clock;
+};
+
+/* The stages of one page, wired together */
+struct nf_tile_chain
+{
+    NF_STAGE_t *stages;
+    size_t nstages;
+    size_t begun;           /* Stages whose begin() succeeded */
+    struct nf_tile_link links[NF_TILE_MAX_STAGES];
+    struct nf_tile_clock clock;
+};
+
+/*
+ * Bounded sink that encrypts into a trusted staging buffer, grown as the
+ * output comes up to the cap of the untrusted one. Nothing reaches the
+ * untrusted buffer before the input tag is checked.
+ */
+struct nf_tile_enc_sink
+{
+    NF_STREAM_ENC_t *enc;
+    size_t cap;
+    uint8_t *staged;
+    size_t staged_cap;
+};
+
+/*
+ * nf_tile_forward:
+ *   Emit callback of every stage: hands the chunk to the next stage, or to
+ *   the sink after the last stage.
+ */
+static sgx_status_t nf_tile_forward(const uint8_t *data, size_t len, void *user)
+{
+    struct nf_tile_link *link = (struct nf_tile_link *) user;
+    uint64_t *prev;
+    sgx_status_t ret;
+
+    if (!len)
+        return SGX_SUCCESS;
+
+    link->from->out_bytes += len;
+
+    if (!link->to) {
+        prev = nf_tile_switch(link->clock, &link->clock->other);
+        ret = link->sink->cbf(data, len, link->sink->user);
+    } else {
+        link->to->in_bytes += len;
+        prev = nf_tile_switch(link->clock, &link->to->cycles);
+        ret = link->to->kernel->process(link->to->state, data, len, &link->to->out);
+    }
+    nf_tile_switch(link->clock, prev);
+    return ret;
+}
+
+static sgx_status_t nf_tile_encrypt(const uint8_t *data, size_t len, void *user)
+{
+    struct nf_tile_enc_sink *sink = (struct nf_tile_enc_sink *) user;
+    size_t need = sink->enc->written + len;
+
+    if (!len)
+        return SGX_SUCCESS;
+    if (len > sink->cap - sink->enc->written)
+        return SGX_ERROR_INVALID_PARAMETER;     /* Output slot too small */
+    if (need > sink->staged_cap) {
+        size_t grow = sink->staged_cap ? 2 * sink->staged_cap : NF_TILE_STAGED_MIN;
+        uint8_t *staged;
+
+        if (grow < need)
+            grow = need;
+        if (grow > sink->cap)
+            grow = sink->cap;
+        staged = (uint8_t *) realloc(sink->staged, grow);
+        if (!staged)
+            return SGX_ERROR_OUT_OF_MEMORY;
+        sink->staged = staged;
+        sink->staged_cap = grow;
+        sink->enc->dst = staged;
+    }
+    return nf_stream_enc_update(sink->enc, data, len);
+}
+
+/* Wires the stages to each other and to sink, and begins them */
+static sgx_status_t nf_tile_chain_begin(struct nf_tile_chain *chain, NF_STAGE_t *stages,
+                                        size_t nstages, NF_EMIT_t *sink)
+{
+    sgx_status_t ret = SGX_SUCCESS;
+
+    chain->stages = stages;
+    chain->nstages = nstages;
+    chain->begun = 0;
+    if (!nstages || nstages > NF_TILE_MAX_STAGES)
+        return SGX_ERROR_INVALID_PARAMETER;
+
+    for (size_t i = 0; i < nstages; i++) {
+        chain->links[i].from = &stages[i];
+        chain->links[i].to = (i + 1 < nstages) ? &stages[i + 1] : NULL;
+        chain->links[i].sink = sink;
+        chain->links[i].clock = &chain->clock;
+        stages[i].out.cbf = nf_tile_forward;
+        stages[i].out.user = &chain->links[i];
+        stages[i].in_bytes = 0;
+        stages[i].out_bytes = 0;
+        stages[i].cycles = 0;
+    }
+    chain->clock.last = 0;
+    chain->clock.other = 0;
+    chain->clock.running = &chain->clock.other;
+    nf_tile_switch(&chain->clock, &chain->clock.other);     /* Starts the clock */
+
+    for (; chain->begun < nstages; chain->begun++) {
+        ret = stages[chain->begun].kernel->begin(stages[chain->begun].state);
+        if (ret != SGX_SUCCESS)
+            break;
+    }
+    return ret;
+}
+
+/* Runs the whole chain over the next chunk of the page */
+static sgx_status_t nf_tile_chain_feed(struct nf_tile_chain *chain, const uint8_t *data,
+                                       size_t len)
+{
+    NF_STAGE_t *first = &chain->stages[0];
+    sgx_status_t ret;
+
+    first->in_bytes += len;
+    nf_tile_switch(&chain->clock, &first->cycles);
+    ret = first->kernel->process(first->state, data, len, &first->out);
+    nf_tile_switch(&chain->clock, &chain->clock.other);
+    return ret;
+}
+
+/* Finishing a stage may still push output through the later stages */
+static sgx_status_t nf_tile_chain_finish(struct nf_tile_chain *chain)
+{
+    sgx_status_t ret = SGX_SUCCESS;
+
+    for (size_t i = 0; i < chain->nstages && ret == SGX_SUCCESS; i++) {
+        nf_tile_switch(&chain->clock, &chain->stages[i].cycles);
+        ret = chain->stages[i].kernel->finish(chain->stages[i].state, &chain->stages[i].out);
+        nf_tile_switch(&chain->clock, &chain->clock.other);
+    }
+    return ret;
+}
+
+static void nf_tile_chain_end(struct nf_tile_chain *chain)
+{
+    for (size_t i = 0; i < chain->begun; i++)
+        chain->stages[i].kernel->end(chain->stages[i].state);
+}
+
+/*
+ * nf_tile_run:
+ *   Decrypts the page tile by tile, runs the stages over each tile and
+ *   encrypts the output of the last stage into trusted memory. Once the
+ *   tag of the input checks out, the output goes to the untrusted buffer
+ *   out, which holds oCap bytes, and its tag to out_mac unless it is NULL.
+ *   Each stage reports its byte counts and, with NF_STAGE_TIMING, its own
+ *   cycles. If the page fails, its tag included, nothing is written to out
+ *   or out_mac and *oSize is 0.
+ */
+sgx_status_t nf_tile_run(NF_STAGE_t *stages, size_t nstages,
+                         const NF_GCM_KEY_t *key, const uint8_t *in_iv,
+                         const uint8_t *cyphertext, size_t lSize,
+                         const uint8_t *en_mac, const uint8_t *out_iv,
+                         uint8_t *out, size_t oCap, size_t *oSize, uint8_t *out_mac)
+{
+    NF_STREAM_DEC_t dec;
+    NF_STREAM_ENC_t enc;
+    uint8_t tile[NF_TILE_SIZE];
+    struct nf_tile_chain chain;
+    struct nf_tile_enc_sink enc_sink = {&enc, oCap, NULL, 0};
+    NF_EMIT_t sink = {nf_tile_encrypt, &enc_sink};
+    uint8_t en_mac_new[16];
+    sgx_status_t ret, mac_ret;
+
+    *oSize = 0;
+    ret = nf_stream_dec_init(&dec, key, in_iv);
+    if (ret != SGX_SUCCESS)
+        return ret;
+    ret = nf_stream_enc_init(&enc, key, out_iv, NULL);
+    if (ret != SGX_SUCCESS) {
+        nf_stream_dec_final(&dec, en_mac);
+        return ret;
+    }
+
+    ret = nf_tile_chain_begin(&chain, stages, nstages, &sink);
+
+    /* Decrypt a tile and run the whole chain over it before the next one */
+    for (size_t off = 0; off < lSize && ret == SGX_SUCCESS; off += NF_TILE_SIZE) {
+        size_t len = lSize - off < NF_TILE_SIZE ? lSize - off : NF_TILE_SIZE;
+
+        /*
+         * cyphertext may be untrusted: snapshot the tile so that the tag
+         * and the NF see the same bytes whatever the host does meanwhile
+         */
+        memcpy(tile, cyphertext + off, len);
+        ret = nf_stream_dec_update(&dec, tile, len, tile);
+        if (ret == SGX_SUCCESS)
+            ret = nf_tile_chain_feed(&chain, tile, len);
+    }
+    if (ret == SGX_SUCCESS)
+        ret = nf_tile_chain_finish(&chain);
+    nf_tile_chain_end(&chain);
+
+    mac_ret = nf_stream_dec_final(&dec, en_mac);
+    if (nf_stream_enc_final(&enc, en_mac_new) != SGX_SUCCESS && ret == SGX_SUCCESS)
+        ret = SGX_ERROR_UNEXPECTED;
+    if (ret == SGX_SUCCESS)
+        ret = mac_ret;
+    if (mac_ret != SGX_SUCCESS)
+        NF_LOG_DEBUG("page of %zu bytes failed authentication", lSize);
+
+    /*
+     * The output was produced before the input tag could be checked, so it
+     * is only released now: the host never sees what the enclave would
+     * make of a forged page, not even from another thread mid-page.
+     */
+    if (ret == SGX_SUCCESS) {
+        if (enc.written)
+            memcpy(out, enc_sink.staged, enc.written);
+        if (out_mac)
+            memcpy(out_mac, en_mac_new, sizeof(en_mac_new));
+        *oSize = enc.written;
+    }
+    memset(en_mac_new, 0, sizeof(en_mac_new));
+    free(enc_sink.staged);
+    return ret;
+}
+
+/*
+ * nf_tile_run_page:
+ *   Runs fn over the page in one piece, for the NFs that spread a large
+ *   page over the workers of nf_sched.h. The page is copied into trusted
+ *   memory, decrypted there and its tag checked before fn sees any of it.
+ *   What fn emits is encrypted and released like the output of
+ *   nf_tile_run(). If the page does not fit in the enclave's heap, the
+ *   call fails with SGX_ERROR_OUT_OF_MEMORY before anything ran.
+ */
+sgx_status_t nf_tile_run_page(NF_PAGE_CALBACK_f fn, void *user,
+                              const NF_GCM_KEY_t *key, const uint8_t *in_iv,
+                              const uint8_t *cyphertext, size_t lSize,
+                              const uint8_t *en_mac, const uint8_t *out_iv,
+                              uint8_t *out, size_t oCap, size_t *oSize, uint8_t *out_mac)
+{
+    NF_STREAM_DEC_t dec;
+    NF_STREAM_ENC_t enc;
+    struct nf_tile_enc_sink enc_sink = {&enc, oCap, NULL, 0};
+    NF_EMIT_t sink = {nf_tile_encrypt, &enc_sink};
+    uint8_t en_mac_new[16];
+    uint8_t *page;
+    sgx_status_t ret, mac_ret;
+
+    *oSize = 0;
+    page = (uint8_t *) malloc(lSize ? lSize : 1);
+    if (!page)
+        return SGX_ERROR_OUT_OF_MEMORY;
+
+    /* One snapshot of the untrusted page: the tag and fn see the same bytes */
+    memcpy(page, cyphertext, lSize);
+    ret = nf_stream_dec_init(&dec, key, in_iv);
+    if (ret != SGX_SUCCESS) {
+        free(page);
+        return ret;
+    }
+    ret = nf_stream_dec_update(&dec, page, lSize, page);
+    mac_ret = nf_stream_dec_final(&dec, en_mac);
+    if (ret == SGX_SUCCESS)
+        ret = mac_ret;
+    if (mac_ret != SGX_SUCCESS)
+        NF_LOG_DEBUG("page of %zu bytes failed authentication", lSize);
+
+    if (ret == SGX_SUCCESS) {
+        ret = nf_stream_enc_init(&enc, key, out_iv, NULL);
+        if (ret == SGX_SUCCESS)
+            ret = fn(page, lSize, &sink, user);
+        if (nf_stream_enc_final(&enc, en_mac_new) != SGX_SUCCESS && ret == SGX_SUCCESS)
+            ret = SGX_ERROR_UNEXPECTED;
+    }
+    if (ret == SGX_SUCCESS) {
+        if (enc.written)
+            memcpy(out, enc_sink.staged, enc.written);
+        if (out_mac)
+            memcpy(out_mac, en_mac_new, sizeof(en_mac_new));
+        *oSize = enc.written;
+    }
+    for (size_t i = 0; i < lSize; i++)
+        ((volatile uint8_t *) page)[i] = 0;
+    memset(en_mac_new, 0, sizeof(en_mac_new));
+    free(enc_sink.staged);
+    free(page);
+    return ret;
+}
+
+/*
+ * nf_tile_check_input:
+ *   Validates a [user_check] input page once. nf_tile_run() reads it only
+ *   through per-tile snapshots afterwards.
+ */
+sgx_status_t nf_tile_check_input(const uint8_t *cyphertext, size_t lSize)
+{
+    if (lSize && (!cyphertext || !sgx_is_outside_enclave(cyphertext, lSize)))
+        return SGX_ERROR_INVALID_PARAMETER;
+    sgx_lfence();
+    return SGX_SUCCESS;
+}
+
+/*
+ * nf_tile_check_output:
+ *   Validates a [user_check] output slot of oCap bytes once. nf_tile_run()
+ *   writes no more than oCap bytes to it.
+ */
+sgx_status_t nf_tile_check_output(const uint8_t *out, size_t oCap)
+{
+    if (oCap && (!out || !sgx_is_outside_enclave(out, oCap)))
+        return SGX_ERROR_INVALID_PARAMETER;
+    sgx_lfence();
+    return SGX_SUCCESS;
+}
+
+/*
+ * nf_tile_run_plain:
+ *   Runs the stages over a page that is already decrypted in trusted
+ *   memory, with the same tiling as nf_tile_run(). The output of the last
+ *   stage goes to sink.
+ */
+sgx_status_t nf_tile_run_plain(NF_STAGE_t *stages, size_t nstages,
+                               const uint8_t *text, size_t len, NF_EMIT_t *sink)
+{
+    struct nf_tile_chain chain;
+    sgx_status_t ret;
+
+    ret = nf_tile_chain_begin(&chain, stages, nstages, sink);
+    for (size_t off = 0; off < len && ret == SGX_SUCCESS; off += NF_TILE_SIZE)
+        ret = nf_tile_chain_feed(&chain, text + off,
+                                 len - off < NF_TILE_SIZE ? len - off : NF_TILE_SIZE);
+    if (ret == SGX_SUCCESS)
+        ret = nf_tile_chain_finish(&chain);
+    nf_tile_chain_end(&chain);
+    return ret;
+}
+
+/*
+ * nf_emit_zeros:
+ *   Emits len zero bytes, e.g. to pad the output of a kernel.
+ */
+sgx_status_t nf_emit_zeros(NF_EMIT_t *emit, size_t len)
+{
+    sgx_status_t ret = SGX_SUCCESS;
+
+    while (len && ret == SGX_SUCCESS) {
+        size_t n = len < NF_TILE_ZERO_CHUNK ? len : NF_TILE_ZERO_CHUNK;
+        ret = emit->cbf(nf_tile_zeros, n, emit->user);
+        len -= n;
+    }
+    return ret;
+}
+
+void nf_carry_reset(NF_CARRY_t *thiz)
+{
+    thiz->len = 0;
+}
+
+/*
+ * nf_carry_scan:
+ *   Calls scan for every start position of the input whose width-byte
+ *   window became complete with this chunk, in order and exactly once.
+ *   Positions close to the end of the chunk are kept in the carry buffer
+ *   until the next chunk completes them. Returns the number of positions
+ *   scanned; thiz->len positions are pending afterwards.
+ */
+size_t nf_carry_scan(NF_CARRY_t *thiz, const uint8_t *data, size_t len,
+                     size_t width, NF_SCAN_CALBACK_f scan, void *user)
+{
+    size_t scanned = 0;
+
+    if (!width || width > NF_CARRY_MAX_WIDTH)
+        return 0;
+
+    if (thiz->len) {
+        /* Complete the pending positions with the head of this chunk */
+        size_t take = len < width - 1 ? len : width - 1;
+        size_t avail, starts;
+
+        memcpy(thiz->buf + thiz->len, data, take);
+        avail = thiz->len + take;
+        if (avail < width) {
+            /* The whole chunk was absorbed */
+            thiz->len = avail;
+            return 0;
+        }
+
+        starts = avail - width + 1;
+        if (starts > thiz->len)
+            starts = thiz->len;
+        scan(thiz->buf, starts, user);
+        scanned += starts;
+
+        if (starts < thiz->len) {
+            /* The chunk was too short to complete all of them */
+            memmove(thiz->buf, thiz->buf + starts, avail - starts);
+            thiz->len = avail - starts;
+            return scanned;
+        }
+    }
+
+    /* Positions whose window lies inside the chunk */
+    if (len >= width) {
+        scan(data, len - width + 1, user);
+        scanned += len - width + 1;
+    }
+
+    /* Keep the tail for the next chunk */
+    if (len >= width - 1) {
+        memcpy(thiz->buf, data + len - (width - 1), width - 1);
+        thiz->len = width - 1;
+    } else {
+        memcpy(thiz->buf, data, len);
+        thiz->len = len;
+    }
+    return scanned;
+}
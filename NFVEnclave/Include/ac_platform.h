@@ -0,0 +1,30 @@
+/*
+ * ac_platform.h: What the Aho-Corasick engine needs from where it runs.
+ *
+ * Common/ahocorasick.cpp is built into the enclave, into the App and, by
+ * Tools/ahocorasick, into native programs. It takes the heap and string
+ * functions from the C library, which tlibc and libc both provide, and
+ * printf for ac_trie_display() only. tlibc has no printf: inside the
+ * enclave it is the OCALL wrapper each variant defines (Enclave.cpp),
+ * declared here the way Enclave.h declares it, which matches libc's.
+ */
+
+#ifndef _AC_PLATFORM_H_
+#define _AC_PLATFORM_H_
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int printf(const char *fmt, ...);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* !_AC_PLATFORM_H_ */
@@ -22,7 +22,6 @@
 #define _AHOCORASICK_H_
 
 #include <stdlib.h>
-#include "Enclave.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -382,6 +381,7 @@ AC_MATCH_t ac_trie_findnext (AC_TRIE_t *thiz);
 int  multifast_replace (AC_TRIE_t *thiz, AC_TEXT_t *text, 
         MF_REPLACE_MODE_t mode, MF_REPLACE_CALBACK_f callback, void *param);
 void multifast_rep_flush (AC_TRIE_t *thiz, int keep);
+void multifast_rep_reset (AC_TRIE_t *thiz);
 
 
 #ifdef __cplusplus
@@ -0,0 +1,84 @@
+/*
+ * nf_atomic.h: Atomic primitives of the enclave's concurrent structures.
+ *
+ * Thin wrappers over the compiler's __atomic builtins, which compile to
+ * plain locked instructions and need nothing from the trusted runtime, so
+ * unlike sgx_thread_mutex_* they never leave the enclave. Loads acquire,
+ * stores release and read-modify-writes do both unless a _relaxed variant
+ * says otherwise.
+ */
+
+#ifndef _NF_ATOMIC_H_
+#define _NF_ATOMIC_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define NF_CACHE_LINE 64
+
+static inline size_t nf_atomic_load(const volatile size_t *p)
+{
+    return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+}
+
+static inline size_t nf_atomic_load_relaxed(const volatile size_t *p)
+{
+    return __atomic_load_n(p, __ATOMIC_RELAXED);
+}
+
+static inline void nf_atomic_store(volatile size_t *p, size_t v)
+{
+    __atomic_store_n(p, v, __ATOMIC_RELEASE);
+}
+
+/** Adds v to *p and returns the new value */
+static inline size_t nf_atomic_add(volatile size_t *p, size_t v)
+{
+    return __atomic_add_fetch(p, v, __ATOMIC_ACQ_REL);
+}
+
+static inline size_t nf_atomic_add_relaxed(volatile size_t *p, size_t v)
+{
+    return __atomic_add_fetch(p, v, __ATOMIC_RELAXED);
+}
+
+static inline size_t nf_atomic_sub(volatile size_t *p, size_t v)
+{
+    return __atomic_sub_fetch(p, v, __ATOMIC_ACQ_REL);
+}
+
+static inline size_t nf_atomic_exchange(volatile size_t *p, size_t v)
+{
+    return __atomic_exchange_n(p, v, __ATOMIC_ACQ_REL);
+}
+
+/**
+ * Sets *p to desired if it holds *expected and returns 1; otherwise loads
+ * *p into *expected and returns 0. May fail spuriously, so call it in a loop.
+ */
+static inline int nf_atomic_cas(volatile size_t *p, size_t *expected, size_t desired)
+{
+    return __atomic_compare_exchange_n(p, expected, desired, 1, __ATOMIC_ACQ_REL,
+                                       __ATOMIC_ACQUIRE);
+}
+
+/** As nf_atomic_cas(), but fails only if *p differs from *expected */
+static inline int nf_atomic_cas_strong(volatile size_t *p, size_t *expected, size_t desired)
+{
+    return __atomic_compare_exchange_n(p, expected, desired, 0, __ATOMIC_SEQ_CST,
+                                       __ATOMIC_SEQ_CST);
+}
+
+/** Orders the stores before it against the loads after it */
+static inline void nf_atomic_fence(void)
+{
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+
+/** Spin-wait hint: lets the sibling hyperthread run */
+static inline void nf_cpu_relax(void)
+{
+    __asm__ volatile ("pause" ::: "memory");
+}
+
+#endif
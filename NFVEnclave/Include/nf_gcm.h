@@ -0,0 +1,126 @@
+/*
+ * nf_gcm.h: AES-128-GCM on AES-NI and PCLMULQDQ.
+ *
+ * The key schedule and the GHASH key powers H^1..H^8 are computed once by
+ * nf_gcm_key_init() and kept in an NF_GCM_KEY_t, so a caller that encrypts
+ * many pages under the same key (a session) only pays for them once. The
+ * data path encrypts NF_GCM_WAYS counter blocks at a time and folds the
+ * GHASH of NF_GCM_WAYS ciphertext blocks into a single reduction.
+ *
+ * nf_gcm_encrypt_mb()/nf_gcm_decrypt_mb() process a batch of independent
+ * messages, each with its own key and IV, by interleaving up to
+ * NF_GCM_WAYS of them block by block. Short pages then fill the AES
+ * pipeline the way a single long page does.
+ *
+ * Built for the enclave and for the App (Common/nf_gcm.cpp). Every CPU
+ * with SGX has AES-NI and PCLMULQDQ, so there is no fallback path.
+ */
+
+#ifndef _NF_GCM_H_
+#define _NF_GCM_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define NF_GCM_KEY_SIZE 16
+#define NF_GCM_IV_SIZE  12
+#define NF_GCM_TAG_SIZE 16
+
+/** Counter blocks in flight in the bulk loop */
+#define NF_GCM_WAYS 8
+
+/**
+ * Expanded key: AES-128 round keys and the powers of the hash key, in the
+ * byte-reflected form used by the GHASH code.
+ */
+typedef struct nf_gcm_key
+{
+    alignas(16) uint8_t rk[11][16];             /**< AES round keys */
+    alignas(16) uint8_t htab[NF_GCM_WAYS][16];  /**< htab[i] = H^(i+1) */
+} NF_GCM_KEY_t;
+
+/**
+ * Incremental encryption or decryption of one message. The message may be
+ * fed in chunks of any length.
+ */
+typedef struct nf_gcm_ctx
+{
+    const NF_GCM_KEY_t *key;
+    alignas(16) uint8_t j0[16];     /**< Pre-counter block */
+    alignas(16) uint8_t ghash[16];  /**< GHASH accumulator (reflected) */
+    uint8_t ks[16];                 /**< Keystream of the partial block */
+    uint8_t partial[16];            /**< Ciphertext of the partial block */
+    size_t partial_len;             /**< Bytes used of ks/partial */
+    uint32_t ctr;                   /**< Next counter value */
+    uint64_t len;                   /**< Message bytes processed */
+} NF_GCM_CTX_t;
+
+/**
+ * One message of a multi-buffer batch. For encryption tag receives the tag;
+ * for decryption it holds the expected tag and status reports the check.
+ */
+typedef struct nf_gcm_job
+{
+    const NF_GCM_KEY_t *key;
+    const uint8_t *iv;
+    const uint8_t *src;
+    size_t len;
+    uint8_t *dst;
+    uint8_t *tag;
+    int status;                     /**< 0 if the tag matched (decryption) */
+} NF_GCM_JOB_t;
+
+/**
+ * Outbound sequence numbers have the top bit set, so the enclave's output
+ * never reuses an IV of the host's input under the same key.
+ */
+#define NF_GCM_SEQ_OUT (1ULL << 63)
+
+/**
+ * @brief Deterministic IV: 32-bit flow ID || 64-bit sequence number, both
+ * big-endian.
+ */
+static inline void nf_gcm_make_iv(uint8_t *iv, uint32_t flow_id, uint64_t seq)
+{
+    for (int i = 0; i < 4; i++)
+        iv[i] = (uint8_t)(flow_id >> (24 - 8 * i));
+    for (int i = 0; i < 8; i++)
+        iv[4 + i] = (uint8_t)(seq >> (56 - 8 * i));
+}
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void nf_gcm_key_init (NF_GCM_KEY_t *thiz, const uint8_t *key);
+void nf_gcm_key_clear (NF_GCM_KEY_t *thiz);
+
+/* Key of one session of flow_id: AES(master, "NFSK" || flow_id || nonce) */
+void nf_gcm_derive_key (const NF_GCM_KEY_t *master, uint32_t flow_id,
+        uint64_t nonce, uint8_t *key);
+
+void nf_gcm_init (NF_GCM_CTX_t *thiz, const NF_GCM_KEY_t *key,
+        const uint8_t *iv);
+void nf_gcm_encrypt_update (NF_GCM_CTX_t *thiz, const uint8_t *src,
+        size_t len, uint8_t *dst);
+void nf_gcm_decrypt_update (NF_GCM_CTX_t *thiz, const uint8_t *src,
+        size_t len, uint8_t *dst);
+void nf_gcm_final (NF_GCM_CTX_t *thiz, uint8_t *tag);
+
+/* One-shot helpers; nf_gcm_decrypt() returns 0 if the tag matches */
+void nf_gcm_encrypt (const NF_GCM_KEY_t *key, const uint8_t *iv,
+        const uint8_t *src, size_t len, uint8_t *dst, uint8_t *tag);
+int  nf_gcm_decrypt (const NF_GCM_KEY_t *key, const uint8_t *iv,
+        const uint8_t *src, size_t len, uint8_t *dst, const uint8_t *tag);
+
+/* Multi-buffer; nf_gcm_decrypt_mb() returns the number of failed tags */
+void   nf_gcm_encrypt_mb (NF_GCM_JOB_t *jobs, size_t count);
+size_t nf_gcm_decrypt_mb (NF_GCM_JOB_t *jobs, size_t count);
+
+int  nf_gcm_tag_equal (const uint8_t *a, const uint8_t *b);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
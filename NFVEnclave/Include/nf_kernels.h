@@ -0,0 +1,80 @@
+/*
+ * nf_kernels.h: The NFs of the enclave as nf_tile kernels.
+ *
+ * The state types are shared, the kernels themselves are defined by each
+ * enclave variant (Enclave.cpp, Enclave_before.cpp, ...) since that is
+ * where the variants differ.
+ */
+
+#ifndef _NF_KERNELS_H_
+#define _NF_KERNELS_H_
+
+#include "nf_tile.h"
+#include "ahocorasick.h"
+#include "nf_ruleset.h"
+#include "user_types.h"
+
+/** Signature looked for by the IDS */
+#define NF_IDS_SIGNATURE "<script>onerror=alert;throw 1</script>"
+
+/**
+ * IDS: looks for a signature anywhere in the page and passes the page
+ * through unchanged.
+ */
+typedef struct nf_ids_state
+{
+    char *signature;        /**< Null-terminated signature */
+    size_t signature_len;
+    NF_CARRY_t carry;       /**< Positions waiting for the next chunk */
+    size_t total;           /**< Bytes seen */
+    size_t scanned;         /**< Start positions scanned */
+    int matched;            /**< Signature found */
+} NF_IDS_STATE_t;
+
+/**
+ * Badword filtering: removes the badwords with the Aho-Corasick replacer,
+ * the patterns come from the current ruleset (nf_ruleset.h).
+ */
+typedef struct nf_badword_state
+{
+    AC_TRIE_t *trie;        /**< Lent by the ruleset for the page */
+    NF_RULESET_t *rules;
+    NF_EMIT_t *emit;        /**< Output of the current chunk */
+    size_t out_len;         /**< Bytes emitted */
+    sgx_status_t status;    /**< First error reported by emit */
+} NF_BADWORD_STATE_t;
+
+/**
+ * Compression: smaz, tile by tile.
+ */
+typedef struct nf_compression_state
+{
+    size_t out_len;         /**< Bytes emitted */
+    uint8_t packed[NF_SMAZ_BOUND(NF_TILE_SIZE)];
+} NF_COMPRESSION_STATE_t;
+
+/**
+ * Room for the state of any of the NFs above.
+ */
+typedef union nf_any_state
+{
+    NF_IDS_STATE_t ids;
+    NF_BADWORD_STATE_t badword;
+    NF_COMPRESSION_STATE_t compression;
+} NF_ANY_STATE_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+sgx_status_t nf_stage_init (NF_STAGE_t *stage, nf_id_t nf, NF_ANY_STATE_t *state);
+
+extern const NF_KERNEL_t nf_ids_kernel;
+extern const NF_KERNEL_t nf_badword_kernel;
+extern const NF_KERNEL_t nf_compression_kernel;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,53 @@
+/*
+ * nf_log.h: Buffered logging inside the enclave.
+ *
+ * NF_LOG_*() append a line to a buffer in the enclave instead of leaving
+ * it through ocall_print_string. The buffer goes to the host with a single
+ * ocall_log_flush when it passes NF_LOG_FLUSH_THRESHOLD, when the host
+ * polls enclave_log_flush (on a timer, see App/Driver/Log.cpp) and at
+ * shutdown. Lines above NF_LOG_LEVEL are compiled out, arguments included.
+ */
+
+#ifndef _NF_LOG_H_
+#define _NF_LOG_H_
+
+#include "sgx_error.h"
+
+#define NF_LOG_LEVEL_ERROR 0
+#define NF_LOG_LEVEL_WARN  1
+#define NF_LOG_LEVEL_INFO  2
+#define NF_LOG_LEVEL_DEBUG 3
+
+/* Most verbose level compiled in, set by the Makefile (Log_Level) */
+#ifndef NF_LOG_LEVEL
+#define NF_LOG_LEVEL NF_LOG_LEVEL_INFO
+#endif
+
+#define NF_LOG_BUFFER_SIZE (64 * 1024)
+#define NF_LOG_FLUSH_THRESHOLD (48 * 1024)
+#define NF_LOG_LINE_MAX 512         /* Longer lines are truncated */
+
+#define NF_LOG(level, ...) \
+    do { \
+        if ((level) <= NF_LOG_LEVEL) \
+            nf_log_write((level), __VA_ARGS__); \
+    } while (0)
+
+#define NF_LOG_ERROR(...) NF_LOG(NF_LOG_LEVEL_ERROR, __VA_ARGS__)
+#define NF_LOG_WARN(...)  NF_LOG(NF_LOG_LEVEL_WARN, __VA_ARGS__)
+#define NF_LOG_INFO(...)  NF_LOG(NF_LOG_LEVEL_INFO, __VA_ARGS__)
+#define NF_LOG_DEBUG(...) NF_LOG(NF_LOG_LEVEL_DEBUG, __VA_ARGS__)
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void nf_log_write (int level, const char *fmt, ...)
+        __attribute__((format(printf, 2, 3)));
+sgx_status_t nf_log_flush (void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,49 @@
+/*
+ * nf_mpmc.h: Bounded lock-free MPMC ring of pointers.
+ *
+ * Any number of threads put and take. Each cell carries a sequence number
+ * that tells whose turn it is (Vyukov's bounded MPMC queue): a putter
+ * claims the head with a compare-and-swap and publishes the item by
+ * advancing the cell's sequence, a taker does the same with the tail.
+ * Neither blocks; a full or empty ring is reported to the caller.
+ *
+ * Built for the enclave and for the App (Common/nf_mpmc.cpp): the host
+ * pipeline's stages hand pages over through it, and NF_QUEUE_t parks its
+ * waiters around it.
+ */
+
+#ifndef _NF_MPMC_H_
+#define _NF_MPMC_H_
+
+#include <stddef.h>
+#include "nf_atomic.h"
+
+struct nf_mpmc_cell
+{
+    volatile size_t seq;
+    void *item;
+};
+
+typedef struct nf_mpmc
+{
+    struct nf_mpmc_cell *cells;
+    size_t mask;                            /**< Capacity - 1, a power of two */
+    alignas(NF_CACHE_LINE) volatile size_t head;    /**< Next cell to put to */
+    alignas(NF_CACHE_LINE) volatile size_t tail;    /**< Next cell to take from */
+    char pad[NF_CACHE_LINE - sizeof(size_t)];
+} NF_MPMC_t;
+
+/* Makes an empty ring of at least capacity items; returns 0 on success */
+int nf_mpmc_init(NF_MPMC_t *r, size_t capacity);
+void nf_mpmc_free(NF_MPMC_t *r);
+
+/* Returns 0 if the ring is full */
+int nf_mpmc_put(NF_MPMC_t *r, void *item);
+
+/* Returns NULL if the ring is empty */
+void *nf_mpmc_take(NF_MPMC_t *r);
+
+/* Items in the ring, exact only while nobody puts or takes */
+size_t nf_mpmc_size(const NF_MPMC_t *r);
+
+#endif /* !_NF_MPMC_H_ */
@@ -0,0 +1,71 @@
+/*
+ * nf_queue.h: Bounded lock-free MPMC queue of pointers inside the enclave.
+ *
+ * Any number of enclave threads push and pop. The items sit in an
+ * NF_MPMC_t (nf_mpmc.h, shared with the host pipeline), so
+ * nf_queue_try_push() and nf_queue_try_pop() never block.
+ *
+ * nf_queue_push() and nf_queue_pop() wait instead: they spin on the queue
+ * for NF_QUEUE_SPIN rounds, then park on a condition variable. A parked
+ * thread sleeps outside the enclave (the condvar wait is an OCALL), so
+ * parking is the slow path; the other side only takes the mutex to wake
+ * it when the waiter count says someone is parked.
+ */
+
+#ifndef _NF_QUEUE_H_
+#define _NF_QUEUE_H_
+
+#include <stddef.h>
+#include "sgx_error.h"
+#include "sgx_thread.h"
+#include "nf_atomic.h"
+#include "nf_mpmc.h"
+
+/* Rounds of spinning before a waiting thread parks */
+#define NF_QUEUE_SPIN 2048
+
+typedef struct nf_queue
+{
+    NF_MPMC_t ring;                         /**< The items */
+    alignas(NF_CACHE_LINE) volatile size_t push_waiters;    /**< Parked pushers */
+    volatile size_t pop_waiters;            /**< Parked poppers */
+    volatile size_t closed;                 /**< Set by nf_queue_close() */
+    size_t parks;                           /**< Times a thread parked */
+    sgx_thread_mutex_t mutex;               /**< Guards the parking only */
+    sgx_thread_cond_t not_full;
+    sgx_thread_cond_t not_empty;
+} NF_QUEUE_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Makes an empty queue of at least capacity items */
+sgx_status_t nf_queue_init (NF_QUEUE_t *q, size_t capacity);
+
+/* No thread may use or wait on q any more */
+void nf_queue_free (NF_QUEUE_t *q);
+
+/* Returns 0 if the queue is full; item must not be NULL */
+int nf_queue_try_push (NF_QUEUE_t *q, void *item);
+
+/* Returns NULL if the queue is empty */
+void *nf_queue_try_pop (NF_QUEUE_t *q);
+
+/* Waits for room; returns 0 if the queue was closed instead */
+int nf_queue_push (NF_QUEUE_t *q, void *item);
+
+/* Waits for an item; returns NULL once the queue is closed and empty */
+void *nf_queue_pop (NF_QUEUE_t *q);
+
+/*
+ * Ends the queue: waiting pushers give up, poppers drain what is left and
+ * then get NULL. Items are never NULL, so NULL always means closed.
+ */
+void nf_queue_close (NF_QUEUE_t *q);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,118 @@
+/*
+ * nf_ring.h: Descriptor ring between the App and an enclave worker.
+ *
+ * The ring lives in untrusted memory and has exactly one producer (an App
+ * thread) and one consumer (the enclave thread sitting in
+ * enclave_ring_worker()). Slot s goes through three phases:
+ *
+ *   [tail, done)  completed, waiting for the App to reap them
+ *   [done, head)  submitted, waiting for the worker
+ *   [head, tail + NF_RING_SLOTS)  free
+ *
+ * The App writes head and tail, the worker writes done, each on its own
+ * cache line. The worker fills in the result of a slot before it moves
+ * done past it, so the App never waits for a separate completion queue.
+ * A full ring is the backpressure: nf_ring_submit() fails until the App
+ * has reaped some completions. The result of a page carries the IV its
+ * output was encrypted under, as for a batch.
+ */
+
+#ifndef _NF_RING_H_
+#define _NF_RING_H_
+
+#include <stdint.h>
+#include <string.h>
+#include "user_types.h"
+
+#define NF_RING_SLOTS 256           /* Power of two */
+#define NF_RING_MASK (NF_RING_SLOTS - 1)
+#define NF_RING_LINE 64
+
+/**
+ * One page: the request is written by the App, the result by the worker.
+ * Offsets are relative to the arena given to enclave_ring_worker().
+ */
+typedef struct nf_ring_slot
+{
+    nf_batch_desc_t desc;
+    uint32_t nf;                    /**< nf_id_t */
+    uint64_t cookie;                /**< Returned untouched */
+    nf_batch_result_t result;
+} NF_RING_SLOT_t;
+
+typedef struct nf_ring
+{
+    volatile uint64_t head;         /**< Slots submitted (App) */
+    uint8_t pad0[NF_RING_LINE - sizeof(uint64_t)];
+    volatile uint64_t done;         /**< Slots completed (worker) */
+    uint8_t pad1[NF_RING_LINE - sizeof(uint64_t)];
+    volatile uint64_t tail;         /**< Slots reaped (App) */
+    volatile uint32_t stop;         /**< Worker returns once the ring is empty */
+    uint8_t pad2[NF_RING_LINE - sizeof(uint64_t) - sizeof(uint32_t)];
+    NF_RING_SLOT_t slots[NF_RING_SLOTS];
+} NF_RING_t;
+
+static inline uint64_t nf_ring_load(volatile uint64_t *p)
+{
+    return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+}
+
+static inline void nf_ring_store(volatile uint64_t *p, uint64_t v)
+{
+    __atomic_store_n(p, v, __ATOMIC_RELEASE);
+}
+
+static inline void nf_ring_pause(void)
+{
+    __asm__ volatile ("pause" ::: "memory");
+}
+
+static inline void nf_ring_init(NF_RING_t *ring)
+{
+    memset(ring, 0, sizeof(*ring));
+}
+
+/**
+ * @brief Queues a page. Returns -1 if the ring is full.
+ */
+static inline int nf_ring_submit(NF_RING_t *ring, const nf_batch_desc_t *desc,
+                                 uint32_t nf, uint64_t cookie)
+{
+    uint64_t head = ring->head;
+    NF_RING_SLOT_t *slot;
+
+    if (head - ring->tail == NF_RING_SLOTS)
+        return -1;
+    slot = &ring->slots[head & NF_RING_MASK];
+    slot->desc = *desc;
+    slot->nf = nf;
+    slot->cookie = cookie;
+    nf_ring_store(&ring->head, head + 1);
+    return 0;
+}
+
+/**
+ * @brief Takes the oldest completed page. Returns NULL if there is none;
+ * the slot is valid until the next nf_ring_release().
+ */
+static inline NF_RING_SLOT_t *nf_ring_peek(NF_RING_t *ring)
+{
+    uint64_t tail = ring->tail;
+
+    if (tail == nf_ring_load(&ring->done))
+        return NULL;
+    return &ring->slots[tail & NF_RING_MASK];
+}
+
+static inline void nf_ring_release(NF_RING_t *ring)
+{
+    nf_ring_store(&ring->tail, ring->tail + 1);
+}
+
+/** Pages submitted and not reaped yet */
+static inline uint64_t nf_ring_pending(const NF_RING_t *ring)
+{
+    return ring->head - ring->tail;
+}
+
+#endif
@@ -0,0 +1,43 @@
+/*
+ * nf_ruleset.h: Badword ruleset of the enclave, provisioned at run time.
+ *
+ * The host hands the patterns to enclave_ruleset_load (plain or encrypted
+ * under the page key and an IV of their own) or to enclave_ruleset_unseal
+ * (a blob written by enclave_ruleset_seal at a previous start). The text
+ * is parsed once: patterns are separated by '|', newlines or NULs, empty
+ * ones are skipped.
+ *
+ * The Aho-Corasick replacer keeps its state in the trie, so a trie serves
+ * one page at a time. Finalized tries of the current ruleset are kept and
+ * handed out again by nf_ruleset_acquire(), a page only builds one when
+ * all of them are in use. Until the host provisions a ruleset, the
+ * variant's compiled-in list (nf_badword_default_rules) is used.
+ */
+
+#ifndef _NF_RULESET_H_
+#define _NF_RULESET_H_
+
+#include <stddef.h>
+#include "sgx_error.h"
+#include "ahocorasick.h"
+
+#define NF_RULESET_MAX (1 << 20)    /* Largest ruleset text accepted */
+#define NF_RULESET_IDLE 16          /* Finalized tries kept, TCSNum is 10 */
+
+typedef struct nf_ruleset NF_RULESET_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+AC_TRIE_t *nf_ruleset_acquire (NF_RULESET_t **rules);
+void nf_ruleset_release (NF_RULESET_t *rules, AC_TRIE_t *trie);
+
+/* Patterns of the ruleset used until the host provisions one */
+extern const char nf_badword_default_rules[];
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
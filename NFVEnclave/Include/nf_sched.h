@@ -0,0 +1,58 @@
+/*
+ * nf_sched.h: Work-stealing scheduler of the enclave's threads.
+ *
+ * Every TCS that takes part gets a slot with its own deque of tasks
+ * (Chase-Lev: the owner pushes and pops at the bottom, the others steal
+ * from the top). Workers are host threads that enter the enclave once,
+ * through enclave_sched_worker(), and stay there: they run the tasks of
+ * their own deque, steal from a random other one when it is empty, spin
+ * for NF_SCHED_SPIN rounds when there is nothing to steal, and then park
+ * on a condition variable until a fork wakes them or the host stops them.
+ *
+ * A task is a range [lo, hi) of some parallel loop. nf_parallel_for()
+ * cuts its range into chunks, pushes them on the caller's deque and helps
+ * until all of them have run, so an NF ECALL can spread one big page over
+ * the workers and still return only when the page is done. Without
+ * workers it runs the whole range inline.
+ */
+
+#ifndef _NF_SCHED_H_
+#define _NF_SCHED_H_
+
+#include <stddef.h>
+#include "sgx_error.h"
+#include "user_types.h"
+#include "nf_atomic.h"
+
+/* Slots, one per TCS that forks or works: at least TCSNum */
+#define NF_SCHED_SLOTS 16
+
+/* Tasks a deque holds, a power of two; a fork runs the rest inline */
+#define NF_SCHED_DEQUE 256
+
+/* Rounds over the other deques before an idle worker parks */
+#define NF_SCHED_SPIN 2048
+
+/* Runs items [lo, hi) of a parallel loop */
+typedef void (*nf_sched_fn_t)(size_t lo, size_t hi, void *arg);
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Runs fn over [begin, end) in chunks of grain items, the last one
+ * shorter: chunk k is [begin + k * grain, begin + (k + 1) * grain), so fn
+ * can tell which chunk it got. Returns when every chunk has run. May be
+ * called from a task.
+ */
+void nf_parallel_for (size_t begin, size_t end, size_t grain, nf_sched_fn_t fn, void *arg);
+
+/* Workers in the enclave right now */
+size_t nf_sched_workers (void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,80 @@
+/*
+ * nf_session.h: Per-flow crypto sessions of the enclave.
+ *
+ * A session caches the expanded GCM key of a flow and hands out its IVs:
+ * pages from the host carry a strictly increasing sequence number, pages
+ * from the enclave get the next outbound one (see nf_gcm_make_iv()). Each
+ * open derives a new key for the flow (nf_gcm_derive_key()), so the
+ * sequence numbers of a reopened flow can start over.
+ */
+
+#ifndef _NF_SESSION_H_
+#define _NF_SESSION_H_
+
+#include <stdint.h>
+#include "sgx_error.h"
+#include "nf_gcm.h"
+#include "nf_tile.h"
+
+#define NF_SESSION_MAX 64
+
+/**
+ * Flow of the pages under the default key. The host numbers its pages
+ * from a random point below NF_GCM_SEQ_OUT, the enclave its output from
+ * one above (nf_session_default_iv()).
+ */
+#define NF_SESSION_DEFAULT_FLOW 0
+
+typedef struct nf_session
+{
+    uint32_t flow_id;
+    int used;
+    uint64_t epoch;         /**< Tells apart the sessions a flow_id had */
+    uint64_t in_seq;        /**< Last inbound sequence number taken */
+    uint64_t out_seq;       /**< Next outbound sequence number */
+    NF_GCM_KEY_t key;
+} NF_SESSION_t;
+
+/**
+ * What a page of a session needs: the key and both IVs. The key is a copy,
+ * so closing the flow under a page in flight cannot change it.
+ */
+typedef struct nf_session_page
+{
+    NF_GCM_KEY_t key;
+    uint64_t epoch;
+    uint8_t in_iv[NF_GCM_IV_SIZE];
+    uint8_t out_iv[NF_GCM_IV_SIZE];
+    uint64_t in_seq;
+    uint64_t out_seq;
+} NF_SESSION_PAGE_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+sgx_status_t nf_session_open (uint32_t flow_id, const uint8_t *key);
+sgx_status_t nf_session_close (uint32_t flow_id);
+
+sgx_status_t nf_session_page_begin (uint32_t flow_id, uint64_t in_seq,
+        NF_SESSION_PAGE_t *page);
+sgx_status_t nf_session_page_commit (uint32_t flow_id,
+        const NF_SESSION_PAGE_t *page);
+
+const NF_GCM_KEY_t *nf_session_default_key (void);
+sgx_status_t nf_session_default_iv (uint8_t *iv, uint64_t *seq);
+sgx_status_t nf_session_default_check_iv (const uint8_t *iv);
+sgx_status_t nf_session_default_run (NF_STAGE_t *stages, size_t nstages,
+        const uint8_t *in_iv, const uint8_t *cyphertext, size_t lSize,
+        const uint8_t *en_mac, uint8_t *out, size_t oCap, size_t *oSize,
+        uint8_t *out_mac, uint8_t *out_iv, uint64_t *out_seq);
+sgx_status_t nf_session_default_run_page (NF_PAGE_CALBACK_f fn, void *user,
+        const uint8_t *in_iv, const uint8_t *cyphertext, size_t lSize,
+        const uint8_t *en_mac, uint8_t *out, size_t oCap, size_t *oSize,
+        uint8_t *out_mac, uint8_t *out_iv, uint64_t *out_seq);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,74 @@
+/*
+ * nf_stream.h: Block-wise AES-GCM helpers for the NF ECALLs.
+ *
+ * The NF entry points used to decrypt the whole page into a freshly
+ * allocated trusted buffer before processing it. These helpers let an NF
+ * decrypt, process and re-encrypt a page NF_STREAM_BLOCK_SIZE bytes at a
+ * time, so the trusted working set does not depend on the page size.
+ */
+
+#ifndef _NF_STREAM_H_
+#define _NF_STREAM_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include "sgx_error.h"
+#include "nf_gcm.h"
+
+/**
+ * Plaintext block processed at a time. A multiple of the AES block size
+ * keeps the bulk GCM path busy between updates.
+ */
+#define NF_STREAM_BLOCK_SIZE (32*1024)
+
+#if (NF_STREAM_BLOCK_SIZE % 16 > 0)
+#error "NF_STREAM_BLOCK_SIZE must be multiple 16"
+#endif
+
+/**
+ * Worst-case smaz output for an input of n bytes: a verbatim byte costs two
+ * output bytes, so the output never exceeds twice the input.
+ */
+#define NF_SMAZ_BOUND(n) (2*(n) + 2)
+
+/**
+ * Incremental AES-GCM decryption of one page. nf_stream_dec_final()
+ * compares the tag of the received ciphertext with the one sent by the host.
+ */
+typedef struct nf_stream_dec
+{
+    NF_GCM_CTX_t gcm;
+} NF_STREAM_DEC_t;
+
+/**
+ * Incremental AES-GCM encryption of one page into an output buffer.
+ */
+typedef struct nf_stream_enc
+{
+    NF_GCM_CTX_t gcm;
+    uint8_t *dst;                   /**< Output buffer, may be moved by its owner */
+    size_t written;                 /**< Bytes written to dst so far */
+} NF_STREAM_ENC_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+sgx_status_t nf_stream_dec_init (NF_STREAM_DEC_t *thiz,
+        const NF_GCM_KEY_t *key, const uint8_t *iv);
+sgx_status_t nf_stream_dec_update (NF_STREAM_DEC_t *thiz,
+        const uint8_t *src, size_t len, uint8_t *dst);
+sgx_status_t nf_stream_dec_final (NF_STREAM_DEC_t *thiz, const uint8_t *mac);
+
+sgx_status_t nf_stream_enc_init (NF_STREAM_ENC_t *thiz,
+        const NF_GCM_KEY_t *key, const uint8_t *iv, uint8_t *dst);
+sgx_status_t nf_stream_enc_update (NF_STREAM_ENC_t *thiz,
+        const uint8_t *src, size_t len);
+sgx_status_t nf_stream_enc_pad (NF_STREAM_ENC_t *thiz, size_t len);
+sgx_status_t nf_stream_enc_final (NF_STREAM_ENC_t *thiz, uint8_t *mac);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,140 @@
+/*
+ * nf_tile.h: Tile-by-tile NF execution framework.
+ *
+ * nf_tile_run() decrypts a page one tile at a time, pushes each tile through
+ * a list of NF kernels while it is still hot in cache, and re-encrypts
+ * whatever the last kernel emits (nf_tile_run_plain() does the same for a
+ * page that is already decrypted). A kernel sees its input as an arbitrary
+ * sequence of chunks and keeps in its own state whatever it needs to carry
+ * across chunk boundaries (see NF_CARRY_t for the common case of a fixed
+ * width window).
+ *
+ * The encrypted page may stay in untrusted memory once
+ * nf_tile_check_input() has accepted it: each tile is copied into trusted
+ * memory before it is decrypted, so no full-size copy is ever made.
+ * nf_tile_run_page() is the exception, for NFs that cut a large page
+ * among the scheduler's workers: it decrypts the whole page into trusted
+ * memory and checks its tag before the NF sees any of it.
+ */
+
+#ifndef _NF_TILE_H_
+#define _NF_TILE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include "sgx_error.h"
+#include "nf_stream.h"
+
+/**
+ * Size of a decrypted tile. Together with a compressed tile the working
+ * set stays well inside L2.
+ */
+#define NF_TILE_SIZE NF_STREAM_BLOCK_SIZE
+
+/**
+ * @brief Receives the output of a kernel (chunk by chunk).
+ */
+typedef sgx_status_t (*NF_EMIT_CALBACK_f)(const uint8_t *data, size_t len,
+        void *user);
+
+typedef struct nf_emit
+{
+    NF_EMIT_CALBACK_f cbf;  /**< Consumer of the output */
+    void *user;             /**< Parameter sent to the consumer */
+} NF_EMIT_t;
+
+/**
+ * An NF kernel. All callbacks receive the kernel state as first parameter.
+ */
+typedef struct nf_kernel
+{
+    const char *name;
+
+    /** Prepares the state for a new page */
+    sgx_status_t (*begin) (void *state);
+
+    /** Consumes the next chunk of the page; output goes to emit */
+    sgx_status_t (*process) (void *state, const uint8_t *data, size_t len,
+            NF_EMIT_t *emit);
+
+    /** Called after the last chunk; may emit trailing output or padding */
+    sgx_status_t (*finish) (void *state, NF_EMIT_t *emit);
+
+    /** Releases what begin() acquired; called even if the page failed */
+    void (*end) (void *state);
+
+} NF_KERNEL_t;
+
+/**
+ * A kernel instance in a chain of kernels.
+ */
+typedef struct nf_stage
+{
+    const NF_KERNEL_t *kernel;
+    void *state;
+
+    /* Set by nf_tile_run() */
+    NF_EMIT_t out;          /**< Where this stage's output goes */
+    size_t in_bytes;        /**< Bytes consumed */
+    size_t out_bytes;       /**< Bytes emitted */
+    uint64_t cycles;        /**< TSC cycles in the kernel, NF_STAGE_TIMING only */
+
+} NF_STAGE_t;
+
+/**
+ * Carry-over buffer for kernels that look at a fixed width window of the
+ * input (e.g. a signature). It holds the start positions of the previous
+ * chunks whose window was not complete yet.
+ */
+#define NF_CARRY_MAX_WIDTH 256
+
+typedef struct nf_carry
+{
+    uint8_t buf[2*NF_CARRY_MAX_WIDTH];
+    size_t len;
+} NF_CARRY_t;
+
+/**
+ * @brief Scans the start positions 0..starts-1 of text; the window of every
+ * start position is complete.
+ */
+typedef void (*NF_SCAN_CALBACK_f)(const uint8_t *text, size_t starts,
+        void *user);
+
+/**
+ * @brief Runs an NF over a whole page, decrypted and authenticated; its
+ * output goes to emit.
+ */
+typedef sgx_status_t (*NF_PAGE_CALBACK_f)(const uint8_t *page, size_t len,
+        NF_EMIT_t *emit, void *user);
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+sgx_status_t nf_tile_run (NF_STAGE_t *stages, size_t nstages,
+        const NF_GCM_KEY_t *key, const uint8_t *in_iv,
+        const uint8_t *cyphertext, size_t lSize, const uint8_t *en_mac,
+        const uint8_t *out_iv, uint8_t *out, size_t oCap, size_t *oSize,
+        uint8_t *out_mac);
+sgx_status_t nf_tile_run_page (NF_PAGE_CALBACK_f fn, void *user,
+        const NF_GCM_KEY_t *key, const uint8_t *in_iv,
+        const uint8_t *cyphertext, size_t lSize, const uint8_t *en_mac,
+        const uint8_t *out_iv, uint8_t *out, size_t oCap, size_t *oSize,
+        uint8_t *out_mac);
+sgx_status_t nf_tile_check_input (const uint8_t *cyphertext, size_t lSize);
+sgx_status_t nf_tile_check_output (const uint8_t *out, size_t oCap);
+sgx_status_t nf_tile_run_plain (NF_STAGE_t *stages, size_t nstages,
+        const uint8_t *text, size_t len, NF_EMIT_t *sink);
+
+sgx_status_t nf_emit_zeros (NF_EMIT_t *emit, size_t len);
+
+void   nf_carry_reset (NF_CARRY_t *thiz);
+size_t nf_carry_scan (NF_CARRY_t *thiz, const uint8_t *data, size_t len,
+        size_t width, NF_SCAN_CALBACK_f scan, void *user);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
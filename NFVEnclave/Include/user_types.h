@@ -32,9 +32,113 @@
 
 /* User defined types */
 
+#ifndef _USER_TYPES_H_
+#define _USER_TYPES_H_
+
+#include <stddef.h>
+
 
 #define LOOPS_PER_THREAD 500
 
 typedef void *buffer_t;
 typedef int array_t[10];
 
+/* NFs selectable by the session ECALLs */
+typedef enum nf_id {
+    NF_IDS = 0,
+    NF_BADWORD = 1,
+    NF_COMPRESSION = 2
+} nf_id_t;
+
+/*
+ * Output slot that always holds what the NFs chain[0..nstages) emit for
+ * an lSize-byte page: the IDS passes its input through, the badword filter
+ * only removes bytes and pads to a power of two, and smaz at most doubles
+ * its input before the same padding. For one NF, chain is &nf, nstages 1.
+ */
+static inline size_t nf_out_cap(const nf_id_t *chain, size_t nstages, size_t lSize)
+{
+    size_t n = lSize;
+
+    for (size_t i = 0; i < nstages; i++) {
+        size_t pad = 1;
+
+        if (chain[i] == NF_IDS)
+            continue;
+        while (pad < n)
+            pad <<= 1;
+        n = chain[i] == NF_COMPRESSION ? 2 * pad : pad;
+    }
+    return n;
+}
+
+/* What enclave_nf_chain reports for each stage */
+typedef struct nf_stage_stats {
+    uint64_t in_bytes;
+    uint64_t out_bytes;
+    uint64_t cycles;        /* 0 unless the enclave is built with NF_STAGE_TIMING */
+} nf_stage_stats_t;
+
+/* Longest chain accepted by enclave_nf_chain */
+#define NF_CHAIN_MAX 8
+
+/* One page of a batch: where it lies in the input and where its output goes */
+typedef struct nf_batch_desc {
+    uint64_t in_offset;
+    uint64_t in_len;
+    uint8_t mac[16];        /* Tag of the page */
+    uint8_t iv[12];         /* IV of the page: NF_SESSION_DEFAULT_FLOW || seq */
+    uint64_t out_offset;
+    uint64_t out_cap;       /* Size of the output slot */
+} nf_batch_desc_t;
+
+/* What a batched ECALL reports for each page */
+typedef struct nf_batch_result {
+    uint32_t status;        /* sgx_status_t of the page */
+    uint64_t out_len;
+    uint64_t matched;       /* IDS only */
+    uint8_t mac[16];        /* Tag of the output */
+    uint8_t iv[12];         /* IV of the output: NF_SESSION_DEFAULT_FLOW || out_seq */
+    uint64_t out_seq;       /* Outbound sequence number, top bit set */
+} nf_batch_result_t;
+
+/* GCM implementations compared by ecall_gcm_benchmark */
+#define GCM_BENCH_SDK        0  /* sgx_rijndael128GCM_*, key set up per call */
+#define GCM_BENCH_NF_COLD    1  /* nf_gcm, key expanded per call */
+#define GCM_BENCH_NF_SESSION 2  /* nf_gcm, key expanded once */
+#define GCM_BENCH_NF_MB      3  /* nf_gcm_*_mb over batches of pages */
+#define GCM_BENCH_ENGINES    4
+
+/* Pointer attributes of the OCALLs issued by ecall_marshal_ocalls */
+#define MARSHAL_BENCH_IN         0  /* [in,size=len] */
+#define MARSHAL_BENCH_OUT        1  /* [out,size=len] */
+#define MARSHAL_BENCH_IN_OUT     2  /* [in,out,size=len] */
+#define MARSHAL_BENCH_USER_CHECK 3  /* [user_check] */
+#define MARSHAL_BENCH_COUNT      4  /* [in,count=n] of uint64_t */
+#define MARSHAL_BENCH_ATTRS      5
+
+/* Work queues compared by the ecall_queue_bench_* */
+#define QUEUE_BENCH_COND     0  /* cond_buffer_t: a mutex and two condition variables */
+#define QUEUE_BENCH_LOCKFREE 1  /* NF_QUEUE_t, see nf_queue.h */
+#define QUEUE_BENCH_DESIGNS  2
+
+/* Shared counters compared by ecall_counter_bench */
+#define COUNTER_BENCH_MUTEX  0  /* sgx_thread_mutex_* around the increment */
+#define COUNTER_BENCH_ATOMIC 1  /* nf_atomic_add */
+
+/* Utilization of one deque of the work-stealing scheduler, see nf_sched.h */
+typedef struct nf_sched_stats
+{
+    uint32_t worker;        /* Its TCS has run enclave_sched_worker */
+    uint64_t tasks;         /* Tasks run on its TCS */
+    uint64_t items;         /* Items of the ranges of those tasks */
+    uint64_t steals;        /* Tasks taken from another slot's deque */
+    uint64_t failed_steals; /* Rounds over the other deques that found nothing */
+    uint64_t parks;         /* Times the worker slept for want of work */
+} nf_sched_stats_t;
+
+/* Chunk-parallel kernels timed by ecall_sched_bench_run */
+#define SCHED_BENCH_SCAN     0  /* Counts NF_IDS_SIGNATURE in the buffer */
+#define SCHED_BENCH_COMPRESS 1  /* smaz, chunk by chunk */
+
+#endif /* !_USER_TYPES_H_ */
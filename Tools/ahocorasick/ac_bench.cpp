@@ -0,0 +1,478 @@
+/*
+ * ac_bench.cpp: Native microbenchmark of the enclave's Aho-Corasick engine.
+ *
+ * Builds Common/ahocorasick.cpp outside the enclave, so the engine can be
+ * profiled and compared on its own. For each ruleset size it times the
+ * build of a finalized trie, then the search (as the IDS would use it) and
+ * the NORMAL-mode replace with empty replacements (as the badword NF uses
+ * it) over each input, fed in chunks of the enclave's tile size. The
+ * rulesets are the first N patterns of --rules, topped up with seeded
+ * pseudo-words when it has fewer. The inputs are seeded text of short
+ * words ("clean", which only matches the short patterns of the file by
+ * chance), the same text with patterns of the ruleset planted in it
+ * ("dense"), and the files given with --input.
+ */
+
+#include <algorithm>
+#include <dirent.h>
+#include <getopt.h>
+#include <random>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <sys/stat.h>
+#include <time.h>
+#include <vector>
+
+#include "ahocorasick.h"
+
+#define AC_BENCH_RULES_FILE "NFVEnclave/badwords.txt"
+#define AC_BENCH_SIZES "10,100,1000,10000"
+#define AC_BENCH_SIZES_MAX 16
+#define AC_BENCH_BYTES (8 << 20)
+#define AC_BENCH_MATCH_RATE 1.0
+#define AC_BENCH_ITERATIONS 5
+#define AC_BENCH_CHUNK (32 * 1024)  /* NF_TILE_SIZE of the enclave */
+#define AC_BENCH_SEED 1
+
+typedef struct {
+    const char *rules;
+    std::vector<const char *> inputs;
+    size_t sizes[AC_BENCH_SIZES_MAX];
+    unsigned nsizes;
+    size_t bytes;
+    double match_rate;
+    unsigned iterations;
+    size_t chunk;
+    unsigned long long seed;
+} AC_BENCH_OPTIONS_t;
+
+/* One input: a name and its pages, searched one after the other */
+typedef struct {
+    std::string name;
+    std::vector<std::string> pages;
+    size_t bytes;
+} AC_BENCH_INPUT_t;
+
+static void ac_bench_usage(const char *prog)
+{
+    printf("Usage: %s [options]\n"
+           "  --bytes N           bytes of the synthetic inputs (default %d)\n"
+           "  --chunk N           bytes per search or replace call (default %d)\n"
+           "  --input PATH        also run over a file, or the files of a directory\n"
+           "  --iterations N      timed runs, the median is reported (default %d)\n"
+           "  --match-rate R      patterns planted per KiB of the dense input (default %g)\n"
+           "  --rules FILE        patterns, separated by '|' or newlines (default %s)\n"
+           "  --seed N            seed of the synthetic patterns and inputs (default %d)\n"
+           "  --sizes LIST        comma-separated ruleset sizes (default %s)\n"
+           "  -h, --help          show this text\n", prog, AC_BENCH_BYTES, AC_BENCH_CHUNK,
+           AC_BENCH_ITERATIONS, AC_BENCH_MATCH_RATE, AC_BENCH_RULES_FILE, AC_BENCH_SEED,
+           AC_BENCH_SIZES);
+}
+
+/* Parses a decimal count in [min, max] */
+static int ac_bench_parse_count(const char *name, const char *arg, unsigned long long min,
+                                unsigned long long max, unsigned long long *value)
+{
+    char *end;
+    unsigned long long n = strtoull(arg, &end, 10);
+
+    if (*arg == '\0' || *arg == '-' || *end != '\0' || n < min || n > max) {
+        printf("Bad %s: %s\n", name, arg);
+        return -1;
+    }
+    *value = n;
+    return 0;
+}
+
+static int ac_bench_parse_sizes(const char *arg, AC_BENCH_OPTIONS_t *opts)
+{
+    std::string list(arg);
+    size_t start = 0;
+    unsigned long long n;
+
+    opts->nsizes = 0;
+    while (start <= list.size()) {
+        size_t comma = list.find(',', start);
+        std::string item = list.substr(start, comma == std::string::npos ? std::string::npos
+                                                                         : comma - start);
+
+        if (opts->nsizes == AC_BENCH_SIZES_MAX) {
+            printf("More than %d ruleset sizes\n", AC_BENCH_SIZES_MAX);
+            return -1;
+        }
+        if (ac_bench_parse_count("ruleset size", item.c_str(), 1, 1 << 24, &n) != 0)
+            return -1;
+        opts->sizes[opts->nsizes++] = (size_t) n;
+        if (comma == std::string::npos)
+            break;
+        start = comma + 1;
+    }
+    return 0;
+}
+
+static int ac_bench_parse_options(int argc, char *argv[], AC_BENCH_OPTIONS_t *opts)
+{
+    enum {
+        OPT_BYTES = 256, OPT_CHUNK, OPT_INPUT, OPT_ITERATIONS, OPT_MATCH_RATE, OPT_RULES,
+        OPT_SEED, OPT_SIZES
+    };
+    static const struct option longopts[] = {
+        {"bytes",      required_argument, NULL, OPT_BYTES},
+        {"chunk",      required_argument, NULL, OPT_CHUNK},
+        {"input",      required_argument, NULL, OPT_INPUT},
+        {"iterations", required_argument, NULL, OPT_ITERATIONS},
+        {"match-rate", required_argument, NULL, OPT_MATCH_RATE},
+        {"rules",      required_argument, NULL, OPT_RULES},
+        {"seed",       required_argument, NULL, OPT_SEED},
+        {"sizes",      required_argument, NULL, OPT_SIZES},
+        {"help",       no_argument,       NULL, 'h'},
+        {NULL, 0, NULL, 0}
+    };
+    unsigned long long n;
+    char *end;
+    int c, ret = 0;
+
+    opts->rules = AC_BENCH_RULES_FILE;
+    opts->bytes = AC_BENCH_BYTES;
+    opts->match_rate = AC_BENCH_MATCH_RATE;
+    opts->iterations = AC_BENCH_ITERATIONS;
+    opts->chunk = AC_BENCH_CHUNK;
+    opts->seed = AC_BENCH_SEED;
+    ac_bench_parse_sizes(AC_BENCH_SIZES, opts);
+
+    while (ret == 0 && (c = getopt_long(argc, argv, "h", longopts, NULL)) != -1) {
+        switch (c) {
+        case OPT_BYTES:
+            ret = ac_bench_parse_count("input size", optarg, 1, 1ull << 32, &n);
+            opts->bytes = (size_t) n;
+            break;
+        case OPT_CHUNK:
+            ret = ac_bench_parse_count("chunk size", optarg, 1, 1ull << 32, &n);
+            opts->chunk = (size_t) n;
+            break;
+        case OPT_INPUT:
+            opts->inputs.push_back(optarg);
+            break;
+        case OPT_ITERATIONS:
+            ret = ac_bench_parse_count("number of iterations", optarg, 1, 1000, &n);
+            opts->iterations = (unsigned) n;
+            break;
+        case OPT_MATCH_RATE:
+            opts->match_rate = strtod(optarg, &end);
+            if (*optarg == '\0' || *end != '\0' ||
+                !(opts->match_rate >= 0 && opts->match_rate <= 1024)) {
+                printf("Bad match rate: %s\n", optarg);
+                ret = -1;
+            }
+            break;
+        case OPT_RULES:
+            opts->rules = optarg;
+            break;
+        case OPT_SEED:
+            ret = ac_bench_parse_count("seed", optarg, 0, UINT64_MAX, &opts->seed);
+            break;
+        case OPT_SIZES:
+            ret = ac_bench_parse_sizes(optarg, opts);
+            break;
+        case 'h':
+            ac_bench_usage(argv[0]);
+            exit(0);
+        default:
+            ac_bench_usage(argv[0]);
+            ret = -1;
+            break;
+        }
+    }
+    if (ret == 0 && optind < argc) {
+        printf("Unexpected argument: %s\n", argv[optind]);
+        ret = -1;
+    }
+    return ret;
+}
+
+static int ac_bench_read(const char *path, std::string& text)
+{
+    char buf[1 << 16];
+    size_t n;
+    FILE *fp = fopen(path, "rb");
+
+    if (fp == NULL) {
+        printf("\nFile %s not exist.\n", path);
+        return -1;
+    }
+    text.clear();
+    while ((n = fread(buf, 1, sizeof(buf), fp)) > 0)
+        text.append(buf, n);
+    fclose(fp);
+    return 0;
+}
+
+/* Splits the way the enclave parses a ruleset: on '|', newlines and NULs */
+static void ac_bench_split(const std::string& text, std::vector<std::string>& patterns)
+{
+    std::string p;
+
+    for (size_t i = 0; i <= text.size(); i++) {
+        char c = i < text.size() ? text[i] : '\0';
+
+        if (c != '|' && c != '\n' && c != '\0') {
+            p += c;
+            continue;
+        }
+        if (c == '\n' && !p.empty() && p.back() == '\r')
+            p.pop_back();
+        if (!p.empty() && p.size() <= AC_PATTRN_MAX_LENGTH)
+            patterns.push_back(p);
+        p.clear();
+    }
+}
+
+static std::string ac_bench_word(std::mt19937_64& gen, size_t min, size_t max)
+{
+    std::uniform_int_distribution<size_t> len(min, max);
+    std::uniform_int_distribution<int> letter('a', 'z');
+    std::string w(len(gen), 'a');
+
+    for (size_t i = 0; i < w.size(); i++)
+        w[i] = (char) letter(gen);
+    return w;
+}
+
+/*
+ * The patterns of the largest ruleset: those of the file, then pseudo-words
+ * of 5 to 12 letters. The words of the text are 1 to 4 letters, so the
+ * pseudo-words only match where they are planted.
+ */
+static int ac_bench_patterns(const AC_BENCH_OPTIONS_t *opts, std::vector<std::string>& patterns)
+{
+    std::mt19937_64 gen(opts->seed);
+    std::string text;
+    size_t want = *std::max_element(opts->sizes, opts->sizes + opts->nsizes);
+
+    if (ac_bench_read(opts->rules, text) != 0)
+        return -1;
+    ac_bench_split(text, patterns);
+    if (patterns.size() < want)
+        printf("Info: %zu patterns in %s, the rest are pseudo-words\n", patterns.size(),
+               opts->rules);
+    while (patterns.size() < want)
+        patterns.push_back(ac_bench_word(gen, 5, 12));
+    return 0;
+}
+
+/* Seeded words of 1 to 4 letters, with rate patterns of rules planted per KiB */
+static void ac_bench_text(const AC_BENCH_OPTIONS_t *opts, const std::vector<std::string>& rules,
+                          double rate, std::string& text)
+{
+    std::mt19937_64 gen(opts->seed + 1);
+    std::uniform_real_distribution<double> u(0, 1);
+    std::uniform_int_distribution<size_t> pick(0, rules.empty() ? 0 : rules.size() - 1);
+    double per_byte = rate / 1024;
+
+    text.clear();
+    text.reserve(opts->bytes + AC_PATTRN_MAX_LENGTH);
+    while (text.size() < opts->bytes) {
+        size_t before = text.size();
+
+        text += ac_bench_word(gen, 1, 4);
+        text += ' ';
+        /* A pattern per word in proportion to the bytes the word took */
+        if (!rules.empty() && u(gen) < per_byte * (double) (text.size() - before)) {
+            text += rules[pick(gen)];
+            text += ' ';
+        }
+    }
+    text.resize(opts->bytes);
+}
+
+static int ac_bench_input(const char *path, AC_BENCH_INPUT_t *in)
+{
+    struct stat st;
+
+    in->name = path;
+    in->bytes = 0;
+    if (stat(path, &st) != 0) {
+        printf("\nFile %s not exist.\n", path);
+        return -1;
+    }
+    if (S_ISDIR(st.st_mode)) {
+        DIR *dir = opendir(path);
+        std::vector<std::string> names;
+        struct dirent *e;
+
+        if (dir == NULL) {
+            printf("\nCan not open directory %s.\n", path);
+            return -1;
+        }
+        while ((e = readdir(dir)) != NULL)
+            if (e->d_name[0] != '.')
+                names.push_back(std::string(path) + "/" + e->d_name);
+        closedir(dir);
+        std::sort(names.begin(), names.end());
+        for (size_t i = 0; i < names.size(); i++) {
+            in->pages.push_back(std::string());
+            if (ac_bench_read(names[i].c_str(), in->pages.back()) != 0)
+                return -1;
+            in->bytes += in->pages.back().size();
+        }
+    } else {
+        in->pages.push_back(std::string());
+        if (ac_bench_read(path, in->pages.back()) != 0)
+            return -1;
+        in->bytes = in->pages.back().size();
+    }
+    return 0;
+}
+
+static double ac_bench_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double) ts.tv_sec + (double) ts.tv_nsec / 1e9;
+}
+
+static double ac_bench_median(std::vector<double>& t)
+{
+    std::nth_element(t.begin(), t.begin() + t.size() / 2, t.end());
+    return t[t.size() / 2];
+}
+
+/* A finalized trie of the first n patterns, as enclave_ruleset.cpp builds it */
+static AC_TRIE_t *ac_bench_build(const std::vector<std::string>& patterns, size_t n)
+{
+    AC_TRIE_t *trie = ac_trie_create();
+
+    for (size_t i = 0; i < n; i++) {
+        AC_PATTERN_t pattern = {{patterns[i].data(), patterns[i].size()}, {"", 0},
+                                {{0}, AC_PATTID_TYPE_DEFAULT}};
+        ac_trie_add(trie, &pattern, 0);
+    }
+    ac_trie_finalize(trie);
+    return trie;
+}
+
+static int ac_bench_count(AC_MATCH_t *m, void *param)
+{
+    *(size_t *) param += m->size;
+    return 0;
+}
+
+static void ac_bench_collect(AC_TEXT_t *text, void *param)
+{
+    *(size_t *) param += text->length;
+}
+
+/* Searches every page chunk by chunk; returns the matches */
+static size_t ac_bench_search(AC_TRIE_t *trie, const AC_BENCH_INPUT_t *in, size_t chunk)
+{
+    size_t matches = 0;
+
+    for (size_t p = 0; p < in->pages.size(); p++) {
+        const std::string& page = in->pages[p];
+
+        for (size_t off = 0; off < page.size(); off += chunk) {
+            AC_TEXT_t text = {page.data() + off, std::min(chunk, page.size() - off)};
+            ac_trie_search(trie, &text, off != 0, ac_bench_count, &matches);
+        }
+    }
+    return matches;
+}
+
+/* Replaces in every page as the badword NF does; returns the output bytes */
+static size_t ac_bench_replace(AC_TRIE_t *trie, const AC_BENCH_INPUT_t *in, size_t chunk)
+{
+    AC_TEXT_t none = {"", 0};
+    size_t out = 0;
+
+    /* A search leaves its position in the trie */
+    multifast_rep_reset(trie);
+    for (size_t p = 0; p < in->pages.size(); p++) {
+        const std::string& page = in->pages[p];
+
+        for (size_t off = 0; off < page.size(); off += chunk) {
+            AC_TEXT_t text = {page.data() + off, std::min(chunk, page.size() - off)};
+            multifast_replace(trie, &text, MF_REPLACE_MODE_NORMAL, ac_bench_collect, &out);
+            multifast_rep_flush(trie, 1);
+        }
+        multifast_replace(trie, &none, MF_REPLACE_MODE_NORMAL, ac_bench_collect, &out);
+        multifast_rep_flush(trie, 0);
+    }
+    return out;
+}
+
+int main(int argc, char *argv[])
+{
+    AC_BENCH_OPTIONS_t opts;
+    std::vector<std::string> patterns;
+    std::vector<AC_BENCH_INPUT_t> inputs(2);
+    std::vector<double> t(0);
+
+    if (ac_bench_parse_options(argc, argv, &opts) != 0 || ac_bench_patterns(&opts, patterns) != 0)
+        return 1;
+    inputs[0].name = "clean";
+    inputs[1].name = "dense";
+    for (size_t i = 0; i < opts.inputs.size(); i++) {
+        inputs.push_back(AC_BENCH_INPUT_t());
+        if (ac_bench_input(opts.inputs[i], &inputs.back()) != 0)
+            return 1;
+    }
+
+    for (unsigned s = 0; s < opts.nsizes; s++) {
+        size_t n = opts.sizes[s];
+        std::vector<std::string> rules(patterns.begin(), patterns.begin() + n);
+        AC_TRIE_t *trie = NULL;
+
+        t.clear();
+        for (unsigned i = 0; i < opts.iterations; i++) {
+            double tic = ac_bench_now();
+
+            if (trie)
+                ac_trie_release(trie);
+            trie = ac_bench_build(patterns, n);
+            t.push_back(ac_bench_now() - tic);
+        }
+        printf("ACBuild:Patterns:%zu:Accepted:%zu:Time:%f\n", n, trie->patterns_count,
+               ac_bench_median(t));
+
+        /* The dense text plants patterns of this ruleset */
+        inputs[0].pages.assign(1, std::string());
+        ac_bench_text(&opts, std::vector<std::string>(), 0, inputs[0].pages[0]);
+        inputs[0].bytes = inputs[0].pages[0].size();
+        inputs[1].pages.assign(1, std::string());
+        ac_bench_text(&opts, rules, opts.match_rate, inputs[1].pages[0]);
+        inputs[1].bytes = inputs[1].pages[0].size();
+
+        for (size_t k = 0; k < inputs.size(); k++) {
+            const AC_BENCH_INPUT_t *in = &inputs[k];
+            size_t matches = 0, out = 0;
+            double search, replace;
+
+            t.clear();
+            for (unsigned i = 0; i < opts.iterations; i++) {
+                double tic = ac_bench_now();
+                matches = ac_bench_search(trie, in, opts.chunk);
+                t.push_back(ac_bench_now() - tic);
+            }
+            search = ac_bench_median(t);
+
+            t.clear();
+            for (unsigned i = 0; i < opts.iterations; i++) {
+                double tic = ac_bench_now();
+                out = ac_bench_replace(trie, in, opts.chunk);
+                t.push_back(ac_bench_now() - tic);
+            }
+            replace = ac_bench_median(t);
+
+            printf("ACSearch:Patterns:%zu:Input:%s:Bytes:%zu:Matches:%zu:Time:%f:MBps:%.1f\n",
+                   n, in->name.c_str(), in->bytes, matches, search,
+                   search > 0 ? (double) in->bytes / search / 1e6 : 0);
+            printf("ACReplace:Patterns:%zu:Input:%s:Bytes:%zu:OutputBytes:%zu:Time:%f:"
+                   "MBps:%.1f\n", n, in->name.c_str(), in->bytes, out, replace,
+                   replace > 0 ? (double) in->bytes / replace / 1e6 : 0);
+        }
+        ac_trie_release(trie);
+    }
+    return 0;
+}
@@ -0,0 +1,232 @@
+/*
+ * ac_fuzz.cpp: Fuzz target of the enclave's Aho-Corasick engine.
+ *
+ * An input is a ruleset and a text: its first two bytes give the length of
+ * the ruleset, whose patterns are separated by '|' or newlines, and the
+ * rest is the text. The low bit of the ruleset length picks whether the
+ * trie copies the patterns, the next one whether they are replaced by ""
+ * (as the badword NF does) or by "*". Each input is checked against:
+ *   - a brute-force search, for every match and its end position;
+ *   - itself fed in chunks, for search and for replace in both modes.
+ * A mismatch aborts, so any fuzzer reports it as a crash.
+ *
+ * Built with clang and -DAC_FUZZ=ON this is a libFuzzer target. Otherwise
+ * main() runs the inputs given as files, or seeded random inputs when
+ * there is none, so the same oracles run in any build.
+ */
+
+#include <algorithm>
+#include <random>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "ahocorasick.h"
+
+/* Bounds that keep the brute-force oracle fast */
+#define AC_FUZZ_PATTERNS_MAX 64
+#define AC_FUZZ_TEXT_MAX 8192
+
+typedef std::vector<std::pair<size_t, std::string>> AC_FUZZ_MATCHES_t;
+
+#define AC_FUZZ_CHECK(cond, what) \
+    do { \
+        if (!(cond)) { \
+            fprintf(stderr, "ac_fuzz: %s\n", what); \
+            abort(); \
+        } \
+    } while (0)
+
+static int ac_fuzz_match(AC_MATCH_t *m, void *param)
+{
+    AC_FUZZ_MATCHES_t *matches = (AC_FUZZ_MATCHES_t *) param;
+
+    for (size_t i = 0; i < m->size; i++)
+        matches->push_back(std::make_pair(m->position,
+                                          std::string(m->patterns[i].ptext.astring,
+                                                      m->patterns[i].ptext.length)));
+    return 0;
+}
+
+static void ac_fuzz_collect(AC_TEXT_t *text, void *param)
+{
+    ((std::string *) param)->append(text->astring, text->length);
+}
+
+static void ac_fuzz_search(AC_TRIE_t *trie, const std::string& text, size_t chunk,
+                           AC_FUZZ_MATCHES_t *matches)
+{
+    size_t off = 0;
+
+    matches->clear();
+    do {
+        AC_TEXT_t t = {text.data() + off, std::min(chunk, text.size() - off)};
+        AC_FUZZ_CHECK(ac_trie_search(trie, &t, off != 0, ac_fuzz_match, matches) == 0,
+                      "search failed");
+        off += t.length;
+    } while (off < text.size());
+    std::sort(matches->begin(), matches->end());
+}
+
+/* Replaces chunk by chunk, then flushes, the way the badword NF does */
+static std::string ac_fuzz_replace(AC_TRIE_t *trie, const std::string& text, size_t chunk,
+                                   MF_REPLACE_MODE_t mode)
+{
+    AC_TEXT_t none = {"", 0};
+    std::string out;
+
+    /* A search leaves its position in the trie */
+    multifast_rep_reset(trie);
+    for (size_t off = 0; off < text.size(); off += chunk) {
+        AC_TEXT_t t = {text.data() + off, std::min(chunk, text.size() - off)};
+        AC_FUZZ_CHECK(multifast_replace(trie, &t, mode, ac_fuzz_collect, &out) == 0,
+                      "replace failed");
+        multifast_rep_flush(trie, 1);
+    }
+    AC_FUZZ_CHECK(multifast_replace(trie, &none, mode, ac_fuzz_collect, &out) == 0,
+                  "replace failed");
+    multifast_rep_flush(trie, 0);
+    return out;
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+    std::vector<std::string> patterns, accepted;
+    AC_FUZZ_MATCHES_t expected, matches;
+    std::string rules, text, p;
+    size_t nrules;
+    int copy, star;
+
+    if (size < 2)
+        return 0;
+    nrules = (size_t) data[0] | (size_t) data[1] << 8;
+    copy = nrules & 1;
+    star = (nrules >> 1) & 1;
+    nrules = std::min(nrules >> 2, size - 2);
+    rules.assign((const char *) data + 2, nrules);
+    text.assign((const char *) data + 2 + nrules, std::min(size - 2 - nrules,
+                                                          (size_t) AC_FUZZ_TEXT_MAX));
+
+    for (size_t i = 0; i <= rules.size(); i++) {
+        if (i < rules.size() && rules[i] != '|' && rules[i] != '\n') {
+            p += rules[i];
+            continue;
+        }
+        if (patterns.size() < AC_FUZZ_PATTERNS_MAX)
+            patterns.push_back(p);
+        p.clear();
+    }
+
+    /* Patterns are kept alive until the release, for the trie that does not copy */
+    AC_TRIE_t *trie = ac_trie_create();
+    for (size_t i = 0; i < patterns.size(); i++) {
+        AC_PATTERN_t pattern = {{patterns[i].data(), patterns[i].size()},
+                                {star ? "*" : "", (size_t) star}, {{0}, AC_PATTID_TYPE_DEFAULT}};
+        AC_STATUS_t status = ac_trie_add(trie, &pattern, copy);
+
+        if (status == ACERR_SUCCESS) {
+            accepted.push_back(patterns[i]);
+            continue;
+        }
+        AC_FUZZ_CHECK(status == ACERR_ZERO_PATTERN || status == ACERR_DUPLICATE_PATTERN,
+                      "pattern rejected");
+        AC_FUZZ_CHECK(status != ACERR_ZERO_PATTERN || patterns[i].empty(),
+                      "pattern taken for empty");
+        AC_FUZZ_CHECK(status != ACERR_DUPLICATE_PATTERN ||
+                      std::find(accepted.begin(), accepted.end(), patterns[i]) != accepted.end(),
+                      "pattern taken for a duplicate");
+    }
+    ac_trie_finalize(trie);
+    AC_FUZZ_CHECK(trie->patterns_count == accepted.size(), "wrong pattern count");
+
+    /* Every occurrence of every accepted pattern, by end position */
+    for (size_t i = 0; i < accepted.size(); i++)
+        for (size_t end = accepted[i].size(); end <= text.size(); end++)
+            if (text.compare(end - accepted[i].size(), accepted[i].size(), accepted[i]) == 0)
+                expected.push_back(std::make_pair(end, accepted[i]));
+    std::sort(expected.begin(), expected.end());
+
+    ac_fuzz_search(trie, text, text.size() + 1, &matches);
+    AC_FUZZ_CHECK(matches == expected, "search disagrees with brute force");
+    for (size_t chunk = 1; chunk < text.size(); chunk = chunk * 3 + 1) {
+        ac_fuzz_search(trie, text, chunk, &matches);
+        AC_FUZZ_CHECK(matches == expected, "chunked search disagrees with brute force");
+    }
+
+    if (!accepted.empty()) {
+        const MF_REPLACE_MODE_t modes[] = {MF_REPLACE_MODE_NORMAL, MF_REPLACE_MODE_LAZY};
+
+        for (size_t m = 0; m < 2; m++) {
+            std::string whole = ac_fuzz_replace(trie, text, text.size() + 1, modes[m]);
+
+            /* Nothing matched, nothing replaced */
+            AC_FUZZ_CHECK(!expected.empty() || whole == text, "replace changed clean text");
+            for (size_t chunk = 1; chunk < text.size(); chunk = chunk * 3 + 1)
+                AC_FUZZ_CHECK(ac_fuzz_replace(trie, text, chunk, modes[m]) == whole,
+                              "chunked replace disagrees");
+        }
+    }
+    ac_trie_release(trie);
+    return 0;
+}
+
+#ifndef AC_FUZZ_LIBFUZZER
+
+#define AC_FUZZ_RUNS 10000
+
+static int ac_fuzz_file(const char *path)
+{
+    std::vector<uint8_t> data;
+    uint8_t buf[1 << 16];
+    size_t n;
+    FILE *fp = fopen(path, "rb");
+
+    if (fp == NULL) {
+        printf("\nFile %s not exist.\n", path);
+        return -1;
+    }
+    while ((n = fread(buf, 1, sizeof(buf), fp)) > 0)
+        data.insert(data.end(), buf, buf + n);
+    fclose(fp);
+    LLVMFuzzerTestOneInput(data.data(), data.size());
+    return 0;
+}
+
+/* Inputs over a small alphabet, so patterns overlap and recur in the text */
+static void ac_fuzz_random(std::mt19937_64& gen, std::vector<uint8_t>& data)
+{
+    static const char alphabet[] = "ab|\nc\0";
+    std::uniform_int_distribution<size_t> len(0, 512), letter(0, sizeof(alphabet) - 1);
+    size_t nrules = len(gen) / 4;
+
+    data.resize(2 + nrules + len(gen));
+    data[0] = (uint8_t) ((nrules << 2) | (gen() & 3));
+    data[1] = (uint8_t) (nrules >> 6);
+    for (size_t i = 2; i < data.size(); i++)
+        data[i] = (uint8_t) alphabet[letter(gen)];
+}
+
+int main(int argc, char *argv[])
+{
+    std::vector<uint8_t> data;
+    std::mt19937_64 gen(1);
+
+    for (int i = 1; i < argc; i++)
+        if (ac_fuzz_file(argv[i]) != 0)
+            return 1;
+    if (argc > 1) {
+        printf("ACFuzz:Inputs:%d\n", argc - 1);
+        return 0;
+    }
+    for (int i = 0; i < AC_FUZZ_RUNS; i++) {
+        ac_fuzz_random(gen, data);
+        LLVMFuzzerTestOneInput(data.data(), data.size());
+    }
+    printf("ACFuzz:Inputs:%d:Seed:1\n", AC_FUZZ_RUNS);
+    return 0;
+}
+
+#endif /* !AC_FUZZ_LIBFUZZER */
@@ -0,0 +1,420 @@
+/*
+ * corpus.cpp: Seeded synthetic web pages for the NF benchmarks. See
+ * corpus.h.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <unordered_set>
+
+#include "corpus.h"
+
+/* Stream of the vocabulary; the pages use their index */
+#define CORPUS_VOCAB_STREAM UINT64_MAX
+
+/* Tries for a word that is new and free of badwords */
+#define CORPUS_WORD_TRIES 64
+
+/* xoshiro256**, seeded through splitmix64 */
+typedef struct {
+    uint64_t s[4];
+} corpus_rng_t;
+
+static uint64_t corpus_splitmix64(uint64_t *x)
+{
+    uint64_t z = (*x += 0x9e3779b97f4a7c15ull);
+
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+}
+
+static void corpus_rng_seed(corpus_rng_t *rng, uint64_t seed, uint64_t stream)
+{
+    uint64_t x = seed ^ corpus_splitmix64(&stream);
+
+    for (int i = 0; i < 4; i++)
+        rng->s[i] = corpus_splitmix64(&x);
+}
+
+static inline uint64_t corpus_rotl(uint64_t x, int k)
+{
+    return (x << k) | (x >> (64 - k));
+}
+
+static uint64_t corpus_rng_next(corpus_rng_t *rng)
+{
+    uint64_t *s = rng->s;
+    uint64_t r = corpus_rotl(s[1] * 5, 7) * 9;
+    uint64_t t = s[1] << 17;
+
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = corpus_rotl(s[3], 45);
+    return r;
+}
+
+/* Uniform in [0, 1) */
+static double corpus_rng_double(corpus_rng_t *rng)
+{
+    return (double) (corpus_rng_next(rng) >> 11) * 0x1.0p-53;
+}
+
+/* Uniform in [0, n) */
+static size_t corpus_rng_below(corpus_rng_t *rng, size_t n)
+{
+    return (size_t) (((unsigned __int128) corpus_rng_next(rng) * n) >> 64);
+}
+
+/* Uniform in [lo, hi] */
+static size_t corpus_rng_range(corpus_rng_t *rng, size_t lo, size_t hi)
+{
+    return lo + corpus_rng_below(rng, hi - lo + 1);
+}
+
+/* Standard normal, Box-Muller */
+static double corpus_rng_normal(corpus_rng_t *rng)
+{
+    double u = 1.0 - corpus_rng_double(rng);
+    double v = corpus_rng_double(rng);
+
+    return std::sqrt(-2.0 * std::log(u)) * std::cos(2.0 * M_PI * v);
+}
+
+/* Rounds x up or down at random, so the mean is x */
+static size_t corpus_rng_round(corpus_rng_t *rng, double x)
+{
+    double whole = std::floor(x);
+
+    return (size_t) whole + (corpus_rng_double(rng) < x - whole);
+}
+
+static const char *const corpus_onsets[] = {
+    "b", "c", "d", "f", "g", "h", "k", "l", "m", "n", "p", "r", "s", "t", "v", "w", "z",
+    "br", "ch", "cl", "dr", "gr", "pl", "pr", "sh", "st", "th", "tr"
+};
+static const char *const corpus_vowels[] = {
+    "a", "e", "i", "o", "u", "ai", "ea", "io", "ou"
+};
+static const char *const corpus_codas[] = {
+    "", "", "", "n", "r", "s", "t", "l", "m", "nd", "st"
+};
+#define CORPUS_COUNT(a) (sizeof(a) / sizeof((a)[0]))
+
+/*
+ * The fixed markup of the pages. Each piece is checked against the
+ * badwords by corpus_markup_check(), the words are filled in between.
+ */
+static const char corpus_head[] =
+    "<!DOCTYPE html>\n<html lang=\"en\">\n<head>\n"
+    "<meta name=\"viewport\" content=\"width=device-width\">\n</head>\n<body>\n<main>\n";
+static const char corpus_tail[] = "</main>\n</body>\n</html>\n";
+static const char *const corpus_markup[] = {
+    corpus_head, corpus_tail,
+    "<h2>", "</h2>\n", "<p>", "</p>\n", "<em>", "</em>",
+    "<a href=\"https://www.", ".org/", ".html\">", "</a>",
+    "<ul>\n", "</ul>\n", "<li>", "</li>\n",
+    "<script>\nvar ", " = \"", "\";\nfunction ", "(e) {\n  return ", " + e;\n}\n</script>\n"
+};
+
+void corpus_parse_badwords(const std::string& text, std::vector<std::string>& badwords)
+{
+    std::string word;
+
+    badwords.clear();
+    for (size_t i = 0; i <= text.size(); i++) {
+        char c = i < text.size() ? text[i] : '\0';
+
+        if (c != '|' && c != '\n' && c != '\0') {
+            word += c;
+            continue;
+        }
+        if (!word.empty() && word.back() == '\r')
+            word.pop_back();
+        if (!word.empty())
+            badwords.push_back(word);
+        word.clear();
+    }
+}
+
+static bool corpus_has_badword(const CORPUS_PARAMS_t *params, const std::string& s)
+{
+    for (size_t i = 0; i < params->badwords.size(); i++)
+        if (s.find(params->badwords[i]) != std::string::npos)
+            return true;
+    return false;
+}
+
+const char *corpus_markup_check(const CORPUS_PARAMS_t *params)
+{
+    for (size_t i = 0; i < CORPUS_COUNT(corpus_markup); i++)
+        if (corpus_has_badword(params, corpus_markup[i]))
+            return corpus_markup[i];
+    return NULL;
+}
+
+/*
+ * corpus_vocab_init:
+ *   Makes vocab_size distinct pseudo-words of one to three syllables; as
+ *   in natural text, the frequent words (low ranks) are the short ones.
+ *   The vocabulary comes out smaller if the badwords leave too few.
+ */
+void corpus_vocab_init(CORPUS_VOCAB_t *vocab, const CORPUS_PARAMS_t *params)
+{
+    std::unordered_set<std::string> seen;
+    corpus_rng_t rng;
+    double total = 0;
+
+    corpus_rng_seed(&rng, params->seed, CORPUS_VOCAB_STREAM);
+    vocab->words.clear();
+    vocab->cdf.clear();
+    vocab->excluded = 0;
+
+    /* Badwords as short as a syllable can rule out most candidates */
+    for (size_t rank = 0; vocab->words.size() < params->vocab_size &&
+                          rank < 4 * params->vocab_size + 1000; rank++) {
+        size_t syllables = 1 + (rank >= 50) + (rank >= 1000);
+        std::string word;
+        int tries;
+
+        for (tries = 0; tries < CORPUS_WORD_TRIES; tries++) {
+            size_t n = corpus_rng_range(&rng, 1, syllables);
+
+            word.clear();
+            for (size_t i = 0; i < n; i++) {
+                word += corpus_onsets[corpus_rng_below(&rng, CORPUS_COUNT(corpus_onsets))];
+                word += corpus_vowels[corpus_rng_below(&rng, CORPUS_COUNT(corpus_vowels))];
+                word += corpus_codas[corpus_rng_below(&rng, CORPUS_COUNT(corpus_codas))];
+            }
+            if (seen.count(word))
+                continue;
+            seen.insert(word);
+            if (!corpus_has_badword(params, word))
+                break;
+            vocab->excluded++;
+        }
+        /* The short words ran out, go on with longer ones */
+        if (tries == CORPUS_WORD_TRIES)
+            continue;
+
+        total += 1.0 / std::pow((double) vocab->words.size() + 1, params->zipf);
+        vocab->words.push_back(word);
+        vocab->cdf.push_back(total);
+    }
+}
+
+/* Builds one page; hits are planted once the page passes their offsets */
+struct corpus_page_ctx
+{
+    const CORPUS_PARAMS_t *params;
+    const CORPUS_VOCAB_t *vocab;
+    corpus_rng_t rng;
+    std::string *page;
+    std::string block;          /* Block being built, kept if it fits */
+    std::vector<size_t> bad;    /* Offsets of the badwords, descending */
+    std::vector<size_t> ids;    /* Offsets of the signatures, descending */
+    CORPUS_HITS_t block_hits;
+};
+
+static size_t corpus_page_size(const CORPUS_PARAMS_t *params, corpus_rng_t *rng)
+{
+    double size, mu;
+
+    switch (params->size_dist) {
+    case CORPUS_SIZE_UNIFORM:
+        return corpus_rng_range(rng, params->size_min, params->size_max);
+    case CORPUS_SIZE_LOGNORMAL:
+        mu = std::log((double) params->size_mean) - params->size_sigma * params->size_sigma / 2;
+        size = std::exp(mu + params->size_sigma * corpus_rng_normal(rng));
+        size = std::max(size, (double) params->size_min);
+        size = std::min(size, (double) params->size_max);
+        return (size_t) size;
+    default:
+        return params->size_mean;
+    }
+}
+
+/* Draws the offsets of rate hits per KiB in [lo, hi), in descending order */
+static void corpus_offsets(corpus_rng_t *rng, double rate, size_t lo, size_t hi,
+                           std::vector<size_t>& offsets)
+{
+    size_t n = hi > lo ? corpus_rng_round(rng, rate * (double) (hi - lo) / 1024) : 0;
+
+    offsets.resize(n);
+    for (size_t i = 0; i < n; i++)
+        offsets[i] = corpus_rng_range(rng, lo, hi - 1);
+    std::sort(offsets.begin(), offsets.end(), std::greater<size_t>());
+}
+
+/* Appends a word of the vocabulary, or a badword whose offset was passed */
+static void corpus_word(struct corpus_page_ctx *ctx)
+{
+    const CORPUS_VOCAB_t *vocab = ctx->vocab;
+
+    if (!ctx->bad.empty() && ctx->bad.back() <= ctx->page->size() + ctx->block.size()) {
+        const std::vector<std::string>& badwords = ctx->params->badwords;
+
+        ctx->bad.pop_back();
+        ctx->block += badwords[corpus_rng_below(&ctx->rng, badwords.size())];
+        ctx->block_hits.badwords++;
+        return;
+    }
+    double u = corpus_rng_double(&ctx->rng) * vocab->cdf.back();
+    size_t i = std::upper_bound(vocab->cdf.begin(), vocab->cdf.end(), u) - vocab->cdf.begin();
+
+    ctx->block += vocab->words[std::min(i, vocab->words.size() - 1)];
+}
+
+static void corpus_words(struct corpus_page_ctx *ctx, size_t lo, size_t hi)
+{
+    size_t n = corpus_rng_range(&ctx->rng, lo, hi);
+
+    for (size_t i = 0; i < n; i++) {
+        if (i)
+            ctx->block += ' ';
+        corpus_word(ctx);
+    }
+}
+
+static void corpus_link(struct corpus_page_ctx *ctx)
+{
+    ctx->block += "<a href=\"https://www.";
+    corpus_word(ctx);
+    ctx->block += ".org/";
+    corpus_word(ctx);
+    ctx->block += ".html\">";
+    corpus_words(ctx, 1, 3);
+    ctx->block += "</a>";
+}
+
+static void corpus_paragraph(struct corpus_page_ctx *ctx)
+{
+    size_t n = corpus_rng_range(&ctx->rng, 8, 60);
+
+    ctx->block += "<p>";
+    for (size_t i = 0; i < n; i++) {
+        size_t r = corpus_rng_below(&ctx->rng, 100);
+
+        if (i)
+            ctx->block += ' ';
+        if (r < 3) {
+            corpus_link(ctx);
+        } else if (r < 5) {
+            ctx->block += "<em>";
+            corpus_word(ctx);
+            ctx->block += "</em>";
+        } else {
+            corpus_word(ctx);
+        }
+    }
+    ctx->block += "</p>\n";
+}
+
+static void corpus_list(struct corpus_page_ctx *ctx)
+{
+    size_t n = corpus_rng_range(&ctx->rng, 2, 8);
+
+    ctx->block += "<ul>\n";
+    for (size_t i = 0; i < n; i++) {
+        ctx->block += "<li>";
+        if (corpus_rng_below(&ctx->rng, 2))
+            corpus_link(ctx);
+        else
+            corpus_words(ctx, 1, 6);
+        ctx->block += "</li>\n";
+    }
+    ctx->block += "</ul>\n";
+}
+
+static void corpus_script(struct corpus_page_ctx *ctx)
+{
+    ctx->block += "<script>\nvar ";
+    corpus_word(ctx);
+    ctx->block += " = \"";
+    corpus_words(ctx, 2, 8);
+    ctx->block += "\";\nfunction ";
+    corpus_word(ctx);
+    ctx->block += "(e) {\n  return ";
+    corpus_word(ctx);
+    ctx->block += " + e;\n}\n</script>\n";
+}
+
+/* Builds the next block: the signatures due, or content */
+static void corpus_block(struct corpus_page_ctx *ctx)
+{
+    size_t r;
+
+    ctx->block.clear();
+    ctx->block_hits.badwords = ctx->block_hits.ids = 0;
+    while (!ctx->ids.empty() && ctx->ids.back() <= ctx->page->size()) {
+        ctx->ids.pop_back();
+        ctx->block += ctx->params->ids_signature;
+        ctx->block += '\n';
+        ctx->block_hits.ids++;
+    }
+    if (!ctx->block.empty())
+        return;
+
+    r = corpus_rng_below(&ctx->rng, 100);
+    if (r < 60) {
+        corpus_paragraph(ctx);
+    } else if (r < 75) {
+        ctx->block += "<h2>";
+        corpus_words(ctx, 2, 6);
+        ctx->block += "</h2>\n";
+    } else if (r < 90) {
+        corpus_list(ctx);
+    } else {
+        corpus_script(ctx);
+    }
+}
+
+/*
+ * corpus_page:
+ *   Blocks are added while they fit before the tail; the rest of the size
+ *   is padded with blank lines. A page smaller than the head and the tail
+ *   is a truncated skeleton.
+ */
+void corpus_page(const CORPUS_PARAMS_t *params, const CORPUS_VOCAB_t *vocab, size_t index,
+                 std::string& page, CORPUS_HITS_t *hits)
+{
+    struct corpus_page_ctx ctx;
+    size_t size, head = sizeof(corpus_head) - 1, tail = sizeof(corpus_tail) - 1, body;
+
+    ctx.params = params;
+    ctx.vocab = vocab;
+    ctx.page = &page;
+    corpus_rng_seed(&ctx.rng, params->seed, index);
+    hits->badwords = hits->ids = 0;
+
+    size = corpus_page_size(params, &ctx.rng);
+    page.clear();
+    page.reserve(size);
+    if (size < head + tail) {
+        page.append(corpus_head).append(corpus_tail).resize(size);
+        return;
+    }
+    body = size - tail;
+
+    corpus_offsets(&ctx.rng, params->badwords.empty() ? 0 : params->badword_rate,
+                   head, body, ctx.bad);
+    corpus_offsets(&ctx.rng, params->ids_signature.empty() ? 0 : params->ids_rate,
+                   head, body, ctx.ids);
+
+    page += corpus_head;
+    for (;;) {
+        corpus_block(&ctx);
+        if (page.size() + ctx.block.size() > body)
+            break;
+        page += ctx.block;
+        hits->badwords += ctx.block_hits.badwords;
+        hits->ids += ctx.block_hits.ids;
+    }
+    while (page.size() < body)
+        page += (body - page.size()) % 64 == 1 ? '\n' : ' ';
+    page += corpus_tail;
+}
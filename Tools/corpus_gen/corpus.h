@@ -0,0 +1,74 @@
+/*
+ * corpus.h: Seeded synthetic web pages for the NF benchmarks.
+ *
+ * A page is a function of the parameters and its index only: each page
+ * draws from its own generator, seeded from the corpus seed and the index,
+ * so pages can be made in any order, on any number of threads, and the
+ * first N pages of a larger corpus are the N pages of a smaller one.
+ *
+ * The text is HTML-like: a head, then paragraphs, lists, links and script
+ * blocks of words drawn from a Zipf-distributed vocabulary of pseudo-words.
+ * Badwords and the IDS signature are planted at a given rate per KiB;
+ * vocabulary words that contain a badword are left out, so the planted
+ * hits are the only ones but for badwords with a space, which two
+ * adjacent words can still spell.
+ */
+
+#ifndef _CORPUS_H_
+#define _CORPUS_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+typedef enum {
+    CORPUS_SIZE_FIXED,          /* Every page is size_mean bytes */
+    CORPUS_SIZE_UNIFORM,        /* Uniform in [size_min, size_max] */
+    CORPUS_SIZE_LOGNORMAL       /* Log-normal of mean size_mean, clamped */
+} corpus_size_dist_t;
+
+typedef struct {
+    uint64_t seed;
+    corpus_size_dist_t size_dist;
+    size_t size_mean;
+    size_t size_min;
+    size_t size_max;
+    double size_sigma;          /* Sigma of the log of the size */
+    size_t vocab_size;          /* Pseudo-words of the vocabulary */
+    double zipf;                /* Exponent of the word frequencies */
+    double badword_rate;        /* Planted badwords per KiB */
+    double ids_rate;            /* Planted IDS signatures per KiB */
+    std::vector<std::string> badwords;
+    std::string ids_signature;
+} CORPUS_PARAMS_t;
+
+typedef struct {
+    std::vector<std::string> words;
+    std::vector<double> cdf;    /* Cumulative Zipf weight of words[0..i] */
+    size_t excluded;            /* Words dropped for containing a badword */
+} CORPUS_VOCAB_t;
+
+/* Hits planted in a page */
+typedef struct {
+    size_t badwords;
+    size_t ids;
+} CORPUS_HITS_t;
+
+/*
+ * Splits text into badwords the way the enclave parses a ruleset: on '|',
+ * newlines and NULs, without CRs and empty entries.
+ */
+void corpus_parse_badwords(const std::string& text, std::vector<std::string>& badwords);
+
+/* Builds the vocabulary of params; it depends on the seed only */
+void corpus_vocab_init(CORPUS_VOCAB_t *vocab, const CORPUS_PARAMS_t *params);
+
+/* Returns the markup of the pages that contains a badword, if any */
+const char *corpus_markup_check(const CORPUS_PARAMS_t *params);
+
+/* Makes page index of the corpus into page */
+void corpus_page(const CORPUS_PARAMS_t *params, const CORPUS_VOCAB_t *vocab, size_t index,
+                 std::string& page, CORPUS_HITS_t *hits);
+
+#endif /* !_CORPUS_H_ */
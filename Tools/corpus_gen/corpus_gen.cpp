@@ -0,0 +1,355 @@
+/*
+ * corpus_gen.cpp: Writes a synthetic corpus in the ../Web/ layout of the
+ * App, one file per page, so the benchmarks run without crawl_topsite.py
+ * and the network. The same seed and parameters give the same bytes, on
+ * any number of --jobs.
+ */
+
+#include <atomic>
+#include <errno.h>
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <thread>
+#include <time.h>
+
+#include "corpus.h"
+
+#define CORPUS_OUT_DIR "Web"
+#define CORPUS_BADWORDS_FILE "NFVEnclave/badwords.txt"
+#define CORPUS_PAGES 1000
+#define CORPUS_SEED 1
+#define CORPUS_SIZE_MEAN (32 << 10)
+#define CORPUS_SIZE_MIN 256
+#define CORPUS_SIZE_MAX (4 << 20)
+#define CORPUS_SIZE_SIGMA 1.0
+#define CORPUS_VOCAB_SIZE 5000
+#define CORPUS_ZIPF 1.0
+#define CORPUS_BADWORD_RATE 0.5
+#define CORPUS_IDS_RATE 0.01
+#define CORPUS_JOBS_MAX 256
+
+/* Signature the IDS NF looks for, NF_IDS_SIGNATURE of nf_kernels.h */
+#define CORPUS_IDS_SIGNATURE "<script>onerror=alert;throw 1</script>"
+
+/* Used when there is no badwords file; a few entries of badwords.txt */
+static const char corpus_default_badwords[] = "4r5e|5h1t|5hit|a55|ar5e|b00bs|b17ch|b1tch|c0ck";
+
+typedef struct {
+    CORPUS_PARAMS_t params;
+    const char *out;
+    const char *badwords;
+    size_t pages;
+    unsigned jobs;
+} CORPUS_OPTIONS_t;
+
+/* Totals of one job */
+typedef struct {
+    size_t pages;
+    size_t bytes;
+    CORPUS_HITS_t hits;
+    int failed;
+} CORPUS_TOTALS_t;
+
+static void corpus_usage(const char *prog)
+{
+    printf("Usage: %s [options]\n"
+           "  --badword-rate R    badwords planted per KiB (default %g)\n"
+           "  --badwords FILE     badwords, separated by '|' or newlines (default %s)\n"
+           "  --ids-rate R        IDS signatures planted per KiB (default %g)\n"
+           "  --jobs N            pages written on N threads (default 1)\n"
+           "  --out DIR           directory of the pages (default %s)\n"
+           "  --pages N           number of pages (default %d)\n"
+           "  --seed N            seed of the corpus (default %d)\n"
+           "  --size-dist D       page sizes: fixed, uniform or lognormal\n"
+           "                      (default lognormal)\n"
+           "  --size-max BYTES    largest page (default %d)\n"
+           "  --size-mean BYTES   mean page size, the size with fixed (default %d)\n"
+           "  --size-min BYTES    smallest page (default %d)\n"
+           "  --size-sigma S      sigma of the log of the size (default %g)\n"
+           "  --vocab N           words of the vocabulary (default %d)\n"
+           "  --zipf S            exponent of the word frequencies (default %g)\n"
+           "  -h, --help          show this text\n", prog, CORPUS_BADWORD_RATE,
+           CORPUS_BADWORDS_FILE, CORPUS_IDS_RATE, CORPUS_OUT_DIR, CORPUS_PAGES, CORPUS_SEED,
+           CORPUS_SIZE_MAX, CORPUS_SIZE_MEAN, CORPUS_SIZE_MIN, CORPUS_SIZE_SIGMA,
+           CORPUS_VOCAB_SIZE, CORPUS_ZIPF);
+}
+
+/* Parses a decimal count in [min, max] */
+static int corpus_parse_count(const char *name, const char *arg, unsigned long long min,
+                              unsigned long long max, unsigned long long *value)
+{
+    char *end;
+    unsigned long long n = strtoull(arg, &end, 10);
+
+    if (*arg == '\0' || *arg == '-' || *end != '\0' || n < min || n > max) {
+        printf("Bad %s: %s\n", name, arg);
+        return -1;
+    }
+    *value = n;
+    return 0;
+}
+
+/* Parses a decimal number in [min, max] */
+static int corpus_parse_real(const char *name, const char *arg, double min, double max,
+                             double *value)
+{
+    char *end;
+    double x = strtod(arg, &end);
+
+    if (*arg == '\0' || *end != '\0' || !(x >= min && x <= max)) {
+        printf("Bad %s: %s\n", name, arg);
+        return -1;
+    }
+    *value = x;
+    return 0;
+}
+
+static int corpus_parse_options(int argc, char *argv[], CORPUS_OPTIONS_t *opts)
+{
+    enum {
+        OPT_BADWORD_RATE = 256, OPT_BADWORDS, OPT_IDS_RATE, OPT_JOBS, OPT_OUT, OPT_PAGES,
+        OPT_SEED, OPT_SIZE_DIST, OPT_SIZE_MAX, OPT_SIZE_MEAN, OPT_SIZE_MIN, OPT_SIZE_SIGMA,
+        OPT_VOCAB, OPT_ZIPF
+    };
+    static const struct option longopts[] = {
+        {"badword-rate", required_argument, NULL, OPT_BADWORD_RATE},
+        {"badwords",     required_argument, NULL, OPT_BADWORDS},
+        {"ids-rate",     required_argument, NULL, OPT_IDS_RATE},
+        {"jobs",         required_argument, NULL, OPT_JOBS},
+        {"out",          required_argument, NULL, OPT_OUT},
+        {"pages",        required_argument, NULL, OPT_PAGES},
+        {"seed",         required_argument, NULL, OPT_SEED},
+        {"size-dist",    required_argument, NULL, OPT_SIZE_DIST},
+        {"size-max",     required_argument, NULL, OPT_SIZE_MAX},
+        {"size-mean",    required_argument, NULL, OPT_SIZE_MEAN},
+        {"size-min",     required_argument, NULL, OPT_SIZE_MIN},
+        {"size-sigma",   required_argument, NULL, OPT_SIZE_SIGMA},
+        {"vocab",        required_argument, NULL, OPT_VOCAB},
+        {"zipf",         required_argument, NULL, OPT_ZIPF},
+        {"help",         no_argument,       NULL, 'h'},
+        {NULL, 0, NULL, 0}
+    };
+    CORPUS_PARAMS_t *params = &opts->params;
+    unsigned long long n;
+    int c, ret = 0;
+
+    opts->out = CORPUS_OUT_DIR;
+    opts->badwords = NULL;
+    opts->pages = CORPUS_PAGES;
+    opts->jobs = 1;
+    params->seed = CORPUS_SEED;
+    params->size_dist = CORPUS_SIZE_LOGNORMAL;
+    params->size_mean = CORPUS_SIZE_MEAN;
+    params->size_min = CORPUS_SIZE_MIN;
+    params->size_max = CORPUS_SIZE_MAX;
+    params->size_sigma = CORPUS_SIZE_SIGMA;
+    params->vocab_size = CORPUS_VOCAB_SIZE;
+    params->zipf = CORPUS_ZIPF;
+    params->badword_rate = CORPUS_BADWORD_RATE;
+    params->ids_rate = CORPUS_IDS_RATE;
+    params->ids_signature = CORPUS_IDS_SIGNATURE;
+
+    while (ret == 0 && (c = getopt_long(argc, argv, "h", longopts, NULL)) != -1) {
+        switch (c) {
+        case OPT_BADWORD_RATE:
+            ret = corpus_parse_real("badword rate", optarg, 0, 1024, &params->badword_rate);
+            break;
+        case OPT_BADWORDS:
+            opts->badwords = optarg;
+            break;
+        case OPT_IDS_RATE:
+            ret = corpus_parse_real("IDS rate", optarg, 0, 1024, &params->ids_rate);
+            break;
+        case OPT_JOBS:
+            ret = corpus_parse_count("job count", optarg, 1, CORPUS_JOBS_MAX, &n);
+            opts->jobs = (unsigned) n;
+            break;
+        case OPT_OUT:
+            opts->out = optarg;
+            break;
+        case OPT_PAGES:
+            ret = corpus_parse_count("page count", optarg, 1, 100000000, &n);
+            opts->pages = (size_t) n;
+            break;
+        case OPT_SEED:
+            ret = corpus_parse_count("seed", optarg, 0, UINT64_MAX, &n);
+            params->seed = n;
+            break;
+        case OPT_SIZE_DIST:
+            if (strcmp(optarg, "fixed") == 0) {
+                params->size_dist = CORPUS_SIZE_FIXED;
+            } else if (strcmp(optarg, "uniform") == 0) {
+                params->size_dist = CORPUS_SIZE_UNIFORM;
+            } else if (strcmp(optarg, "lognormal") == 0) {
+                params->size_dist = CORPUS_SIZE_LOGNORMAL;
+            } else {
+                printf("Bad size distribution: %s\n", optarg);
+                ret = -1;
+            }
+            break;
+        case OPT_SIZE_MAX:
+            ret = corpus_parse_count("maximum size", optarg, 1, 1ull << 32, &n);
+            params->size_max = (size_t) n;
+            break;
+        case OPT_SIZE_MEAN:
+            ret = corpus_parse_count("mean size", optarg, 1, 1ull << 32, &n);
+            params->size_mean = (size_t) n;
+            break;
+        case OPT_SIZE_MIN:
+            ret = corpus_parse_count("minimum size", optarg, 1, 1ull << 32, &n);
+            params->size_min = (size_t) n;
+            break;
+        case OPT_SIZE_SIGMA:
+            ret = corpus_parse_real("size sigma", optarg, 0, 4, &params->size_sigma);
+            break;
+        case OPT_VOCAB:
+            ret = corpus_parse_count("vocabulary size", optarg, 1, 1000000, &n);
+            params->vocab_size = (size_t) n;
+            break;
+        case OPT_ZIPF:
+            ret = corpus_parse_real("Zipf exponent", optarg, 0, 4, &params->zipf);
+            break;
+        case 'h':
+            corpus_usage(argv[0]);
+            exit(0);
+        default:
+            corpus_usage(argv[0]);
+            ret = -1;
+            break;
+        }
+    }
+    if (ret == 0 && optind < argc) {
+        printf("Unexpected argument: %s\n", argv[optind]);
+        ret = -1;
+    }
+    if (ret == 0 && params->size_min > params->size_max) {
+        printf("--size-min is larger than --size-max\n");
+        ret = -1;
+    }
+    return ret;
+}
+
+/* Reads the badwords; a missing default file falls back to the short list */
+static int corpus_load_badwords(CORPUS_OPTIONS_t *opts)
+{
+    const char *path = opts->badwords ? opts->badwords : CORPUS_BADWORDS_FILE;
+    std::string text;
+    char buf[4096];
+    size_t n;
+    FILE *fp = fopen(path, "rb");
+
+    if (fp == nullptr) {
+        if (opts->badwords) {
+            printf("\nFile %s not exist.\n", path);
+            return -1;
+        }
+        printf("Info: no %s, using the built-in badwords\n", path);
+        text = corpus_default_badwords;
+    } else {
+        while ((n = fread(buf, 1, sizeof(buf), fp)) > 0)
+            text.append(buf, n);
+        fclose(fp);
+    }
+    corpus_parse_badwords(text, opts->params.badwords);
+    if (opts->params.badwords.empty() && opts->params.badword_rate > 0) {
+        printf("No badwords in %s\n", path);
+        return -1;
+    }
+    return 0;
+}
+
+/* Makes the pages the cursor hands out and writes them to opts->out */
+static void corpus_job(const CORPUS_OPTIONS_t *opts, const CORPUS_VOCAB_t *vocab,
+                       std::atomic<size_t> *cursor, CORPUS_TOTALS_t *totals)
+{
+    std::string page;
+    CORPUS_HITS_t hits;
+    char path[4096];
+    size_t i;
+
+    while (!totals->failed && (i = cursor->fetch_add(1)) < opts->pages) {
+        corpus_page(&opts->params, vocab, i, page, &hits);
+        snprintf(path, sizeof(path), "%s/page%08zu.html", opts->out, i);
+
+        FILE *fp = fopen(path, "wb");
+        if (fp == nullptr) {
+            printf("\nCan not open or create file %s.\n", path);
+            totals->failed = 1;
+            break;
+        }
+        if (fwrite(page.data(), 1, page.size(), fp) != page.size()) {
+            printf("\nCan not write file %s.\n", path);
+            totals->failed = 1;
+        }
+        fclose(fp);
+
+        totals->pages++;
+        totals->bytes += page.size();
+        totals->hits.badwords += hits.badwords;
+        totals->hits.ids += hits.ids;
+    }
+}
+
+static double corpus_time(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double) ts.tv_sec + (double) ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char *argv[])
+{
+    CORPUS_OPTIONS_t opts;
+    CORPUS_VOCAB_t vocab;
+    std::atomic<size_t> cursor(0);
+    std::vector<CORPUS_TOTALS_t> totals;
+    std::vector<std::thread> threads;
+    CORPUS_TOTALS_t sum = {0, 0, {0, 0}, 0};
+    const char *markup;
+    double tic;
+
+    if (corpus_parse_options(argc, argv, &opts) != 0 || corpus_load_badwords(&opts) != 0)
+        return 1;
+
+    markup = corpus_markup_check(&opts.params);
+    if (markup)
+        printf("Warning: the markup \"%s\" holds a badword, pages match more than planted\n",
+               markup);
+    corpus_vocab_init(&vocab, &opts.params);
+    if (vocab.words.empty()) {
+        printf("The badwords leave no vocabulary\n");
+        return 1;
+    }
+    if (vocab.words.size() < opts.params.vocab_size)
+        printf("Warning: vocabulary of %zu words only\n", vocab.words.size());
+
+    if (mkdir(opts.out, 0755) != 0 && errno != EEXIST) {
+        printf("\nCan not create directory %s.\n", opts.out);
+        return 1;
+    }
+
+    tic = corpus_time();
+    totals.assign(opts.jobs, sum);
+    for (unsigned j = 1; j < opts.jobs; j++)
+        threads.emplace_back(corpus_job, &opts, &vocab, &cursor, &totals[j]);
+    corpus_job(&opts, &vocab, &cursor, &totals[0]);
+    for (size_t j = 0; j < threads.size(); j++)
+        threads[j].join();
+
+    for (unsigned j = 0; j < opts.jobs; j++) {
+        sum.pages += totals[j].pages;
+        sum.bytes += totals[j].bytes;
+        sum.hits.badwords += totals[j].hits.badwords;
+        sum.hits.ids += totals[j].hits.ids;
+        sum.failed |= totals[j].failed;
+    }
+    printf("Corpus:Seed:%llu:Pages:%zu:Bytes:%zu:Vocab:%zu:Excluded:%zu:Badwords:%zu:Ids:%zu"
+           ":Time:%f\n", (unsigned long long) opts.params.seed, sum.pages, sum.bytes,
+           vocab.words.size(), vocab.excluded, sum.hits.badwords, sum.hits.ids,
+           corpus_time() - tic);
+    return sum.failed ? 1 : 0;
+}
@@ -0,0 +1,745 @@
+/*
+ * nf_analyze.cpp: Compares the NF benchmark results of enclave variants.
+ *
+ * Each argument names a variant and its result file, written by the App
+ * with --bench-pages (a row per NF and page) or --bench-out (a row per NF
+ * and size bucket), as CSV or JSON. The rows of per-page files are paired
+ * by NF and page: the time overhead of a variant is the sum of its median
+ * page times over that of the baseline on the same pages, and the size
+ * overhead likewise with the output bytes, per size bucket and over all
+ * pages, with percentile bootstrap confidence intervals. Summary files
+ * give the ratios of their means, without intervals. A column the App
+ * no longer writes is an error, not a blank.
+ */
+
+#include <chrono>
+#include <cmath>
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "results.h"
+#include "stats.h"
+
+#define ANALYZE_REPLICATES 1000
+#define ANALYZE_CONFIDENCE 95.0
+#define ANALYZE_SEED 1
+#define ANALYZE_JOBS_MAX 256
+#define ANALYZE_VARIANTS_MAX 32     /* Bits of ANALYZE_NF_t::seen */
+#define ANALYZE_BUCKETS_MAX 255
+
+/* Buckets of the App's benchmark, in its order; others follow as they come */
+static const char *analyze_buckets[] = {
+    "0-1K", "1K-4K", "4K-16K", "16K-64K", "64K-256K", "256K-1M", "1M+"
+};
+#define ANALYZE_BUCKETS (sizeof(analyze_buckets) / sizeof(analyze_buckets[0]))
+
+typedef enum {
+    ANALYZE_UNKNOWN,
+    ANALYZE_PAGES,              /* --bench-pages: a row per NF and page */
+    ANALYZE_SUMMARY             /* --bench-out: a row per NF and bucket */
+} analyze_kind_t;
+
+typedef struct {
+    std::string name;
+    const char *path;
+} ANALYZE_INPUT_t;
+
+typedef struct {
+    std::vector<ANALYZE_INPUT_t> inputs;
+    const char *baseline;
+    const char *csv;
+    unsigned replicates;
+    double confidence;
+    uint64_t seed;
+    unsigned jobs;
+} ANALYZE_OPTIONS_t;
+
+/*
+ * The pages of one NF in per-page files, a series per variant. The files
+ * of one run list the pages in the same order, so a page is first looked
+ * for where the last one was found plus one; the index is built the first
+ * time that fails.
+ */
+typedef struct {
+    std::string name;
+    std::vector<std::string> pages;
+    std::unordered_map<std::string, size_t> index;  /* Page name to position, or empty */
+    size_t next;                                    /* Expected position of the next page */
+    size_t first;                                   /* Variant whose file listed it first */
+    std::vector<uint8_t> bucket;
+    std::vector<uint32_t> seen;                     /* Variants with the page, a bit each */
+    std::vector<std::vector<double>> time;          /* [variant][page], median us */
+    std::vector<std::vector<double>> size;          /* [variant][page], output bytes */
+} ANALYZE_NF_t;
+
+/* One row of a summary file */
+typedef struct {
+    size_t nf;
+    size_t bucket;
+    size_t variant;
+    double pages;
+    double mean_us;
+    double out_bytes;
+} ANALYZE_SUMMARY_t;
+
+typedef struct {
+    analyze_kind_t kind;
+    const std::vector<ANALYZE_INPUT_t> *inputs;
+    size_t nvariants;
+    std::vector<std::string> buckets;
+    std::vector<ANALYZE_NF_t> nfs;
+    std::vector<ANALYZE_SUMMARY_t> summary;
+
+    /* The file being read */
+    size_t variant;
+    const char *path;
+    analyze_kind_t file_kind;
+    size_t ncolumns;            /* Columns when col[] was looked up */
+    int col[6];
+    size_t last_nf;
+} ANALYZE_DATA_t;
+
+/* One line of the report */
+typedef struct {
+    const char *nf;
+    const char *bucket;
+    const char *variant;
+    double pages;
+    double base_time, time;     /* Mean us per page */
+    double base_size, size;     /* Output bytes */
+    double time_lo, time_hi;    /* NaN without a bootstrap */
+    double size_lo, size_hi;
+} ANALYZE_ROW_t;
+
+static void analyze_usage(const char *prog)
+{
+    printf("Usage: %s [options] NAME=FILE NAME=FILE...\n"
+           "Compares the results of the App's --bench-pages (or --bench-out) of\n"
+           "enclave variants, each FILE named NAME, CSV or JSON.\n"
+           "  --baseline NAME     variant the others are compared with (default the first)\n"
+           "  --bootstrap N       bootstrap replicates, 0 for none (default %d)\n"
+           "  --confidence P      confidence of the intervals in percent (default %g)\n"
+           "  --csv FILE          also write the comparison to FILE as CSV\n"
+           "  --jobs N            bootstrap on N threads (default the CPUs)\n"
+           "  --seed N            seed of the bootstrap (default %d)\n"
+           "  -h, --help          show this text\n", prog, ANALYZE_REPLICATES,
+           ANALYZE_CONFIDENCE, ANALYZE_SEED);
+}
+
+/* Parses a decimal count in [min, max] */
+static int analyze_parse_count(const char *name, const char *arg, unsigned long long min,
+                               unsigned long long max, unsigned long long *value)
+{
+    char *end;
+    unsigned long long n = strtoull(arg, &end, 10);
+
+    if (*arg == '\0' || *arg == '-' || *end != '\0' || n < min || n > max) {
+        printf("Bad %s: %s\n", name, arg);
+        return -1;
+    }
+    *value = n;
+    return 0;
+}
+
+/* Parses a decimal number in [min, max] */
+static int analyze_parse_real(const char *name, const char *arg, double min, double max,
+                              double *value)
+{
+    char *end;
+    double x = strtod(arg, &end);
+
+    if (*arg == '\0' || *end != '\0' || !(x >= min && x <= max)) {
+        printf("Bad %s: %s\n", name, arg);
+        return -1;
+    }
+    *value = x;
+    return 0;
+}
+
+static int analyze_parse_options(int argc, char *argv[], ANALYZE_OPTIONS_t *opts)
+{
+    enum {
+        OPT_BASELINE = 256, OPT_BOOTSTRAP, OPT_CONFIDENCE, OPT_CSV, OPT_JOBS, OPT_SEED
+    };
+    static const struct option longopts[] = {
+        {"baseline",   required_argument, NULL, OPT_BASELINE},
+        {"bootstrap",  required_argument, NULL, OPT_BOOTSTRAP},
+        {"confidence", required_argument, NULL, OPT_CONFIDENCE},
+        {"csv",        required_argument, NULL, OPT_CSV},
+        {"jobs",       required_argument, NULL, OPT_JOBS},
+        {"seed",       required_argument, NULL, OPT_SEED},
+        {"help",       no_argument,       NULL, 'h'},
+        {NULL, 0, NULL, 0}
+    };
+    unsigned long long n;
+    int c, ret = 0;
+
+    opts->baseline = NULL;
+    opts->csv = NULL;
+    opts->replicates = ANALYZE_REPLICATES;
+    opts->confidence = ANALYZE_CONFIDENCE;
+    opts->seed = ANALYZE_SEED;
+    opts->jobs = std::thread::hardware_concurrency();
+    if (opts->jobs == 0)
+        opts->jobs = 1;
+    if (opts->jobs > ANALYZE_JOBS_MAX)
+        opts->jobs = ANALYZE_JOBS_MAX;
+
+    while (ret == 0 && (c = getopt_long(argc, argv, "h", longopts, NULL)) != -1) {
+        switch (c) {
+        case OPT_BASELINE:
+            opts->baseline = optarg;
+            break;
+        case OPT_BOOTSTRAP:
+            ret = analyze_parse_count("bootstrap replicates", optarg, 0, 1000000, &n);
+            opts->replicates = (unsigned) n;
+            break;
+        case OPT_CONFIDENCE:
+            ret = analyze_parse_real("confidence", optarg, 1, 99.9, &opts->confidence);
+            break;
+        case OPT_CSV:
+            opts->csv = optarg;
+            break;
+        case OPT_JOBS:
+            ret = analyze_parse_count("number of jobs", optarg, 1, ANALYZE_JOBS_MAX, &n);
+            opts->jobs = (unsigned) n;
+            break;
+        case OPT_SEED:
+            ret = analyze_parse_count("seed", optarg, 0, UINT64_MAX, &n);
+            opts->seed = n;
+            break;
+        case 'h':
+            analyze_usage(argv[0]);
+            exit(0);
+        default:
+            analyze_usage(argv[0]);
+            ret = -1;
+            break;
+        }
+    }
+    for (int i = optind; ret == 0 && i < argc; i++) {
+        const char *eq = strchr(argv[i], '=');
+        ANALYZE_INPUT_t in;
+
+        if (eq == NULL || eq == argv[i] || eq[1] == '\0') {
+            printf("Expected NAME=FILE: %s\n", argv[i]);
+            ret = -1;
+            break;
+        }
+        in.name.assign(argv[i], (size_t) (eq - argv[i]));
+        in.path = eq + 1;
+        for (size_t v = 0; v < opts->inputs.size(); v++)
+            if (opts->inputs[v].name == in.name) {
+                printf("Variant %s given twice\n", in.name.c_str());
+                ret = -1;
+            }
+        opts->inputs.push_back(in);
+    }
+    if (ret == 0 && (opts->inputs.size() < 2 || opts->inputs.size() > ANALYZE_VARIANTS_MAX)) {
+        printf("Expected 2 to %d NAME=FILE arguments\n", ANALYZE_VARIANTS_MAX);
+        ret = -1;
+    }
+    if (ret == 0 && opts->baseline) {
+        size_t v = 0;
+
+        while (v < opts->inputs.size() && opts->inputs[v].name != opts->baseline)
+            v++;
+        if (v == opts->inputs.size()) {
+            printf("No variant %s to be the baseline\n", opts->baseline);
+            ret = -1;
+        }
+    }
+    return ret;
+}
+
+/*
+ * Parses the digits[.digits] the App writes; the quotient of two exact
+ * doubles is rounded as strtod rounds. Returns -1 for anything else.
+ */
+static int analyze_decimal(const char *p, double *value)
+{
+    static const double scale[] = {1, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10,
+                                   1e11, 1e12, 1e13, 1e14, 1e15};
+    uint64_t n = 0;
+    int digits = 0, frac = 0;
+
+    for (; *p >= '0' && *p <= '9'; p++, digits++)
+        n = n * 10 + (uint64_t) (*p - '0');
+    if (*p == '.')
+        for (p++; *p >= '0' && *p <= '9'; p++, digits++, frac++)
+            n = n * 10 + (uint64_t) (*p - '0');
+    if (*p != '\0' || digits == 0 || digits > 15)
+        return -1;
+    *value = (double) n / scale[frac];
+    return 0;
+}
+
+static int analyze_number(const ANALYZE_DATA_t *data, const RESULTS_RECORD_t *rec, int col,
+                          double *value)
+{
+    const std::string& text = rec->values[(size_t) col];
+    char *end;
+
+    if (analyze_decimal(text.c_str(), value) == 0)
+        return 0;
+    *value = strtod(text.c_str(), &end);
+    if (text.empty() || *end != '\0' || !std::isfinite(*value) || *value < 0) {
+        printf("%s:%zu: bad %s: \"%s\"\n", data->path, rec->line,
+               rec->columns[(size_t) col].c_str(), text.c_str());
+        return -1;
+    }
+    return 0;
+}
+
+/* Looks up the columns of the file's kind; a missing one is an error */
+static int analyze_columns(ANALYZE_DATA_t *data, const RESULTS_RECORD_t *rec)
+{
+    static const char *page_columns[] = {
+        "nf", "page", "bucket", "out_bytes", "median_us", NULL
+    };
+    static const char *summary_columns[] = {
+        "nf", "bucket", "pages", "out_bytes", "mean_us", NULL
+    };
+    const char **names;
+
+    if (data->file_kind == ANALYZE_UNKNOWN) {
+        data->file_kind = results_column(rec, "page") >= 0 ? ANALYZE_PAGES : ANALYZE_SUMMARY;
+        if (data->kind == ANALYZE_UNKNOWN) {
+            data->kind = data->file_kind;
+        } else if (data->kind != data->file_kind) {
+            printf("%s: %s results, the files before hold %s results\n", data->path,
+                   data->file_kind == ANALYZE_PAGES ? "per-page" : "summary",
+                   data->kind == ANALYZE_PAGES ? "per-page" : "summary");
+            return -1;
+        }
+    }
+    names = data->kind == ANALYZE_PAGES ? page_columns : summary_columns;
+    for (size_t i = 0; names[i]; i++)
+        if ((data->col[i] = results_column(rec, names[i])) < 0) {
+            printf("%s:%zu: no column %s\n", data->path, rec->line, names[i]);
+            return -1;
+        }
+    data->ncolumns = rec->columns.size();
+    return 0;
+}
+
+static int analyze_bucket(ANALYZE_DATA_t *data, const std::string& name, size_t *bucket)
+{
+    for (size_t b = 0; b < data->buckets.size(); b++)
+        if (data->buckets[b] == name) {
+            *bucket = b;
+            return 0;
+        }
+    if (data->buckets.size() == ANALYZE_BUCKETS_MAX) {
+        printf("%s: more than %d buckets\n", data->path, ANALYZE_BUCKETS_MAX);
+        return -1;
+    }
+    data->buckets.push_back(name);
+    *bucket = data->buckets.size() - 1;
+    return 0;
+}
+
+static size_t analyze_nf(ANALYZE_DATA_t *data, const std::string& name)
+{
+    if (data->last_nf < data->nfs.size() && data->nfs[data->last_nf].name == name)
+        return data->last_nf;
+    for (data->last_nf = 0; data->last_nf < data->nfs.size(); data->last_nf++)
+        if (data->nfs[data->last_nf].name == name)
+            return data->last_nf;
+    data->nfs.push_back(ANALYZE_NF_t());
+    data->nfs.back().name = name;
+    data->nfs.back().next = 0;
+    data->nfs.back().first = data->variant;
+    data->nfs.back().time.resize(data->nvariants);
+    data->nfs.back().size.resize(data->nvariants);
+    return data->last_nf;
+}
+
+/*
+ * Sets *i to the position of page in nf, or past the end if it is new.
+ * The pages of the first file of nf are appended unchecked; one it lists
+ * twice is found when the index is built, and otherwise pairs with the
+ * same two rows of every file.
+ */
+static int analyze_find(const ANALYZE_DATA_t *data, ANALYZE_NF_t *nf, const std::string& page,
+                        size_t *i)
+{
+    if (nf->index.empty()) {
+        if (nf->first == data->variant) {
+            *i = nf->pages.size();
+            return 0;
+        }
+        nf->index.reserve(nf->pages.size());
+        for (size_t j = 0; j < nf->pages.size(); j++)
+            if (!nf->index.emplace(nf->pages[j], j).second) {
+                printf("%s: page %s of %s given twice\n", (*data->inputs)[nf->first].path,
+                       nf->pages[j].c_str(), nf->name.c_str());
+                return -1;
+            }
+    }
+    auto it = nf->index.find(page);
+    *i = it == nf->index.end() ? nf->pages.size() : it->second;
+    return 0;
+}
+
+static int analyze_page(ANALYZE_DATA_t *data, const RESULTS_RECORD_t *rec)
+{
+    const std::string& page = rec->values[(size_t) data->col[1]];
+    ANALYZE_NF_t *nf = &data->nfs[analyze_nf(data, rec->values[(size_t) data->col[0]])];
+    size_t bucket, i;
+    double out_bytes, median_us;
+
+    if (analyze_number(data, rec, data->col[3], &out_bytes) != 0 ||
+        analyze_number(data, rec, data->col[4], &median_us) != 0)
+        return -1;
+
+    if (nf->next < nf->pages.size() && nf->pages[nf->next] == page)
+        i = nf->next;
+    else if (analyze_find(data, nf, page, &i) != 0)
+        return -1;
+    if (i == nf->pages.size()) {
+        if (analyze_bucket(data, rec->values[(size_t) data->col[2]], &bucket) != 0)
+            return -1;
+        if (!nf->index.empty())
+            nf->index.emplace(page, i);
+        nf->pages.push_back(page);
+        nf->bucket.push_back((uint8_t) bucket);
+        nf->seen.push_back(0);
+        for (size_t v = 0; v < data->nvariants; v++) {
+            nf->time[v].push_back(0);
+            nf->size[v].push_back(0);
+        }
+    }
+    nf->next = i + 1;
+    if (nf->seen[i] & (1u << data->variant)) {
+        printf("%s:%zu: page %s of %s given twice\n", data->path, rec->line, page.c_str(),
+               nf->name.c_str());
+        return -1;
+    }
+    nf->seen[i] |= 1u << data->variant;
+    nf->time[data->variant][i] = median_us;
+    nf->size[data->variant][i] = out_bytes;
+    return 0;
+}
+
+static int analyze_summary_row(ANALYZE_DATA_t *data, const RESULTS_RECORD_t *rec)
+{
+    ANALYZE_SUMMARY_t row;
+
+    row.nf = analyze_nf(data, rec->values[(size_t) data->col[0]]);
+    row.variant = data->variant;
+    if (analyze_bucket(data, rec->values[(size_t) data->col[1]], &row.bucket) != 0 ||
+        analyze_number(data, rec, data->col[2], &row.pages) != 0 ||
+        analyze_number(data, rec, data->col[3], &row.out_bytes) != 0 ||
+        analyze_number(data, rec, data->col[4], &row.mean_us) != 0)
+        return -1;
+    data->summary.push_back(row);
+    return 0;
+}
+
+static int analyze_record(const RESULTS_RECORD_t *rec, void *user)
+{
+    ANALYZE_DATA_t *data = (ANALYZE_DATA_t *) user;
+
+    if (data->ncolumns != rec->columns.size() && analyze_columns(data, rec) != 0)
+        return -1;
+    return data->kind == ANALYZE_PAGES ? analyze_page(data, rec)
+                                       : analyze_summary_row(data, rec);
+}
+
+static double analyze_ratio(double x, double base)
+{
+    return base > 0 ? x / base : NAN;
+}
+
+/* Drops the pages some variant lacks; returns how many */
+static size_t analyze_pair(ANALYZE_NF_t *nf, size_t nvariants)
+{
+    uint32_t all = nvariants == 32 ? UINT32_MAX : (1u << nvariants) - 1;
+    size_t kept = 0, n = nf->seen.size();
+
+    for (size_t i = 0; i < n; i++) {
+        if (nf->seen[i] != all)
+            continue;
+        nf->bucket[kept] = nf->bucket[i];
+        for (size_t v = 0; v < nvariants; v++) {
+            nf->time[v][kept] = nf->time[v][i];
+            nf->size[v][kept] = nf->size[v][i];
+        }
+        kept++;
+    }
+    nf->bucket.resize(kept);
+    for (size_t v = 0; v < nvariants; v++) {
+        nf->time[v].resize(kept);
+        nf->size[v].resize(kept);
+    }
+    nf->seen.clear();
+    nf->index.clear();
+    nf->pages.clear();
+    return n - kept;
+}
+
+/* Rows of one NF of per-page files, the buckets then all pages */
+static void analyze_pages_nf(const ANALYZE_OPTIONS_t *opts, const ANALYZE_DATA_t *data,
+                             const ANALYZE_NF_t *nf, size_t base, std::vector<ANALYZE_ROW_t>& rows)
+{
+    size_t nv = data->nvariants, ns = 2 * nv, ng = data->buckets.size();
+    std::vector<const double *> series(ns);
+    std::vector<double> sums, boot, ratios;
+    std::vector<size_t> pages(ng + 1, 0);
+    STATS_SAMPLE_t sample;
+    double alpha = (1 - opts->confidence / 100) / 2;
+
+    for (size_t v = 0; v < nv; v++) {
+        series[2 * v] = nf->time[v].data();
+        series[2 * v + 1] = nf->size[v].data();
+    }
+    sample.series = series.data();
+    sample.nseries = ns;
+    sample.group = nf->bucket.data();
+    sample.ngroups = (unsigned) ng;
+    sample.n = nf->bucket.size();
+    for (size_t i = 0; i < sample.n; i++)
+        pages[nf->bucket[i]]++;
+    pages[ng] = sample.n;
+
+    stats_sums(&sample, sums);
+    if (opts->replicates)
+        stats_bootstrap(&sample, opts->replicates, opts->seed, opts->jobs, boot);
+
+    for (size_t g = 0; g <= ng; g++) {
+        if (pages[g] == 0)
+            continue;
+        for (size_t v = 0; v < nv; v++) {
+            const double *s = &sums[g * ns];
+            ANALYZE_ROW_t row;
+
+            if (v == base)
+                continue;
+            row.nf = nf->name.c_str();
+            row.bucket = g < ng ? data->buckets[g].c_str() : "all";
+            row.variant = opts->inputs[v].name.c_str();
+            row.pages = (double) pages[g];
+            row.base_time = s[2 * base] / row.pages;
+            row.time = s[2 * v] / row.pages;
+            row.base_size = s[2 * base + 1];
+            row.size = s[2 * v + 1];
+            row.time_lo = row.time_hi = row.size_lo = row.size_hi = NAN;
+
+            for (size_t k = 0; opts->replicates && k < 2; k++) {
+                ratios.resize(opts->replicates);
+                for (unsigned r = 0; r < opts->replicates; r++) {
+                    const double *b = &boot[(r * (ng + 1) + g) * ns];
+                    ratios[r] = analyze_ratio(b[2 * v + k], b[2 * base + k]);
+                }
+                (k ? row.size_lo : row.time_lo) = stats_quantile(ratios, alpha);
+                (k ? row.size_hi : row.time_hi) = stats_quantile(ratios, 1 - alpha);
+            }
+            rows.push_back(row);
+        }
+    }
+}
+
+/* Rows of summary files, in the order of the baseline's rows */
+static void analyze_summaries(const ANALYZE_OPTIONS_t *opts, const ANALYZE_DATA_t *data,
+                              size_t base, std::vector<ANALYZE_ROW_t>& rows, size_t *pages,
+                              size_t *unpaired)
+{
+    for (size_t i = 0; i < data->summary.size(); i++) {
+        const ANALYZE_SUMMARY_t *b = &data->summary[i];
+
+        if (b->variant != base)
+            continue;
+        if (data->buckets[b->bucket] == "all")
+            *pages += (size_t) b->pages;
+        for (size_t v = 0; v < data->nvariants; v++) {
+            const ANALYZE_SUMMARY_t *s = NULL;
+            ANALYZE_ROW_t row;
+
+            if (v == base)
+                continue;
+            for (size_t j = 0; j < data->summary.size() && !s; j++)
+                if (data->summary[j].variant == v && data->summary[j].nf == b->nf &&
+                    data->summary[j].bucket == b->bucket)
+                    s = &data->summary[j];
+            if (!s) {
+                (*unpaired)++;
+                continue;
+            }
+            row.nf = data->nfs[b->nf].name.c_str();
+            row.bucket = data->buckets[b->bucket].c_str();
+            row.variant = opts->inputs[v].name.c_str();
+            row.pages = b->pages;
+            row.base_time = b->mean_us;
+            row.time = s->mean_us;
+            row.base_size = b->out_bytes;
+            row.size = s->out_bytes;
+            row.time_lo = row.time_hi = row.size_lo = row.size_hi = NAN;
+            rows.push_back(row);
+        }
+    }
+}
+
+static void analyze_interval(char *buf, size_t len, double lo, double hi)
+{
+    if (std::isnan(lo) || std::isnan(hi))
+        snprintf(buf, len, "-");
+    else
+        snprintf(buf, len, "[%.3f, %.3f]", lo, hi);
+}
+
+static void analyze_print(const ANALYZE_OPTIONS_t *opts, const std::vector<ANALYZE_ROW_t>& rows)
+{
+    char ci[32], time_ci[40], size_ci[40];
+
+    snprintf(ci, sizeof(ci), "%g%% CI", opts->confidence);
+    printf("\n%-12s %-10s %-12s %9s %12s %12s %8s %-18s %8s %s\n", "NF", "Bucket",
+           "Variant", "Pages", "BaseUs", "Us", "Time", ci, "Size", ci);
+    for (size_t i = 0; i < rows.size(); i++) {
+        const ANALYZE_ROW_t *r = &rows[i];
+
+        analyze_interval(time_ci, sizeof(time_ci), r->time_lo, r->time_hi);
+        analyze_interval(size_ci, sizeof(size_ci), r->size_lo, r->size_hi);
+        printf("%-12s %-10s %-12s %9.0f %12.3f %12.3f %8.3f %-18s %8.3f %s\n", r->nf,
+               r->bucket, r->variant, r->pages, r->base_time, r->time,
+               analyze_ratio(r->time, r->base_time), time_ci,
+               analyze_ratio(r->size, r->base_size), size_ci);
+    }
+}
+
+/* Writes a CSV field, quoted when it holds a separator */
+static void analyze_csv_name(FILE *fp, const char *name)
+{
+    if (strpbrk(name, ",\"\r\n") == NULL) {
+        fputs(name, fp);
+        return;
+    }
+    fputc('"', fp);
+    for (; *name; name++) {
+        if (*name == '"')
+            fputc('"', fp);
+        fputc(*name, fp);
+    }
+    fputc('"', fp);
+}
+
+/* Writes x, or nothing when it is NaN */
+static void analyze_csv_real(FILE *fp, const char *format, double x)
+{
+    fputc(',', fp);
+    if (!std::isnan(x))
+        fprintf(fp, format, x);
+}
+
+static int analyze_write_csv(const ANALYZE_OPTIONS_t *opts, const char *baseline,
+                             const std::vector<ANALYZE_ROW_t>& rows)
+{
+    FILE *fp = fopen(opts->csv, "w");
+
+    if (fp == NULL) {
+        printf("\nCan not open or create file %s.\n", opts->csv);
+        return -1;
+    }
+    fprintf(fp, "nf,bucket,variant,baseline,pages,base_time_us,time_us,time_ratio,time_lo,"
+            "time_hi,base_out_bytes,out_bytes,size_ratio,size_lo,size_hi\n");
+    for (size_t i = 0; i < rows.size(); i++) {
+        const ANALYZE_ROW_t *r = &rows[i];
+
+        analyze_csv_name(fp, r->nf);
+        fputc(',', fp);
+        analyze_csv_name(fp, r->bucket);
+        fputc(',', fp);
+        analyze_csv_name(fp, r->variant);
+        fputc(',', fp);
+        analyze_csv_name(fp, baseline);
+        fprintf(fp, ",%.0f,%.3f,%.3f", r->pages, r->base_time, r->time);
+        analyze_csv_real(fp, "%.4f", analyze_ratio(r->time, r->base_time));
+        analyze_csv_real(fp, "%.4f", r->time_lo);
+        analyze_csv_real(fp, "%.4f", r->time_hi);
+        fprintf(fp, ",%.0f,%.0f", r->base_size, r->size);
+        analyze_csv_real(fp, "%.4f", analyze_ratio(r->size, r->base_size));
+        analyze_csv_real(fp, "%.4f", r->size_lo);
+        analyze_csv_real(fp, "%.4f", r->size_hi);
+        fputc('\n', fp);
+    }
+    if (fclose(fp) != 0) {
+        printf("\nCan not write file %s.\n", opts->csv);
+        return -1;
+    }
+    return 0;
+}
+
+static double analyze_time(void)
+{
+    return std::chrono::duration<double>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+int main(int argc, char *argv[])
+{
+    ANALYZE_OPTIONS_t opts;
+    ANALYZE_DATA_t data;
+    std::vector<ANALYZE_ROW_t> rows;
+    size_t base = 0, pages = 0, unpaired = 0;
+    double tic;
+
+    if (analyze_parse_options(argc, argv, &opts) != 0)
+        return 1;
+    while (opts.baseline && opts.inputs[base].name != opts.baseline)
+        base++;
+
+    tic = analyze_time();
+    data.kind = ANALYZE_UNKNOWN;
+    data.inputs = &opts.inputs;
+    data.nvariants = opts.inputs.size();
+    data.buckets.assign(analyze_buckets, analyze_buckets + ANALYZE_BUCKETS);
+    data.last_nf = 0;
+    for (size_t v = 0; v < opts.inputs.size(); v++) {
+        data.variant = v;
+        data.path = opts.inputs[v].path;
+        data.file_kind = ANALYZE_UNKNOWN;
+        data.ncolumns = 0;
+        for (size_t f = 0; f < data.nfs.size(); f++)
+            data.nfs[f].next = 0;
+        if (results_read(data.path, analyze_record, &data) != 0)
+            return 1;
+        if (data.file_kind == ANALYZE_UNKNOWN) {
+            printf("%s: no results\n", data.path);
+            return 1;
+        }
+    }
+
+    if (data.kind == ANALYZE_PAGES) {
+        for (size_t f = 0; f < data.nfs.size(); f++) {
+            size_t dropped = analyze_pair(&data.nfs[f], data.nvariants);
+
+            if (dropped)
+                printf("Warning: %zu pages of %s are not in every file, left out\n", dropped,
+                       data.nfs[f].name.c_str());
+            unpaired += dropped;
+            pages += data.nfs[f].bucket.size();
+            analyze_pages_nf(&opts, &data, &data.nfs[f], base, rows);
+        }
+    } else {
+        analyze_summaries(&opts, &data, base, rows, &pages, &unpaired);
+        if (unpaired)
+            printf("Warning: %zu rows of the baseline are not in every file, left out\n",
+                   unpaired);
+    }
+
+    printf("Analyze:Results:%s:Baseline:%s:Variants:%zu:Pages:%zu:Unpaired:%zu:"
+           "Replicates:%u:Confidence:%g:Time:%f\n",
+           data.kind == ANALYZE_PAGES ? "pages" : "summary", opts.inputs[base].name.c_str(),
+           data.nvariants, pages, unpaired, data.kind == ANALYZE_PAGES ? opts.replicates : 0,
+           opts.confidence, analyze_time() - tic);
+    analyze_print(&opts, rows);
+    if (opts.csv && analyze_write_csv(&opts, opts.inputs[base].name.c_str(), rows) != 0)
+        return 1;
+    return 0;
+}
@@ -0,0 +1,425 @@
+/*
+ * results.cpp: Reads the result files of the App's NF benchmark. See
+ * results.h.
+ */
+
+#include <ctype.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "results.h"
+
+/* Nesting past which a JSON file is not one of the App's */
+#define RESULTS_JSON_DEPTH 32
+
+typedef struct {
+    const char *path;
+    const char *p;
+    const char *end;
+    size_t line;
+    RESULTS_RECORD_t rec;
+    results_fn_t fn;
+    void *user;
+} RESULTS_READER_t;
+
+static int results_error(const RESULTS_READER_t *r, const char *what)
+{
+    printf("%s:%zu: %s\n", r->path, r->line, what);
+    return -1;
+}
+
+static int results_load(const char *path, std::string& text)
+{
+    char buf[1 << 16];
+    size_t n;
+    FILE *fp = fopen(path, "rb");
+
+    if (fp == nullptr) {
+        printf("\nFile %s not exist.\n", path);
+        return -1;
+    }
+    while ((n = fread(buf, 1, sizeof(buf), fp)) > 0)
+        text.append(buf, n);
+    if (ferror(fp)) {
+        printf("\nCan not read file %s.\n", path);
+        fclose(fp);
+        return -1;
+    }
+    fclose(fp);
+    return 0;
+}
+
+/* Column of name, added if new; hint is where it was in the last record */
+static size_t results_intern(RESULTS_RECORD_t *rec, const std::string& name, size_t hint)
+{
+    if (hint < rec->columns.size() && rec->columns[hint] == name)
+        return hint;
+    for (size_t i = 0; i < rec->columns.size(); i++)
+        if (rec->columns[i] == name)
+            return i;
+    rec->columns.push_back(name);
+    rec->values.resize(rec->columns.size());
+    return rec->columns.size() - 1;
+}
+
+int results_column(const RESULTS_RECORD_t *rec, const char *name)
+{
+    for (size_t i = 0; i < rec->columns.size(); i++)
+        if (rec->columns[i] == name)
+            return (int) i;
+    return -1;
+}
+
+/* CSV */
+
+/* Reads one field into out; returns the byte after it, or NULL on a bad quote */
+static const char *results_csv_field(RESULTS_READER_t *r, const char *p, std::string& out)
+{
+    out.clear();
+    if (p < r->end && *p == '"') {
+        for (p++; ; p++) {
+            if (p == r->end)
+                return NULL;
+            if (*p == '"') {
+                if (p + 1 < r->end && p[1] == '"') {
+                    out += '"';
+                    p++;
+                    continue;
+                }
+                p++;
+                break;
+            }
+            if (*p == '\n')
+                r->line++;
+            out += *p;
+        }
+        if (p < r->end && *p != ',' && *p != '\n' && *p != '\r')
+            return NULL;
+        return p;
+    }
+
+    const char *start = p;
+    while (p < r->end && *p != ',' && *p != '\n' && *p != '\r')
+        p++;
+    out.assign(start, (size_t) (p - start));
+    return p;
+}
+
+/* Reads the fields of one row into fields; returns how many, or -1 */
+static long results_csv_row(RESULTS_READER_t *r, std::vector<std::string>& fields)
+{
+    size_t n = 0;
+    const char *p = r->p;
+
+    for (;;) {
+        if (n == fields.size())
+            fields.emplace_back();
+        p = results_csv_field(r, p, fields[n++]);
+        if (p == NULL)
+            return results_error(r, "unterminated or misplaced quote");
+        if (p < r->end && *p == ',') {
+            p++;
+            continue;
+        }
+        break;
+    }
+    if (p < r->end && *p == '\r')
+        p++;
+    if (p < r->end && *p == '\n')
+        p++;
+    r->p = p;
+    return (long) n;
+}
+
+static int results_csv(RESULTS_READER_t *r)
+{
+    RESULTS_RECORD_t *rec = &r->rec;
+    long n;
+    int ret;
+
+    /* Blank lines are skipped, before the header and between rows */
+    for (;;) {
+        while (r->p < r->end && (*r->p == '\n' || *r->p == '\r')) {
+            if (*r->p == '\n')
+                r->line++;
+            r->p++;
+        }
+        if (r->p == r->end)
+            return 0;
+        rec->line = r->line;
+        if (rec->columns.empty()) {
+            if ((n = results_csv_row(r, rec->columns)) < 0)
+                return -1;
+            rec->columns.resize((size_t) n);
+            rec->values.resize((size_t) n);
+        } else {
+            if ((n = results_csv_row(r, rec->values)) < 0)
+                return -1;
+            if ((size_t) n != rec->columns.size()) {
+                char what[96];
+                snprintf(what, sizeof(what), "%ld fields, the header has %zu", n,
+                         rec->columns.size());
+                return results_error(r, what);
+            }
+            if ((ret = r->fn(rec, r->user)) != 0)
+                return ret;
+        }
+        r->line++;
+    }
+}
+
+/* JSON */
+
+static void results_json_blank(RESULTS_READER_t *r)
+{
+    while (r->p < r->end && (*r->p == ' ' || *r->p == '\t' || *r->p == '\n' || *r->p == '\r')) {
+        if (*r->p == '\n')
+            r->line++;
+        r->p++;
+    }
+}
+
+static void results_utf8(std::string& out, unsigned long c)
+{
+    if (c < 0x80) {
+        out += (char) c;
+    } else if (c < 0x800) {
+        out += (char) (0xc0 | (c >> 6));
+        out += (char) (0x80 | (c & 0x3f));
+    } else if (c < 0x10000) {
+        out += (char) (0xe0 | (c >> 12));
+        out += (char) (0x80 | ((c >> 6) & 0x3f));
+        out += (char) (0x80 | (c & 0x3f));
+    } else {
+        out += (char) (0xf0 | (c >> 18));
+        out += (char) (0x80 | ((c >> 12) & 0x3f));
+        out += (char) (0x80 | ((c >> 6) & 0x3f));
+        out += (char) (0x80 | (c & 0x3f));
+    }
+}
+
+static int results_json_hex4(RESULTS_READER_t *r, unsigned long *c)
+{
+    *c = 0;
+    if (r->end - r->p < 4)
+        return -1;
+    for (int i = 0; i < 4; i++) {
+        char h = *r->p++;
+
+        *c <<= 4;
+        if (h >= '0' && h <= '9')
+            *c |= (unsigned long) (h - '0');
+        else if (h >= 'a' && h <= 'f')
+            *c |= (unsigned long) (h - 'a' + 10);
+        else if (h >= 'A' && h <= 'F')
+            *c |= (unsigned long) (h - 'A' + 10);
+        else
+            return -1;
+    }
+    return 0;
+}
+
+/* Reads a string, the opening quote included, into out */
+static int results_json_string(RESULTS_READER_t *r, std::string& out)
+{
+    out.clear();
+    r->p++;
+    for (;;) {
+        const char *start = r->p;
+        unsigned long c, lo;
+
+        while (r->p < r->end && *r->p != '"' && *r->p != '\\' && *r->p != '\n')
+            r->p++;
+        out.append(start, (size_t) (r->p - start));
+        if (r->p == r->end || *r->p == '\n')
+            return results_error(r, "unterminated string");
+        if (*r->p++ == '"')
+            return 0;
+        if (r->p == r->end)
+            return results_error(r, "unterminated string");
+        switch (*r->p++) {
+        case '"': out += '"'; break;
+        case '\\': out += '\\'; break;
+        case '/': out += '/'; break;
+        case 'b': out += '\b'; break;
+        case 'f': out += '\f'; break;
+        case 'n': out += '\n'; break;
+        case 'r': out += '\r'; break;
+        case 't': out += '\t'; break;
+        case 'u':
+            if (results_json_hex4(r, &c) != 0)
+                return results_error(r, "bad \\u escape");
+            /* A surrogate pair spells one code point */
+            if (c >= 0xd800 && c < 0xdc00 && r->end - r->p >= 6 && r->p[0] == '\\' &&
+                r->p[1] == 'u') {
+                r->p += 2;
+                if (results_json_hex4(r, &lo) != 0 || lo < 0xdc00 || lo > 0xdfff)
+                    return results_error(r, "bad surrogate pair");
+                c = 0x10000 + ((c - 0xd800) << 10) + (lo - 0xdc00);
+            }
+            results_utf8(out, c);
+            break;
+        default:
+            return results_error(r, "bad escape");
+        }
+    }
+}
+
+/* Reads a number or a literal as written; null reads as empty */
+static int results_json_scalar(RESULTS_READER_t *r, std::string& out)
+{
+    const char *start = r->p;
+
+    while (r->p < r->end && (isalnum((unsigned char) *r->p) || *r->p == '-' || *r->p == '+' ||
+                             *r->p == '.'))
+        r->p++;
+    if (r->p == start)
+        return results_error(r, "expected a value");
+    out.assign(start, (size_t) (r->p - start));
+    if (out == "null")
+        out.clear();
+    return 0;
+}
+
+static int results_json_value(RESULTS_READER_t *r, int depth, int *scalar);
+
+/* An object of scalars only is a record: its members are set as they come */
+static int results_json_object(RESULTS_READER_t *r, int depth)
+{
+    RESULTS_RECORD_t *rec = &r->rec;
+    std::string key;
+    size_t member = 0, line = r->line;
+    int record = 1, scalar, ret;
+
+    r->p++;
+    for (size_t i = 0; i < rec->values.size(); i++)
+        rec->values[i].clear();
+    results_json_blank(r);
+    if (r->p < r->end && *r->p == '}') {
+        r->p++;
+        return 0;
+    }
+    for (;;) {
+        results_json_blank(r);
+        if (r->p == r->end || *r->p != '"')
+            return results_error(r, "expected a member name");
+        if (results_json_string(r, key) != 0)
+            return -1;
+        results_json_blank(r);
+        if (r->p == r->end || *r->p != ':')
+            return results_error(r, "expected ':'");
+        r->p++;
+        results_json_blank(r);
+
+        /* The value goes to the record; a nested container clobbers it */
+        if (r->p < r->end && (*r->p == '{' || *r->p == '[')) {
+            record = 0;
+            if ((ret = results_json_value(r, depth + 1, &scalar)) != 0)
+                return ret;
+        } else {
+            size_t col = results_intern(rec, key, member);
+
+            if (r->p < r->end && *r->p == '"')
+                ret = results_json_string(r, rec->values[col]);
+            else
+                ret = results_json_scalar(r, rec->values[col]);
+            if (ret != 0)
+                return ret;
+        }
+        member++;
+
+        results_json_blank(r);
+        if (r->p < r->end && *r->p == ',') {
+            r->p++;
+            continue;
+        }
+        if (r->p < r->end && *r->p == '}') {
+            r->p++;
+            break;
+        }
+        return results_error(r, "expected ',' or '}'");
+    }
+    if (!record)
+        return 0;
+    rec->line = line;
+    return r->fn(rec, r->user);
+}
+
+static int results_json_value(RESULTS_READER_t *r, int depth, int *scalar)
+{
+    std::string text;
+    int ret;
+
+    if (depth > RESULTS_JSON_DEPTH)
+        return results_error(r, "nested too deep");
+    results_json_blank(r);
+    *scalar = 0;
+    if (r->p == r->end)
+        return results_error(r, "expected a value");
+    if (*r->p == '{')
+        return results_json_object(r, depth);
+    if (*r->p == '[') {
+        r->p++;
+        results_json_blank(r);
+        if (r->p < r->end && *r->p == ']') {
+            r->p++;
+            return 0;
+        }
+        for (;;) {
+            int s;
+
+            if ((ret = results_json_value(r, depth + 1, &s)) != 0)
+                return ret;
+            results_json_blank(r);
+            if (r->p < r->end && *r->p == ',') {
+                r->p++;
+                continue;
+            }
+            if (r->p < r->end && *r->p == ']') {
+                r->p++;
+                return 0;
+            }
+            return results_error(r, "expected ',' or ']'");
+        }
+    }
+    *scalar = 1;
+    return *r->p == '"' ? results_json_string(r, text) : results_json_scalar(r, text);
+}
+
+static int results_json(RESULTS_READER_t *r)
+{
+    int scalar, ret;
+
+    if ((ret = results_json_value(r, 0, &scalar)) != 0)
+        return ret;
+    results_json_blank(r);
+    if (r->p != r->end)
+        return results_error(r, "trailing bytes after the document");
+    return 0;
+}
+
+int results_read(const char *path, results_fn_t fn, void *user)
+{
+    std::string text;
+    RESULTS_READER_t r;
+    const char *p;
+
+    if (results_load(path, text) != 0)
+        return -1;
+    r.path = path;
+    r.p = text.data();
+    r.end = text.data() + text.size();
+    r.line = 1;
+    r.rec.line = 1;
+    r.fn = fn;
+    r.user = user;
+
+    /* A UTF-8 byte order mark is not part of the first column name */
+    if (text.size() >= 3 && memcmp(r.p, "\xef\xbb\xbf", 3) == 0)
+        r.p += 3;
+    for (p = r.p; p < r.end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r'); p++)
+        ;
+    if (p < r.end && (*p == '{' || *p == '['))
+        return results_json(&r);
+    return results_csv(&r);
+}
@@ -0,0 +1,37 @@
+/*
+ * results.h: Reads the result files of the App's NF benchmark.
+ *
+ * Both layouts of --bench-format are read. A CSV file is a header row of
+ * column names and a row per record, with RFC 4180 quoting. In a JSON
+ * file, every object whose members are all scalars is a record: the
+ * entries of "results" (--bench-out) or "pages" (--bench-pages). The
+ * values are handed over as text, as written, so a column is read the
+ * same from either layout.
+ */
+
+#ifndef _RESULTS_H_
+#define _RESULTS_H_
+
+#include <string>
+#include <vector>
+
+typedef struct {
+    std::vector<std::string> columns;   /* Names, in order of appearance */
+    std::vector<std::string> values;    /* By column; empty when absent */
+    size_t line;                        /* Where the record starts, for errors */
+} RESULTS_RECORD_t;
+
+/* Called on each record; a nonzero return stops the reading */
+typedef int (*results_fn_t)(const RESULTS_RECORD_t *rec, void *user);
+
+/*
+ * Reads the records of path, a JSON file if its first non-blank byte is
+ * '{' or '[', a CSV file otherwise. Returns 0, the nonzero return of fn,
+ * or -1 after printing why the file could not be read.
+ */
+int results_read(const char *path, results_fn_t fn, void *user);
+
+/* Returns the index of column name in rec, or -1 */
+int results_column(const RESULTS_RECORD_t *rec, const char *name);
+
+#endif /* !_RESULTS_H_ */
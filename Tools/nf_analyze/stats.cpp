@@ -0,0 +1,216 @@
+/*
+ * stats.cpp: Grouped sums of paired series and their Poisson bootstrap.
+ * See stats.h.
+ *
+ * The bootstrap copies the series in group order first, so each group is
+ * a run of pages and a weighted sum is a plain dot product the compiler
+ * vectorizes. It walks the pages a chunk at a time; the chunk stays in
+ * cache while every replicate of a block weights it.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <thread>
+
+#include "stats.h"
+
+/* Replicates that weight a chunk while it is in cache */
+#define STATS_BLOCK 16
+
+/* Pages per chunk: the series of a chunk fit in L2 */
+#define STATS_CHUNK 2048
+
+/* Poisson(1) count of each 16-bit uniform; P(X > 8) is below 1e-5 */
+static uint8_t stats_poisson[1 << 16];
+
+/* The series in group order, each group a run [start[g], start[g + 1]) */
+typedef struct {
+    const STATS_SAMPLE_t *sample;
+    std::vector<std::vector<double>> series;
+    std::vector<size_t> start;
+    unsigned replicates;
+    uint64_t seed;
+} STATS_SORTED_t;
+
+static void stats_poisson_init(void)
+{
+    double p = std::exp(-1.0), cdf = p;
+    unsigned k = 0;
+
+    /* u falls on k while (u + 1/2) / 2^16 is below P(X <= k) */
+    for (uint32_t u = 0; u < (1u << 16); u++) {
+        while ((u + 0.5) / 65536.0 >= cdf && k < 255) {
+            k++;
+            p /= k;
+            cdf += p;
+        }
+        stats_poisson[u] = (uint8_t) k;
+    }
+}
+
+static uint64_t stats_splitmix64(uint64_t *state)
+{
+    uint64_t z = (*state += 0x9e3779b97f4a7c15ull);
+
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+}
+
+void stats_sums(const STATS_SAMPLE_t *sample, std::vector<double>& sums)
+{
+    size_t ns = sample->nseries;
+
+    sums.assign((sample->ngroups + 1) * ns, 0);
+    for (size_t i = 0; i < sample->n; i++) {
+        double *acc = &sums[sample->group[i] * ns];
+
+        for (size_t s = 0; s < ns; s++)
+            acc[s] += sample->series[s][i];
+    }
+    for (unsigned g = 0; g < sample->ngroups; g++)
+        for (size_t s = 0; s < ns; s++)
+            sums[sample->ngroups * ns + s] += sums[g * ns + s];
+}
+
+/* Four partial sums, so the loop vectorizes without reassociating FP */
+static double stats_dot(const double *w, const double *x, size_t n)
+{
+    double acc[4] = {0, 0, 0, 0};
+    size_t i;
+
+    for (i = 0; i + 4 <= n; i += 4)
+        for (size_t j = 0; j < 4; j++)
+            acc[j] += w[i + j] * x[i + j];
+    for (; i < n; i++)
+        acc[0] += w[i] * x[i];
+    return (acc[0] + acc[1]) + (acc[2] + acc[3]);
+}
+
+/* Replicates [first, first + count) into sums */
+static void stats_block(const STATS_SORTED_t *sorted, unsigned first, unsigned count,
+                        double *sums)
+{
+    const STATS_SAMPLE_t *sample = sorted->sample;
+    size_t ns = sample->nseries, ng = sample->ngroups, stride = (ng + 1) * ns;
+    uint64_t state[STATS_BLOCK];
+    double w[STATS_CHUNK];
+
+    /* Each replicate draws from its own stream, whatever the block */
+    for (unsigned r = 0; r < count; r++) {
+        state[r] = sorted->seed ^ ((uint64_t) (first + r) * 0xd1b54a32d192ed03ull);
+        state[r] = stats_splitmix64(&state[r]);
+    }
+    std::fill(sums, sums + (size_t) count * stride, 0.0);
+
+    for (size_t c = 0; c < sample->n; c += STATS_CHUNK) {
+        size_t len = std::min((size_t) STATS_CHUNK, sample->n - c);
+
+        for (unsigned r = 0; r < count; r++) {
+            double *acc = sums + r * stride;
+
+            /* Four weights per 64 random bits */
+            for (size_t i = 0; i < len; i += 4) {
+                uint64_t bits = stats_splitmix64(&state[r]);
+
+                w[i] = stats_poisson[bits & 0xffff];
+                w[i + 1] = stats_poisson[(bits >> 16) & 0xffff];
+                w[i + 2] = stats_poisson[(bits >> 32) & 0xffff];
+                w[i + 3] = stats_poisson[bits >> 48];
+            }
+            for (size_t g = 0; g < ng; g++) {
+                size_t lo = std::max(sorted->start[g], c);
+                size_t hi = std::min(sorted->start[g + 1], c + len);
+
+                if (lo >= hi)
+                    continue;
+                for (size_t s = 0; s < ns; s++)
+                    acc[g * ns + s] += stats_dot(w + (lo - c), &sorted->series[s][lo], hi - lo);
+            }
+        }
+    }
+    for (unsigned r = 0; r < count; r++) {
+        double *all = sums + r * stride + ng * ns;
+
+        for (size_t g = 0; g < ng; g++)
+            for (size_t s = 0; s < ns; s++)
+                all[s] += sums[r * stride + g * ns + s];
+    }
+}
+
+static void stats_job(const STATS_SORTED_t *sorted, std::atomic<unsigned> *cursor,
+                      double *sums)
+{
+    size_t stride = (sorted->sample->ngroups + 1) * sorted->sample->nseries;
+    unsigned first;
+
+    while ((first = cursor->fetch_add(STATS_BLOCK)) < sorted->replicates)
+        stats_block(sorted, first, std::min((unsigned) STATS_BLOCK, sorted->replicates - first),
+                    sums + first * stride);
+}
+
+void stats_bootstrap(const STATS_SAMPLE_t *sample, unsigned replicates, uint64_t seed,
+                     unsigned jobs, std::vector<double>& sums)
+{
+    size_t stride = (sample->ngroups + 1) * sample->nseries;
+    unsigned blocks = (replicates + STATS_BLOCK - 1) / STATS_BLOCK;
+    std::vector<size_t> next(sample->ngroups + 1, 0);
+    std::atomic<unsigned> cursor(0);
+    std::vector<std::thread> threads;
+    STATS_SORTED_t sorted;
+
+    if (stats_poisson[(1 << 16) - 1] == 0)
+        stats_poisson_init();
+
+    /* Counting sort of the pages by group */
+    sorted.sample = sample;
+    sorted.replicates = replicates;
+    sorted.seed = seed;
+    sorted.start.assign(sample->ngroups + 1, 0);
+    for (size_t i = 0; i < sample->n; i++)
+        next[sample->group[i] + 1]++;
+    for (unsigned g = 0; g < sample->ngroups; g++)
+        next[g + 1] += next[g];
+    sorted.start = next;
+    sorted.series.resize(sample->nseries);
+    for (size_t s = 0; s < sample->nseries; s++)
+        sorted.series[s].resize(sample->n);
+    for (size_t i = 0; i < sample->n; i++) {
+        size_t j = next[sample->group[i]]++;
+
+        for (size_t s = 0; s < sample->nseries; s++)
+            sorted.series[s][j] = sample->series[s][i];
+    }
+
+    sums.assign(replicates * stride, 0);
+    if (jobs > blocks)
+        jobs = blocks;
+    for (unsigned j = 1; j < jobs; j++)
+        threads.emplace_back(stats_job, &sorted, &cursor, sums.data());
+    stats_job(&sorted, &cursor, sums.data());
+    for (size_t j = 0; j < threads.size(); j++)
+        threads[j].join();
+}
+
+double stats_quantile(std::vector<double>& values, double q)
+{
+    size_t n, lo;
+    double pos, a, b;
+
+    values.erase(std::remove_if(values.begin(), values.end(),
+                                [](double v) { return !std::isfinite(v); }),
+                 values.end());
+    if ((n = values.size()) == 0)
+        return NAN;
+    pos = q * (double) (n - 1);
+    lo = (size_t) pos;
+    if (lo >= n - 1) {
+        std::nth_element(values.begin(), values.begin() + (n - 1), values.end());
+        return values[n - 1];
+    }
+    std::nth_element(values.begin(), values.begin() + lo, values.end());
+    a = values[lo];
+    b = *std::min_element(values.begin() + lo + 1, values.end());
+    return a + (b - a) * (pos - (double) lo);
+}
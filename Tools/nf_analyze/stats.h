@@ -0,0 +1,51 @@
+/*
+ * stats.h: Grouped sums of paired series and their Poisson bootstrap.
+ *
+ * A sample is n pages, each in one group (its size bucket), with the same
+ * pages measured in every series (the time and output size of each
+ * variant). Ratios of sums are taken over the replicates afterwards, so
+ * one pass serves every group, series and ratio.
+ *
+ * A replicate weights each page by an independent Poisson(1) count rather
+ * than drawing n pages with replacement. The weights of a page do not
+ * depend on the other pages, so the pages stream through once per block
+ * of replicates and the blocks run on any number of threads; for the
+ * sample sizes of a benchmark the two bootstraps agree.
+ */
+
+#ifndef _STATS_H_
+#define _STATS_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+typedef struct {
+    const double *const *series;    /* nseries arrays of n values */
+    size_t nseries;
+    const uint8_t *group;           /* Group of each page, < ngroups */
+    unsigned ngroups;
+    size_t n;
+} STATS_SAMPLE_t;
+
+/*
+ * Sums each series over each group, and over all pages as group ngroups:
+ * sums[g * nseries + s].
+ */
+void stats_sums(const STATS_SAMPLE_t *sample, std::vector<double>& sums);
+
+/*
+ * The sums of stats_sums for each of replicates Poisson bootstrap
+ * replicates: sums[(r * (ngroups + 1) + g) * nseries + s]. Replicate r
+ * depends on seed and r only, not on jobs.
+ */
+void stats_bootstrap(const STATS_SAMPLE_t *sample, unsigned replicates, uint64_t seed,
+                     unsigned jobs, std::vector<double>& sums);
+
+/*
+ * Quantile q of the finite values, interpolated between order statistics;
+ * reorders values. NaN when there is none.
+ */
+double stats_quantile(std::vector<double>& values, double q);
+
+#endif /* !_STATS_H_ */
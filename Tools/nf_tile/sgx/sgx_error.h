@@ -0,0 +1,18 @@
+/*
+ * sgx_error.h: The status codes of the SGX SDK the tile pipeline returns,
+ * with the SDK's values, for the native build of Tools/nf_tile.
+ */
+
+#ifndef _SGX_ERROR_H_
+#define _SGX_ERROR_H_
+
+typedef enum _status_t
+{
+    SGX_SUCCESS                 = 0x0000,
+    SGX_ERROR_UNEXPECTED        = 0x0001,
+    SGX_ERROR_INVALID_PARAMETER = 0x0002,
+    SGX_ERROR_OUT_OF_MEMORY     = 0x0003,
+    SGX_ERROR_MAC_MISMATCH      = 0x3001
+} sgx_status_t;
+
+#endif /* !_SGX_ERROR_H_ */
@@ -0,0 +1,10 @@
+/*
+ * sgx_lfence.h: The speculation barrier of the SDK.
+ */
+
+#ifndef _SGX_LFENCE_H_
+#define _SGX_LFENCE_H_
+
+#define sgx_lfence() __asm__ volatile ("lfence" ::: "memory")
+
+#endif /* !_SGX_LFENCE_H_ */
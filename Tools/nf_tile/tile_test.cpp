@@ -0,0 +1,166 @@
+/*
+ * tile_test.cpp: Checks that nf_tile_run() and nf_tile_run_page() return
+ * nothing usable for a page that fails authentication.
+ *
+ * nf_tile_run() encrypts each tile's output before the tag of the input
+ * has been checked, so it must hold that output back in trusted memory.
+ * Pages of several sizes go through an identity stage once intact, then
+ * with one ciphertext byte or one tag byte flipped. The stage checks that
+ * the output buffer is still untouched while the page runs. An intact
+ * page must come back decryptable under the output IV and its tag. A
+ * tampered one must fail with SGX_ERROR_MAC_MISMATCH, with *oSize 0 and
+ * neither the output bytes nor out_mac touched. nf_tile_run_page() goes
+ * through the same pages; it must not even run its NF over a tampered one.
+ */
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include "nf_tile.h"
+#include "nf_log.h"
+
+#define TILE_TEST_FILL 0xee
+
+/* Output buffer of the page running, which must not change before its end */
+static const uint8_t *tile_test_out;
+static size_t tile_test_out_len;
+
+#define TILE_TEST_CHECK(cond, what) \
+    do { \
+        if (!(cond)) { \
+            fprintf(stderr, "tile_test: %s (page of %zu bytes, %s)\n", what, len, how); \
+            return 1; \
+        } \
+    } while (0)
+
+void nf_log_write(int level, const char *fmt, ...)
+{
+    (void) level;
+    (void) fmt;
+}
+
+static sgx_status_t identity_begin(void *state)
+{
+    (void) state;
+    return SGX_SUCCESS;
+}
+
+static sgx_status_t identity_process(void *state, const uint8_t *data, size_t len,
+                                     NF_EMIT_t *emit)
+{
+    (void) state;
+    for (size_t i = 0; i < tile_test_out_len; i++)
+        if (tile_test_out[i] != TILE_TEST_FILL)
+            return SGX_ERROR_UNEXPECTED;    /* Output released mid-page */
+    return emit->cbf(data, len, emit->user);
+}
+
+static sgx_status_t identity_finish(void *state, NF_EMIT_t *emit)
+{
+    (void) state;
+    (void) emit;
+    return SGX_SUCCESS;
+}
+
+static void identity_end(void *state)
+{
+    (void) state;
+}
+
+static const NF_KERNEL_t identity_kernel = {
+    "identity", identity_begin, identity_process, identity_finish, identity_end
+};
+
+/* The identity over a whole page; user counts the calls */
+static sgx_status_t identity_page(const uint8_t *page, size_t len, NF_EMIT_t *emit, void *user)
+{
+    ++*(int *) user;
+    return identity_process(NULL, page, len, emit);
+}
+
+/*
+ * Runs one page through nf_tile_run(), or nf_tile_run_page() if whole is
+ * set; flip < 0 leaves it intact, flip >= len flips a tag byte
+ */
+static int tile_test_page(const NF_GCM_KEY_t *key, size_t len, long flip, int whole)
+{
+    static const uint8_t in_iv[NF_GCM_IV_SIZE] = {1};
+    static const uint8_t out_iv[NF_GCM_IV_SIZE] = {2};
+    std::vector<uint8_t> plain(len + 1), cypher(len + 1), out(len + 1), back(len + 1);
+    uint8_t in_mac[NF_GCM_TAG_SIZE], out_mac[NF_GCM_TAG_SIZE], sentinel[NF_GCM_TAG_SIZE];
+    NF_STAGE_t stage = {&identity_kernel, NULL, {NULL, NULL}, 0, 0, 0};
+    const char *how = flip < 0 ? "intact" : (size_t) flip < len ? "text flipped" : "tag flipped";
+    size_t oSize = 12345;
+    int calls = 0;
+    sgx_status_t ret;
+
+    for (size_t i = 0; i < len; i++)
+        plain[i] = (uint8_t) (i * 131 + 7);
+    nf_gcm_encrypt(key, in_iv, plain.data(), len, cypher.data(), in_mac);
+    if (flip >= 0 && (size_t) flip < len)
+        cypher[flip] ^= 0x01;
+    else if (flip >= 0)
+        in_mac[(size_t) flip - len] ^= 0x80;
+    memset(sentinel, 0xa5, sizeof(sentinel));
+    memcpy(out_mac, sentinel, sizeof(out_mac));
+    memset(out.data(), TILE_TEST_FILL, out.size());
+    tile_test_out = out.data();
+    tile_test_out_len = len;
+
+    if (whole)
+        ret = nf_tile_run_page(identity_page, &calls, key, in_iv, cypher.data(), len, in_mac,
+                               out_iv, out.data(), len, &oSize, out_mac);
+    else
+        ret = nf_tile_run(&stage, 1, key, in_iv, cypher.data(), len, in_mac, out_iv,
+                          out.data(), len, &oSize, out_mac);
+
+    if (flip < 0) {
+        TILE_TEST_CHECK(ret == SGX_SUCCESS, "intact page failed");
+        TILE_TEST_CHECK(oSize == len, "wrong output size");
+        TILE_TEST_CHECK(nf_gcm_decrypt(key, out_iv, out.data(), oSize, back.data(), out_mac) == 0,
+                        "output tag does not verify");
+        TILE_TEST_CHECK(memcmp(back.data(), plain.data(), len) == 0, "output is not the page");
+        return 0;
+    }
+    TILE_TEST_CHECK(ret == SGX_ERROR_MAC_MISMATCH, "tampered page not rejected");
+    TILE_TEST_CHECK(calls == 0, "tampered page reached the NF");
+    TILE_TEST_CHECK(oSize == 0, "tampered page has an output size");
+    TILE_TEST_CHECK(memcmp(out_mac, sentinel, sizeof(out_mac)) == 0,
+                    "tampered page got an output tag");
+    for (size_t i = 0; i < len; i++)
+        TILE_TEST_CHECK(out[i] == TILE_TEST_FILL, "tampered page left output behind");
+    return 0;
+}
+
+int main(void)
+{
+    static const uint8_t raw_key[NF_GCM_KEY_SIZE] = {0x42};
+    static const size_t sizes[] = {0, 1, 100, NF_TILE_SIZE, 3 * NF_TILE_SIZE + 17};
+    NF_GCM_KEY_t key;
+    int runs = 0;
+
+    nf_gcm_key_init(&key, raw_key);
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        size_t len = sizes[s];
+        /* Intact, first byte, a byte of the last tile, last byte, a tag byte */
+        long flips[] = {-1, 0, (long) (len - len % NF_TILE_SIZE), (long) len - 1, (long) len + 5};
+
+        for (size_t f = 0; f < sizeof(flips) / sizeof(flips[0]); f++) {
+            if (flips[f] >= (long) len && f != 4)
+                continue;   /* No such byte in a short page */
+            if (f > 0 && flips[f] < 0)
+                continue;
+            for (int whole = 0; whole < 2; whole++) {
+                if (tile_test_page(&key, len, flips[f], whole) != 0)
+                    return 1;
+                runs++;
+            }
+        }
+    }
+    nf_gcm_key_clear(&key);
+    printf("TileTest:Pages:%d:Ok\n", runs);
+    return 0;
+}